@@ -41,6 +41,8 @@
 #include <daw/daw_traits.h>
 
 #include "base_error.h"
+#include "base_slab.h"
+#include "base_threading.h"
 
 namespace daw {
 	namespace nodepp {
@@ -129,8 +131,12 @@ namespace daw {
 						using cb_type = std::function<daw::traits::root_type_t<ReturnType>(
 						  typename daw::traits::root_type_t<Args>... )>;
 
-						auto const callback = std::any_cast<cb_type>( m_callback );
-						daw::invoke( callback, std::forward<Args>( args )... );
+						// Cast to a pointer so the std::function is not copied per emit
+						auto const *callback = std::any_cast<cb_type>( &m_callback );
+						if( callback == nullptr ) {
+							throw std::bad_any_cast( );
+						}
+						daw::invoke( *callback, std::forward<Args>( args )... );
 					}
 
 					template<typename ReturnType = void, typename... Args>
@@ -138,8 +144,11 @@ namespace daw {
 						using cb_type = std::function<daw::traits::root_type_t<ReturnType>(
 						  typename daw::traits::root_type_t<Args>... )>;
 
-						auto const callback = std::any_cast<cb_type>( m_callback );
-						daw::invoke( callback, std::forward<Args>( args )... );
+						auto const *callback = std::any_cast<cb_type>( &m_callback );
+						if( callback == nullptr ) {
+							throw std::bad_any_cast( );
+						}
+						daw::invoke( *callback, std::forward<Args>( args )... );
 					}
 
 					explicit operator bool( ) const noexcept {
@@ -156,7 +165,7 @@ namespace daw {
 
 				private:
 					callback_id_t get_next_id( ) const noexcept {
-						static std::atomic<callback_id_t> s_last_id{1};
+						static counter_t<callback_id_t> s_last_id{1};
 						return s_last_id++;
 					}
 				};
@@ -180,7 +189,7 @@ namespace daw {
 
 					listeners_t m_listeners{};
 					size_t m_max_listeners{};
-					std::atomic_int_least8_t m_emit_depth = 0;
+					counter_t<int_least8_t> m_emit_depth{0};
 
 					listeners_t &listeners( ) noexcept {
 						return m_listeners;
@@ -315,8 +324,8 @@ namespace daw {
 			class StandardEventEmitter {
 				using emitter_t =
 				  ee_impl::basic_event_emitter<ee_impl::DefaultMaxEventCount>;
-				std::shared_ptr<emitter_t> m_emitter =
-				  std::make_shared<emitter_t>( 10 );
+				rc_ptr<emitter_t> m_emitter =
+				  make_slab_shared<emitter_t>( 10 );
 
 			public:
 				using callback_id_t = ee_impl::callback_info_t::callback_id_t;
@@ -0,0 +1,171 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <daw/daw_traits.h>
+
+#include "base_threading.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			namespace ha_impl {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Fixed slots for the completion handler memory of one
+				///				connection.  asio may free a handler's memory after the
+				///				handler, and with it the connection, is gone so the block
+				///				stays until its owner and every allocation have let go
+				class arena_block_t {
+				public:
+					static constexpr size_t slot_size = 512;
+					static constexpr size_t slot_count = 4;
+
+				private:
+					struct alignas( std::max_align_t ) slot_t {
+						unsigned char data[slot_size];
+					};
+
+					std::array<slot_t, slot_count> m_slots{};
+					std::array<counter_t<bool>, slot_count> m_in_use{};
+					counter_t<size_t> m_refs{1};
+					counter_t<size_t> m_fallbacks{0};
+
+					arena_block_t( ) noexcept = default;
+					~arena_block_t( ) noexcept = default;
+
+					bool try_take( size_t n ) noexcept;
+
+				public:
+					arena_block_t( arena_block_t const & ) = delete;
+					arena_block_t( arena_block_t && ) = delete;
+					arena_block_t &operator=( arena_block_t const & ) = delete;
+					arena_block_t &operator=( arena_block_t && ) = delete;
+
+					static arena_block_t *create( );
+					void add_ref( ) noexcept;
+					void release( ) noexcept;
+
+					void *allocate( size_t size );
+					void deallocate( void *ptr ) noexcept;
+
+					/// @return How many allocations did not fit and used operator new
+					size_t fallbacks( ) const noexcept;
+				};
+			} // namespace ha_impl
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Recycles the memory asio allocates for the pending operations
+			///				of one connection.  Bind handlers to it with bind_arena.
+			///				Copies share the same slots
+			class handler_arena_t {
+				ha_impl::arena_block_t *m_block;
+
+			public:
+				handler_arena_t( );
+				~handler_arena_t( ) noexcept;
+
+				handler_arena_t( handler_arena_t const &other ) noexcept;
+				handler_arena_t &operator=( handler_arena_t const &rhs ) noexcept;
+				handler_arena_t( handler_arena_t &&other ) noexcept;
+				handler_arena_t &operator=( handler_arena_t &&rhs ) noexcept;
+
+				ha_impl::arena_block_t &block( ) const noexcept;
+				size_t fallbacks( ) const noexcept;
+			};
+
+			template<typename T>
+			class handler_allocator {
+				ha_impl::arena_block_t *m_block;
+
+				template<typename>
+				friend class handler_allocator;
+
+			public:
+				using value_type = T;
+
+				explicit handler_allocator( ha_impl::arena_block_t &block ) noexcept
+				  : m_block( &block ) {}
+
+				template<typename U>
+				handler_allocator( handler_allocator<U> const &other ) noexcept
+				  : m_block( other.m_block ) {}
+
+				T *allocate( size_t n ) {
+					return static_cast<T *>( m_block->allocate( n * sizeof( T ) ) );
+				}
+
+				void deallocate( T *ptr, size_t ) noexcept {
+					m_block->deallocate( ptr );
+				}
+
+				template<typename U>
+				bool operator==( handler_allocator<U> const &rhs ) const noexcept {
+					return m_block == rhs.m_block;
+				}
+
+				template<typename U>
+				bool operator!=( handler_allocator<U> const &rhs ) const noexcept {
+					return m_block != rhs.m_block;
+				}
+			};
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	A completion handler whose associated allocator is an arena
+			template<typename Handler>
+			class arena_handler_t {
+				ha_impl::arena_block_t *m_block;
+				Handler m_handler;
+
+			public:
+				using allocator_type = handler_allocator<Handler>;
+
+				template<typename H>
+				arena_handler_t( ha_impl::arena_block_t &block, H &&handler )
+				  : m_block( &block )
+				  , m_handler( std::forward<H>( handler ) ) {}
+
+				allocator_type get_allocator( ) const noexcept {
+					return allocator_type( *m_block );
+				}
+
+				template<typename... Args>
+				void operator( )( Args &&... args ) {
+					m_handler( std::forward<Args>( args )... );
+				}
+			};
+
+			template<typename Handler>
+			arena_handler_t<daw::remove_cvref_t<Handler>>
+			bind_arena( handler_arena_t const &arena, Handler &&handler ) {
+				return arena_handler_t<daw::remove_cvref_t<Handler>>(
+				  arena.block( ), std::forward<Handler>( handler ) );
+			}
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
@@ -0,0 +1,115 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/buffer.hpp>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#if defined( ASIO_HAS_IO_URING )
+#include <asio/buffer_registration.hpp>
+#include <asio/registered_buffer.hpp>
+#endif
+
+#include "base_service_handle.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	A fixed set of equal sized buffers that, with the io_uring
+			///				backend, are registered with the kernel once so that reads
+			///				and writes using them skip the per operation page pinning.
+			///				With the reactor backend they are plain pooled memory
+			class RegisteredBufferPool {
+			public:
+#if defined( ASIO_HAS_IO_URING )
+				using buffer_type = asio::mutable_registered_buffer;
+#else
+				using buffer_type = asio::mutable_buffer;
+#endif
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	A buffer on loan from the pool.  It is returned when
+				///				destructed
+				class lease_t {
+					RegisteredBufferPool *m_pool = nullptr;
+					size_t m_index = 0;
+
+					friend RegisteredBufferPool;
+					lease_t( RegisteredBufferPool &pool, size_t index ) noexcept;
+
+				public:
+					lease_t( ) noexcept = default;
+					~lease_t( ) noexcept;
+
+					lease_t( lease_t const & ) = delete;
+					lease_t &operator=( lease_t const & ) = delete;
+					lease_t( lease_t &&other ) noexcept;
+					lease_t &operator=( lease_t &&rhs ) noexcept;
+
+					char *data( ) const noexcept;
+					size_t capacity( ) const noexcept;
+
+					/// @return The first size bytes in a form that the io_uring
+					/// backend sends with the fixed buffer operations
+					buffer_type buffer( size_t size ) const noexcept;
+				};
+
+			private:
+				size_t m_buffer_size;
+				std::unique_ptr<char[]> m_memory;
+				std::vector<size_t> m_free;
+				std::mutex m_mutex{};
+#if defined( ASIO_HAS_IO_URING )
+				std::optional<
+				  asio::buffer_registration<std::vector<asio::mutable_buffer>>>
+				  m_registration{};
+#endif
+
+				void release( size_t index ) noexcept;
+
+			public:
+				RegisteredBufferPool( IoService &service, size_t buffer_count,
+				                      size_t buffer_size );
+
+				RegisteredBufferPool( RegisteredBufferPool const & ) = delete;
+				RegisteredBufferPool &
+				operator=( RegisteredBufferPool const & ) = delete;
+				RegisteredBufferPool( RegisteredBufferPool && ) = delete;
+				RegisteredBufferPool &operator=( RegisteredBufferPool && ) = delete;
+				~RegisteredBufferPool( ) noexcept = default;
+
+				size_t buffer_size( ) const noexcept;
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Borrow a buffer that can hold size bytes
+				/// @return	Nothing when size is too big or all buffers are in use
+				std::optional<lease_t> try_acquire( size_t size );
+			};
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
@@ -29,9 +29,29 @@ namespace daw {
 		namespace base {
 			using IoService = asio::io_service;
 
+			class RegisteredBufferPool;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	How the IoService waits for I/O.  Chosen at build time with
+			///				the NODEPP_USE_IO_URING cmake option
+			enum class IoBackend : uint_fast8_t { reactor, io_uring };
+
 			struct ServiceHandle {
 				static IoService &get( );
 
+				static constexpr IoBackend backend( ) noexcept {
+#if defined( ASIO_HAS_IO_URING_AS_DEFAULT )
+					return IoBackend::io_uring;
+#else
+					return IoBackend::reactor;
+#endif
+				}
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Buffers registered with the IoService for small socket
+				///				writes
+				static RegisteredBufferPool &registered_buffers( );
+
 				static void run( );
 				static void stop( );
 				static void reset( );
@@ -43,6 +63,9 @@ namespace daw {
 
 			enum class StartServiceMode : uint_fast8_t { Single, OnePerCore };
 
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Run the io service on this thread, or on one thread per
+			///				core.  OnePerCore throws in NODEPP_SINGLE_THREADED builds
 			void start_service( daw::nodepp::base::StartServiceMode mode =
 			                      daw::nodepp::base::StartServiceMode::Single );
 		} // namespace base
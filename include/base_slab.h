@@ -0,0 +1,146 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "base_threading.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			namespace slab_impl {
+				inline constexpr size_t cache_line_size = 64;
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Blocks larger than this come from operator new
+				inline constexpr size_t max_block_size = 4096;
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	A cache line aligned block of at least size bytes from the
+				///				calling thread's slab
+				void *allocate( size_t size );
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Return a block to the calling thread's slab.  It does not
+				///				have to be the thread that allocated it.  Past a few
+				///				chunks' worth of free blocks of one size, half go back to
+				///				be shared with the other threads
+				void deallocate( void *ptr, size_t size ) noexcept;
+			} // namespace slab_impl
+
+			struct slab_stats_t {
+				/// Chunks carved for all threads so far, they are never released
+				size_t chunks = 0;
+				/// Blocks handed out by the calling thread
+				size_t allocations = 0;
+				/// How many of those were recycled blocks
+				size_t reuses = 0;
+			};
+
+			slab_stats_t slab_stats( );
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	An allocator for per connection objects.  Single objects come
+			///				from a per thread, and so per reactor, slab of cache line
+			///				aligned blocks that are recycled when freed instead of going
+			///				back to the heap.  Arrays use operator new
+			template<typename T>
+			class slab_allocator {
+				static_assert( alignof( T ) <= slab_impl::cache_line_size,
+				               "Over aligned types are not supported" );
+
+			public:
+				using value_type = T;
+
+				constexpr slab_allocator( ) noexcept = default;
+
+				template<typename U>
+				constexpr slab_allocator( slab_allocator<U> const & ) noexcept {}
+
+				T *allocate( size_t n ) {
+					if( n == 1 ) {
+						return static_cast<T *>( slab_impl::allocate( sizeof( T ) ) );
+					}
+					return static_cast<T *>( ::operator new( n * sizeof( T ) ) );
+				}
+
+				void deallocate( T *ptr, size_t n ) noexcept {
+					if( n == 1 ) {
+						slab_impl::deallocate( ptr, sizeof( T ) );
+						return;
+					}
+					::operator delete( ptr );
+				}
+
+				template<typename U>
+				constexpr bool operator==( slab_allocator<U> const & ) const noexcept {
+					return true;
+				}
+
+				template<typename U>
+				constexpr bool operator!=( slab_allocator<U> const & ) const noexcept {
+					return false;
+				}
+			};
+
+			template<typename T>
+			struct slab_deleter {
+				constexpr slab_deleter( ) noexcept = default;
+
+				void operator( )( T *ptr ) const noexcept {
+					ptr->~T( );
+					slab_impl::deallocate( ptr, sizeof( T ) );
+				}
+			};
+
+			template<typename T>
+			using slab_ptr = std::unique_ptr<T, slab_deleter<T>>;
+
+			template<typename T, typename... Args>
+			slab_ptr<T> make_slab_ptr( Args &&... args ) {
+				auto *mem = slab_impl::allocate( sizeof( T ) );
+				try {
+					return slab_ptr<T>( new( mem ) T( std::forward<Args>( args )... ) );
+				} catch( ... ) {
+					slab_impl::deallocate( mem, sizeof( T ) );
+					throw;
+				}
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	A reference counted pointer whose control block and object
+			///				share one slab block
+			template<typename T, typename... Args>
+			rc_ptr<T> make_slab_shared( Args &&... args ) {
+				return allocate_rc<T>( slab_allocator<T>( ),
+				                       std::forward<Args>( args )... );
+			}
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
@@ -81,7 +81,7 @@ namespace daw {
 					template<typename Listener>
 					decltype( auto ) on_all_writes_completed( Listener &&listener ) {
 						derived_emitter( ).template add_listener<Derived>(
-						  "all_writes_completion", std::forward<Listener>( listener ) );
+						  "all_writes_completed", std::forward<Listener>( listener ) );
 						return derived( );
 					}
 
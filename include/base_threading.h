@@ -0,0 +1,199 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <daw/daw_utility.h>
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Set by the NODEPP_SINGLE_THREADED cmake option.  Each io
+			///				service, and every connection on it, is then only used by
+			///				the one thread that runs it
+#if defined( NODEPP_SINGLE_THREADED )
+			inline constexpr bool is_single_threaded = true;
+#else
+			inline constexpr bool is_single_threaded = false;
+#endif
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	A counter that is only atomic when more than one thread can
+			///				reach it
+			template<typename T>
+			using counter_t =
+			  std::conditional_t<is_single_threaded, T, std::atomic<T>>;
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	The shared pointer for state that is copied into every
+			///				handler.  Single threaded builds use rc_ptr_t, whose
+			///				reference count is not atomic
+#if defined( NODEPP_SINGLE_THREADED )
+			namespace rc_impl {
+				struct rc_block_base_t {
+					size_t count = 1;
+					void ( *destroy )( rc_block_base_t * ) noexcept = nullptr;
+				};
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	The count, the allocator and the object in one allocation
+				template<typename T, typename Allocator>
+				struct rc_block_t : rc_block_base_t {
+					using block_allocator_t = typename std::allocator_traits<
+					  Allocator>::template rebind_alloc<rc_block_t>;
+
+					// Kept as given, rebinding it here needs a complete rc_block_t
+					Allocator alloc;
+					T value;
+
+					template<typename... Args>
+					rc_block_t( Allocator const &a, Args &&... args )
+					  : alloc( a )
+					  , value( std::forward<Args>( args )... ) {
+						destroy = &destroy_block;
+					}
+
+					static void destroy_block( rc_block_base_t *base ) noexcept {
+						auto *self = static_cast<rc_block_t *>( base );
+						auto a = block_allocator_t( self->alloc );
+						self->~rc_block_t( );
+						std::allocator_traits<block_allocator_t>::deallocate( a, self, 1 );
+					}
+				};
+			} // namespace rc_impl
+
+			template<typename T>
+			class rc_ptr_t {
+				T *m_ptr = nullptr;
+				rc_impl::rc_block_base_t *m_block = nullptr;
+
+				template<typename U, typename Allocator, typename... Args>
+				friend rc_ptr_t<U> allocate_rc( Allocator const &, Args &&... );
+
+				rc_ptr_t( T *ptr, rc_impl::rc_block_base_t *block ) noexcept
+				  : m_ptr( ptr )
+				  , m_block( block ) {}
+
+			public:
+				using element_type = T;
+
+				constexpr rc_ptr_t( ) noexcept = default;
+				constexpr rc_ptr_t( std::nullptr_t ) noexcept {}
+
+				rc_ptr_t( rc_ptr_t const &other ) noexcept
+				  : m_ptr( other.m_ptr )
+				  , m_block( other.m_block ) {
+					if( m_block != nullptr ) {
+						++m_block->count;
+					}
+				}
+
+				rc_ptr_t( rc_ptr_t &&other ) noexcept
+				  : m_ptr( std::exchange( other.m_ptr, nullptr ) )
+				  , m_block( std::exchange( other.m_block, nullptr ) ) {}
+
+				rc_ptr_t &operator=( rc_ptr_t const &rhs ) noexcept {
+					rc_ptr_t( rhs ).swap( *this );
+					return *this;
+				}
+
+				rc_ptr_t &operator=( rc_ptr_t &&rhs ) noexcept {
+					rc_ptr_t( daw::move( rhs ) ).swap( *this );
+					return *this;
+				}
+
+				~rc_ptr_t( ) {
+					if( m_block != nullptr and --m_block->count == 0 ) {
+						m_block->destroy( m_block );
+					}
+				}
+
+				void swap( rc_ptr_t &other ) noexcept {
+					std::swap( m_ptr, other.m_ptr );
+					std::swap( m_block, other.m_block );
+				}
+
+				void reset( ) noexcept {
+					rc_ptr_t( ).swap( *this );
+				}
+
+				T *get( ) const noexcept {
+					return m_ptr;
+				}
+
+				T &operator*( ) const noexcept {
+					return *m_ptr;
+				}
+
+				T *operator->( ) const noexcept {
+					return m_ptr;
+				}
+
+				explicit operator bool( ) const noexcept {
+					return m_ptr != nullptr;
+				}
+
+				size_t use_count( ) const noexcept {
+					return m_block == nullptr ? 0U : m_block->count;
+				}
+			};
+
+			template<typename T>
+			using rc_ptr = rc_ptr_t<T>;
+
+			template<typename T, typename Allocator, typename... Args>
+			rc_ptr_t<T> allocate_rc( Allocator const &alloc, Args &&... args ) {
+				using block_t = rc_impl::rc_block_t<T, Allocator>;
+				using traits_t =
+				  std::allocator_traits<typename block_t::block_allocator_t>;
+				auto block_alloc = typename block_t::block_allocator_t( alloc );
+				auto *mem = traits_t::allocate( block_alloc, 1 );
+				try {
+					auto *block = new( static_cast<void *>( mem ) )
+					  block_t( alloc, std::forward<Args>( args )... );
+					return rc_ptr_t<T>( &block->value, block );
+				} catch( ... ) {
+					traits_t::deallocate( block_alloc, mem, 1 );
+					throw;
+				}
+			}
+#else
+			template<typename T>
+			using rc_ptr = std::shared_ptr<T>;
+
+			template<typename T, typename Allocator, typename... Args>
+			rc_ptr<T> allocate_rc( Allocator const &alloc, Args &&... args ) {
+				return std::allocate_shared<T>( alloc, std::forward<Args>( args )... );
+			}
+#endif
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
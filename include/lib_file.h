@@ -22,7 +22,10 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <type_traits>
 
 #include <daw/daw_string_view.h>
@@ -40,6 +43,32 @@ namespace daw {
 
 				std::streampos file_size( daw::string_view path );
 
+				enum class FileWriteMode : uint_fast8_t {
+					OverwriteOrCreate,
+					AppendOrCreate,
+					MustCreate
+				};
+
+				namespace impl {
+					using read_callback_t = std::function<void(
+					  std::optional<base::Error>, std::shared_ptr<base::data_t> )>;
+					using write_callback_t =
+					  std::function<void( std::optional<base::Error> )>;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Append the file to buffer.  With the io_uring backend
+					///				the IoService does the read, otherwise it blocks a task
+					///				pool thread.  on_completion runs on the IoService
+					void read_file_async( daw::string_view path,
+					                      std::shared_ptr<base::data_t> buffer,
+					                      read_callback_t on_completion );
+
+					void write_file_async( daw::string_view path,
+					                       std::shared_ptr<base::data_t const> buffer,
+					                       FileWriteMode mode, size_t bytes_to_write,
+					                       write_callback_t on_completion );
+				} // namespace impl
+
 				//////////////////////////////////////////////////////////////////////////
 				/// @brief	Reads in contents of file and appends it to buffer
 				std::optional<base::Error> read_file( daw::string_view path,
@@ -56,25 +85,15 @@ namespace daw {
 					                      std::shared_ptr<base::data_t>>,
 					  "Callback does not accept required arguments" );
 
-					base::add_task(
-					  [path, buffer = mutable_capture( daw::move( buffer ) ),
-					   append_buffer]( ) {
-						  if( !( *buffer ) ) {
-							  buffer->reset( new base::data_t{} );
-						  } else if( !append_buffer ) {
-							  ( *buffer )->resize( 0 );
-						  }
-						  return read_file( path, **buffer );
-					  },
-					  std::forward<Callback>( on_completion ) );
+					if( !buffer ) {
+						buffer = std::make_shared<base::data_t>( );
+					} else if( !append_buffer ) {
+						buffer->resize( 0 );
+					}
+					impl::read_file_async( path, daw::move( buffer ),
+					                       std::forward<Callback>( on_completion ) );
 				}
 
-				enum class FileWriteMode : uint_fast8_t {
-					OverwriteOrCreate,
-					AppendOrCreate,
-					MustCreate
-				};
-
 				std::optional<base::Error>
 				write_file( daw::string_view path, base::data_t const &buffer,
 				            FileWriteMode mode = FileWriteMode::MustCreate,
@@ -90,11 +109,9 @@ namespace daw {
 					  std::is_invocable_v<Callback, std::optional<base::Error>>,
 					  "Callback does not accept requried arguments" );
 
-					base::add_task(
-					  [path, buffer = daw::move( buffer ), mode, bytes_to_write]( ) {
-						  return write_file( path, buffer, mode, bytes_to_write );
-					  },
-					  std::forward<Callback>( on_completion ) );
+					impl::write_file_async(
+					  path, std::make_shared<base::data_t const>( daw::move( buffer ) ),
+					  mode, bytes_to_write, std::forward<Callback>( on_completion ) );
 				}
 
 			} // namespace file
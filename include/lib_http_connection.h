@@ -34,24 +34,30 @@ namespace daw {
 			namespace http {
 				enum class HttpConnectionState : uint_fast8_t { Request, Message };
 
-				template<typename EventEmitter>
+				template<typename EventEmitter,
+				         typename Socket = net::nss_impl::BoostSocket>
 				class basic_http_server_connection_t
 				  : public base::BasicStandardEvents<
-				      basic_http_server_connection_t<EventEmitter>, EventEmitter> {
+				      basic_http_server_connection_t<EventEmitter, Socket>,
+				      EventEmitter> {
 
 					using base::BasicStandardEvents<
-					  basic_http_server_connection_t<EventEmitter>,
+					  basic_http_server_connection_t<EventEmitter, Socket>,
 					  EventEmitter>::emitter;
 
-					net::NetSocketStream<EventEmitter> m_socket;
+				public:
+					using socket_t = net::NetSocketStream<EventEmitter, Socket>;
+					using response_t = HttpServerResponse<EventEmitter, Socket>;
+
+				private:
+					socket_t m_socket;
 
 				public:
 					explicit basic_http_server_connection_t(
-					  net::NetSocketStream<EventEmitter> &&socket,
-					  EventEmitter &&emitter = EventEmitter( ) )
+					  socket_t &&socket, EventEmitter &&emitter = EventEmitter( ) )
 					  : base::BasicStandardEvents<
-					      basic_http_server_connection_t<EventEmitter>, EventEmitter>(
-					      daw::move( emitter ) )
+					      basic_http_server_connection_t<EventEmitter, Socket>,
+					      EventEmitter>( daw::move( emitter ) )
 					  , m_socket( daw::move( socket ) ) {}
 
 					// Event callbacks
@@ -75,8 +81,7 @@ namespace daw {
 					template<typename Listener>
 					basic_http_server_connection_t &
 					on_request_made( Listener &&listener ) {
-						base::add_listener<HttpClientRequest,
-						                   HttpServerResponse<EventEmitter> &>(
+						base::add_listener<HttpClientRequest, response_t &>(
 						  "request_made", emitter( ), std::forward<Listener>( listener ) );
 						return *this;
 					}
@@ -84,8 +89,7 @@ namespace daw {
 					template<typename Listener>
 					basic_http_server_connection_t &
 					on_next_request_made( Listener &&listener ) {
-						base::add_listener<HttpClientRequest,
-						                   HttpServerResponse<EventEmitter>>(
+						base::add_listener<HttpClientRequest, response_t>(
 						  "request_made", emitter( ), std::forward<Listener>( listener ),
 						  base::callback_run_mode_t::run_once );
 						return *this;
@@ -116,8 +120,7 @@ namespace daw {
 							      "event" );
 
 							    try {
-								    auto response =
-								      HttpServerResponse<EventEmitter>( obj->m_socket );
+								    auto response = response_t( obj->m_socket );
 								    response.start( );
 								    try {
 									    auto request = parse_http_request( daw::string_view(
@@ -150,7 +153,7 @@ namespace daw {
 						m_socket.read_async( );
 					}
 
-					net::NetSocketStream<EventEmitter> socket( ) {
+					socket_t socket( ) {
 						return m_socket;
 					}
 
@@ -163,7 +166,7 @@ namespace daw {
 					}
 
 					void emit_request_made( HttpClientRequest request,
-					                        HttpServerResponse<EventEmitter> response ) {
+					                        response_t response ) {
 						emitter( ).emit( "request_made", std::move( request ), std::move( response ) );
 					}
 				};
@@ -29,6 +29,7 @@
 #include <daw/daw_exception.h>
 
 #include "base_event_emitter.h"
+#include "base_slab.h"
 #include "lib_http_connection.h"
 #include "lib_http_server_response.h"
 #include "lib_net_server.h"
@@ -38,31 +39,40 @@ namespace daw {
 		namespace lib {
 			namespace http {
 				/// @brief		An HTTP Server class
-				///
-				template<typename EventEmitter>
+				/// Socket is as for net::basic_net_server_t, use
+				/// net::nss_impl::PlainSocket when the server never uses TLS
+				template<typename EventEmitter,
+				         typename Socket = net::nss_impl::BoostSocket>
 				class basic_http_server_t
-				  : public base::BasicStandardEvents<basic_http_server_t<EventEmitter>,
-				                                     EventEmitter> {
+				  : public base::BasicStandardEvents<
+				      basic_http_server_t<EventEmitter, Socket>, EventEmitter> {
 
-					using base::BasicStandardEvents<basic_http_server_t<EventEmitter>,
-							EventEmitter>::emitter;
-					using base::BasicStandardEvents<basic_http_server_t<EventEmitter>,
-					                                EventEmitter>::emit_error;
+					using base::BasicStandardEvents<
+					  basic_http_server_t<EventEmitter, Socket>, EventEmitter>::emitter;
+					using base::BasicStandardEvents<
+					  basic_http_server_t<EventEmitter, Socket>,
+					  EventEmitter>::emit_error;
 
-					net::basic_net_server_t<EventEmitter> m_netserver;
-					std::list<basic_http_server_connection_t<EventEmitter>> m_connections;
-
-					static void
-					handle_connection( basic_http_server_t<EventEmitter> &self,
-					                   net::NetSocketStream<EventEmitter> socket ) {
+				public:
+					using net_server_t = net::basic_net_server_t<EventEmitter, Socket>;
+					using socket_t = typename net_server_t::socket_t;
+					using connection_t =
+					  basic_http_server_connection_t<EventEmitter, Socket>;
+
+				private:
+					net_server_t m_netserver;
+					std::list<connection_t, base::slab_allocator<connection_t>>
+					  m_connections;
+
+					static void handle_connection( basic_http_server_t &self,
+					                               socket_t socket ) {
 						try {
 							if( !socket or !( socket.is_open( ) ) or socket.is_closed( ) ) {
 								self.emit_error( "Invalid socket passed to handle_connection",
 								                 "basic_http_server_t::handle_connection" );
 								return;
 							}
-							auto connection = basic_http_server_connection_t<EventEmitter>(
-							  daw::move( socket ) );
+							auto connection = connection_t( daw::move( socket ) );
 
 							auto it = self.m_connections.emplace( self.m_connections.end( ),
 							                                      connection );
@@ -99,24 +109,25 @@ namespace daw {
 				public:
 					explicit basic_http_server_t(
 					  EventEmitter &&emitter = EventEmitter( ) )
-					  : base::BasicStandardEvents<basic_http_server_t<EventEmitter>,
-					                              EventEmitter>( daw::move( emitter ) )
-					  , m_netserver( net::basic_net_server_t<EventEmitter>( ) ) {}
+					  : base::BasicStandardEvents<
+					      basic_http_server_t<EventEmitter, Socket>, EventEmitter>(
+					      daw::move( emitter ) )
+					  , m_netserver( net_server_t( ) ) {}
 
 					explicit basic_http_server_t(
 					  net::SslServerConfig const &ssl_config,
 					  EventEmitter &&emitter = EventEmitter( ) )
-					  : base::BasicStandardEvents<basic_http_server_t<EventEmitter>,
-					                              EventEmitter>( daw::move( emitter ) )
-					  , m_netserver(
-					      net::basic_net_server_t<EventEmitter>( ssl_config ) ) {}
+					  : base::BasicStandardEvents<
+					      basic_http_server_t<EventEmitter, Socket>, EventEmitter>(
+					      daw::move( emitter ) )
+					  , m_netserver( net_server_t( ssl_config ) ) {}
 
 					void listen_on( uint16_t port, net::ip_version ip_ver,
 					                uint16_t max_backlog ) {
 						try {
 							m_netserver
 							  .on_connection(
-							    [self = this]( net::NetSocketStream<EventEmitter> socket ) {
+							    [self = this]( socket_t socket ) {
 								    handle_connection( *self, daw::move( socket ) );
 							    } )
 							  .on_error( emitter( ), "Error listening",
@@ -134,7 +145,7 @@ namespace daw {
 						try {
 							m_netserver
 							  .on_connection(
-							    [self = this]( net::NetSocketStream<EventEmitter> socket ) {
+							    [self = this]( socket_t socket ) {
 								    handle_connection( *self, daw::move( socket ) );
 							    } )
 							  .on_error( emitter( ), "Error listening",
@@ -152,6 +163,78 @@ namespace daw {
 						listen_on( port, net::ip_version::ipv6 );
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Serve on a unix domain socket, for a proxy on the same
+					///				host
+					void listen_on( net::UnixEndPoint const &endpoint,
+					                uint16_t max_backlog ) {
+						try {
+							m_netserver
+							  .on_connection(
+							    [self = this]( socket_t socket ) {
+								    handle_connection( *self, daw::move( socket ) );
+							    } )
+							  .on_error( emitter( ), "Error listening",
+							             "basic_http_server_t::listen_on" )
+							  .template delegate_to<net::EndPoint>( "listening", emitter( ),
+							                                        "listening" )
+							  .listen_unix( endpoint.path, max_backlog );
+						} catch( ... ) {
+							emit_error( std::current_exception( ), "Error while listening",
+							            "basic_http_server_t::listen_on" );
+						}
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	TCP tuning for the listening and accepted sockets.  Set
+					///				before listen_on
+					basic_http_server_t &
+					set_socket_options( net::SocketOptions const &options ) {
+						m_netserver.set_socket_options( options );
+						return *this;
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Outstanding accepts, backlog draining and the connection
+					///				limit.  Plaintext connections over max_connections get
+					///				a 503 unless overload_response says otherwise.  Set
+					///				before listen_on
+					basic_http_server_t &
+					set_accept_options( net::AcceptOptions options ) {
+						if( options.get_max_connections( ) != 0 and
+						    !options.overload_response ) {
+							options.overload_response =
+							  "HTTP/1.1 503 Service Unavailable\r\n"
+							  "Content-Length: 0\r\n"
+							  "Retry-After: 1\r\n"
+							  "Connection: close\r\n\r\n";
+						}
+						m_netserver.set_accept_options( options );
+						return *this;
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Pick up rotated TLS certificates without restarting.
+					///				Connections already open keep their context
+					basic_http_server_t &reload_tls_context( ) {
+						m_netserver.reload_tls_context( );
+						return *this;
+					}
+
+					basic_http_server_t &
+					reload_tls_context( net::SslServerConfig const &ssl_config ) {
+						m_netserver.reload_tls_context( ssl_config );
+						return *this;
+					}
+
+					net::TlsSessionStats tls_session_stats( ) const {
+						return m_netserver.tls_session_stats( );
+					}
+
+					net::AcceptStats accept_stats( ) const {
+						return m_netserver.accept_stats( );
+					}
+
 					template<bool NotImplemented = true>
 					size_t &max_header_count( ) {
 						static_assert( !NotImplemented );
@@ -187,7 +270,7 @@ namespace daw {
 
 					template<typename Listener>
 					basic_http_server_t &on_next_connected( Listener &&listener ) {
-						base::add_listener<basic_http_server_connection_t<EventEmitter>>(
+						base::add_listener<connection_t>(
 						  "client_connected", emitter( ),
 						  std::forward<Listener>( listener ),
 						  base::callback_run_mode_t::run_once );
@@ -196,7 +279,7 @@ namespace daw {
 
 					template<typename Listener>
 					basic_http_server_t &on_client_connected( Listener &&listener ) {
-						base::add_listener<basic_http_server_connection_t<EventEmitter>>(
+						base::add_listener<connection_t>(
 						  "client_connected", emitter( ),
 						  std::forward<Listener>( listener ) );
 						return *this;
@@ -204,7 +287,7 @@ namespace daw {
 
 					template<typename Listener>
 					basic_http_server_t &on_next_client_connected( Listener &&listener ) {
-						base::add_listener<basic_http_server_connection_t<EventEmitter>>(
+						base::add_listener<connection_t>(
 						  "client_connected", emitter( ),
 						  std::forward<Listener>( listener ),
 						  base::callback_run_mode_t::run_once );
@@ -231,8 +314,7 @@ namespace daw {
 						static_assert( !NotImplemented );
 					}
 
-					void emit_client_connected(
-					  basic_http_server_connection_t<EventEmitter> connection ) {
+					void emit_client_connected( connection_t connection ) {
 						emitter( ).emit( "client_connected", daw::move( connection ) );
 					}
 
@@ -246,6 +328,9 @@ namespace daw {
 				};
 
 				using HttpServer = basic_http_server_t<base::StandardEventEmitter>;
+				using HttpPlainServer =
+				  basic_http_server_t<base::StandardEventEmitter,
+				                      net::nss_impl::PlainSocket>;
 			} // namespace http
 		}   // namespace lib
 	}     // namespace nodepp
@@ -55,21 +55,26 @@ namespace daw {
 					};
 				} // namespace hsr_impl
 
-				template<typename EventEmitter = base::StandardEventEmitter>
+				template<typename EventEmitter = base::StandardEventEmitter,
+				         typename Socket = net::nss_impl::BoostSocket>
 				class HttpServerResponse
 				  : public base::stream::StreamWritableEvents<
-				      HttpServerResponse<EventEmitter>>,
-				    public base::BasicStandardEvents<HttpServerResponse<EventEmitter>,
-				                                     EventEmitter> {
+				      HttpServerResponse<EventEmitter, Socket>>,
+				    public base::BasicStandardEvents<
+				      HttpServerResponse<EventEmitter, Socket>, EventEmitter> {
 
-					net::NetSocketStream<EventEmitter> m_socket;
+				public:
+					using socket_t = net::NetSocketStream<EventEmitter, Socket>;
+
+				private:
+					socket_t m_socket;
 
 					std::shared_ptr<hsr_impl::response_data_t> m_response_data;
 
 					template<typename Action>
 					bool on_socket_if_valid( Action &&action ) {
 						static_assert(
-						  std::is_invocable_v<Action, net::NetSocketStream<EventEmitter> &>,
+						  std::is_invocable_v<Action, socket_t &>,
 						  "Action must accept a NetSocketStream as an argument" );
 
 						if( m_socket.expired( ) ) {
@@ -80,25 +85,29 @@ namespace daw {
 					}
 
 				public:
-					explicit HttpServerResponse(
-					  net::NetSocketStream<EventEmitter> socket )
-					  : base::BasicStandardEvents<HttpServerResponse<EventEmitter>,
-					                              EventEmitter>( )
+					explicit HttpServerResponse( socket_t socket )
+					  : base::BasicStandardEvents<
+					      HttpServerResponse<EventEmitter, Socket>, EventEmitter>( )
 					  , m_socket( daw::move( socket ) )
 					  , m_response_data( ) {}
 
-					explicit HttpServerResponse(
-					  net::NetSocketStream<EventEmitter> socket, EventEmitter emitter )
-					  : base::BasicStandardEvents<HttpServerResponse<EventEmitter>,
-					                              EventEmitter>( daw::move( emitter ) )
+					explicit HttpServerResponse( socket_t socket, EventEmitter emitter )
+					  : base::BasicStandardEvents<
+					      HttpServerResponse<EventEmitter, Socket>, EventEmitter>(
+					      daw::move( emitter ) )
 					  , m_socket( daw::move( socket ) )
 					  , m_response_data( ) {}
 
 					~HttpServerResponse( ) noexcept {
 						// Attempt cleanup
 						try {
-							on_socket_if_valid( []( net::NetSocketStream<EventEmitter> &s ) {
-								s.close( false );
+							on_socket_if_valid( []( socket_t &s ) {
+								if( s.pending_writes( ) > 0 ) {
+									// Let a file or body that is still being sent finish
+									s.close_when_writes_completed( );
+								} else {
+									s.close( false );
+								}
 							} );
 						} catch( ... ) {
 							// Do nothing
@@ -115,7 +124,7 @@ namespace daw {
 
 					HttpServerResponse &write_raw_body( base::data_t const &data ) {
 						on_socket_if_valid(
-						  [&data]( net::NetSocketStream<EventEmitter> socket ) {
+						  [&data]( socket_t socket ) {
 							  socket.write( data );
 						  } );
 						return *this;
@@ -149,7 +158,7 @@ namespace daw {
 					HttpServerResponse &end( ) {
 						send( );
 						on_socket_if_valid(
-						  []( net::NetSocketStream<EventEmitter> socket ) {
+						  []( socket_t socket ) {
 							  socket.end( );
 						  } );
 						return *this;
@@ -167,8 +176,8 @@ namespace daw {
 							send( );
 						}
 						on_socket_if_valid(
-						  []( net::NetSocketStream<EventEmitter> socket ) {
-							  socket.end( ).close( );
+						  []( socket_t socket ) {
+							  socket.close_when_writes_completed( );
 						  } );
 					}
 
@@ -176,7 +185,7 @@ namespace daw {
 						try {
 							auto self = HttpServerResponse( *this );
 							on_socket_if_valid(
-							  [&]( net::NetSocketStream<EventEmitter> socket ) {
+							  [&]( socket_t socket ) {
 								  socket.on_write_completion(
 								    [self = mutable_capture( self )]( auto ) {
 									    self->emit_write_completion( *self );
@@ -208,7 +217,7 @@ namespace daw {
 						  std::to_string( status.code ) + " " + status.message + "\r\n";
 
 						m_response_data->m_status_sent = on_socket_if_valid(
-						  [&msg]( net::NetSocketStream<EventEmitter> socket ) {
+						  [&msg]( socket_t socket ) {
 							  socket.write_async( msg ); // TODO: make faster
 						  } );
 						return *this;
@@ -222,7 +231,7 @@ namespace daw {
 						                  status_msg.to_string( ) + "\r\n";
 
 						m_response_data->m_status_sent = on_socket_if_valid(
-						  [&msg]( net::NetSocketStream<EventEmitter> socket ) {
+						  [&msg]( socket_t socket ) {
 							  socket.write_async( msg ); // TODO: make faster
 						  } );
 						return *this;
@@ -230,7 +239,7 @@ namespace daw {
 
 					HttpServerResponse &send_headers( ) {
 						m_response_data->m_headers_sent = on_socket_if_valid(
-						  [&]( net::NetSocketStream<EventEmitter> socket ) {
+						  [&]( socket_t socket ) {
 							  auto &dte = m_response_data->m_headers["Date"];
 							  if( dte.empty( ) ) {
 								  dte = hsr_impl::gmt_timestamp( );
@@ -242,7 +251,7 @@ namespace daw {
 
 					HttpServerResponse &send_body( ) {
 						m_response_data->m_body_sent = on_socket_if_valid(
-						  [&]( net::NetSocketStream<EventEmitter> socket ) {
+						  [&]( socket_t socket ) {
 							  HttpHeader content_header{
 							    "Content-Length",
 							    std::to_string( m_response_data->m_body.size( ) )};
@@ -304,7 +313,7 @@ namespace daw {
 
 					HttpServerResponse &prepare_raw_write( size_t content_length ) {
 						on_socket_if_valid(
-						  [&]( net::NetSocketStream<EventEmitter> socket ) {
+						  [&]( socket_t socket ) {
 							  m_response_data->m_body_sent = true;
 							  m_response_data->m_body.clear( );
 							  send( );
@@ -318,7 +327,7 @@ namespace daw {
 
 					HttpServerResponse &write_file( daw::string_view file_name ) {
 						on_socket_if_valid(
-						  [file_name]( net::NetSocketStream<EventEmitter> socket ) {
+						  [file_name]( socket_t socket ) {
 							  socket.send_file( file_name );
 						  } );
 						return *this;
@@ -326,16 +335,17 @@ namespace daw {
 
 					HttpServerResponse &write_file_async( string_view file_name ) {
 						on_socket_if_valid(
-						  [file_name]( net::NetSocketStream<EventEmitter> socket ) {
+						  [file_name]( socket_t socket ) {
 							  socket.send_file_async( file_name );
 						  } );
 						return *this;
 					}
 				}; // struct HttpServerResponse
 
-				template<typename EventEmitter>
+				template<typename EventEmitter, typename Socket>
 				void create_http_server_error_response(
-				  HttpServerResponse<EventEmitter> response, uint16_t error_no ) {
+				  HttpServerResponse<EventEmitter, Socket> response,
+				  uint16_t error_no ) {
 					auto msg = HttpStatusCodes( error_no );
 					if( msg.code != error_no ) {
 						msg.code = error_no;
@@ -42,7 +42,8 @@ namespace daw {
 	namespace nodepp {
 		namespace lib {
 			namespace http {
-				template<typename EventEmitter>
+				template<typename EventEmitter,
+				         typename Socket = net::nss_impl::BoostSocket>
 				struct basic_http_site_t;
 
 				namespace hs_impl {
@@ -50,17 +51,18 @@ namespace daw {
 					                   boost::filesystem::path child );
 					std::string find_host_name( HttpClientRequest const &request );
 
-					template<typename EventEmitter>
+					template<typename EventEmitter, typename Socket>
 					void default_page_error_listener(
-					  HttpServerResponse<EventEmitter> const &response,
+					  HttpServerResponse<EventEmitter, Socket> const &response,
 					  uint16_t error_no ) {
 						create_http_server_error_response( response, error_no );
 					}
 
-					template<typename EventEmitter>
-					void handle_request_made( HttpClientRequest const &request,
-					                          HttpServerResponse<EventEmitter> &response,
-					                          basic_http_site_t<EventEmitter> &self ) {
+					template<typename EventEmitter, typename Socket>
+					void handle_request_made(
+					  HttpClientRequest const &request,
+					  HttpServerResponse<EventEmitter, Socket> &response,
+					  basic_http_site_t<EventEmitter, Socket> &self ) {
 
 						auto host = std::string( );
 						try {
@@ -92,13 +94,14 @@ namespace daw {
 						}
 					}
 
-					template<typename EventEmitter = base::StandardEventEmitter>
+					template<typename EventEmitter = base::StandardEventEmitter,
+					         typename Socket = net::nss_impl::BoostSocket>
 					struct site_registration {
 						std::string host{}; // * = any
 						std::string
 						  path{}; // postfixing with a * means match left(will mean)
 						std::function<void( HttpClientRequest,
-						                    HttpServerResponse<EventEmitter> )>
+						                    HttpServerResponse<EventEmitter, Socket> )>
 						  listener{};
 						HttpClientRequestMethod method = HttpClientRequestMethod::Any;
 
@@ -120,55 +123,55 @@ namespace daw {
 
 							static_assert(
 							  std::is_invocable_v<std::decay_t<Listener>, HttpClientRequest,
-							                      HttpServerResponse<EventEmitter>>,
+							                      HttpServerResponse<EventEmitter, Socket>>,
 							  "Listener must take arguments of type "
 							  "HttpClientRequest and HttpServerResponse" );
 						}
 
 					}; // site_registration
 
-					template<typename EventEmitter>
-					bool
-					operator==( site_registration<EventEmitter> const &lhs,
-					            site_registration<EventEmitter> const &rhs ) noexcept {
+					template<typename EventEmitter, typename Socket>
+					bool operator==(
+					  site_registration<EventEmitter, Socket> const &lhs,
+					  site_registration<EventEmitter, Socket> const &rhs ) noexcept {
 						return ( lhs.method == rhs.method ) and ( lhs.host == rhs.host ) and
 						       ( lhs.path == rhs.path );
 					}
 				} // namespace hs_impl
 
-				template<typename EventEmitter>
+				template<typename EventEmitter, typename Socket>
 				struct basic_http_site_t
-				  : public base::BasicStandardEvents<basic_http_site_t<EventEmitter>,
-				                                     EventEmitter> {
-
-					using base::BasicStandardEvents<basic_http_site_t<EventEmitter>,
-					                                EventEmitter>::emitter;
-					using registered_pages_t =
-					  std::vector<hs_impl::site_registration<EventEmitter>>;
+				  : public base::BasicStandardEvents<
+				      basic_http_site_t<EventEmitter, Socket>, EventEmitter> {
+
+					using base::BasicStandardEvents<
+					  basic_http_site_t<EventEmitter, Socket>, EventEmitter>::emitter;
+					using registration_t =
+					  hs_impl::site_registration<EventEmitter, Socket>;
+					using registered_pages_t = std::vector<registration_t>;
 					using iterator = typename registered_pages_t::iterator;
 					using emitter_t = EventEmitter;
+					using server_t = basic_http_server_t<EventEmitter, Socket>;
+					using response_t = HttpServerResponse<EventEmitter, Socket>;
 
 				private:
-					basic_http_server_t<EventEmitter> m_server{};
+					server_t m_server{};
 					registered_pages_t m_registered_sites{};
 					std::unordered_map<
 					  uint16_t,
-					  std::function<void( HttpClientRequest,
-					                      HttpServerResponse<EventEmitter>, uint16_t )>>
+					  std::function<void( HttpClientRequest, response_t, uint16_t )>>
 					  m_error_listeners{};
 
 					void sort_registered( ) {
 						daw::container::sort(
 						  m_registered_sites,
-						  []( hs_impl::site_registration<EventEmitter> const &lhs,
-						      hs_impl::site_registration<EventEmitter> const &rhs ) {
+						  []( registration_t const &lhs, registration_t const &rhs ) {
 							  return lhs.host < rhs.host;
 						  } );
 
 						daw::container::stable_sort(
 						  m_registered_sites,
-						  []( hs_impl::site_registration<EventEmitter> const &lhs,
-						      hs_impl::site_registration<EventEmitter> const &rhs ) {
+						  []( registration_t const &lhs, registration_t const &rhs ) {
 							  return lhs.path < rhs.path;
 						  } );
 					}
@@ -182,7 +185,7 @@ namespace daw {
 						  .on_client_connected(
 						    [obj = mutable_capture( emitter( ) ),
 						     site = mutable_capture( *this )](
-						      basic_http_server_connection_t<EventEmitter> connection ) {
+						      typename server_t::connection_t connection ) {
 							    try {
 								    connection
 								      .on_error(
@@ -191,8 +194,7 @@ namespace daw {
 								      .delegate_to( "client_error", *obj, "error" )
 								      .on_request_made(
 								        [obj, site = daw::move( site )](
-								          HttpClientRequest request,
-								          HttpServerResponse<EventEmitter> response ) {
+								          HttpClientRequest request, response_t response ) {
 									        try {
 										        hs_impl::handle_request_made( daw::move( request ),
 										                                      daw::move( response ),
@@ -215,16 +217,17 @@ namespace daw {
 					basic_http_site_t( ) = default;
 
 					explicit basic_http_site_t( EventEmitter &&emitter )
-					  : base::BasicStandardEvents<basic_http_site_t<EventEmitter>,
-					                              EventEmitter>( daw::move( emitter ) ) {}
+					  : base::BasicStandardEvents<
+					      basic_http_site_t<EventEmitter, Socket>, EventEmitter>(
+					      daw::move( emitter ) ) {}
 
-					explicit basic_http_site_t( basic_http_server_t<EventEmitter> server )
+					explicit basic_http_site_t( server_t server )
 					  : m_server( daw::move( server ) ) {}
 
-					basic_http_site_t( basic_http_server_t<EventEmitter> server,
-					                   EventEmitter &&emitter )
-					  : base::BasicStandardEvents<basic_http_site_t<EventEmitter>,
-					                              EventEmitter>( daw::move( emitter ) )
+					basic_http_site_t( server_t server, EventEmitter &&emitter )
+					  : base::BasicStandardEvents<
+					      basic_http_site_t<EventEmitter, Socket>, EventEmitter>(
+					      daw::move( emitter ) )
 					  , m_server( daw::move( server ) ) {}
 
 					explicit basic_http_site_t( net::SslServerConfig const &ssl_config )
@@ -232,8 +235,9 @@ namespace daw {
 
 					basic_http_site_t( net::SslServerConfig const &ssl_config,
 					                   EventEmitter &&emitter )
-					  : base::BasicStandardEvents<basic_http_site_t<EventEmitter>,
-					                              EventEmitter>( daw::move( emitter ) )
+					  : base::BasicStandardEvents<
+					      basic_http_site_t<EventEmitter, Socket>, EventEmitter>(
+					      daw::move( emitter ) )
 					  , m_server( ssl_config ) {}
 
 					//////////////////////////////////////////////////////////////////////////
@@ -245,7 +249,7 @@ namespace daw {
 					                                    Listener &&listener ) {
 						static_assert(
 						  std::is_invocable_v<std::decay_t<Listener>, HttpClientRequest &,
-						                      HttpServerResponse<EventEmitter> &>,
+						                      response_t &>,
 						  "Listener must accept HttpClientRequest and "
 						  "HttpServerResponse as arguments" );
 
@@ -266,7 +270,7 @@ namespace daw {
 						Unused( path );
 						static_assert(
 						  std::is_invocable_v<std::decay_t<Listener>, HttpClientRequest,
-						                      HttpServerResponse<EventEmitter>>,
+						                      response_t>,
 						  "Listener must accept HttpClientRequest and "
 						  "HttpServerResponse as arguments" );
 
@@ -287,8 +291,7 @@ namespace daw {
 					iterator match_site( daw::string_view host, daw::string_view path,
 					                     HttpClientRequestMethod method ) {
 
-						auto const key =
-						  hs_impl::site_registration<EventEmitter>( host, path, method );
+						auto const key = registration_t( host, path, method );
 
 						return daw::container::max_element(
 						  m_registered_sites, [&key]( auto const &lhs, auto const &rhs ) {
@@ -320,7 +323,7 @@ namespace daw {
 					basic_http_site_t &on_any_page_error( Listener &&listener ) {
 						static_assert(
 						  std::is_invocable_v<std::decay_t<Listener>, HttpClientRequest,
-						                      HttpServerResponse, uint16_t /*error_no*/>,
+						                      response_t, uint16_t /*error_no*/>,
 						  "Listener must accept HttpClientRequest, HttpServerResponse, and "
 						  "uint16_t as arguments" );
 
@@ -350,8 +353,7 @@ namespace daw {
 						return *this;
 					}
 
-					void emit_page_error( HttpClientRequest request,
-					                      HttpServerResponse<EventEmitter> response,
+					void emit_page_error( HttpClientRequest request, response_t response,
 					                      uint16_t error_no ) {
 						response.reset( );
 						auto err_it = m_error_listeners.find( error_no );
@@ -375,7 +377,7 @@ namespace daw {
 					}
 
 					void emit_request_made( HttpClientRequest request,
-					                        HttpServerResponse<EventEmitter> response ) {
+					                        response_t response ) {
 						emitter( ).emit( "request_made", daw::move( request ),
 						                 daw::move( response ) );
 					}
@@ -387,6 +389,46 @@ namespace daw {
 						return *this;
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	TCP tuning for the listening and accepted sockets.  Set
+					///				before listen_on
+					basic_http_site_t &
+					set_socket_options( net::SocketOptions const &options ) {
+						m_server.set_socket_options( options );
+						return *this;
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Outstanding accepts, backlog draining and the connection
+					///				limit.  Set before listen_on
+					basic_http_site_t &
+					set_accept_options( net::AcceptOptions const &options ) {
+						m_server.set_accept_options( options );
+						return *this;
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Pick up rotated TLS certificates without restarting.
+					///				Connections already open keep their context
+					basic_http_site_t &reload_tls_context( ) {
+						m_server.reload_tls_context( );
+						return *this;
+					}
+
+					basic_http_site_t &
+					reload_tls_context( net::SslServerConfig const &ssl_config ) {
+						m_server.reload_tls_context( ssl_config );
+						return *this;
+					}
+
+					net::TlsSessionStats tls_session_stats( ) const {
+						return m_server.tls_session_stats( );
+					}
+
+					net::AcceptStats accept_stats( ) const {
+						return m_server.accept_stats( );
+					}
+
 					basic_http_site_t &
 					listen_on( uint16_t port,
 					           net::ip_version ip_ver = net::ip_version::ipv4_v6,
@@ -395,9 +437,18 @@ namespace daw {
 						m_server.listen_on( port, ip_ver, max_backlog );
 						return *this;
 					}
+
+					basic_http_site_t &listen_on( net::UnixEndPoint const &endpoint,
+					                              uint16_t max_backlog = 511 ) {
+						m_server.listen_on( endpoint, max_backlog );
+						return *this;
+					}
 				}; // class basic_http_site_t
 
 				using HttpSite = basic_http_site_t<base::StandardEventEmitter>;
+				using HttpPlainSite =
+				  basic_http_site_t<base::StandardEventEmitter,
+				                    net::nss_impl::PlainSocket>;
 			} // namespace http
 		}   // namespace lib
 	}     // namespace nodepp
@@ -45,10 +45,10 @@ namespace daw {
 					bool is_parent_of( boost::filesystem::path const &parent,
 					                   boost::filesystem::path child );
 
-					template<typename EventEmitter, typename Req, typename Resp>
+					template<typename EventEmitter, typename Site, typename Req,
+					         typename Resp>
 					void process_request( basic_http_static_service_t<EventEmitter> &srv,
-					                      basic_http_site_t<EventEmitter> &site,
-					                      Req &&request, Resp &&response ) {
+					                      Site &site, Req &&request, Resp &&response ) {
 						try {
 							daw::string_view requested_url = request.request_line.url.path;
 							requested_url.remove_prefix( srv.get_base_path( ).size( ) - 1 );
@@ -166,8 +166,9 @@ namespace daw {
 						  "Local filesystem web directory is not a directory" );
 					}
 
+					template<typename Socket>
 					basic_http_static_service_t &
-					connect( basic_http_site_t<EventEmitter> &site ) {
+					connect( basic_http_site_t<EventEmitter, Socket> &site ) {
 						try {
 							delegate_to( "error", site.emitter( ), "error" );
 							site.delegate_to( "exit", emitter( ), "exit" );
@@ -40,13 +40,14 @@ namespace daw {
 	namespace nodepp {
 		namespace lib {
 			namespace http {
-				template<typename EventEmitter = base::StandardEventEmitter>
+				template<typename EventEmitter = base::StandardEventEmitter,
+				         typename Socket = net::nss_impl::BoostSocket>
 				class HttpWebService
-				  : public base::BasicStandardEvents<HttpWebService<EventEmitter>,
-				                                     EventEmitter> {
+				  : public base::BasicStandardEvents<
+				      HttpWebService<EventEmitter, Socket>, EventEmitter> {
 
 					using handler_t = std::function<void(
-					  HttpClientRequest, HttpServerResponse<EventEmitter> )>;
+					  HttpClientRequest, HttpServerResponse<EventEmitter, Socket> )>;
 
 					std::set<HttpClientRequestMethod> m_method;
 					std::string m_base_path;
@@ -57,7 +58,7 @@ namespace daw {
 					handler_t make_handler( Handler &&handler ) {
 						static_assert(
 						  std::is_invocable_v<std::decay_t<Handler>, HttpClientRequest,
-						                      HttpServerResponse<EventEmitter>>,
+						                      HttpServerResponse<EventEmitter, Socket>>,
 						  "Handler must take a HttpClientRequest and a "
 						  "HttpServerResponse as arguments" );
 
@@ -71,7 +72,7 @@ namespace daw {
 					}
 
 				public:
-					using base::BasicStandardEvents<HttpWebService<EventEmitter>,
+					using base::BasicStandardEvents<HttpWebService<EventEmitter, Socket>,
 					                                EventEmitter>::emitter;
 					template<typename Handler>
 					HttpWebService(
@@ -103,7 +104,8 @@ namespace daw {
 						return m_method.count( method ) != 0;
 					}
 
-					HttpWebService &connect( basic_http_site_t<EventEmitter> &site ) {
+					HttpWebService &
+					connect( basic_http_site_t<EventEmitter, Socket> &site ) {
 						site.delegate_to( "exit", emitter( ), "exit" );
 						site.delegate_to( "error", emitter( ), "error" );
 
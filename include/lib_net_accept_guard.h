@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "base_error.h"
+#include "base_threading.h"
+#include "lib_net_socket_options.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Counters for the overload protection of one server
+				struct AcceptStats {
+					/// Connections accepted and not yet destroyed
+					uint64_t active_connections = 0;
+					/// Connections refused because max_connections was reached
+					uint64_t shed_over_limit = 0;
+					/// Connections accepted with the spare descriptor and closed
+					/// because the process had run out of file descriptors
+					uint64_t shed_no_descriptors = 0;
+					/// Times accepting was paused after running out of descriptors
+					uint64_t accept_backoffs = 0;
+				};
+
+				namespace nss_impl {
+					class accept_guard_t;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	One of a server's max_connections.  Given back when the
+					///				connection holding it is destroyed
+					class connection_slot_t {
+						std::shared_ptr<accept_guard_t> m_guard{};
+
+					public:
+						connection_slot_t( ) noexcept = default;
+						explicit connection_slot_t(
+						  std::shared_ptr<accept_guard_t> guard ) noexcept;
+						~connection_slot_t( ) noexcept;
+
+						connection_slot_t( connection_slot_t const & ) = delete;
+						connection_slot_t &operator=( connection_slot_t const & ) = delete;
+						connection_slot_t( connection_slot_t && ) noexcept = default;
+						connection_slot_t &operator=( connection_slot_t &&rhs ) noexcept;
+
+						explicit operator bool( ) const noexcept;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The accept side of a server under load.  Counts the open
+					///				connections against max_connections, keeps a spare
+					///				descriptor to clear the backlog with when there are no
+					///				more and spaces out the accepts that keep failing
+					class accept_guard_t
+					  : public std::enable_shared_from_this<accept_guard_t> {
+
+						base::counter_t<uint64_t> m_active{0};
+						base::counter_t<uint64_t> m_shed_over_limit{0};
+						base::counter_t<uint64_t> m_shed_no_descriptors{0};
+						base::counter_t<uint64_t> m_backoffs{0};
+						base::counter_t<int64_t> m_backoff_ms{0};
+						uint32_t m_max_connections;
+						std::chrono::milliseconds m_max_backoff;
+						/// Only touched when out of descriptors, never on the hot path
+						std::atomic<int> m_spare_fd{-1};
+
+						friend class connection_slot_t;
+
+					public:
+						explicit accept_guard_t( AcceptOptions const &options );
+						~accept_guard_t( ) noexcept;
+
+						accept_guard_t( accept_guard_t const & ) = delete;
+						accept_guard_t( accept_guard_t && ) = delete;
+						accept_guard_t &operator=( accept_guard_t const & ) = delete;
+						accept_guard_t &operator=( accept_guard_t && ) = delete;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Claim a slot for a connection that was just accepted
+						/// @return	An empty slot when max_connections are open.  The
+						///				connection is counted as shed
+						connection_slot_t try_take_slot( );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Give up the spare descriptor and use it to accept and
+						///				close what is queued on acceptor, so clients are told
+						///				no instead of waiting in a full backlog
+						void shed_backlog( asio::ip::tcp::acceptor &acceptor );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	How long to wait before accepting again.  Doubles each
+						///				call up to max_accept_backoff
+						std::chrono::milliseconds next_backoff( );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	An accept succeeded, the next failure starts over with
+						///				the shortest wait
+						void reset_backoff( ) noexcept;
+
+						AcceptStats stats( ) const noexcept;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Did accept fail because the process or system is out of
+					///				descriptors or memory for a new socket
+					bool is_resource_exhausted( base::ErrorCode const &err ) noexcept;
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
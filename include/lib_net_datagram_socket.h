@@ -0,0 +1,179 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/ip/udp.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <daw/daw_string_view.h>
+
+#include "base_event_emitter.h"
+#include "lib_net_socket_asio_socket.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	How a NetDatagramSocket batches its system calls
+				struct DatagramOptions {
+					/// Datagrams received or sent per recvmmsg/sendmmsg
+					size_t batch_size = 32U;
+					/// Longest datagram received, longer ones are truncated.  64KiB
+					/// when gro is on
+					size_t max_datagram_size = 2048U;
+					/// Batches received before going back to the reactor, so one busy
+					/// socket does not starve the others
+					size_t max_receive_batches = 8U;
+					/// Have Linux coalesce datagrams of a flow on receive (UDP_GRO).
+					/// They are still delivered one at a time
+					bool gro = false;
+					/// Send runs of datagrams of this size to the same endpoint as one
+					/// buffer that the kernel, or the NIC, splits (UDP_SEGMENT).  The
+					/// last of a run may be shorter.  Zero for off
+					uint16_t gso_segment_size = 0U;
+				};
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Counters for one NetDatagramSocket
+				struct DatagramSocketStats {
+					uint64_t received = 0;
+					/// Received datagrams cut short by max_datagram_size
+					uint64_t truncated = 0;
+					uint64_t receive_calls = 0;
+					uint64_t sent = 0;
+					/// Sent datagrams that were part of a segmented buffer
+					uint64_t segmented = 0;
+					uint64_t send_calls = 0;
+					/// Datagrams dropped because sending them failed
+					uint64_t send_errors = 0;
+				};
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	A received datagram.  data points into a pooled receive
+				///				buffer and is only valid until the listener returns
+				struct Datagram {
+					asio::ip::udp::endpoint endpoint{};
+					daw::string_view data{};
+				};
+
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Receive buffers shared by the datagram sockets.  A socket
+					///				only holds one while it receives a batch, so idle
+					///				sockets hold no buffer memory
+					class datagram_buffer_pool_t {
+						std::mutex m_mutex{};
+						std::unordered_map<size_t, std::vector<std::unique_ptr<char[]>>>
+						  m_free{};
+
+					public:
+						static datagram_buffer_pool_t &get( );
+
+						std::unique_ptr<char[]> acquire( size_t size );
+						void release( size_t size, std::unique_ptr<char[]> buffer );
+					};
+
+					struct datagram_state_t;
+				} // namespace nss_impl
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	A UDP socket.  Datagrams are received and sent a batch per
+				///				system call.  Copies share the socket
+				class NetDatagramSocket
+				  : public base::StandardEvents<NetDatagramSocket> {
+
+					std::shared_ptr<nss_impl::datagram_state_t> m_state;
+
+					void open( asio::ip::udp const &protocol );
+					void start_receiving( );
+					void wait_readable( );
+					void receive_batches( );
+					void flush_sends( );
+
+					static void handle_readable( NetDatagramSocket &self,
+					                             base::ErrorCode const &err );
+
+				public:
+					explicit NetDatagramSocket(
+					  base::StandardEventEmitter &&emitter = base::StandardEventEmitter{} );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Set before bind or the first send_to
+					NetDatagramSocket &set_options( DatagramOptions options );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Receive datagrams sent to port.  Emits listening
+					NetDatagramSocket &bind( uint16_t port,
+					                         ip_version ip_ver = ip_version::ipv4_v6 );
+					NetDatagramSocket &bind( asio::ip::udp::endpoint const &endpoint );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Queue a datagram.  Those queued while the io service is
+					///				busy are sent together.  An unbound socket is opened
+					///				and receives the replies
+					NetDatagramSocket &send_to( asio::ip::udp::endpoint endpoint,
+					                            daw::string_view data );
+
+					void close( );
+					bool is_open( ) const;
+					asio::ip::udp::endpoint local_endpoint( ) const;
+					DatagramSocketStats stats( ) const;
+
+					//////////////////////////////////////////////////////////////////////////
+					// Event callbacks
+
+					/// @brief Event emitted when bound
+					template<typename Listener>
+					NetDatagramSocket &on_listening( Listener &&listener ) {
+						base::add_listener<asio::ip::udp::endpoint>(
+						  "listening", emitter( ), std::forward<Listener>( listener ) );
+						return *this;
+					}
+
+					/// @brief Event emitted for each datagram received
+					template<typename Listener>
+					NetDatagramSocket &on_datagram( Listener &&listener ) {
+						base::add_listener<Datagram>( "datagram", emitter( ),
+						                              std::forward<Listener>( listener ) );
+						return *this;
+					}
+
+					/// @brief Event emitted when the socket is closed
+					template<typename Listener>
+					NetDatagramSocket &on_closed( Listener &&listener ) {
+						base::add_listener<>( "closed", emitter( ),
+						                      std::forward<Listener>( listener ),
+						                      base::callback_run_mode_t::run_once );
+						return *this;
+					}
+				}; // class NetDatagramSocket
+			}    // namespace net
+		}      // namespace lib
+	}        // namespace nodepp
+} // namespace daw
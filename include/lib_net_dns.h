@@ -31,6 +31,7 @@
 
 #include "base_event_emitter.h"
 #include "base_service_handle.h"
+#include "lib_net_dns_cache.h"
 
 namespace daw {
 	namespace nodepp {
@@ -40,6 +41,7 @@ namespace daw {
 
 				class NetDns : public daw::nodepp::base::StandardEvents<NetDns> {
 					std::shared_ptr<Resolver> m_resolver;
+					std::shared_ptr<DnsCache> m_cache;
 
 					static void handle_resolve( NetDns self, base::ErrorCode const &err,
 					                            Resolver::iterator it );
@@ -52,12 +54,20 @@ namespace daw {
 					explicit NetDns( daw::nodepp::base::StandardEventEmitter &&emitter =
 					                   daw::nodepp::base::StandardEventEmitter{} );
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Resolve names and addresses through cache
+					explicit NetDns( std::shared_ptr<DnsCache> cache,
+					                 daw::nodepp::base::StandardEventEmitter &&emitter =
+					                   daw::nodepp::base::StandardEventEmitter{} );
+
 					using handler_argument_t = Resolver::iterator;
 
 					/// @brief resolve name or ip address and call callback of form
-					/// void(base::ErrorCode, Resolver::iterator)
+					/// void(base::ErrorCode, Resolver::iterator).  Names and
+					/// addresses are answered from the DNS cache
 					void resolve( daw::string_view address );
 					void resolve( daw::string_view address, uint16_t port );
+					/// @brief Always sent to the system resolver
 					void resolve( Resolver::query &query );
 
 					//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,144 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base_error.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				struct DnsCacheOptions {
+					/// How long an answer is used.  The system resolver does not
+					/// report record TTLs, so this stands in for them
+					std::chrono::seconds ttl = std::chrono::seconds( 60 );
+					/// How long a failed lookup is answered with the same error
+					std::chrono::seconds negative_ttl = std::chrono::seconds( 5 );
+					/// Names kept.  Expired ones are dropped first when full
+					size_t max_entries = 4096;
+					/// A file in /etc/hosts format whose names are answered without
+					/// a lookup and never expire.  Empty for none
+					std::string hosts_file{};
+				};
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Counters for one DnsCache
+				struct DnsCacheStats {
+					/// Answered from the cache or the hosts file
+					uint64_t hits = 0;
+					/// Answered with the error of a recent failed lookup
+					uint64_t negative_hits = 0;
+					/// Lookups sent to the system resolver
+					uint64_t lookups = 0;
+					/// Requests that waited on a lookup already in progress
+					uint64_t coalesced = 0;
+					uint64_t size = 0;
+				};
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Resolves host names without blocking the io service and
+				///				keeps the answers, and the failures, for a while.  When
+				///				several requests for the same name and port arrive while
+				///				it is being looked up they share the one lookup
+				class DnsCache : public std::enable_shared_from_this<DnsCache> {
+				public:
+					using results_t = asio::ip::tcp::resolver::results_type;
+					using handler_t = std::function<void( base::ErrorCode, results_t )>;
+
+				private:
+					using clock_t = std::chrono::steady_clock;
+
+					struct entry_t {
+						results_t results{};
+						base::ErrorCode error{};
+						clock_t::time_point expires{};
+					};
+
+					DnsCacheOptions m_options;
+					mutable std::mutex m_mutex{};
+					std::unordered_map<std::string, entry_t> m_entries{};
+					/// Handlers waiting on a lookup, by key
+					std::unordered_map<std::string, std::vector<handler_t>> m_pending{};
+					/// Addresses from the hosts file, by name
+					std::unordered_map<std::string, std::vector<asio::ip::address>>
+					  m_hosts{};
+					std::atomic<uint64_t> m_hits{0};
+					std::atomic<uint64_t> m_negative_hits{0};
+					std::atomic<uint64_t> m_lookups{0};
+					std::atomic<uint64_t> m_coalesced{0};
+
+					/// Must hold m_mutex
+					std::vector<handler_t> take_waiting( std::string const &key );
+					void finish_lookup( std::string const &key, base::ErrorCode err,
+					                    results_t results );
+					/// Fail those waiting on key without caching the error
+					void fail_waiting( std::string const &key, base::ErrorCode err );
+					void store( std::string const &key, entry_t entry );
+
+				public:
+					explicit DnsCache( DnsCacheOptions options = DnsCacheOptions{} );
+
+					DnsCache( DnsCache const & ) = delete;
+					DnsCache( DnsCache && ) = delete;
+					DnsCache &operator=( DnsCache const & ) = delete;
+					DnsCache &operator=( DnsCache && ) = delete;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The cache used by NetSocketStream::connect and NetDns
+					///				when they are not given one
+					static std::shared_ptr<DnsCache> get_default( );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Use cache for everything resolved after this call
+					static void set_default( std::shared_ptr<DnsCache> cache );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Resolve host and call handler on the io service with the
+					///				endpoints or the error.  It is never called before
+					///				async_resolve returns.  A lookup that could not be
+					///				started is reported this way too, and not cached
+					void async_resolve( std::string const &host, uint16_t port,
+					                    handler_t handler );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Forget every answer.  Lookups in progress still finish
+					void clear( );
+
+					DnsCacheStats stats( ) const;
+				};
+			} // namespace net
+		}   // namespace lib
+	}     // namespace nodepp
+} // namespace daw
@@ -0,0 +1,109 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <asio/ssl/context.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	What is needed from the handshake to hand the write side
+					///				of a TLS connection to the kernel.  Filled in by the
+					///				OpenSSL callbacks installed with ktls_prepare
+					struct ktls_state_t {
+						std::array<unsigned char, 64> traffic_secret{};
+						size_t traffic_secret_size = 0;
+						uint64_t write_seq = 0;
+						bool counting = false;
+						// Set once the kernel owns the write side.  OpenSSL must not
+						// write another record from then on
+						int socket_fd = -1;
+						bool offloaded = false;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The server's write keys and the sequence number of the
+					///				next record it writes
+					struct ktls_keys_t {
+						std::array<unsigned char, 32> key{};
+						std::array<unsigned char, 12> iv{};
+						size_t key_size = 0;
+						size_t iv_size = 0;
+						uint64_t seq = 0;
+						int version = 0;
+						int cipher_nid = 0;
+
+						void clear( ) noexcept;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Ask for kernel TLS on connections using this context.  It
+					///				only takes effect where the kernel supports it
+					void ktls_enable( asio::ssl::context &ctx );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Start tracking the handshake of ssl.  Returns false when
+					///				the context does not want kernel TLS
+					bool ktls_prepare( SSL *ssl, ktls_state_t &state ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Derive the write keys of a finished handshake from the
+					///				TLS 1.2 master secret or the TLS 1.3 traffic secret
+					/// @return	false for protocol versions and ciphers the kernel does
+					///				not know
+					bool ktls_write_keys( SSL *ssl, ktls_state_t const &state,
+					                      ktls_keys_t &keys ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	After the handshake, install the write keys on the socket
+					///				so that the kernel does the record framing and
+					///				encryption.  Reads stay with OpenSSL.  Should OpenSSL
+					///				try to write a record afterwards, e.g. the reply to a
+					///				KeyUpdate or an alert, the socket is shut down
+					///				instead of sending bytes the peer cannot decrypt
+					/// @return	false if the kernel, protocol version or cipher is not
+					///				supported, or renegotiation is allowed.  The socket is
+					///				then unchanged
+					bool ktls_start_send( SSL *ssl, int socket_fd,
+					                      ktls_state_t &state ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Stop tracking ssl, the state passed to ktls_prepare can
+					///				be destroyed afterwards
+					void ktls_release( SSL *ssl ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	OpenSSL no longer knows the write sequence, send the
+					///				close_notify alert through the kernel
+					void ktls_send_close_notify( int socket_fd ) noexcept;
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
 #include <list>
 #include <memory>
 #include <string>
@@ -32,11 +33,16 @@
 
 #include "base_error.h"
 #include "base_event_emitter.h"
+#include "base_handler_arena.h"
 #include "base_service_handle.h"
 #include "base_types.h"
+#include "lib_net_accept_guard.h"
 #include "lib_net_address.h"
+#include "lib_net_proxy_protocol.h"
 #include "lib_net_server.h"
+#include "lib_net_socket_options.h"
 #include "lib_net_socket_stream.h"
+#include "lib_net_unix_socket.h"
 
 namespace daw {
 	namespace nodepp {
@@ -47,19 +53,32 @@ namespace daw {
 				// Requires:	daw::nodepp::EventEmitter,
 				// daw::nodepp::base::options_t,
 				//				daw::nodepp::lib::net::NetAddress, daw::nodepp::base::Error
-				template<typename EventEmitter = base::StandardEventEmitter>
+				/// Connections are nss_impl::PlainSocket streams unless Socket says
+				/// otherwise
+				template<typename EventEmitter = base::StandardEventEmitter,
+				         typename Socket = nss_impl::PlainSocket>
 				class NetNoSslServer
-				  : public base::BasicStandardEvents<NetNoSslServer<EventEmitter>,
-				                                     EventEmitter> {
+				  : public base::BasicStandardEvents<
+				      NetNoSslServer<EventEmitter, Socket>, EventEmitter> {
 
 					std::shared_ptr<asio::ip::tcp::acceptor> m_acceptor;
+					SocketOptions m_socket_options{};
+					AcceptOptions m_accept_options{};
+					asio::ip::tcp m_protocol = asio::ip::tcp::v6( );
+					/// Memory for the pending accepts, shared by copies of the server
+					base::handler_arena_t m_accept_arena{};
+					std::shared_ptr<nss_impl::accept_guard_t> m_accept_guard{};
+					/// Listening on a unix domain socket, TCP options do not apply
+					bool m_is_unix = false;
 
-					using base::BasicStandardEvents<NetNoSslServer<EventEmitter>,
+					using base::BasicStandardEvents<NetNoSslServer<EventEmitter, Socket>,
 					                                EventEmitter>::emitter;
-					using base::BasicStandardEvents<NetNoSslServer<EventEmitter>,
+					using base::BasicStandardEvents<NetNoSslServer<EventEmitter, Socket>,
 					                                EventEmitter>::emit_error;
 
 				public:
+					using socket_t = NetSocketStream<EventEmitter, Socket>;
+
 					explicit NetNoSslServer( EventEmitter emit )
 					  : base::BasicStandardEvents<NetNoSslServer, EventEmitter>( emit )
 					  , m_acceptor( std::make_shared<asio::ip::tcp::acceptor>(
@@ -76,9 +95,10 @@ namespace daw {
 							m_acceptor->set_option(
 							  asio::ip::tcp::acceptor::reuse_address{true} );
 							set_ipv6_only( *m_acceptor, ip_ver );
+							nss_impl::apply_listen_options( *m_acceptor, m_socket_options );
 							m_acceptor->bind( endpoint );
 							m_acceptor->listen( max_backlog );
-							start_accept( );
+							start_accepting( tcp );
 							emitter( ).emit( "listening", daw::move( endpoint ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
@@ -96,9 +116,10 @@ namespace daw {
 							m_acceptor->set_option(
 							  asio::ip::tcp::acceptor::reuse_address( true ) );
 							set_ipv6_only( *m_acceptor, ip_ver );
+							nss_impl::apply_listen_options( *m_acceptor, m_socket_options );
 							m_acceptor->bind( endpoint );
 							m_acceptor->listen( );
-							start_accept( );
+							start_accepting( tcp );
 							emitter( ).emit( "listening", daw::move( endpoint ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
@@ -106,6 +127,42 @@ namespace daw {
 						}
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Listen on the unix domain socket at path, '@' first for
+					///				the abstract namespace.  The listening event carries an
+					///				unspecified EndPoint
+					void listen_unix( std::string const &path, uint16_t max_backlog ) {
+						try {
+							nss_impl::listen_unix( *m_acceptor, path, max_backlog );
+							m_is_unix = true;
+							start_accepting( asio::ip::tcp::v4( ) );
+							emitter( ).emit( "listening", EndPoint( ) );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error listening for connection", "listen_unix" );
+						}
+					}
+
+					void listen_unix( std::string const &path ) {
+						listen_unix( path, static_cast<uint16_t>(
+						                     asio::socket_base::max_listen_connections ) );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Options applied to the listening socket, and to each
+					///				accepted one where they are not inherited.  Set before
+					///				listening
+					void set_socket_options( SocketOptions options ) {
+						m_socket_options = daw::move( options );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	How many accepts are outstanding and whether the backlog
+					///				is drained after each.  Set before listening
+					void set_accept_options( AcceptOptions options ) {
+						m_accept_options = daw::move( options );
+					}
+
 					void listen( uint16_t port ) {
 						listen( port, ip_version::ipv6 );
 					}
@@ -115,7 +172,20 @@ namespace daw {
 						static_assert( !NotImplemented );
 					}
 
+					template<typename Listener>
+					NetNoSslServer &on_connection( Listener &&listener ) {
+						base::add_listener<socket_t>( "connection", emitter( ),
+						                              std::forward<Listener>( listener ) );
+						return *this;
+					}
+
 					NetAddress address( ) const {
+						if( m_is_unix ) {
+							// The acceptor's endpoint would decode the sockaddr_un as IP
+							return NetAddress{
+							  nss_impl::unix_address( m_acceptor->native_handle( ), false )
+							    .value_or( "unix" )};
+						}
 						auto ss = std::stringstream( );
 						ss << m_acceptor->local_endpoint( );
 						return NetAddress{ss.str( )};
@@ -129,16 +199,107 @@ namespace daw {
 						static_assert( !NotImplemented );
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Open connections and those shed under load.  All zero
+					///				before listening
+					AcceptStats accept_stats( ) const {
+						if( !m_accept_guard ) {
+							return AcceptStats{};
+						}
+						return m_accept_guard->stats( );
+					}
+
 				private:
+					void refuse_connection( socket_t socket ) {
+						auto const response = m_accept_options.get_overload_response( );
+						if( response.empty( ) ) {
+							socket.close( false );
+							return;
+						}
+						socket.write_async( response );
+						socket.close_when_writes_completed( );
+					}
+
+					void accept_connection( socket_t socket ) {
+						m_accept_guard->reset_backoff( );
+						auto slot = m_accept_guard->try_take_slot( );
+						if( !slot ) {
+							refuse_connection( daw::move( socket ) );
+							return;
+						}
+						socket.hold_connection_slot( daw::move( slot ) );
+						if( m_is_unix ) {
+							socket.socket( ).set_unix_domain( );
+						} else if( !nss_impl::socket_options_inherited( ) ) {
+							nss_impl::apply_socket_options( socket.socket( ).next_layer( ),
+							                                m_socket_options );
+						}
+						if( m_accept_options.get_proxy_protocol( ) ) {
+							read_proxy_header( daw::move( socket ) );
+							return;
+						}
+						emitter( ).emit( "connection", std::move( socket ) );
+					}
+
+					static void handle_proxy_header( NetNoSslServer &self,
+					                                 socket_t socket, base::ErrorCode err,
+					                                 ProxyHeader header ) {
+						// A bad header only affects that client
+						if( err ) {
+							self.emit_error( err, "Error reading PROXY protocol header",
+							                 "handle_proxy_header" );
+							socket.close( false );
+							return;
+						}
+						socket.set_proxy_header( daw::move( header ) );
+						self.emitter( ).emit( "connection", daw::move( socket ) );
+					}
+
+					void read_proxy_header( socket_t socket ) {
+						auto &raw_socket = socket.socket( ).next_layer( );
+						nss_impl::read_proxy_header_async(
+						  raw_socket, m_accept_options.get_proxy_header_timeout( ),
+						  [self = this, socket = mutable_capture( daw::move( socket ) )](
+						    base::ErrorCode err, ProxyHeader header ) {
+							  handle_proxy_header( *self, *socket, err, daw::move( header ) );
+						  } );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Take every connection already queued without going back
+					///				to the reactor for each one
+					void drain_backlog( ) {
+						while( true ) {
+							auto socket = socket_t( );
+							auto err = base::ErrorCode( );
+							if( !nss_impl::try_accept( *m_acceptor,
+							                           socket.socket( ).next_layer( ),
+							                           m_protocol, err ) ) {
+								if( err ) {
+									emit_error( err, "Error draining backlog", "drain_backlog" );
+								}
+								return;
+							}
+							accept_connection( daw::move( socket ) );
+						}
+					}
+
 					static void handle_accept( NetNoSslServer &self,
-					                           NetSocketStream<EventEmitter> socket,
+					                           socket_t socket,
 					                           base::ErrorCode err ) {
 						try {
-							if( err.value( ) == 24 ) {
-								self.emit_error( err, "Too many open files", "handle_accept" );
-							} else {
-								daw::exception::daw_throw_value_on_true( err );
-								self.emitter( ).emit( "connection", std::move( socket ) );
+							if( nss_impl::is_resource_exhausted( err ) ) {
+								// Accepting again straight away would spin while the
+								// backlog stays full
+								self.m_accept_guard->shed_backlog( *self.m_acceptor );
+								self.emit_error( err, "Out of descriptors", "handle_accept" );
+								self.start_accept_after( self.m_accept_guard->next_backoff( ) );
+								return;
+							}
+							daw::exception::daw_throw_value_on_true( err );
+							self.accept_connection( daw::move( socket ) );
+							if( self.m_accept_options.get_drain_backlog( ) ) {
+								self.drain_backlog( );
 							}
 						} catch( ... ) {
 							self.emit_error( std::current_exception( ),
@@ -148,20 +309,51 @@ namespace daw {
 						self.start_accept( );
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Keep pending_accepts accepts outstanding.  Each re-arms
+					///				itself when it completes
+					void start_accepting( asio::ip::tcp const &protocol ) {
+						m_protocol = protocol;
+						m_accept_guard =
+						  std::make_shared<nss_impl::accept_guard_t>( m_accept_options );
+						if( m_accept_options.get_drain_backlog( ) ) {
+							m_acceptor->non_blocking( true );
+						}
+						for( uint16_t n = 0; n < m_accept_options.get_pending_accepts( );
+						     ++n ) {
+							start_accept( );
+						}
+					}
+
 					void start_accept( ) {
 						try {
-							auto socket = NetSocketStream<EventEmitter>( );
+							auto socket = socket_t( );
 							m_acceptor->async_accept(
-							  socket.socket( )->next_layer( ),
-							  [self = this,
-							   socket = mutable_capture( socket )]( base::ErrorCode err ) {
-								  handle_accept( *self, *socket, err );
-							  } );
+							  socket.socket( ).next_layer( ),
+							  base::bind_arena(
+							    m_accept_arena,
+							    [self = this,
+							     socket = mutable_capture( socket )]( base::ErrorCode err ) {
+								    handle_accept( *self, *socket, err );
+							    } ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
 							            "Error while starting accept", "start_accept" );
 						}
 					}
+
+					void start_accept_after( std::chrono::milliseconds delay ) {
+						try {
+							auto timer = std::make_shared<asio::steady_timer>(
+							  base::ServiceHandle::get( ), delay );
+							timer->async_wait( [self = this, timer]( base::ErrorCode ) {
+								self->start_accept( );
+							} );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error while delaying accept", "start_accept_after" );
+						}
+					}
 				}; // class NetNoSslServer
 			}    // namespace net
 		}      // namespace lib
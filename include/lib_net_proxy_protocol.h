@@ -0,0 +1,82 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+
+#include "base_error.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	The addresses a load balancer passed in front of a
+				///				connection with the PROXY protocol
+				struct ProxyHeader {
+					/// Bytes the header took at the start of the stream
+					size_t size = 0;
+					/// The client and the address it connected to.  Unset for the
+					/// balancer's own connections (LOCAL) and for address families
+					/// that are not TCP over IP
+					std::optional<asio::ip::tcp::endpoint> source{};
+					std::optional<asio::ip::tcp::endpoint> destination{};
+				};
+
+				namespace nss_impl {
+					enum class proxy_parse_status { complete, incomplete, invalid };
+
+					struct proxy_parse_result_t {
+						proxy_parse_status status = proxy_parse_status::invalid;
+						/// When incomplete, the bytes needed before parsing again
+						size_t needed = 0;
+						ProxyHeader header{};
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Parse a version 1 (text) or version 2 (binary) PROXY
+					///				protocol header at the start of [first, last)
+					proxy_parse_result_t parse_proxy_header( char const *first,
+					                                         char const *last );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Take the PROXY protocol header off the front of a newly
+					///				accepted socket.  The bytes are peeked, so data sent
+					///				along with the header stays queued for the next read
+					///				and no extra round trip is made.  handler gets
+					///				protocol_error when there is no valid header.  When the
+					///				whole header has not arrived within timeout the socket
+					///				is closed and handler gets timed_out.  A zero timeout
+					///				waits forever
+					void read_proxy_header_async(
+					  asio::ip::tcp::socket &socket, std::chrono::milliseconds timeout,
+					  std::function<void( base::ErrorCode, ProxyHeader )> handler );
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -35,36 +35,62 @@ namespace daw {
 		namespace lib {
 			namespace net {
 				/// @brief		A TCP Server class
-				template<typename EventEmitter>
+				/// With nss_impl::BoostSocket whether TLS is used is only known at
+				/// run time, so both kinds of server hand out the same ssl capable
+				/// socket.  With nss_impl::PlainSocket the server is plaintext only
+				/// and its connections never touch OpenSSL
+				template<typename EventEmitter,
+				         typename Socket = nss_impl::BoostSocket>
 				class basic_net_server_t
-				  : public base::BasicStandardEvents<basic_net_server_t<EventEmitter>,
-				                                     EventEmitter> {
+				  : public base::BasicStandardEvents<
+				      basic_net_server_t<EventEmitter, Socket>, EventEmitter> {
 
-					using base::BasicStandardEvents<basic_net_server_t<EventEmitter>,
-				                                     EventEmitter>::emitter;
+					using base::BasicStandardEvents<
+					  basic_net_server_t<EventEmitter, Socket>, EventEmitter>::emitter;
 
-					using value_type = std::variant<NetNoSslServer<EventEmitter>,
-					                                NetSslServer<EventEmitter>>;
+					using nossl_server_t = NetNoSslServer<EventEmitter, Socket>;
+					using ssl_server_t = NetSslServer<EventEmitter>;
+					using value_type =
+					  std::conditional_t<Socket::supports_encryption,
+					                     std::variant<nossl_server_t, ssl_server_t>,
+					                     std::variant<nossl_server_t>>;
 					value_type m_net_server;
 
+					ssl_server_t *ssl_server( ) noexcept {
+						if constexpr( Socket::supports_encryption ) {
+							return std::get_if<ssl_server_t>( &m_net_server );
+						} else {
+							return nullptr;
+						}
+					}
+
+					ssl_server_t const *ssl_server( ) const noexcept {
+						if constexpr( Socket::supports_encryption ) {
+							return std::get_if<ssl_server_t>( &m_net_server );
+						} else {
+							return nullptr;
+						}
+					}
+
 				public:
-					using socket_t = NetSocketStream<EventEmitter>;
+					using socket_t = NetSocketStream<EventEmitter, Socket>;
 
 					explicit basic_net_server_t( EventEmitter emit = EventEmitter{} )
-					  : base::BasicStandardEvents<basic_net_server_t<EventEmitter>, EventEmitter>(
-					      emit )
-					  , m_net_server( NetNoSslServer<EventEmitter>( emit ) ) {
-					}
+					  : base::BasicStandardEvents<
+					      basic_net_server_t<EventEmitter, Socket>, EventEmitter>( emit )
+					  , m_net_server( nossl_server_t( emit ) ) {}
 
 					explicit basic_net_server_t( SslServerConfig const &ssl_config,
-					                    EventEmitter emit = EventEmitter{} )
-					  : base::BasicStandardEvents<basic_net_server_t<EventEmitter>, EventEmitter>(
-					      emit )
-					  , m_net_server(
-					      NetSslServer<EventEmitter>( ssl_config, emit ) ) {}
+					                             EventEmitter emit = EventEmitter{} )
+					  : base::BasicStandardEvents<
+					      basic_net_server_t<EventEmitter, Socket>, EventEmitter>( emit )
+					  , m_net_server( ssl_server_t( ssl_config, emit ) ) {
+						static_assert( Socket::supports_encryption,
+						               "A plaintext socket cannot serve TLS" );
+					}
 
 					bool using_ssl( ) const noexcept {
-						return m_net_server.index == 1;
+						return ssl_server( ) != nullptr;
 					}
 
 					void listen( uint16_t port, ip_version ip_ver,
@@ -82,6 +108,65 @@ namespace daw {
 						  );
 					}
 
+					void listen_unix( std::string const &path, uint16_t max_backlog ) {
+						daw::visit_nt( m_net_server, [&path, max_backlog]( auto &srv ) {
+							srv.listen_unix( path, max_backlog );
+						} );
+					}
+
+					void listen_unix( std::string const &path ) {
+						daw::visit_nt( m_net_server,
+						               [&path]( auto &srv ) { srv.listen_unix( path ); } );
+					}
+
+					void set_socket_options( SocketOptions const &options ) {
+						daw::visit_nt( m_net_server, [&options]( auto &srv ) {
+							srv.set_socket_options( options );
+						} );
+					}
+
+					void set_accept_options( AcceptOptions const &options ) {
+						daw::visit_nt( m_net_server, [&options]( auto &srv ) {
+							srv.set_accept_options( options );
+						} );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Load the TLS certificates again for new connections.
+					///				Nothing is done for a plaintext server
+					void reload_tls_context( ) {
+						auto srv = ssl_server( );
+						if( srv ) {
+							srv->reload_tls_context( );
+						}
+					}
+
+					void reload_tls_context( SslServerConfig const &ssl_config ) {
+						auto srv = ssl_server( );
+						if( srv ) {
+							srv->reload_tls_context( ssl_config );
+						}
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Session resumption counters.  All zero for a plaintext
+					///				server
+					TlsSessionStats tls_session_stats( ) const {
+						auto srv = ssl_server( );
+						if( srv ) {
+							return srv->tls_session_stats( );
+						}
+						return TlsSessionStats{};
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Open connections and those shed under load
+					AcceptStats accept_stats( ) const {
+						return daw::visit_nt( m_net_server, []( auto const &srv ) {
+							return srv.accept_stats( );
+						} );
+					}
+
 					void listen( uint16_t port ) {
 						daw::visit_nt( m_net_server,
 						  [port]( auto &srv ) { srv.listen( port, ip_version::ipv4_v6 ); } );
@@ -107,23 +192,21 @@ namespace daw {
 					}
 
 					///
-					/// \tparam Listener an invokable that can accept NetSocketStream<EventEmitter> as arguments
+					/// \tparam Listener an invokable that can accept a socket_t
 					/// \param listener a callback for when connections are made
 					/// \return A reference to Server
 					template<typename Listener>
 					basic_net_server_t &on_connection( Listener &&listener ) {
-						base::add_listener<NetSocketStream<EventEmitter>>(
-						  "connection", emitter( ),
-						  std::forward<Listener>( listener ) );
+						base::add_listener<socket_t>( "connection", emitter( ),
+						                              std::forward<Listener>( listener ) );
 						return *this;
 					}
 
 					template<typename Listener>
 					basic_net_server_t &on_next_connection( Listener &&listener ) {
-						base::add_listener<NetSocketStream<EventEmitter>>(
-						  "connection", emitter( ),
-						  std::forward<Listener>( listener ),
-						  base::callback_run_mode_t::run_once );
+						base::add_listener<socket_t>( "connection", emitter( ),
+						                              std::forward<Listener>( listener ),
+						                              base::callback_run_mode_t::run_once );
 						return *this;
 					}
 
@@ -150,7 +233,7 @@ namespace daw {
 						return *this;
 					}
 
-					void emit_connection( NetSocketStream<EventEmitter> socket ) {
+					void emit_connection( socket_t socket ) {
 						emitter( ).emit( "connection", std::move( socket ) );
 					}
 
@@ -165,6 +248,11 @@ namespace daw {
 
 				using NetServer = basic_net_server_t<base::StandardEventEmitter>;
 				using NetServerSocket = typename NetServer::socket_t;
+
+				/// A server for connections known to be plaintext at compile time
+				using NetPlainServer =
+				  basic_net_server_t<base::StandardEventEmitter, nss_impl::PlainSocket>;
+				using NetPlainServerSocket = typename NetPlainServer::socket_t;
 			}    // namespace net
 		}      // namespace lib
 	}        // namespace nodepp
@@ -22,16 +22,27 @@
 
 #pragma once
 
+#include <asio/bind_executor.hpp>
 #include <asio/read_until.hpp>
 #include <asio/ssl/context.hpp>
 #include <asio/ssl/stream.hpp>
+#include <chrono>
+#include <optional>
+#include <string>
 #include <type_traits>
 
 #include <daw/daw_exception.h>
 #include <daw/daw_memory_mapped_file.h>
+#include <daw/daw_utility.h>
 
 #include "base_error.h"
+#include "base_slab.h"
 #include "base_types.h"
+#include "lib_net_ktls.h"
+#include "lib_net_socket_connect.h"
+#include "lib_net_socket_sendfile.h"
+#include "lib_net_unix_socket.h"
+#include "lib_net_tls_session.h"
 
 namespace daw {
 	namespace nodepp {
@@ -46,6 +57,27 @@ namespace daw {
 					std::string tls_certificate_chain_file;
 					std::string tls_private_key_file;
 					std::string tls_dh_file;
+					/// Hand record encryption to the kernel after the handshake where
+					/// it is supported
+					std::optional<bool> tls_kernel_offload;
+					/// Sessions kept for resumption, 0 turns the cache off.  Defaults
+					/// to 20480
+					std::optional<uint32_t> tls_session_cache_size;
+					/// Independently locked parts of the cache.  Defaults to 16
+					std::optional<uint16_t> tls_session_cache_shards;
+					/// Seconds a session can be resumed for.  Defaults to 300
+					std::optional<int32_t> tls_session_timeout;
+					/// Issue session tickets.  Defaults to true
+					std::optional<bool> tls_session_tickets;
+					/// Seconds between new ticket keys.  Defaults to 3600
+					std::optional<int32_t> tls_ticket_key_rotation;
+					/// Threads that run the handshakes of accepted connections so that
+					/// the key exchange does not hold up the io threads.  Defaults to
+					/// 0, handshaking on the io threads
+					std::optional<uint16_t> tls_handshake_threads;
+					/// Seconds a closing connection waits for the peer's close_notify
+					/// before it is cut off.  Defaults to 5
+					std::optional<int32_t> tls_shutdown_timeout;
 
 					static void json_link_map( );
 
@@ -53,6 +85,14 @@ namespace daw {
 					std::string get_tls_certificate_chain_file( ) const;
 					std::string get_tls_private_key_file( ) const;
 					std::string get_tls_dh_file( ) const;
+					bool get_tls_kernel_offload( ) const;
+					size_t get_tls_session_cache_size( ) const;
+					size_t get_tls_session_cache_shards( ) const;
+					std::chrono::seconds get_tls_session_timeout( ) const;
+					bool get_tls_session_tickets( ) const;
+					std::chrono::seconds get_tls_ticket_key_rotation( ) const;
+					uint16_t get_tls_handshake_threads( ) const;
+					std::chrono::seconds get_tls_shutdown_timeout( ) const;
 				};
 
 				inline auto describe_json_class( SslServerConfig ) noexcept {
@@ -61,25 +101,55 @@ namespace daw {
 					static constexpr char const n1[] = "tls_certificate_chain_file";
 					static constexpr char const n2[] = "tls_private_key_file";
 					static constexpr char const n3[] = "tls_dh_file";
-					return class_description_t<json_string<n0>, json_string<n1>,
-					                           json_string<n2>, json_string<n3>>{};
+					static constexpr char const n4[] = "tls_kernel_offload";
+					static constexpr char const n5[] = "tls_session_cache_size";
+					static constexpr char const n6[] = "tls_session_cache_shards";
+					static constexpr char const n7[] = "tls_session_timeout";
+					static constexpr char const n8[] = "tls_session_tickets";
+					static constexpr char const n9[] = "tls_ticket_key_rotation";
+					static constexpr char const n10[] = "tls_handshake_threads";
+					static constexpr char const n11[] = "tls_shutdown_timeout";
+					return class_description_t<
+					  json_string<n0>, json_string<n1>, json_string<n2>,
+					  json_string<n3>, json_nullable<json_bool<n4>>,
+					  json_nullable<json_number<n5, uint32_t>>,
+					  json_nullable<json_number<n6, uint16_t>>,
+					  json_nullable<json_number<n7, int32_t>>,
+					  json_nullable<json_bool<n8>>,
+					  json_nullable<json_number<n9, int32_t>>,
+					  json_nullable<json_number<n10, uint16_t>>,
+					  json_nullable<json_number<n11, int32_t>>>{};
 				}
 
 				inline auto to_json_data( SslServerConfig const &value ) noexcept {
 					return std::forward_as_tuple(
 					  value.tls_ca_verify_file, value.tls_certificate_chain_file,
-					  value.tls_private_key_file, value.tls_dh_file );
+					  value.tls_private_key_file, value.tls_dh_file,
+					  value.tls_kernel_offload, value.tls_session_cache_size,
+					  value.tls_session_cache_shards, value.tls_session_timeout,
+					  value.tls_session_tickets, value.tls_ticket_key_rotation,
+					  value.tls_handshake_threads, value.tls_shutdown_timeout );
 				}
 
 				namespace nss_impl {
 					struct BoostSocket {
 						using BoostSocketValueType =
 						  asio::ssl::stream<asio::ip::tcp::socket>;
+						static constexpr bool supports_encryption = true;
 
 					private:
-						std::unique_ptr<EncryptionContext> m_encryption_context{};
-						std::unique_ptr<BoostSocketValueType> m_socket{};
+						std::shared_ptr<EncryptionContext> m_encryption_context{};
+						base::slab_ptr<BoostSocketValueType> m_socket{};
+						std::unique_ptr<ktls_state_t> m_ktls{};
+						std::chrono::seconds m_shutdown_timeout = std::chrono::seconds( 5 );
+						/// The happy eyeballs connect in flight, if any
+						connect_race_handle_t m_connect{};
 						bool m_encryption_enabled = false;
+						bool m_ktls_send = false;
+						bool m_is_unix = false;
+
+						void prepare_ktls( );
+						void start_ktls( );
 
 						BoostSocketValueType &raw_socket( );
 						BoostSocketValueType const &raw_socket( ) const;
@@ -87,11 +157,11 @@ namespace daw {
 					public:
 						constexpr BoostSocket( ) noexcept = default;
 
-						explicit BoostSocket( std::unique_ptr<EncryptionContext> context );
+						explicit BoostSocket( std::shared_ptr<EncryptionContext> context );
 						explicit BoostSocket( SslServerConfig const &ssl_config );
 
-						BoostSocket( std::unique_ptr<BoostSocketValueType> &&socket,
-						             std::unique_ptr<EncryptionContext> &&context );
+						BoostSocket( base::slab_ptr<BoostSocketValueType> &&socket,
+						             std::shared_ptr<EncryptionContext> context );
 
 						explicit operator bool( ) const;
 
@@ -103,6 +173,9 @@ namespace daw {
 						BoostSocketValueType *operator->( ) const;
 						BoostSocketValueType *operator->( );
 
+						asio::ip::tcp::socket &next_layer( );
+						asio::ip::tcp::socket const &next_layer( ) const;
+
 						bool encyption_on( ) const;
 						bool &encryption_on( );
 						void encyption_on( bool value );
@@ -113,6 +186,19 @@ namespace daw {
 						EncryptionContext &encryption_context( );
 						EncryptionContext const &encryption_context( ) const;
 
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Is the kernel encrypting what is written
+						bool kernel_tls( ) const noexcept;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Does OpenSSL encrypt what is written.  When false the
+						///				buffers are handed to the kernel as they are
+						bool user_space_encryption( ) const noexcept;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Largest plaintext put in one TLS record from now on
+						void set_max_record_size( size_t size );
+
 						void ip6_only( bool value );
 						bool ip6_only( ) const;
 
@@ -120,6 +206,11 @@ namespace daw {
 						bool is_open( ) const;
 						bool is_open( );
 
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Shut the connection down after the last write.  kTLS
+						///				sends close_notify first.  TLS in user space is left
+						///				alone, close_async sends its close_notify and that
+						///				cannot go out once the TCP send side is shut
 						void shutdown( );
 						std::error_code shutdown( std::error_code &ec ) noexcept;
 
@@ -128,22 +219,87 @@ namespace daw {
 
 						void cancel( );
 
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Mark the socket as a unix domain one.  Set when it is
+						///				accepted from a unix listener or connected to a path
+						void set_unix_domain( ) noexcept {
+							m_is_unix = true;
+						}
+
+						bool is_unix_domain( ) const noexcept {
+							return m_is_unix;
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	The peer and local endpoints.  Unix domain sockets have
+						///				no IP endpoint and give a default constructed one, see
+						///				unix_address
 						asio::ip::tcp::endpoint remote_endpoint( ) const;
 						asio::ip::tcp::endpoint local_endpoint( ) const;
 
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	The "unix:" address of the peer or local end
+						/// @return	nullopt when this is not a unix domain socket
+						std::optional<std::string> unix_address( bool peer ) const;
+
 						template<typename HandshakeHandler>
 						void handshake_async( BoostSocketValueType::handshake_type role,
 						                      HandshakeHandler handler ) {
 							init( );
 							daw::exception::precondition_check( m_socket, "Invalid socket" );
-							m_socket->async_handshake( role, handler );
+							handshake_async( role, m_socket->get_executor( ),
+							                 daw::move( handler ) );
 						}
 
-						template<typename ShutdownHandler>
-						void shutdown_shutdown( ShutdownHandler handler ) {
-							m_socket->async_shutdown( handler );
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Handshake with the OpenSSL work, and the handler, run
+						///				on executor.  The socket stays with its io service,
+						///				only the steps between reads and writes move
+						template<typename Executor, typename HandshakeHandler>
+						void handshake_async( BoostSocketValueType::handshake_type role,
+						                      Executor const &executor,
+						                      HandshakeHandler handler ) {
+							init( );
+							daw::exception::precondition_check( m_socket, "Invalid socket" );
+							prepare_ktls( );
+							auto on_handshake = [this, handler = daw::move( handler )](
+							                      base::ErrorCode const &err ) mutable {
+								if( !err ) {
+									tls_record_handshake( m_socket->native_handle( ) );
+									start_ktls( );
+								}
+								handler( err );
+							};
+							m_socket->async_handshake(
+							  role,
+							  asio::bind_executor( executor, daw::move( on_handshake ) ) );
 						}
 
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Handshake as a client of host, offering the session
+						///				from the last connection to host and port when the
+						///				context keeps them
+						template<typename HandshakeHandler>
+						void client_handshake_async( std::string const &host, uint16_t port,
+						                             HandshakeHandler handler ) {
+							init( );
+							daw::exception::precondition_check( m_socket, "Invalid socket" );
+							tls_client_prepare( m_socket->native_handle( ), host, port );
+							handshake_async( BoostSocketValueType::client,
+							                 daw::move( handler ) );
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	How long close waits for the peer's close_notify
+						void set_shutdown_timeout( std::chrono::seconds timeout ) noexcept;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Close without blocking the io service.  An encrypted
+						///				socket is handed to an operation that sends close_notify,
+						///				waits up to the shutdown timeout for the peer's and then
+						///				closes it.  This object is left without a socket
+						void close_async( );
+
 						template<typename ConstBufferSequence, typename WriteHandler>
 						void write_async( ConstBufferSequence &&buffer,
 						                  WriteHandler &&handler ) {
@@ -151,7 +307,7 @@ namespace daw {
 							daw::exception::precondition_check( m_socket, "Invalid socket" );
 							daw::exception::precondition_check(
 							  is_open( ), "Attempt to write to closed socket" );
-							if( encryption_on( ) ) {
+							if( user_space_encryption( ) ) {
 								asio::async_write( *m_socket, buffer,
 								                   std::forward<WriteHandler>( handler ) );
 							} else {
@@ -166,7 +322,7 @@ namespace daw {
 							daw::exception::precondition_check( m_socket, "Invalid socket" );
 							daw::exception::precondition_check(
 							  is_open( ), "Attempt to write to closed socket" );
-							if( encryption_on( ) ) {
+							if( user_space_encryption( ) ) {
 								asio::write( *m_socket, buffer );
 							} else {
 								asio::write( m_socket->next_layer( ), buffer );
@@ -175,6 +331,29 @@ namespace daw {
 
 						void write_file( daw::string_view file_name );
 
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Can send_file_async be used.  Only for plaintext sockets
+						///				or when the kernel does the encryption
+						bool can_sendfile( ) const noexcept;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Send count bytes of file starting at offset with
+						///				sendfile(2).  file must stay open until the handler runs
+						template<typename WriteHandler>
+						void send_file_async( int file, uint64_t offset, size_t count,
+						                      WriteHandler &&handler ) {
+							init( );
+							daw::exception::precondition_check( m_socket, "Invalid socket" );
+							daw::exception::precondition_check(
+							  is_open( ), "Attempt to write to closed socket" );
+							daw::exception::precondition_check(
+							  can_sendfile( ), "sendfile is not available on this socket" );
+
+							nss_impl::sendfile_async( m_socket->next_layer( ), file, offset,
+							                          count,
+							                          std::forward<WriteHandler>( handler ) );
+						}
+
 						template<typename MutableBufferSequence, typename ReadHandler>
 						void read_async( MutableBufferSequence &buffer,
 						                 ReadHandler handler ) {
@@ -203,22 +382,37 @@ namespace daw {
 							}
 						}
 
-						template<typename Iterator, typename ComposedConnectHandler>
-						void connect_async( Iterator &&it,
-						                    ComposedConnectHandler &&handler ) {
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Connect to the first of endpoints to answer, see
+						///				happy_eyeballs_connect
+						template<typename ConnectHandler>
+						void connect_async( asio::ip::tcp::resolver::results_type const &endpoints,
+						                    ConnectOptions const &options,
+						                    ConnectHandler &&handler ) {
 
 							static_assert(
-							  std::is_invocable_v<ComposedConnectHandler,
-							                      daw::nodepp::base::ErrorCode,
-							                      asio::ip::tcp::resolver::iterator>,
+							  std::is_invocable_v<ConnectHandler, daw::nodepp::base::ErrorCode,
+							                      asio::ip::tcp::endpoint>,
 							  "Connection handler must accept an error_code and "
 							  "and endpoint as arguments" );
 							init( );
 							daw::exception::precondition_check( m_socket, "Invalid socket" );
 
-							asio::async_connect(
-							  m_socket->next_layer( ), std::forward<Iterator>( it ),
-							  std::forward<ComposedConnectHandler>( handler ) );
+							m_connect = nss_impl::happy_eyeballs_connect(
+							  m_socket->next_layer( ), endpoints, options,
+							  std::forward<ConnectHandler>( handler ) );
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Connect to the unix domain socket at path
+						template<typename ConnectHandler>
+						void connect_unix_async( std::string const &path,
+						                         ConnectHandler &&handler ) {
+							init( );
+							daw::exception::precondition_check( m_socket, "Invalid socket" );
+							m_is_unix = true;
+							nss_impl::connect_unix_async(
+							  m_socket->next_layer( ), path, std::forward<ConnectHandler>( handler ) );
 						}
 
 						void enable_encryption(
@@ -0,0 +1,105 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "base_error.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	How an outbound connection tries the addresses of a host.
+				///				Attempts start attempt_delay apart, alternating between
+				///				IPv6 and IPv4, and the first to connect wins (RFC 8305)
+				struct ConnectOptions {
+					/// Wait for an attempt before the next address is tried alongside
+					/// it.  An attempt that fails starts the next one straight away
+					std::chrono::milliseconds attempt_delay =
+					  std::chrono::milliseconds( 250 );
+					/// Longest the whole connect may take, zero for no limit
+					std::chrono::milliseconds deadline = std::chrono::seconds( 30 );
+				};
+
+				namespace nss_impl {
+					using connect_handler_t =
+					  std::function<void( base::ErrorCode, asio::ip::tcp::endpoint )>;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The order to try endpoints in.  Address families alternate,
+					///				starting with the family of the first endpoint, and the
+					///				resolver's order is kept within each family
+					std::vector<asio::ip::tcp::endpoint>
+					order_endpoints( asio::ip::tcp::resolver::results_type const &endpoints );
+
+					class connect_race_t;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Owns a running happy_eyeballs_connect, like the socket it
+					///				connects owns it.  Cancelling, or destroying it, aborts
+					///				the connect and from then on the target socket is not
+					///				touched.  The handler still runs, with operation_aborted
+					class connect_race_handle_t {
+						std::shared_ptr<connect_race_t> m_race{};
+
+					public:
+						constexpr connect_race_handle_t( ) noexcept = default;
+						explicit connect_race_handle_t(
+						  std::shared_ptr<connect_race_t> race ) noexcept;
+
+						connect_race_handle_t( connect_race_handle_t const & ) = delete;
+						connect_race_handle_t &
+						operator=( connect_race_handle_t const & ) = delete;
+						connect_race_handle_t( connect_race_handle_t && ) noexcept = default;
+						connect_race_handle_t &
+						operator=( connect_race_handle_t &&rhs ) noexcept;
+
+						~connect_race_handle_t( ) noexcept;
+
+						void cancel( ) noexcept;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Connect target to the first of endpoints that answers.
+					///				Attempts run on their own sockets and the winner is moved
+					///				into target, the others are closed.  handler gets
+					///				timed_out when the deadline passes first, otherwise the
+					///				error of the last attempt to fail.  Keep the handle
+					///				with target, target is only used while the handle is
+					///				alive and not cancelled
+					[[nodiscard]] connect_race_handle_t
+					happy_eyeballs_connect( asio::ip::tcp::socket &target,
+					                        asio::ip::tcp::resolver::results_type const &endpoints,
+					                        ConnectOptions const &options,
+					                        connect_handler_t handler );
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
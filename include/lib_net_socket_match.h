@@ -0,0 +1,175 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <asio/buffers_iterator.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "base_stream.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				enum class NetSocketStreamFramePrefix : uint_fast8_t {
+					none,
+					u16,
+					u32,
+					varint
+				};
+
+				enum class NetSocketStreamByteOrder : uint_fast8_t {
+					big_endian,
+					little_endian
+				};
+
+				namespace nss_impl {
+					using match_iterator_t =
+					  asio::buffers_iterator<base::stream::StreamBuf::const_buffers_type>;
+
+					using match_result_t = std::pair<match_iterator_t, bool>;
+
+					using match_function_t = std::function<match_result_t(
+					  match_iterator_t begin, match_iterator_t end )>;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Search for a fixed delimiter in the receive buffer.  The
+					///				skip table is built once when the delimiter is set so that
+					///				each read only pays for the scan.  Single byte delimiters
+					///				use memchr
+					class values_matcher_t {
+						std::string m_values{};
+						std::array<size_t, 256> m_skip{};
+
+					public:
+						values_matcher_t( ) noexcept = default;
+						explicit values_matcher_t( std::string values );
+
+						std::string const &values( ) const noexcept;
+						bool empty( ) const noexcept;
+
+						match_result_t operator( )( match_iterator_t first,
+						                            match_iterator_t last ) const;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Find the end of a header block.  That is two newlines where
+					///				each may be preceded by a carriage return, the same as the
+					///				regex (?:\r\n|\n){2}.  Uses AVX2 or SSE2 when the cpu has
+					///				it
+					/// @return	One past the terminator or nullptr if there isn't a
+					///				complete one in the range
+					char const *find_header_end( char const *first,
+					                             char const *last ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Match condition for NetSocketStreamReadMode::double_newline.
+					///				When the terminator is not found the search resumes near
+					///				the end of what was already scanned instead of rescanning
+					///				the whole buffer on the next partial read
+					struct header_end_matcher_t {
+						using result_type = match_result_t;
+
+						result_type operator( )( match_iterator_t first,
+						                         match_iterator_t last ) const;
+					};
+
+					struct frame_header_t {
+						size_t prefix_size = 0;
+						size_t payload_size = 0;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Match condition for the binary framing read modes.
+					///				Either a fixed number of bytes or a payload preceded by its
+					///				length as a u16, u32 or an unsigned LEB128 varint.  A
+					///				declared length larger than max_frame_size matches at the
+					///				end of the prefix so the reader can reject it without
+					///				buffering it
+					class frame_matcher_t {
+						size_t m_max_frame_size = 0;
+						NetSocketStreamFramePrefix m_prefix =
+						  NetSocketStreamFramePrefix::none;
+						NetSocketStreamByteOrder m_byte_order =
+						  NetSocketStreamByteOrder::big_endian;
+
+					public:
+						using result_type = match_result_t;
+
+						frame_matcher_t( ) noexcept = default;
+
+						static frame_matcher_t exact( size_t frame_size ) noexcept;
+						static frame_matcher_t
+						length_prefixed( NetSocketStreamFramePrefix prefix,
+						                 NetSocketStreamByteOrder byte_order,
+						                 size_t max_frame_size ) noexcept;
+
+						size_t max_frame_size( ) const noexcept;
+
+						/// @brief Largest prefix and payload the receive buffer must hold
+						size_t max_buffer_size( ) const noexcept;
+
+						/// @return The prefix and payload sizes of the frame at first or
+						/// nothing when the prefix has not been fully received
+						std::optional<frame_header_t> header( char const *first,
+						                                      char const *last ) const
+						  noexcept;
+
+						result_type operator( )( match_iterator_t first,
+						                         match_iterator_t last ) const;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Non-owning match condition passed to asio::async_read_until.
+					///				asio copies the match condition into every read operation,
+					///				this keeps that copy to a pointer.  The matcher must outlive
+					///				the read
+					template<typename Matcher>
+					struct match_ref_t {
+						using result_type = match_result_t;
+
+						Matcher const *m_matcher;
+
+						result_type operator( )( match_iterator_t first,
+						                         match_iterator_t last ) const {
+							return ( *m_matcher )( first, last );
+						}
+					};
+
+					template<typename Matcher>
+					constexpr match_ref_t<Matcher>
+					match_ref( Matcher const &matcher ) noexcept {
+						return match_ref_t<Matcher>{&matcher};
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,196 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include <daw/json/daw_json_link.h>
+
+#include "base_error.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	TCP tuning applied by the servers.  Unset members keep the
+				///				system default.  Times are in seconds
+				struct SocketOptions {
+					/// Disable Nagle's algorithm
+					std::optional<bool> no_delay;
+					std::optional<bool> keep_alive;
+					/// Idle time before the first keep alive probe
+					std::optional<int32_t> keep_alive_idle;
+					/// Time between keep alive probes
+					std::optional<int32_t> keep_alive_interval;
+					/// Unanswered probes before the connection is dropped
+					std::optional<int32_t> keep_alive_count;
+					/// Only accept a connection once the client has sent data, or
+					/// this long has passed
+					std::optional<int32_t> defer_accept;
+					/// Length of the queue of pending TCP Fast Open connections
+					std::optional<int32_t> fast_open_queue;
+					std::optional<int32_t> send_buffer_size;
+					std::optional<int32_t> receive_buffer_size;
+					/// Bytes of unsent data at which the socket stops being writable
+					std::optional<int32_t> not_sent_low_water;
+				};
+
+				inline auto describe_json_class( SocketOptions ) noexcept {
+					using namespace daw::json;
+					static constexpr char const n0[] = "no_delay";
+					static constexpr char const n1[] = "keep_alive";
+					static constexpr char const n2[] = "keep_alive_idle";
+					static constexpr char const n3[] = "keep_alive_interval";
+					static constexpr char const n4[] = "keep_alive_count";
+					static constexpr char const n5[] = "defer_accept";
+					static constexpr char const n6[] = "fast_open_queue";
+					static constexpr char const n7[] = "send_buffer_size";
+					static constexpr char const n8[] = "receive_buffer_size";
+					static constexpr char const n9[] = "not_sent_low_water";
+					return class_description_t<
+					  json_nullable<json_bool<n0>>, json_nullable<json_bool<n1>>,
+					  json_nullable<json_number<n2, int32_t>>,
+					  json_nullable<json_number<n3, int32_t>>,
+					  json_nullable<json_number<n4, int32_t>>,
+					  json_nullable<json_number<n5, int32_t>>,
+					  json_nullable<json_number<n6, int32_t>>,
+					  json_nullable<json_number<n7, int32_t>>,
+					  json_nullable<json_number<n8, int32_t>>,
+					  json_nullable<json_number<n9, int32_t>>>{};
+				}
+
+				inline auto to_json_data( SocketOptions const &value ) noexcept {
+					return std::forward_as_tuple(
+					  value.no_delay, value.keep_alive, value.keep_alive_idle,
+					  value.keep_alive_interval, value.keep_alive_count,
+					  value.defer_accept, value.fast_open_queue, value.send_buffer_size,
+					  value.receive_buffer_size, value.not_sent_low_water );
+				}
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	How a server takes connections off the listen backlog
+				struct AcceptOptions {
+					/// Number of accepts kept outstanding on the listening socket.
+					/// Defaults to 1
+					std::optional<uint16_t> pending_accepts;
+					/// After each accept completes, keep accepting without waiting
+					/// until the backlog is empty
+					std::optional<bool> drain_backlog;
+					/// Connections open at once.  Those over the limit are sent
+					/// overload_response and closed.  Unset or 0 for no limit
+					std::optional<uint32_t> max_connections;
+					/// Written to a plaintext connection refused because of
+					/// max_connections.  Encrypted ones are closed before the
+					/// handshake
+					std::optional<std::string> overload_response;
+					/// Longest wait, in milliseconds, before accepting again after
+					/// running out of file descriptors.  Defaults to 1000
+					std::optional<uint32_t> max_accept_backoff;
+					/// Connections start with a PROXY protocol version 1 or 2 header
+					/// from a load balancer.  Those without one are closed
+					std::optional<bool> proxy_protocol;
+					/// Longest wait, in milliseconds, for the whole PROXY header
+					/// before the connection is closed.  Defaults to 5000, 0 waits
+					/// forever
+					std::optional<uint32_t> proxy_header_timeout;
+
+					uint16_t get_pending_accepts( ) const;
+					bool get_drain_backlog( ) const;
+					uint32_t get_max_connections( ) const;
+					std::string get_overload_response( ) const;
+					std::chrono::milliseconds get_max_accept_backoff( ) const;
+					bool get_proxy_protocol( ) const;
+					std::chrono::milliseconds get_proxy_header_timeout( ) const;
+				};
+
+				inline auto describe_json_class( AcceptOptions ) noexcept {
+					using namespace daw::json;
+					static constexpr char const n0[] = "pending_accepts";
+					static constexpr char const n1[] = "drain_backlog";
+					static constexpr char const n2[] = "max_connections";
+					static constexpr char const n3[] = "overload_response";
+					static constexpr char const n4[] = "max_accept_backoff";
+					static constexpr char const n5[] = "proxy_protocol";
+					static constexpr char const n6[] = "proxy_header_timeout";
+					return class_description_t<
+					  json_nullable<json_number<n0, uint16_t>>,
+					  json_nullable<json_bool<n1>>,
+					  json_nullable<json_number<n2, uint32_t>>,
+					  json_nullable<json_string<n3>>,
+					  json_nullable<json_number<n4, uint32_t>>,
+					  json_nullable<json_bool<n5>>,
+					  json_nullable<json_number<n6, uint32_t>>>{};
+				}
+
+				inline auto to_json_data( AcceptOptions const &value ) noexcept {
+					return std::forward_as_tuple(
+					  value.pending_accepts, value.drain_backlog, value.max_connections,
+					  value.overload_response, value.max_accept_backoff,
+					  value.proxy_protocol, value.proxy_header_timeout );
+				}
+
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Accept a queued connection without waiting.  The
+					///				acceptor must be non-blocking
+					/// @return	true when socket holds a new connection.  false with ec
+					///				clear when the backlog is empty
+					bool try_accept( asio::ip::tcp::acceptor &acceptor,
+					                 asio::ip::tcp::socket &socket,
+					                 asio::ip::tcp const &protocol, base::ErrorCode &ec );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Do accepted sockets start with the options set on the
+					///				listening socket.  When they do, nothing is set per
+					///				connection
+					bool socket_options_inherited( ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Apply options to an open acceptor before it listens.  This
+					///				includes the listener only options defer_accept and
+					///				fast_open_queue
+					void apply_listen_options( asio::ip::tcp::acceptor &acceptor,
+					                           SocketOptions const &options );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Apply the per connection options to an accepted socket
+					void apply_socket_options( asio::ip::tcp::socket &socket,
+					                           SocketOptions const &options );
+
+					void set_no_delay( asio::ip::tcp::socket &socket, bool value );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Turn keep alive on or off.  When idle_seconds is positive
+					///				it is the idle time before the first probe
+					void set_keep_alive( asio::ip::tcp::socket &socket, bool value,
+					                     int32_t idle_seconds );
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
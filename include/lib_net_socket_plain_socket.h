@@ -0,0 +1,226 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <asio/read.hpp>
+#include <asio/read_until.hpp>
+#include <asio/write.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+#include <daw/daw_exception.h>
+#include <daw/daw_utility.h>
+
+#include "base_error.h"
+#include "base_slab.h"
+#include "base_types.h"
+#include "lib_net_socket_connect.h"
+#include "lib_net_socket_sendfile.h"
+#include "lib_net_unix_socket.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	A TCP socket that is never encrypted.  It has the same
+					///				interface as BoostSocket without the ssl::stream, so a
+					///				connection does not allocate an SSL object or branch on
+					///				encryption for each read and write
+					struct PlainSocket {
+						using BoostSocketValueType = asio::ip::tcp::socket;
+						static constexpr bool supports_encryption = false;
+
+					private:
+						base::slab_ptr<BoostSocketValueType> m_socket{};
+						/// The happy eyeballs connect in flight, if any
+						connect_race_handle_t m_connect{};
+						bool m_is_unix = false;
+
+						BoostSocketValueType &raw_socket( );
+						BoostSocketValueType const &raw_socket( ) const;
+
+					public:
+						constexpr PlainSocket( ) noexcept = default;
+
+						explicit PlainSocket(
+						  base::slab_ptr<BoostSocketValueType> &&socket ) noexcept;
+
+						explicit operator bool( ) const;
+
+						void init( bool must_exist = true );
+
+						BoostSocketValueType const &operator*( ) const;
+
+						BoostSocketValueType &operator*( );
+						BoostSocketValueType *operator->( ) const;
+						BoostSocketValueType *operator->( );
+
+						BoostSocketValueType &next_layer( );
+						BoostSocketValueType const &next_layer( ) const;
+
+						constexpr bool encyption_on( ) const noexcept {
+							return false;
+						}
+
+						constexpr bool kernel_tls( ) const noexcept {
+							return false;
+						}
+
+						constexpr bool user_space_encryption( ) const noexcept {
+							return false;
+						}
+
+						void ip6_only( bool value );
+						bool ip6_only( ) const;
+
+						void reset_socket( );
+						bool is_open( ) const;
+						bool is_open( );
+
+						void shutdown( );
+						std::error_code shutdown( std::error_code &ec ) noexcept;
+
+						void close( );
+						std::error_code close( std::error_code &ec );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Shut down and close the socket, leaving this object
+						///				without one.  Nothing is waited on
+						void close_async( );
+
+						void cancel( );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Mark the socket as a unix domain one.  Set when it is
+						///				accepted from a unix listener or connected to a path
+						void set_unix_domain( ) noexcept {
+							m_is_unix = true;
+						}
+
+						bool is_unix_domain( ) const noexcept {
+							return m_is_unix;
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	The peer and local endpoints.  Unix domain sockets have
+						///				no IP endpoint and give a default constructed one, see
+						///				unix_address
+						asio::ip::tcp::endpoint remote_endpoint( ) const;
+						asio::ip::tcp::endpoint local_endpoint( ) const;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	The "unix:" address of the peer or local end
+						/// @return	nullopt when this is not a unix domain socket
+						std::optional<std::string> unix_address( bool peer ) const;
+
+						template<typename ConstBufferSequence, typename WriteHandler>
+						void write_async( ConstBufferSequence &&buffer,
+						                  WriteHandler &&handler ) {
+							init( );
+							daw::exception::precondition_check(
+							  is_open( ), "Attempt to write to closed socket" );
+							asio::async_write( *m_socket, buffer,
+							                   std::forward<WriteHandler>( handler ) );
+						}
+
+						template<typename ConstBufferSequence>
+						void write( ConstBufferSequence const &buffer ) {
+							init( );
+							daw::exception::precondition_check(
+							  is_open( ), "Attempt to write to closed socket" );
+							asio::write( *m_socket, buffer );
+						}
+
+						bool can_sendfile( ) const noexcept;
+
+						template<typename WriteHandler>
+						void send_file_async( int file, uint64_t offset, size_t count,
+						                      WriteHandler &&handler ) {
+							init( );
+							daw::exception::precondition_check(
+							  is_open( ), "Attempt to write to closed socket" );
+							daw::exception::precondition_check(
+							  can_sendfile( ), "sendfile is not available on this socket" );
+
+							nss_impl::sendfile_async( *m_socket, file, offset, count,
+							                          std::forward<WriteHandler>( handler ) );
+						}
+
+						template<typename MutableBufferSequence, typename ReadHandler>
+						void read_async( MutableBufferSequence &buffer,
+						                 ReadHandler handler ) {
+							init( );
+							asio::async_read( *m_socket, buffer, handler );
+						}
+
+						template<typename MutableBufferSequence, typename MatchType,
+						         typename ReadHandler>
+						void read_until_async( MutableBufferSequence &buffer, MatchType &&m,
+						                       ReadHandler handler ) {
+							init( );
+							asio::async_read_until( *m_socket, buffer,
+							                        std::forward<MatchType>( m ), handler );
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Connect to the first of endpoints to answer, see
+						///				happy_eyeballs_connect
+						template<typename ConnectHandler>
+						void connect_async( asio::ip::tcp::resolver::results_type const &endpoints,
+						                    ConnectOptions const &options,
+						                    ConnectHandler &&handler ) {
+
+							static_assert(
+							  std::is_invocable_v<ConnectHandler, daw::nodepp::base::ErrorCode,
+							                      asio::ip::tcp::endpoint>,
+							  "Connection handler must accept an error_code and "
+							  "and endpoint as arguments" );
+							init( );
+
+							m_connect = nss_impl::happy_eyeballs_connect(
+							  *m_socket, endpoints, options,
+							  std::forward<ConnectHandler>( handler ) );
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Connect to the unix domain socket at path
+						template<typename ConnectHandler>
+						void connect_unix_async( std::string const &path,
+						                         ConnectHandler &&handler ) {
+							init( );
+							m_is_unix = true;
+							nss_impl::connect_unix_async(
+							  *m_socket, path, std::forward<ConnectHandler>( handler ) );
+						}
+					};
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
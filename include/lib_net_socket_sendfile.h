@@ -0,0 +1,174 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/buffer.hpp>
+#include <asio/ip/tcp.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+#include <daw/daw_string_view.h>
+#include <daw/daw_utility.h>
+
+#include "base_error.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	How send_file streams a file when the kernel cannot send it
+				///				directly.  Each write is at most window chunks of chunk_size
+				///				bytes and the kernel is asked to read the next window ahead
+				///				while the current one is written
+				struct SendFileOptions {
+					size_t chunk_size = 64U * 1024U;
+					size_t window = 4U;
+				};
+
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Is the kernel able to send a file to a socket directly
+					bool has_sendfile( ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Owns a file descriptor opened for reading
+					class file_descriptor_t {
+						int m_fd = -1;
+
+					public:
+						file_descriptor_t( ) noexcept = default;
+						explicit file_descriptor_t( daw::string_view file_name );
+						~file_descriptor_t( ) noexcept;
+
+						file_descriptor_t( file_descriptor_t const & ) = delete;
+						file_descriptor_t &operator=( file_descriptor_t const & ) = delete;
+						file_descriptor_t( file_descriptor_t &&other ) noexcept;
+						file_descriptor_t &operator=( file_descriptor_t &&rhs ) noexcept;
+
+						int get( ) const noexcept;
+						explicit operator bool( ) const noexcept;
+						size_t size( ) const;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Reads a range of a file one window at a time with pread so
+					///				that only a window of it is ever held in memory
+					class file_chunk_reader_t {
+						file_descriptor_t m_file;
+						uint64_t m_offset;
+						size_t m_remaining;
+						SendFileOptions m_options;
+						std::vector<char> m_buffer{};
+
+					public:
+						file_chunk_reader_t( file_descriptor_t file, uint64_t offset,
+						                     size_t length, SendFileOptions options );
+
+						bool done( ) const noexcept;
+
+						/// @return The next window of the file.  It is valid until the
+						/// next call
+						asio::const_buffer read_window( );
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Send as much of the file as the socket will take without
+					///				blocking.  offset is advanced by the amount sent
+					/// @return	Number of bytes sent.  ec is would_block when the socket
+					///				buffer is full
+					size_t sendfile_some( int socket_fd, int file_fd, uint64_t &offset,
+					                      size_t count, base::ErrorCode &ec ) noexcept;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Composed operation that sends count bytes of a file with
+					///				sendfile(2) and waits for the socket to become writable
+					///				whenever the kernel buffer is full.  The file data is not
+					///				copied into user space
+					template<typename Handler>
+					class sendfile_op_t {
+						asio::ip::tcp::socket *m_socket;
+						int m_file;
+						uint64_t m_offset;
+						size_t m_remaining;
+						size_t m_total = 0;
+						Handler m_handler;
+
+					public:
+						sendfile_op_t( asio::ip::tcp::socket &socket, int file,
+						               uint64_t offset, size_t count, Handler handler )
+						  : m_socket( &socket )
+						  , m_file( file )
+						  , m_offset( offset )
+						  , m_remaining( count )
+						  , m_handler( daw::move( handler ) ) {}
+
+						void operator( )( base::ErrorCode ec ) {
+							while( !ec and m_remaining > 0 ) {
+								auto const sent = sendfile_some( m_socket->native_handle( ),
+								                                 m_file, m_offset, m_remaining, ec );
+								m_total += sent;
+								m_remaining -= sent;
+								if( ec == std::errc::operation_would_block or
+								    ec == std::errc::resource_unavailable_try_again ) {
+									auto &socket = *m_socket;
+									socket.async_wait( asio::ip::tcp::socket::wait_write,
+									                   daw::move( *this ) );
+									return;
+								}
+								if( !ec and sent == 0 ) {
+									// The file is shorter than requested
+									ec = std::make_error_code( std::errc::no_message_available );
+								}
+							}
+							m_handler( ec, m_total );
+						}
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Start sending count bytes from offset in file.  The handler
+					///				is called with the error and the bytes sent.  file must
+					///				stay open until then
+					template<typename Handler>
+					void sendfile_async( asio::ip::tcp::socket &socket, int file,
+					                     uint64_t offset, size_t count,
+					                     Handler &&handler ) {
+						// Not every backend makes the descriptor non-blocking for
+						// async_wait, the io_uring one polls without touching it.  A
+						// blocking sendfile would hold the io thread until the whole
+						// file is sent.  asio's synchronous operations still block
+						socket.native_non_blocking( true );
+						// Wait first so the handler is never called from inside this
+						// function
+						socket.async_wait(
+						  asio::ip::tcp::socket::wait_write,
+						  sendfile_op_t<std::decay_t<Handler>>(
+						    socket, file, offset, count, std::forward<Handler>( handler ) ) );
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -22,11 +22,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <asio.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/regex.hpp>
 #include <cstdint>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <type_traits>
 
@@ -35,13 +39,26 @@
 
 #include "base_enoding.h"
 #include "base_error.h"
+#include "base_handler_arena.h"
+#include "base_slab.h"
+#include "base_registered_buffers.h"
 #include "base_selfdestruct.h"
 #include "base_service_handle.h"
 #include "base_stream.h"
+#include "base_threading.h"
 #include "base_types.h"
 #include "base_write_buffer.h"
+#include "lib_net_accept_guard.h"
 #include "lib_net_dns.h"
+#include "lib_net_dns_cache.h"
+#include "lib_net_proxy_protocol.h"
 #include "lib_net_socket_asio_socket.h"
+#include "lib_net_socket_connect.h"
+#include "lib_net_socket_match.h"
+#include "lib_net_socket_options.h"
+#include "lib_net_socket_plain_socket.h"
+#include "lib_net_tls_writer.h"
+#include "lib_net_unix_socket.h"
 
 namespace daw {
 	namespace nodepp {
@@ -56,7 +73,9 @@ namespace daw {
 					next_byte,
 					regex,
 					values,
-					double_newline
+					double_newline,
+					exact_bytes,
+					length_prefixed
 				};
 
 				namespace nss_impl {
@@ -97,17 +116,12 @@ namespace daw {
 						}
 					};
 
-					using match_iterator_t =
-					  asio::buffers_iterator<base::stream::StreamBuf::const_buffers_type>;
-
-					using match_function_t =
-					  std::function<std::pair<match_iterator_t, bool>(
-					    match_iterator_t begin, match_iterator_t end )>;
-
 					struct netsockstream_readoptions_t {
 						size_t max_read_size = 8192;
 						std::unique_ptr<match_function_t> read_predicate = nullptr;
-						std::string read_until_values = {};
+						values_matcher_t read_until_values = {};
+						std::optional<boost::regex> read_until_regex = {};
+						frame_matcher_t read_frame = {};
 						NetSocketStreamReadMode read_mode =
 						  NetSocketStreamReadMode::newline;
 
@@ -118,75 +132,112 @@ namespace daw {
 						  , read_mode( NetSocketStreamReadMode::newline ) {}
 					};
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The state shared by the handles to one connection.  It is
+					///				destructed once, after the last handle and the last
+					///				pending operation let go of it, and that is where the
+					///				socket is torn down
+					template<typename Socket>
 					struct ss_data_t {
-						nss_impl::BoostSocket m_socket{};
-						std::atomic_int m_pending_writes{0};
+						Socket m_socket{};
+						base::counter_t<int> m_pending_writes{0};
 						base::data_t m_response_buffers{};
 						std::size_t m_bytes_read{0};
 						std::size_t m_bytes_written{0};
 						nss_impl::netsockstream_readoptions_t m_read_options{};
 						nss_impl::netsockstream_state_t m_state{};
+						SendFileOptions m_send_file_options{};
+						ConnectOptions m_connect_options{};
+						nss_impl::tls_write_queue_t m_tls_writes{};
+						base::handler_arena_t m_handler_arena{};
+						nss_impl::connection_slot_t m_connection_slot{};
+						/// The client behind a load balancer, from a PROXY header
+						ProxyHeader m_proxy_header{};
+						bool m_close_when_writes_completed = false;
+						/// end( ) was called with writes still in flight
+						bool m_shutdown_when_writes_completed = false;
 
 						ss_data_t( ) noexcept = default;
 
 						explicit ss_data_t( SslServerConfig const &ssl_config )
 						  : m_socket( ssl_config ) {}
 
-						explicit ss_data_t( std::unique_ptr<asio::ssl::context> ctx )
+						explicit ss_data_t( std::shared_ptr<EncryptionContext> ctx )
 						  : m_socket( daw::move( ctx ) ) {}
+
+						ss_data_t( ss_data_t const & ) = delete;
+						ss_data_t( ss_data_t && ) = delete;
+						ss_data_t &operator=( ss_data_t const & ) = delete;
+						ss_data_t &operator=( ss_data_t && ) = delete;
+
+						~ss_data_t( ) noexcept {
+							try {
+								if( m_socket.is_open( ) ) {
+									m_socket.close_async( );
+								}
+							} catch( ... ) {}
+						}
 					};
 				} // namespace nss_impl
 
-				template<typename EventEmitter>
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	A TCP stream.  Socket is nss_impl::BoostSocket when the
+				///				connection may be encrypted and nss_impl::PlainSocket when
+				///				it never is.
+				///				Handles are copyable and share one ss_data_t.  Every
+				///				pending operation holds a handle of its own, so there
+				///				are no borrowed references to dangle.  Copies cost a
+				///				reference count update, only atomic when
+				///				NODEPP_SINGLE_THREADED is off.  There is no move-only
+				///				owner because the event API hands each listener a copy
+				///				to keep.  References kept alive by a pending operation
+				///				count would not save anything either, that count has to
+				///				be atomic when several threads complete operations
+				template<typename EventEmitter,
+				         typename Socket = nss_impl::BoostSocket>
 				class NetSocketStream
-				  : public base::BasicStandardEvents<NetSocketStream<EventEmitter>,
-				                                     EventEmitter>,
+				  : public base::BasicStandardEvents<
+				      NetSocketStream<EventEmitter, Socket>, EventEmitter>,
 				    public base::stream::StreamWritableEvents<
-				      NetSocketStream<EventEmitter>> {
+				      NetSocketStream<EventEmitter, Socket>> {
 
-					using base::BasicStandardEvents<NetSocketStream<EventEmitter>,
+					using base::BasicStandardEvents<NetSocketStream<EventEmitter, Socket>,
 					                                EventEmitter>::emit_error;
 
 					// Data members
-					std::shared_ptr<nss_impl::ss_data_t> m_data{
-					  std::make_shared<nss_impl::ss_data_t>( )};
+					base::rc_ptr<nss_impl::ss_data_t<Socket>> m_data{
+					  base::make_slab_shared<nss_impl::ss_data_t<Socket>>( )};
 
 				public:
-					using base::BasicStandardEvents<NetSocketStream<EventEmitter>,
+					using base::BasicStandardEvents<NetSocketStream<EventEmitter, Socket>,
 					                                EventEmitter>::emitter;
 
 					explicit NetSocketStream( EventEmitter emit = EventEmitter{} )
-					  : base::BasicStandardEvents<NetSocketStream<EventEmitter>,
+					  : base::BasicStandardEvents<NetSocketStream<EventEmitter, Socket>,
 					                              EventEmitter>( emit ) {}
 
 					NetSocketStream( SslServerConfig const &ssl_config,
 					                 EventEmitter emit = EventEmitter{} )
-					  : base::BasicStandardEvents<NetSocketStream<EventEmitter>,
+					  : base::BasicStandardEvents<NetSocketStream<EventEmitter, Socket>,
+					                              EventEmitter>( emit )
+					  , m_data( base::make_slab_shared<nss_impl::ss_data_t<Socket>>(
+					      ssl_config ) ) {}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	An encrypted socket using an already built context that
+					///				may be shared with other sockets
+					NetSocketStream( std::shared_ptr<EncryptionContext> context,
+					                 EventEmitter emit = EventEmitter{} )
+					  : base::BasicStandardEvents<NetSocketStream<EventEmitter, Socket>,
 					                              EventEmitter>( emit )
-					  , m_data( std::make_shared<nss_impl::ss_data_t>( ssl_config ) ) {}
+					  , m_data( base::make_slab_shared<nss_impl::ss_data_t<Socket>>(
+					      daw::move( context ) ) ) {}
 
 					NetSocketStream( NetSocketStream const & ) = default;
 					NetSocketStream( NetSocketStream && ) noexcept = default;
 					NetSocketStream &operator=( NetSocketStream const & ) = default;
 					NetSocketStream &operator=( NetSocketStream && ) noexcept = default;
-
-					~NetSocketStream( ) noexcept {
-						try {
-							try {
-								if( m_data ) {
-									if( m_data->m_socket.is_open( ) ) {
-										auto ec = base::ErrorCode( );
-										m_data->m_socket.shutdown( ec );
-										m_data->m_socket.close( ec );
-									}
-								}
-							} catch( ... ) {
-								emit_error( std::current_exception( ),
-								            "Error shutting down socket ~NetSocketStream",
-								            "NetSocketStream::~NetSocketStream" );
-							}
-						} catch( ... ) {}
-					}
+					~NetSocketStream( ) noexcept = default;
 
 					base::data_t read( ) {
 						return nss_impl::get_clear_buffer(
@@ -194,11 +245,18 @@ namespace daw {
 						  0 );
 					}
 
-					template<bool NotImplemented = true>
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Take up to bytes of the data queued while there were no
+					///				data_received listeners
 					base::data_t read( size_t bytes ) {
-
-						Unused( bytes );
-						static_assert( !NotImplemented );
+						auto &buffers = m_data->m_response_buffers;
+						auto const last = std::next(
+						  buffers.cbegin( ),
+						  static_cast<ptrdiff_t>( std::min( bytes, buffers.size( ) ) ) );
+
+						auto result = base::data_t( buffers.cbegin( ), last );
+						buffers.erase( buffers.cbegin( ), last );
+						return result;
 					}
 
 					bool expired( ) const {
@@ -263,17 +321,35 @@ namespace daw {
 							  !is_closed( ) && can_write( ),
 							  "Attempt to use a closed NetSocketStream" );
 
+							if( m_data->m_socket.user_space_encryption( ) ) {
+								++m_data->m_pending_writes;
+								if( m_data->m_tls_writes.push( first, last ) ) {
+									schedule_tls_flush( );
+								}
+								return *this;
+							}
+#if defined( ASIO_HAS_IO_URING )
+							if( write_registered_async( first, last ) ) {
+								return *this;
+							}
+#endif
 							auto buff_data =
 							  std::make_unique<std::vector<uint8_t>>( first, last );
 
+							// Argument evaluation order is unspecified, build the buffer
+							// before buff_data is moved into the handler
+							auto const buff =
+							  asio::const_buffer( buff_data->data( ), buff_data->size( ) );
 							++m_data->m_pending_writes;
+							auto handler = [obj = mutable_capture( *this ),
+							                buff_data = daw::move( buff_data )](
+							                 base::ErrorCode const &err,
+							                 size_t bytes_transfered ) {
+								handle_write( *obj, err, bytes_transfered );
+							};
 							m_data->m_socket.write_async(
-							  asio::const_buffer( buff_data->data( ), buff_data->size( ) ),
-							  [obj = mutable_capture( *this ),
-							   buff_data = daw::move( buff_data )](
-							    base::ErrorCode const &err, size_t bytes_transfered ) {
-								  handle_write( *obj, err, bytes_transfered );
-							  } );
+							  buff, base::bind_arena( m_data->m_handler_arena,
+							                          daw::move( handler ) ) );
 
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
@@ -296,21 +372,37 @@ namespace daw {
 						                    std::cend( container ) );
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Send a file without blocking.  Plaintext sockets use
+					///				sendfile(2), encrypted ones read and write it a window at a
+					///				time.  write_completion is emitted once the whole file has
+					///				been sent
 					NetSocketStream &send_file( daw::string_view file_name ) {
 						try {
 							daw::exception::precondition_check(
 							  !is_closed( ) and can_write( ),
 							  "Attempt to use a closed NetSocketStream" );
 
-							m_data->m_bytes_written += boost::filesystem::file_size(
-							  boost::filesystem::path( file_name.to_string( ) ) );
-
-							auto mmf =
-							  daw::filesystem::memory_mapped_file_t<char>( file_name );
-							daw::exception::precondition_check( mmf, "Could not open file" );
+							if( m_data->m_socket.can_sendfile( ) ) {
+								return send_file_async( file_name );
+							}
+							auto reader = std::make_shared<nss_impl::file_chunk_reader_t>(
+							  nss_impl::file_descriptor_t( file_name ), 0,
+							  std::numeric_limits<size_t>::max( ),
+							  m_data->m_send_file_options );
 
-							m_data->m_socket.write(
-							  asio::const_buffer( mmf.data( ), mmf.size( ) ) );
+							++m_data->m_pending_writes;
+							if( m_data->m_socket.user_space_encryption( ) ) {
+								// Goes out after the writes already queued
+								auto job = [obj = mutable_capture( *this ), reader]( ) {
+									send_file_window( *obj, reader );
+								};
+								if( m_data->m_tls_writes.push_job( daw::move( job ) ) ) {
+									schedule_tls_flush( );
+								}
+								return *this;
+							}
+							send_file_window( *this, daw::move( reader ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
 							            "Exception while writing from file", "send_file" );
@@ -318,27 +410,93 @@ namespace daw {
 						return *this;
 					}
 
+					NetSocketStream &set_send_file_options( SendFileOptions options ) {
+						daw::exception::precondition_check(
+						  options.chunk_size > 0 and options.window > 0,
+						  "Chunk size and window must be greater than zero" );
+						m_data->m_send_file_options = options;
+						return *this;
+					}
+
 					NetSocketStream &send_file_async( string_view file_name ) {
+						return send_file_async( file_name, 0,
+						                        std::numeric_limits<size_t>::max( ) );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Send length bytes of a file starting at offset.  Plaintext
+					///				sockets use sendfile(2) so the file is never copied into
+					///				user space.  Encrypted sockets map the file instead
+					NetSocketStream &send_file_async( string_view file_name,
+					                                  size_t offset, size_t length ) {
 						try {
 							daw::exception::precondition_check(
 							  !is_closed( ) and can_write( ),
 							  "Attempt to use a closed NetSocketStream" );
 
+							if( m_data->m_socket.can_sendfile( ) ) {
+								auto file =
+								  std::make_shared<nss_impl::file_descriptor_t>( file_name );
+								auto const file_size = file->size( );
+								daw::exception::precondition_check(
+								  offset <= file_size, "Offset is past the end of the file" );
+								length = std::min( length, file_size - offset );
+
+								++m_data->m_pending_writes;
+								m_data->m_socket.send_file_async(
+								  file->get( ), offset, length,
+								  [obj = mutable_capture( *this ), file](
+								    base::ErrorCode err, size_t bytes_transfered ) {
+									  handle_write( *obj, err, bytes_transfered );
+								  } );
+								return *this;
+							}
 							auto mmf =
 							  std::make_unique<daw::filesystem::memory_mapped_file_t<char>>(
 							    file_name );
 
 							daw::exception::precondition_check( mmf, "Could not open file" );
 							daw::exception::precondition_check( *mmf, "Could not open file" );
+							daw::exception::precondition_check(
+							  offset <= mmf->size( ), "Offset is past the end of the file" );
+							length = std::min( length, mmf->size( ) - offset );
 
 							++m_data->m_pending_writes;
 
+							if( m_data->m_socket.user_space_encryption( ) ) {
+								auto file = std::shared_ptr<
+								  daw::filesystem::memory_mapped_file_t<char>>(
+								  daw::move( mmf ) );
+								auto job = [obj = mutable_capture( *this ), file, offset,
+								            length]( ) {
+									// obj is moved into the handler below
+									auto &socket = obj->m_data->m_socket;
+									auto const &arena = obj->m_data->m_handler_arena;
+									socket.write_async(
+									  asio::const_buffer( file->data( ) + offset, length ),
+									  base::bind_arena(
+									    arena, [obj = daw::move( *obj ), file](
+									             base::ErrorCode err,
+									             size_t bytes_transfered ) mutable {
+										    handle_write( obj, err, bytes_transfered );
+										    flush_tls_writes( obj );
+									    } ) );
+								};
+								if( m_data->m_tls_writes.push_job( daw::move( job ) ) ) {
+									schedule_tls_flush( );
+								}
+								return *this;
+							}
+							auto const buff =
+							  asio::const_buffer( mmf->data( ) + offset, length );
+							auto handler = [obj = mutable_capture( *this ),
+							                mmf = daw::move( mmf )](
+							                 base::ErrorCode err, size_t bytes_transfered ) {
+								handle_write( *obj, err, bytes_transfered );
+							};
 							m_data->m_socket.write_async(
-							  asio::const_buffer( mmf->data( ), mmf->size( ) ),
-							  [self = this, mmf = daw::move( mmf )](
-							    base::ErrorCode err, size_t bytes_transfered ) {
-								  handle_write( *self, err, bytes_transfered );
-							  } );
+							  buff, base::bind_arena( m_data->m_handler_arena,
+							                          daw::move( handler ) ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
 							            "Exception while writing from file",
@@ -347,9 +505,19 @@ namespace daw {
 						return *this;
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	No more writes are accepted.  The socket is shut down
+					///				once the writes already made, including those still
+					///				queued for a TLS flush, have gone out.  TLS done in
+					///				user space is only shut down when closed, so that
+					///				close_notify can still be sent
 					NetSocketStream &end( ) {
 						try {
 							m_data->m_state.end( true );
+							if( m_data->m_pending_writes != 0 ) {
+								m_data->m_shutdown_when_writes_completed = true;
+								return *this;
+							}
 							if( m_data->m_socket.is_open( ) ) {
 								m_data->m_socket.shutdown( );
 							}
@@ -367,21 +535,30 @@ namespace daw {
 						return end( );
 					}
 
-					NetSocketStream &connect( daw::string_view host, uint16_t port ) {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	How connect races the addresses of a host.  Set before
+					///				connect
+					NetSocketStream &set_connect_options( ConnectOptions options ) {
+						daw::exception::precondition_check(
+						  options.attempt_delay.count( ) >= 0 and
+						    options.deadline.count( ) >= 0,
+						  "Connect delays cannot be negative" );
+						m_data->m_connect_options = options;
+						return *this;
+					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Resolve host through the default DnsCache and connect to
+					///				the first endpoint that answers, see ConnectOptions
+					NetSocketStream &connect( daw::string_view host, uint16_t port ) {
 						try {
-							auto resolver =
-							  asio::ip::tcp::resolver( base::ServiceHandle::get( ) );
-							auto r =
-							  resolver.resolve( host.to_string( ), std::to_string( port ) );
-							// TODO ensure we have the correct handling, not passing endpoint
-							// on
-							auto handler =
-							  [self = this]( daw::nodepp::base::ErrorCode const &err,
-							                 auto && ) { handle_connect( *self, err ); };
-
-							m_data->m_socket.connect_async( daw::move( r ),
-							                                daw::move( handler ) );
+							DnsCache::get_default( )->async_resolve(
+							  host.to_string( ), port,
+							  [obj = mutable_capture( *this ), host = host.to_string( ),
+							   port]( base::ErrorCode const &err,
+							          DnsCache::results_t results ) {
+								  handle_resolve( *obj, err, daw::move( results ), host, port );
+							  } );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
 							            "Exception starting connect", "connect" );
@@ -389,13 +566,33 @@ namespace daw {
 						return *this;
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Connect to the unix domain socket at path, '@' first for
+					///				the abstract namespace.  An encrypted stream handshakes
+					///				with path as the server name
+					NetSocketStream &connect_unix( daw::string_view path ) {
+						try {
+							m_data->m_socket.connect_unix_async(
+							  path.to_string( ),
+							  [obj = mutable_capture( *this ),
+							   path = path.to_string( )]( base::ErrorCode const &err ) {
+								  handle_connect( *obj, err, path, 0 );
+							  } );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Exception starting connect", "connect_unix" );
+						}
+						return *this;
+					}
+
 					void close( bool emit_cb = true ) {
 						try {
 							m_data->m_state.closed( true );
 							m_data->m_state.end( true );
 							if( m_data->m_socket.is_open( ) ) {
 								m_data->m_socket.cancel( );
-								m_data->m_socket.reset_socket( );
+								// Encrypted sockets say goodbye in the background
+								m_data->m_socket.close_async( );
 							}
 							if( emit_cb ) {
 								emit_closed( );
@@ -406,6 +603,33 @@ namespace daw {
 						}
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	End and close the socket once the pending async writes
+					///				have completed.  No more writes are accepted
+					NetSocketStream &close_when_writes_completed( ) {
+						if( m_data->m_pending_writes == 0 ) {
+							end( );
+							close( );
+							return *this;
+						}
+						m_data->m_state.end( true );
+						m_data->m_close_when_writes_completed = true;
+						return *this;
+					}
+
+					size_t pending_writes( ) const {
+						return static_cast<size_t>( m_data->m_pending_writes );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Count against a server's max_connections until the
+					///				stream is destroyed
+					NetSocketStream &
+					hold_connection_slot( nss_impl::connection_slot_t slot ) {
+						m_data->m_connection_slot = daw::move( slot );
+						return *this;
+					}
+
 					void cancel( ) {
 						m_data->m_socket.cancel( );
 					}
@@ -418,6 +642,11 @@ namespace daw {
 						return m_data->m_socket.is_open( );
 					}
 
+					/// @brief	Is the kernel encrypting what is written
+					bool kernel_tls( ) const noexcept {
+						return m_data->m_socket.kernel_tls( );
+					}
+
 					bool can_write( ) const {
 						return !m_data->m_state.end( );
 					}
@@ -455,23 +684,66 @@ namespace daw {
 							m_data->m_read_options.read_mode =
 							  NetSocketStreamReadMode::newline;
 						}
-						m_data->m_read_options.read_until_values.clear( );
+						m_data->m_read_options.read_until_values = {};
+						m_data->m_read_options.read_until_regex.reset( );
 						m_data->m_read_options.read_predicate.reset( );
 						return *this;
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Deliver data in frames of exactly frame_size bytes
+					NetSocketStream &set_read_exact( size_t frame_size ) {
+						daw::exception::precondition_check(
+						  frame_size > 0, "Frame size must be greater than zero" );
+
+						m_data->m_read_options.read_frame =
+						  nss_impl::frame_matcher_t::exact( frame_size );
+						m_data->m_read_options.read_mode =
+						  NetSocketStreamReadMode::exact_bytes;
+						return *this;
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Deliver the payload of frames that are preceded by their
+					///				length.  A frame longer than max_frame_size is an error and
+					///				closes the socket as the stream cannot be resynchronized
+					NetSocketStream &set_read_length_prefixed(
+					  NetSocketStreamFramePrefix prefix,
+					  NetSocketStreamByteOrder byte_order =
+					    NetSocketStreamByteOrder::big_endian,
+					  size_t max_frame_size = 1024U * 1024U ) {
+						daw::exception::precondition_check(
+						  prefix != NetSocketStreamFramePrefix::none,
+						  "Use set_read_exact for frames without a length prefix" );
+
+						m_data->m_read_options.read_frame =
+						  nss_impl::frame_matcher_t::length_prefixed( prefix, byte_order,
+						                                              max_frame_size );
+						m_data->m_read_options.read_mode =
+						  NetSocketStreamReadMode::length_prefixed;
+						return *this;
+					}
+
 					NetSocketStream &set_read_until_values( std::string values,
 					                                        bool is_regex ) {
-						m_data->m_read_options.read_mode =
-						  is_regex ? NetSocketStreamReadMode::regex
-						           : NetSocketStreamReadMode::values;
-						m_data->m_read_options.read_until_values = daw::move( values );
-						m_data->m_read_options.read_predicate.reset( );
+						auto &opts = m_data->m_read_options;
+						if( is_regex ) {
+							// Compile once here instead of on every read
+							opts.read_until_regex.emplace( values );
+							opts.read_until_values = {};
+							opts.read_mode = NetSocketStreamReadMode::regex;
+						} else {
+							opts.read_until_values =
+							  nss_impl::values_matcher_t( daw::move( values ) );
+							opts.read_until_regex.reset( );
+							opts.read_mode = NetSocketStreamReadMode::values;
+						}
+						opts.read_predicate.reset( );
 						return *this;
 					}
 
 					void emit_connect( ) {
-						emitter( ).emit( "connect" );
+						emitter( ).emit( "connect", *this );
 					}
 
 					void emit_timeout( ) {
@@ -491,19 +763,29 @@ namespace daw {
 								return *this;
 							}
 							auto buff_ptr = read_buffer.get( );
-							auto handler = [obj = mutable_capture( *this ),
-							                read_buffer =
-							                  mutable_capture( daw::move( read_buffer ) )](
-							                 base::ErrorCode err, size_t bytes_transfered ) {
-								handle_read( *obj, daw::move( *read_buffer ), err,
-								             bytes_transfered );
-							};
-							static boost::regex const dbl_newline( R"((?:\r\n|\n){2})" );
-
+							auto handler = base::bind_arena(
+							  m_data->m_handler_arena,
+							  [obj = mutable_capture( *this ),
+							   read_buffer = mutable_capture( daw::move( read_buffer ) )](
+							    base::ErrorCode err, size_t bytes_transfered ) {
+								  handle_read( *obj, daw::move( *read_buffer ), err,
+								               bytes_transfered );
+							  } );
 							switch( m_data->m_read_options.read_mode ) {
-							case NetSocketStreamReadMode::next_byte:
-								// Not Implemented
-								std::terminate( );
+							case NetSocketStreamReadMode::next_byte: {
+								static auto const one_byte =
+								  nss_impl::frame_matcher_t::exact( 1 );
+								m_data->m_socket.read_until_async(
+								  *buff_ptr, nss_impl::match_ref( one_byte ), handler );
+								break;
+							}
+							case NetSocketStreamReadMode::exact_bytes:
+							case NetSocketStreamReadMode::length_prefixed:
+								m_data->m_socket.read_until_async(
+								  *buff_ptr,
+								  nss_impl::match_ref( m_data->m_read_options.read_frame ),
+								  handler );
+								break;
 							case NetSocketStreamReadMode::buffer_full:
 								m_data->m_socket.read_async( *buff_ptr, handler );
 								break;
@@ -511,22 +793,28 @@ namespace daw {
 								m_data->m_socket.read_until_async( *buff_ptr, "\n", handler );
 								break;
 							case NetSocketStreamReadMode::double_newline:
-								m_data->m_socket.read_until_async( *buff_ptr, dbl_newline,
-								                                   handler );
+								m_data->m_socket.read_until_async(
+								  *buff_ptr, nss_impl::header_end_matcher_t{}, handler );
 								break;
 							case NetSocketStreamReadMode::predicate:
 								m_data->m_socket.read_until_async(
-								  *buff_ptr, *m_data->m_read_options.read_predicate, handler );
+								  *buff_ptr,
+								  nss_impl::match_ref( *m_data->m_read_options.read_predicate ),
+								  handler );
 								break;
 							case NetSocketStreamReadMode::values:
 								m_data->m_socket.read_until_async(
-								  *buff_ptr, m_data->m_read_options.read_until_values,
+								  *buff_ptr,
+								  nss_impl::match_ref(
+								    m_data->m_read_options.read_until_values ),
 								  handler );
 								break;
 							case NetSocketStreamReadMode::regex:
+								daw::exception::precondition_check(
+								  m_data->m_read_options.read_until_regex,
+								  "Regex read mode requires set_read_until_values" );
 								m_data->m_socket.read_until_async(
-								  *buff_ptr,
-								  boost::regex( m_data->m_read_options.read_until_values ),
+								  *buff_ptr, *m_data->m_read_options.read_until_regex,
 								  handler );
 								break;
 							default:
@@ -542,21 +830,30 @@ namespace daw {
 					/// Asynchronously read data from a socket
 					/// \return A reference to the socket
 					NetSocketStream &read_async( ) {
+						auto const &opts = m_data->m_read_options;
+						auto buffer_size = opts.max_read_size;
+						if( opts.read_mode == NetSocketStreamReadMode::exact_bytes or
+						    opts.read_mode == NetSocketStreamReadMode::length_prefixed ) {
+							// A whole frame has to fit
+							buffer_size =
+							  std::max( buffer_size, opts.read_frame.max_buffer_size( ) );
+						}
 						return read_async(
 						  std::make_shared<daw::nodepp::base::stream::StreamBuf>(
-						    m_data->m_read_options.max_read_size ) );
+						    buffer_size ) );
 					}
 
-					template<bool NotImplemented = true>
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Size of the receive buffer created by read_async( )
 					size_t &buffer_size( ) {
-						static_assert( !NotImplemented );
+						return m_data->m_read_options.max_read_size;
 					}
 
-					daw::nodepp::lib::net::nss_impl::BoostSocket &socket( ) {
+					Socket &socket( ) {
 						return m_data->m_socket;
 					}
 
-					daw::nodepp::lib::net::nss_impl::BoostSocket const &socket( ) const {
+					Socket const &socket( ) const {
 						return m_data->m_socket;
 					}
 
@@ -567,15 +864,25 @@ namespace daw {
 							  "Attempt to use a closed NetSocketStream" );
 							m_data->m_bytes_written += buff.size( );
 
+							if( m_data->m_socket.user_space_encryption( ) ) {
+								++m_data->m_pending_writes;
+								if( m_data->m_tls_writes.push( buff.data( ),
+								                               buff.data( ) + buff.size( ) ) ) {
+									schedule_tls_flush( );
+								}
+								return *this;
+							}
+							auto const asio_buff = buff.asio_buff( );
 							++m_data->m_pending_writes;
 							m_data->m_socket.write_async(
-							  buff.asio_buff( ),
-							  [obj = mutable_capture( *this ),
-							   buff = mutable_capture( daw::move( buff ) )](
-							    base::ErrorCode err, size_t bytes_transfered ) {
-								  handle_write( *obj, daw::move( *buff ), err,
-								                bytes_transfered );
-							  } );
+							  asio_buff, base::bind_arena(
+							               m_data->m_handler_arena,
+							               [obj = mutable_capture( *this ),
+							                buff = mutable_capture( daw::move( buff ) )](
+							                 base::ErrorCode err, size_t bytes_transfered ) {
+								               handle_write( *obj, daw::move( *buff ), err,
+								                             bytes_transfered );
+							               } ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ), "Exception while writing",
 							            "write_async" );
@@ -588,32 +895,84 @@ namespace daw {
 						static_assert( !NotImplemented );
 					}
 
-					template<bool NotImplemented = true>
-					NetSocketStream &set_no_delay( bool ) {
-						static_assert( !NotImplemented );
+					NetSocketStream &set_no_delay( bool value ) {
+						try {
+							nss_impl::set_no_delay( m_data->m_socket.next_layer( ), value );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error setting TCP_NODELAY", "set_no_delay" );
+						}
+						return *this;
 					}
 
-					template<bool NotImplemented = true>
-					NetSocketStream &set_keep_alive( bool, int32_t ) {
-						static_assert( !NotImplemented );
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Enable or disable keep alive probes
+					/// @param initial_delay Milliseconds idle before the first probe.
+					/// Zero keeps the current setting
+					NetSocketStream &set_keep_alive( bool value,
+					                                 int32_t initial_delay = 0 ) {
+						try {
+							nss_impl::set_keep_alive( m_data->m_socket.next_layer( ), value,
+							                          ( initial_delay + 999 ) / 1000 );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error setting keep alive", "set_keep_alive" );
+						}
+						return *this;
 					}
 
 					///
-					/// \return A string representing the address of the remote host
+					/// \return A string representing the address of the remote host.
+					/// Unix domain sockets give "unix:" and the path, or just "unix"
 					std::string remote_address( ) const {
-						return m_data->m_socket.remote_endpoint( ).address( ).to_string( );
+						if( !m_data->m_proxy_header.source ) {
+							if( auto addr = m_data->m_socket.unix_address( true ); addr ) {
+								return daw::move( *addr );
+							}
+						}
+						return remote_endpoint( ).address( ).to_string( );
 					}
 
 					std::string local_address( ) const {
-						return m_data->m_socket.local_endpoint( ).address( ).to_string( );
+						if( !m_data->m_proxy_header.destination ) {
+							if( auto addr = m_data->m_socket.unix_address( false ); addr ) {
+								return daw::move( *addr );
+							}
+						}
+						return local_endpoint( ).address( ).to_string( );
 					}
 
 					uint16_t remote_port( ) const {
-						return m_data->m_socket.remote_endpoint( ).port( );
+						return remote_endpoint( ).port( );
 					}
 
 					uint16_t local_port( ) const {
-						return m_data->m_socket.local_endpoint( ).port( );
+						return local_endpoint( ).port( );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The peer, or the client a PROXY header named.  Unix
+					///				domain sockets have no IP endpoint and give port 0
+					EndPoint remote_endpoint( ) const {
+						if( m_data->m_proxy_header.source ) {
+							return *m_data->m_proxy_header.source;
+						}
+						return m_data->m_socket.remote_endpoint( );
+					}
+
+					EndPoint local_endpoint( ) const {
+						if( m_data->m_proxy_header.destination ) {
+							return *m_data->m_proxy_header.destination;
+						}
+						return m_data->m_socket.local_endpoint( );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Report the addresses in header instead of the socket's.
+					///				Set by servers accepting the PROXY protocol
+					NetSocketStream &set_proxy_header( ProxyHeader header ) {
+						m_data->m_proxy_header = daw::move( header );
+						return *this;
 					}
 
 					size_t bytes_read( ) const {
@@ -631,13 +990,13 @@ namespace daw {
 					/// @brief Event emitted when a connection is established
 					template<typename Listener>
 					NetSocketStream &on_connected( Listener &&listener ) {
-						emitter( ).template add_listener<NetSocketStream>(
-						  "connect", [sock = mutable_capture( *this ),
-						              listener = mutable_capture(
-						                std::forward<Listener>( listener ) )]( ) {
-							  daw::invoke( *listener, *sock );
-						  } );
-
+						// The stream comes with the event so that the listener does not
+						// keep its own emitter alive
+						base::add_listener<NetSocketStream>(
+						  "connect", emitter( ),
+						  [listener =
+						     mutable_capture( std::forward<Listener>( listener ) )](
+						    NetSocketStream sock ) { daw::invoke( *listener, sock ); } );
 						return *this;
 					}
 
@@ -647,12 +1006,9 @@ namespace daw {
 					NetSocketStream &on_next_connected( Listener &&listener ) {
 						base::add_listener<NetSocketStream>(
 						  "connect", emitter( ),
-						  [sock = *this, listener = mutable_capture(
-						                   std::forward<Listener>( listener ) )]( ) {
-							  if( sock ) {
-								  daw::invoke( *listener, sock );
-							  }
-						  },
+						  [listener =
+						     mutable_capture( std::forward<Listener>( listener ) )](
+						    NetSocketStream sock ) { daw::invoke( *listener, sock ); },
 						  base::callback_run_mode_t::run_once );
 						return *this;
 					}
@@ -754,12 +1110,68 @@ namespace daw {
 					}
 
 				private:
+					static void handle_resolve( NetSocketStream &obj,
+					                            base::ErrorCode const &err,
+					                            DnsCache::results_t results,
+					                            std::string const &host, uint16_t port ) {
+						if( err ) {
+							obj.emit_error( err, "Error resolving host", "connect" );
+							return;
+						}
+						try {
+							// TODO ensure we have the correct handling, not passing endpoint
+							// on
+							auto handler = [obj = mutable_capture( obj ), host,
+							                port]( daw::nodepp::base::ErrorCode const &ec,
+							                       auto && ) {
+								handle_connect( *obj, ec, host, port );
+							};
+							obj.m_data->m_socket.connect_async(
+							  results, obj.m_data->m_connect_options, daw::move( handler ) );
+						} catch( ... ) {
+							obj.emit_error( std::current_exception( ),
+							                "Exception starting connect", "connect" );
+						}
+					}
+
 					static void handle_connect( NetSocketStream &obj,
-					                            base::ErrorCode err ) {
+					                            base::ErrorCode err,
+					                            std::string const &host, uint16_t port ) {
 						if( err ) {
 							obj.emit_error( err, "Running connection listeners", "connect" );
 							return;
 						}
+						try {
+							if constexpr( Socket::supports_encryption ) {
+								if( obj.m_data->m_socket.encyption_on( ) ) {
+									// Connected once the handshake is done, it resumes the
+									// last session with the host when the context keeps them
+									auto handler = [obj = mutable_capture( obj )](
+									                 base::ErrorCode const &ec ) {
+										handle_connect( *obj, ec );
+									};
+									obj.m_data->m_socket.client_handshake_async(
+									  host, port, daw::move( handler ) );
+									return;
+								}
+							} else {
+								Unused( host );
+								Unused( port );
+							}
+							obj.emit_connect( );
+						} catch( ... ) {
+							obj.emit_error( std::current_exception( ),
+							                "Exception while running connection listener",
+							                "handle_connect" );
+						}
+					}
+
+					static void handle_connect( NetSocketStream &obj,
+					                            base::ErrorCode err ) {
+						if( err ) {
+							obj.emit_error( err, "Error during TLS handshake", "connect" );
+							return;
+						}
 						try {
 							obj.emit_connect( );
 						} catch( ... ) {
@@ -783,16 +1195,33 @@ namespace daw {
 							auto ptr = obj.m_data;
 							auto &response_buffers = ptr->m_response_buffers;
 
-							read_buffer->commit( bytes_transferred );
+							// The read has already committed the data.  Anything past
+							// bytes_transferred belongs to the next read and stays in
+							// read_buffer
 							if( bytes_transferred > 0 ) {
-
+								auto data_size = bytes_transferred;
+								if( ptr->m_read_options.read_mode ==
+								    NetSocketStreamReadMode::length_prefixed ) {
+									auto const &frame = ptr->m_read_options.read_frame;
+									auto const first =
+									  static_cast<char const *>( read_buffer->data( ).data( ) );
+									auto const hdr =
+									  frame.header( first, first + bytes_transferred );
+									if( !hdr or hdr->payload_size > frame.max_frame_size( ) ) {
+										obj.emit_error( "Frame exceeds the maximum frame size",
+										                "handle_read" );
+										obj.close( );
+										return;
+									}
+									read_buffer->consume( hdr->prefix_size );
+									data_size = hdr->payload_size;
+								}
 								std::istream resp( read_buffer.get( ) );
 								auto new_data = std::make_shared<base::data_t>(
-								  bytes_transferred, static_cast<char>( 0 ) );
+								  data_size, static_cast<char>( 0 ) );
 
 								resp.read( new_data->data( ),
-								           static_cast<std::streamsize>( bytes_transferred ) );
-								read_buffer->consume( bytes_transferred );
+								           static_cast<std::streamsize>( data_size ) );
 								if( obj.emitter( ).listener_count( "data_received" ) > 0 ) {
 									if( !response_buffers.empty( ) ) {
 										auto buff = std::make_shared<base::data_t>(
@@ -819,6 +1248,180 @@ namespace daw {
 						}
 					}
 
+#if defined( ASIO_HAS_IO_URING )
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Write plaintext from a registered buffer so that io_uring
+					///				does not pin the pages for each send
+					/// @return	false when encrypting in user space or no buffer is free
+					template<typename ContiguousIterator>
+					bool write_registered_async( ContiguousIterator first,
+					                             ContiguousIterator const last ) {
+						if( m_data->m_socket.user_space_encryption( ) ) {
+							return false;
+						}
+						auto const size =
+						  static_cast<size_t>( std::distance( first, last ) );
+						auto lease =
+						  base::ServiceHandle::registered_buffers( ).try_acquire( size );
+						if( !lease ) {
+							return false;
+						}
+						std::copy( first, last, lease->data( ) );
+						auto const buff = lease->buffer( size );
+						++m_data->m_pending_writes;
+						auto handler = [obj = mutable_capture( *this ),
+						                lease = daw::move( *lease )](
+						                 base::ErrorCode const &err,
+						                 size_t bytes_transfered ) {
+							handle_write( *obj, err, bytes_transfered );
+						};
+						m_data->m_socket.write_async(
+						  buff, base::bind_arena( m_data->m_handler_arena,
+						                          daw::move( handler ) ) );
+						return true;
+					}
+#endif
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Flush on the next turn of the io service so that the
+					///				writes made until then go out together
+					void schedule_tls_flush( ) {
+						asio::post( base::ServiceHandle::get( ),
+						            [obj = mutable_capture( *this )]( ) {
+							            flush_tls_writes( *obj );
+						            } );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Start the next queued TLS write.  Runs again as each one
+					///				completes until the queue is empty
+					static void flush_tls_writes( NetSocketStream &obj ) {
+						if( !obj.m_data ) {
+							return;
+						}
+						auto &queue = obj.m_data->m_tls_writes;
+						if( auto job = queue.take_job( ) ) {
+							try {
+								( *job )( );
+							} catch( ... ) {
+								obj.emit_error( std::current_exception( ),
+								                "Exception while writing", "flush_tls_writes" );
+								write_finished( obj );
+								flush_tls_writes( obj );
+							}
+							return;
+						}
+						if( !queue.take_writes( ) ) {
+							return;
+						}
+						try {
+							if constexpr( Socket::supports_encryption ) {
+								obj.m_data->m_socket.set_max_record_size(
+								  queue.record_size( ) );
+							}
+							obj.m_data->m_socket.write_async(
+							  queue.writing( ),
+							  base::bind_arena( obj.m_data->m_handler_arena,
+							                    [obj = mutable_capture( obj )](
+							                      base::ErrorCode const &err,
+							                      size_t bytes_transferred ) {
+								                    handle_tls_writes( *obj, err,
+								                                       bytes_transferred );
+							                    } ) );
+						} catch( ... ) {
+							obj.emit_error( std::current_exception( ),
+							                "Exception while writing", "flush_tls_writes" );
+							auto const writes = queue.finish_writes( 0 ) + queue.clear( );
+							for( size_t n = 0; n < writes; ++n ) {
+								write_finished( obj );
+							}
+						}
+					}
+
+					static void handle_tls_writes( NetSocketStream &obj,
+					                               base::ErrorCode err,
+					                               size_t bytes_transferred ) {
+						if( !obj.m_data ) {
+							return;
+						}
+						auto &queue = obj.m_data->m_tls_writes;
+						auto writes = queue.finish_writes( bytes_transferred );
+						if( err ) {
+							// Nothing queued after a failed write can be sent
+							writes += queue.clear( );
+						}
+						handle_write( obj, err, bytes_transferred );
+						for( size_t n = 1; n < writes; ++n ) {
+							if( err ) {
+								write_finished( obj );
+							} else {
+								handle_write( obj, err, 0 );
+							}
+						}
+						if( !err ) {
+							flush_tls_writes( obj );
+						}
+					}
+
+					static void write_finished( NetSocketStream &obj ) {
+						if( ( --obj.m_data->m_pending_writes ) != 0 ) {
+							return;
+						}
+						obj.emit_all_writes_completed( obj );
+						if( obj.m_data->m_close_when_writes_completed ) {
+							obj.m_data->m_close_when_writes_completed = false;
+							obj.m_data->m_shutdown_when_writes_completed = false;
+							obj.end( );
+							obj.close( );
+						} else if( obj.m_data->m_shutdown_when_writes_completed ) {
+							obj.m_data->m_shutdown_when_writes_completed = false;
+							obj.end( );
+						}
+					}
+
+					static void send_file_window(
+					  NetSocketStream &obj,
+					  std::shared_ptr<nss_impl::file_chunk_reader_t> reader ) {
+						auto const buff = reader->read_window( );
+						auto handler = [obj = mutable_capture( obj ),
+						                reader = daw::move( reader )](
+						                 base::ErrorCode err, size_t bytes_transferred ) {
+							handle_file_window( *obj, daw::move( reader ), err,
+							                    bytes_transferred );
+						};
+						obj.m_data->m_socket.write_async(
+						  buff, base::bind_arena( obj.m_data->m_handler_arena,
+						                          daw::move( handler ) ) );
+					}
+
+					static void handle_file_window(
+					  NetSocketStream &obj,
+					  std::shared_ptr<nss_impl::file_chunk_reader_t> reader,
+					  base::ErrorCode err, size_t bytes_transferred ) {
+						if( !obj.m_data ) {
+							return;
+						}
+						if( !err and obj.is_closed( ) ) {
+							err = std::make_error_code( std::errc::operation_canceled );
+						}
+						if( err or reader->done( ) ) {
+							handle_write( obj, err, bytes_transferred );
+							if( obj.m_data->m_socket.user_space_encryption( ) ) {
+								flush_tls_writes( obj );
+							}
+							return;
+						}
+						obj.m_data->m_bytes_written += bytes_transferred;
+						try {
+							send_file_window( obj, daw::move( reader ) );
+						} catch( ... ) {
+							obj.emit_error( std::current_exception( ),
+							                "Exception while writing from file",
+							                "handle_file_window" );
+							write_finished( obj );
+						}
+					}
+
 					static void handle_write( NetSocketStream &obj,
 					                          base::write_buffer &&buff,
 					                          base::ErrorCode err,
@@ -827,11 +1430,8 @@ namespace daw {
 						if( !obj ) {
 							return;
 						}
-						auto const on_exit = daw::on_scope_exit( [&]( ) {
-							if( ( --obj.m_data->m_pending_writes ) == 0 ) {
-								obj.emit_all_writes_completed( obj );
-							}
-						} );
+						auto const on_exit =
+						  daw::on_scope_exit( [&]( ) { write_finished( obj ); } );
 						try {
 							obj.m_data->m_bytes_written += bytes_transferred;
 							if( !err ) {
@@ -852,11 +1452,8 @@ namespace daw {
 						if( !obj.m_data ) {
 							return;
 						}
-						auto const on_exit = daw::on_scope_exit( [&]( ) {
-							if( ( --obj.m_data->m_pending_writes ) == 0 ) {
-								obj.emit_all_writes_completed( obj );
-							}
-						} );
+						auto const on_exit =
+						  daw::on_scope_exit( [&]( ) { write_finished( obj ); } );
 						obj.m_data->m_bytes_written += bytes_transfered;
 						if( !err ) {
 							try {
@@ -878,9 +1475,14 @@ namespace daw {
 
 				inline constexpr daw::string_view const eol = "\r\n";
 
-				template<typename Emitter>
-				NetSocketStream<Emitter> &operator<<( NetSocketStream<Emitter> &socket,
-				                                      daw::string_view message ) {
+				template<typename EventEmitter = base::StandardEventEmitter>
+				using NetPlainSocketStream =
+				  NetSocketStream<EventEmitter, nss_impl::PlainSocket>;
+
+				template<typename Emitter, typename Socket>
+				NetSocketStream<Emitter, Socket> &
+				operator<<( NetSocketStream<Emitter, Socket> &socket,
+				            daw::string_view message ) {
 					daw::exception::precondition_check(
 					  socket, "Attempt to use a null NetSocketStream" );
 
@@ -23,6 +23,9 @@
 #pragma once
 
 #include <asio/ip/tcp.hpp>
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/thread_pool.hpp>
 #include <list>
 #include <memory>
 #include <string>
@@ -32,11 +35,17 @@
 
 #include "base_error.h"
 #include "base_event_emitter.h"
+#include "base_handler_arena.h"
 #include "base_service_handle.h"
 #include "base_types.h"
+#include "lib_net_accept_guard.h"
 #include "lib_net_address.h"
+#include "lib_net_proxy_protocol.h"
 #include "lib_net_server.h"
+#include "lib_net_socket_options.h"
 #include "lib_net_socket_stream.h"
+#include "lib_net_unix_socket.h"
+#include "lib_net_tls_context.h"
 
 namespace daw {
 	namespace nodepp {
@@ -53,6 +62,18 @@ namespace daw {
 
 					std::shared_ptr<asio::ip::tcp::acceptor> m_acceptor;
 					SslServerConfig m_config;
+					std::shared_ptr<TlsContext> m_tls_context =
+					  std::make_shared<TlsContext>( );
+					/// Runs handshakes when tls_handshake_threads is set
+					std::shared_ptr<asio::thread_pool> m_handshake_pool{};
+					SocketOptions m_socket_options{};
+					AcceptOptions m_accept_options{};
+					asio::ip::tcp m_protocol = asio::ip::tcp::v6( );
+					/// Memory for the pending accepts, shared by copies of the server
+					base::handler_arena_t m_accept_arena{};
+					std::shared_ptr<nss_impl::accept_guard_t> m_accept_guard{};
+					/// Listening on a unix domain socket, TCP options do not apply
+					bool m_is_unix = false;
 
 					using base::BasicStandardEvents<NetSslServer<EventEmitter>,
 					                                EventEmitter>::emitter;
@@ -74,13 +95,16 @@ namespace daw {
 							                   ? asio::ip::tcp::v4( )
 							                   : asio::ip::tcp::v6( );
 							auto endpoint = EndPoint( tcp, port );
+							m_tls_context->reload( m_config );
+							start_handshake_pool( );
 							m_acceptor->open( endpoint.protocol( ) );
 							m_acceptor->set_option(
 							  asio::ip::tcp::acceptor::reuse_address( true ) );
 							set_ipv6_only( *m_acceptor, ip_ver );
+							nss_impl::apply_listen_options( *m_acceptor, m_socket_options );
 							m_acceptor->bind( endpoint );
 							m_acceptor->listen( max_backlog );
-							start_accept( );
+							start_accepting( tcp );
 							emitter( ).emit( "listening", daw::move( endpoint ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
@@ -94,13 +118,16 @@ namespace daw {
 							                   ? asio::ip::tcp::v4( )
 							                   : asio::ip::tcp::v6( );
 							auto endpoint = EndPoint( tcp, port );
+							m_tls_context->reload( m_config );
+							start_handshake_pool( );
 							m_acceptor->open( endpoint.protocol( ) );
 							m_acceptor->set_option(
 							  asio::ip::tcp::acceptor::reuse_address( true ) );
 							set_ipv6_only( *m_acceptor, ip_ver );
+							nss_impl::apply_listen_options( *m_acceptor, m_socket_options );
 							m_acceptor->bind( endpoint );
 							m_acceptor->listen( );
-							start_accept( );
+							start_accepting( tcp );
 							emitter( ).emit( "listening", daw::move( endpoint ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
@@ -108,16 +135,102 @@ namespace daw {
 						}
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Listen on the unix domain socket at path, '@' first for
+					///				the abstract namespace.  The listening event carries an
+					///				unspecified EndPoint
+					void listen_unix( std::string const &path, uint16_t max_backlog ) {
+						try {
+							m_tls_context->reload( m_config );
+							start_handshake_pool( );
+							nss_impl::listen_unix( *m_acceptor, path, max_backlog );
+							m_is_unix = true;
+							start_accepting( asio::ip::tcp::v4( ) );
+							emitter( ).emit( "listening", EndPoint( ) );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error listening for connection", "listen_unix" );
+						}
+					}
+
+					void listen_unix( std::string const &path ) {
+						listen_unix( path, static_cast<uint16_t>(
+						                     asio::socket_base::max_listen_connections ) );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Options applied to the listening socket, and to each
+					///				accepted one where they are not inherited.  Set before
+					///				listening
+					void set_socket_options( SocketOptions options ) {
+						m_socket_options = daw::move( options );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	How many accepts are outstanding and whether the backlog
+					///				is drained after each.  Set before listening
+					void set_accept_options( AcceptOptions options ) {
+						m_accept_options = daw::move( options );
+					}
+
 					void listen( uint16_t port ) {
 						listen( port, ip_version::ipv6 );
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Session resumption counters since the server started
+					TlsSessionStats tls_session_stats( ) const {
+						return m_tls_context->session_stats( );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Open connections and those shed under load.  All zero
+					///				before listening
+					AcceptStats accept_stats( ) const {
+						if( !m_accept_guard ) {
+							return AcceptStats{};
+						}
+						return m_accept_guard->stats( );
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Read the certificate and key files again and use them for
+					///				new connections.  Existing connections are unaffected
+					void reload_tls_context( ) {
+						try {
+							m_tls_context->reload( );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error reloading TLS context",
+							            "NetSslServer::reload_tls_context" );
+						}
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Use the files in ssl_config for new connections
+					void reload_tls_context( SslServerConfig const &ssl_config ) {
+						try {
+							m_tls_context->reload( ssl_config );
+							m_config = ssl_config;
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error reloading TLS context",
+							            "NetSslServer::reload_tls_context" );
+						}
+					}
+
 					template<bool NotImplemented = true>
 					constexpr void close( ) noexcept {
 						static_assert( !NotImplemented );
 					}
 
 					NetAddress address( ) const {
+						if( m_is_unix ) {
+							// The acceptor's endpoint would decode the sockaddr_un as IP
+							return NetAddress{
+							  nss_impl::unix_address( m_acceptor->native_handle( ), false )
+							    .value_or( "unix" )};
+						}
 						std::stringstream ss{};
 						ss << m_acceptor->local_endpoint( );
 						return NetAddress{ss.str( )};
@@ -136,28 +249,150 @@ namespace daw {
 					static void handle_handshake( NetSslServer &self,
 					                              NetSocketStream<EventEmitter> socket,
 					                              base::ErrorCode err ) {
-
-						daw::exception::daw_throw_value_on_true( err );
+						// A failed handshake only affects that client
+						if( err ) {
+							self.emit_error( err, "Error during TLS handshake",
+							                 "NetSslServer::handle_handshake" );
+							return;
+						}
 						self.emitter( ).emit( "connection", daw::move( socket ) );
 					}
 
+					NetSocketStream<EventEmitter> make_socket( ) {
+						auto socket =
+						  NetSocketStream<EventEmitter>( m_tls_context->get( ) );
+						daw::exception::precondition_check(
+						  socket, "NetSslServer::make_socket( ), Invalid socket - null" );
+
+						socket.socket( ).init( );
+						socket.socket( ).set_shutdown_timeout(
+						  m_config.get_tls_shutdown_timeout( ) );
+						return socket;
+					}
+
+					void accept_connection( NetSocketStream<EventEmitter> socket ) {
+						m_accept_guard->reset_backoff( );
+						auto slot = m_accept_guard->try_take_slot( );
+						if( !slot ) {
+							// A handshake costs more than the refusal is worth
+							auto err = base::ErrorCode( );
+							socket.socket( ).next_layer( ).close( err );
+							return;
+						}
+						socket.hold_connection_slot( daw::move( slot ) );
+						if( m_is_unix ) {
+							socket.socket( ).set_unix_domain( );
+						} else if( !nss_impl::socket_options_inherited( ) ) {
+							nss_impl::apply_socket_options( socket.socket( ).next_layer( ),
+							                                m_socket_options );
+						}
+						if( m_accept_options.get_proxy_protocol( ) ) {
+							// The header comes before the TLS handshake
+							read_proxy_header( daw::move( socket ) );
+							return;
+						}
+						start_handshake( daw::move( socket ) );
+					}
+
+					static void handle_proxy_header( NetSslServer &self,
+					                                 NetSocketStream<EventEmitter> socket,
+					                                 base::ErrorCode err,
+					                                 ProxyHeader header ) {
+						if( err ) {
+							self.emit_error( err, "Error reading PROXY protocol header",
+							                 "NetSslServer::handle_proxy_header" );
+							auto ec = base::ErrorCode( );
+							socket.socket( ).next_layer( ).close( ec );
+							return;
+						}
+						socket.set_proxy_header( daw::move( header ) );
+						self.start_handshake( daw::move( socket ) );
+					}
+
+					void read_proxy_header( NetSocketStream<EventEmitter> socket ) {
+						auto &raw_socket = socket.socket( ).next_layer( );
+						nss_impl::read_proxy_header_async(
+						  raw_socket, m_accept_options.get_proxy_header_timeout( ),
+						  [socket = mutable_capture( daw::move( socket ) ),
+						   self = mutable_capture( *this )]( base::ErrorCode err,
+						                                     ProxyHeader header ) {
+							  handle_proxy_header( *self, *socket, err, daw::move( header ) );
+						  } );
+					}
+
+					void start_handshake( NetSocketStream<EventEmitter> socket ) {
+						auto tmp_sock = socket;
+						if( !m_handshake_pool ) {
+							tmp_sock.socket( ).handshake_async(
+							  asio::ssl::stream_base::server,
+							  [socket = mutable_capture( daw::move( socket ) ),
+							   self = mutable_capture( *this )](
+							    base::ErrorCode const &err ) {
+								  handle_handshake( *self, *socket, err );
+							  } );
+							return;
+						}
+						// The key exchange runs on the pool, the connection continues on
+						// the io threads.  Nothing that owns the pool may be left on a
+						// pool thread, the last owner joins its threads
+						tmp_sock.socket( ).handshake_async(
+						  asio::ssl::stream_base::server, m_handshake_pool->get_executor( ),
+						  [socket = mutable_capture( daw::move( socket ) ),
+						   self = mutable_capture( *this )]( base::ErrorCode const &err ) {
+							  asio::post( base::ServiceHandle::get( ),
+							              [socket = mutable_capture( daw::move( *socket ) ),
+							               self = mutable_capture( daw::move( *self ) ),
+							               err]( ) {
+								              handle_handshake( *self, *socket, err );
+							              } );
+						  } );
+					}
+
+					void start_handshake_pool( ) {
+						auto const threads = m_config.get_tls_handshake_threads( );
+						if( threads > 0 and !m_handshake_pool ) {
+							m_handshake_pool = std::make_shared<asio::thread_pool>(
+							  static_cast<size_t>( threads ) );
+						}
+					}
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Take every connection already queued without going back
+					///				to the reactor for each one
+					void drain_backlog( ) {
+						while( true ) {
+							auto socket = make_socket( );
+							auto err = base::ErrorCode( );
+							if( !nss_impl::try_accept( *m_acceptor,
+							                           socket.socket( ).next_layer( ),
+							                           m_protocol, err ) ) {
+								if( err ) {
+									emit_error( err, "Error draining backlog",
+									            "NetSslServer::drain_backlog" );
+								}
+								return;
+							}
+							accept_connection( daw::move( socket ) );
+						}
+					}
+
 					static void handle_accept( NetSslServer &self,
 					                           NetSocketStream<EventEmitter> socket,
 					                           base::ErrorCode err ) {
 						try {
-							if( err.value( ) == 24 ) {
-								self.emit_error( err, "Too many open files",
-								                 "NetNoSslServer::handle_accept" );
-							} else {
-								daw::exception::daw_throw_value_on_true( err );
-								auto tmp_sock = socket;
-								tmp_sock.socket( ).handshake_async(
-								  asio::ssl::stream_base::server,
-								  [socket = mutable_capture( daw::move( socket ) ),
-								   self = mutable_capture( daw::move( self ) )](
-								    base::ErrorCode const &err1 ) {
-									  handle_handshake( *self, *socket, err1 );
-								  } );
+							if( nss_impl::is_resource_exhausted( err ) ) {
+								// Accepting again straight away would spin while the
+								// backlog stays full
+								self.m_accept_guard->shed_backlog( *self.m_acceptor );
+								self.emit_error( err, "Out of descriptors",
+								                 "NetSslServer::handle_accept" );
+								self.start_accept_after( self.m_accept_guard->next_backoff( ) );
+								return;
+							}
+							daw::exception::daw_throw_value_on_true( err );
+							self.accept_connection( daw::move( socket ) );
+							if( self.m_accept_options.get_drain_backlog( ) ) {
+								self.drain_backlog( );
 							}
 						} catch( ... ) {
 							self.emit_error( std::current_exception( ),
@@ -167,23 +402,35 @@ namespace daw {
 						self.start_accept( );
 					}
 
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Keep pending_accepts accepts outstanding.  Each re-arms
+					///				itself when it completes
+					void start_accepting( asio::ip::tcp const &protocol ) {
+						m_protocol = protocol;
+						m_accept_guard =
+						  std::make_shared<nss_impl::accept_guard_t>( m_accept_options );
+						if( m_accept_options.get_drain_backlog( ) ) {
+							m_acceptor->non_blocking( true );
+						}
+						for( uint16_t n = 0; n < m_accept_options.get_pending_accepts( );
+						     ++n ) {
+							start_accept( );
+						}
+					}
+
 					void start_accept( ) {
 						try {
-							auto socket = NetSocketStream<EventEmitter>( m_config );
-							daw::exception::precondition_check(
-							  socket,
-							  "NetSslServer::start_accept( ), Invalid socket - null" );
-
-							socket.socket( ).init( );
+							auto socket = make_socket( );
 							auto &asio_socket = socket.socket( );
 
 							m_acceptor->async_accept(
 							  asio_socket->lowest_layer( ),
-							  [socket = mutable_capture( daw::move( socket ) ),
-							   self = mutable_capture( *this )]( base::ErrorCode err ) {
-								  daw::exception::daw_throw_value_on_true( err );
-								  handle_accept( *self, *socket, err );
-							  } );
+							  base::bind_arena(
+							    m_accept_arena,
+							    [socket = mutable_capture( daw::move( socket ) ),
+							     self = mutable_capture( *this )]( base::ErrorCode err ) {
+								    handle_accept( *self, *socket, err );
+							    } ) );
 						} catch( ... ) {
 							emit_error( std::current_exception( ),
 							            "Error while starting accept",
@@ -191,6 +438,21 @@ namespace daw {
 						}
 					}
 
+					void start_accept_after( std::chrono::milliseconds delay ) {
+						try {
+							auto timer = std::make_shared<asio::steady_timer>(
+							  base::ServiceHandle::get( ), delay );
+							timer->async_wait(
+							  [self = mutable_capture( *this ), timer]( base::ErrorCode ) {
+								  self->start_accept( );
+							  } );
+						} catch( ... ) {
+							emit_error( std::current_exception( ),
+							            "Error while delaying accept",
+							            "NetSslServer::start_accept_after" );
+						}
+					}
+
 				}; // class NetSslServer
 			}    // namespace net
 		}      // namespace lib
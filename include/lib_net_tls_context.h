@@ -0,0 +1,104 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <asio/ssl/context.hpp>
+#include <memory>
+#include <mutex>
+
+#include "lib_net_socket_asio_socket.h"
+#include "lib_net_tls_session.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Build a server side TLS context from the certificate, key
+				///				and dh files in ssl_config
+				std::shared_ptr<EncryptionContext>
+				make_server_context( SslServerConfig const &ssl_config );
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	As above, keeping sessions and ticket keys in state so
+				///				that they outlive the context
+				std::shared_ptr<EncryptionContext> make_server_context(
+				  SslServerConfig const &ssl_config,
+				  std::shared_ptr<nss_impl::TlsSessionState> state );
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	A context for outbound connections that resumes the
+				///				session last used with each host and port.  Share it
+				///				between sockets so that they share the sessions
+				std::shared_ptr<EncryptionContext>
+				make_client_context( size_t session_cache_size = 1024U );
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	The TLS context shared by every connection a server
+				///				accepts.  It is built once and not changed afterward, a
+				///				reload builds a new one and swaps it in.  Connections
+				///				keep the context they were accepted with
+				class TlsContext {
+					std::shared_ptr<EncryptionContext> m_context{};
+					SslServerConfig m_config{};
+					std::shared_ptr<nss_impl::TlsSessionState> m_session_state{};
+					std::mutex m_reload_mutex{};
+
+				public:
+					TlsContext( ) = default;
+					explicit TlsContext( SslServerConfig ssl_config );
+
+					TlsContext( TlsContext const & ) = delete;
+					TlsContext( TlsContext && ) = delete;
+					TlsContext &operator=( TlsContext const & ) = delete;
+					TlsContext &operator=( TlsContext && ) = delete;
+					~TlsContext( ) = default;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The current context, or null if none has been loaded.
+					///				Safe to call while another thread reloads
+					std::shared_ptr<EncryptionContext> get( ) const;
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Read the files named in the last config again, for
+					///				when the certificates are rotated in place.  On error
+					///				the current context is kept and the exception is
+					///				rethrown
+					void reload( );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Build a context from ssl_config and use it for new
+					///				connections
+					void reload( SslServerConfig ssl_config );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Resumption counters, kept across reloads
+					TlsSessionStats session_stats( ) const;
+
+					explicit operator bool( ) const;
+				};
+			} // namespace net
+		}   // namespace lib
+	}     // namespace nodepp
+} // namespace daw
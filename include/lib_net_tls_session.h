@@ -0,0 +1,190 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <array>
+#include <asio/ssl/context.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Counters for TLS session resumption on one context
+				struct TlsSessionStats {
+					/// Completed handshakes, full and resumed
+					uint64_t handshakes = 0;
+					/// Handshakes that resumed a session from the cache or a ticket
+					uint64_t resumed = 0;
+					uint64_t cache_hits = 0;
+					uint64_t cache_misses = 0;
+					/// Sessions dropped from the cache to make room for new ones
+					uint64_t cache_evictions = 0;
+					uint64_t cache_size = 0;
+					uint64_t tickets_issued = 0;
+					uint64_t ticket_key_rotations = 0;
+				};
+
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	The resumption counters of a context.  All zero when
+				///				resumption was never enabled on it
+				TlsSessionStats tls_session_stats( asio::ssl::context &ctx );
+
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	An LRU cache of TLS sessions split into shards, each with
+					///				its own lock, so that handshakes on different threads
+					///				seldom wait on each other
+					class TlsSessionCache {
+						struct shard_t;
+						std::unique_ptr<shard_t[]> m_shards;
+						size_t m_shard_count;
+						size_t m_shard_capacity;
+
+						shard_t &get_shard( std::string const &key ) const;
+
+					public:
+						TlsSessionCache( size_t capacity, size_t shard_count );
+						~TlsSessionCache( );
+
+						TlsSessionCache( TlsSessionCache const & ) = delete;
+						TlsSessionCache( TlsSessionCache && ) = delete;
+						TlsSessionCache &operator=( TlsSessionCache const & ) = delete;
+						TlsSessionCache &operator=( TlsSessionCache && ) = delete;
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Store session under key, replacing what was there.
+						///				The cache takes over the caller's reference
+						/// @return	Number of sessions evicted to make room
+						size_t insert( std::string key, SSL_SESSION *session );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	A new reference to the session stored under key, or
+						///				nullptr when there is none or it has expired.  With
+						///				take the session is removed from the cache
+						SSL_SESSION *find( std::string const &key, bool take = false );
+
+						void erase( std::string const &key );
+						size_t size( ) const;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The keys that encrypt session tickets.  A new key is made
+					///				every rotation period and the old ones still decrypt for
+					///				one more period, after which clients get a full
+					///				handshake
+					class TlsTicketKeys {
+					public:
+						struct key_t {
+							std::array<unsigned char, 16> name{};
+							std::array<unsigned char, 32> aes_key{};
+							std::array<unsigned char, 32> hmac_key{};
+							std::chrono::steady_clock::time_point created{};
+						};
+
+					private:
+						std::chrono::seconds m_rotation;
+						mutable std::mutex m_mutex{};
+						/// Newest first
+						std::deque<key_t> m_keys{};
+						std::atomic<uint64_t> m_rotations{0};
+
+					public:
+						explicit TlsTicketKeys( std::chrono::seconds rotation );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	The key for new tickets, making a new one when due
+						key_t current( );
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	The key a ticket was issued under.  The flag is set when
+						///				it is no longer current and the ticket should be
+						///				replaced
+						std::optional<std::pair<key_t, bool>>
+						find( unsigned char const *name );
+
+						uint64_t rotations( ) const noexcept;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Resumption state of a context.  Kept across reloads of a
+					///				server's certificates so that clients can still resume
+					struct TlsSessionState {
+						std::optional<TlsSessionCache> cache{};
+						std::optional<TlsTicketKeys> ticket_keys{};
+						std::atomic<uint64_t> handshakes{0};
+						std::atomic<uint64_t> resumed{0};
+						std::atomic<uint64_t> cache_hits{0};
+						std::atomic<uint64_t> cache_misses{0};
+						std::atomic<uint64_t> cache_evictions{0};
+						std::atomic<uint64_t> tickets_issued{0};
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @param	cache_size	Sessions kept, 0 for no cache
+						/// @param	ticket_key_rotation	Zero to leave tickets to OpenSSL
+						TlsSessionState( size_t cache_size, size_t cache_shards,
+						                 std::chrono::seconds ticket_key_rotation );
+
+						TlsSessionStats stats( ) const;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Have a server context cache sessions in state and encrypt
+					///				tickets with its rotating keys.  Sessions expire after
+					///				timeout
+					void enable_server_resumption( asio::ssl::context &ctx,
+					                               std::shared_ptr<TlsSessionState> state,
+					                               std::chrono::seconds timeout,
+					                               bool use_tickets );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Have a client context remember the sessions servers give
+					///				it, one per host and port
+					void
+					enable_client_resumption( asio::ssl::context &ctx,
+					                          std::shared_ptr<TlsSessionState> state );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Before a client handshake, name the server for SNI and
+					///				offer the session last used with it
+					void tls_client_prepare( SSL *ssl, std::string const &host,
+					                         uint16_t port );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Count a completed handshake on the context of ssl
+					void tls_record_handshake( SSL *ssl ) noexcept;
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
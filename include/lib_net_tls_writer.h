@@ -0,0 +1,144 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <asio/buffer.hpp>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <optional>
+
+#include "base_types.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Dynamic TLS record sizing.  Records fit in one TCP segment
+					///				until a connection has sent enough to be a bulk transfer,
+					///				so the first bytes of a response can be decrypted as soon
+					///				as they arrive.  After that they grow to the largest
+					///				record, and go back to small after the connection idles
+					class tls_record_sizer_t {
+					public:
+						using clock_type = std::chrono::steady_clock;
+
+						/// Fits in a 1500 byte MTU with the TCP, IP and record overhead
+						static constexpr size_t const small_record_size = 1369U;
+						static constexpr size_t const large_record_size = 16U * 1024U;
+						static constexpr size_t const bulk_threshold = 64U * 1024U;
+						static constexpr std::chrono::milliseconds const idle_timeout{1000};
+
+					private:
+						size_t m_sent = 0;
+						clock_type::time_point m_last_send{};
+
+					public:
+						size_t record_size( clock_type::time_point now ) noexcept;
+						void sent( size_t bytes, clock_type::time_point now ) noexcept;
+					};
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The writes waiting on a TLS connection, in order.  Small
+					///				writes made while another is in flight, or in the same
+					///				tick, are packed into one buffer.  OpenSSL then turns it
+					///				into records of the current record size and it goes to
+					///				the kernel in as few syscalls as the records allow.
+					///				Writes that cannot be copied, like files, are queued as
+					///				jobs so they keep their place
+					class tls_write_queue_t {
+					public:
+						using job_t = std::function<void( )>;
+
+					private:
+						struct item_t {
+							base::data_t data{};
+							size_t writes = 0;
+							job_t job{};
+						};
+						std::deque<item_t> m_items{};
+						base::data_t m_writing{};
+						size_t m_writing_count = 0;
+						bool m_busy = false;
+						tls_record_sizer_t m_record_sizer{};
+
+						bool start( );
+
+					public:
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Queue a copy of [first, last) as one write
+						/// @return	true when nothing is flushing and the caller must
+						///				schedule a flush
+						template<typename ContiguousIterator>
+						bool push( ContiguousIterator first, ContiguousIterator last ) {
+							if( m_items.empty( ) or m_items.back( ).job ) {
+								m_items.emplace_back( );
+							}
+							auto &item = m_items.back( );
+							item.data.insert( item.data.end( ), first, last );
+							++item.writes;
+							return start( );
+						}
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Queue a write that starts itself.  It must call
+						///				the flush again when it completes
+						/// @return	true when the caller must schedule a flush
+						bool push_job( job_t job );
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	The job at the front, if that is what runs next
+						std::optional<job_t> take_job( );
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Move the packed writes at the front into the write
+						///				buffer
+						/// @return	false when the queue is empty, it is then idle
+						bool take_writes( );
+
+						asio::const_buffer writing( ) const noexcept;
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	The record size to use for the write being started
+						size_t record_size( );
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	The write buffer has been sent
+						/// @return	The number of writes it held
+						size_t finish_writes( size_t bytes_transferred );
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Drop everything still queued after an error
+						/// @return	The number of writes dropped
+						size_t clear( ) noexcept;
+					};
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <asio/ip/tcp.hpp>
+#include <functional>
+#include <optional>
+#include <string>
+
+#include <daw/daw_utility.h>
+
+#include "base_error.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				//////////////////////////////////////////////////////////////////////////
+				/// @brief	Where a unix domain socket listens.  A path starting with
+				///				'@' is a name in the Linux abstract namespace and leaves no
+				///				file behind
+				struct UnixEndPoint {
+					std::string path;
+
+					explicit UnixEndPoint( std::string p )
+					  : path( daw::move( p ) ) {}
+				};
+
+				namespace nss_impl {
+					// Unix domain sockets are carried in the asio::ip::tcp acceptors
+					// and sockets.  Reads, writes and accepts only use the descriptor,
+					// so servers and streams work on them unchanged.  TCP options and
+					// asio's endpoint queries do not apply to them, the sockaddr_un
+					// would be decoded as an IP address.  Use unix_address instead
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Open acceptor as a unix domain socket listening on path.
+					///				A stale socket file left at path is removed first.
+					///				Throws EADDRINUSE when a server still listens there
+					void listen_unix( asio::ip::tcp::acceptor &acceptor,
+					                  std::string const &path, int backlog );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	Connect socket to the unix domain socket at path.  handler
+					///				is called on the io service, with try_again when the
+					///				listener's backlog is full
+					void
+					connect_unix_async( asio::ip::tcp::socket &socket,
+					                    std::string const &path,
+					                    std::function<void( base::ErrorCode )> handler );
+
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	The address of the unix domain socket fd, or of its peer,
+					///				as "unix:" and the path.  Abstract names start with '@'
+					///				and an unnamed end, like most connecting clients, is just
+					///				"unix"
+					/// @return	nullopt when fd is not a unix domain socket
+					std::optional<std::string> unix_address( int fd, bool peer );
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
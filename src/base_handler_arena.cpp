@@ -0,0 +1,150 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <new>
+
+#include "base_handler_arena.h"
+#include "base_slab.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			namespace ha_impl {
+				arena_block_t *arena_block_t::create( ) {
+					auto *mem = slab_impl::allocate( sizeof( arena_block_t ) );
+					return new( mem ) arena_block_t( );
+				}
+
+				void arena_block_t::add_ref( ) noexcept {
+					++m_refs;
+				}
+
+				void arena_block_t::release( ) noexcept {
+					if( --m_refs != 0 ) {
+						return;
+					}
+					this->~arena_block_t( );
+					slab_impl::deallocate( this, sizeof( arena_block_t ) );
+				}
+
+				bool arena_block_t::try_take( size_t n ) noexcept {
+#if defined( NODEPP_SINGLE_THREADED )
+					if( m_in_use[n] ) {
+						return false;
+					}
+					m_in_use[n] = true;
+					return true;
+#else
+					return !m_in_use[n].exchange( true, std::memory_order_acquire );
+#endif
+				}
+
+				void *arena_block_t::allocate( size_t size ) {
+					if( size <= slot_size ) {
+						for( size_t n = 0; n < slot_count; ++n ) {
+							if( try_take( n ) ) {
+								add_ref( );
+								return m_slots[n].data;
+							}
+						}
+					}
+					++m_fallbacks;
+					return ::operator new( size );
+				}
+
+				void arena_block_t::deallocate( void *ptr ) noexcept {
+					auto const *first = m_slots.front( ).data;
+					auto const *last = m_slots.back( ).data + slot_size;
+					auto const *p = static_cast<unsigned char const *>( ptr );
+					if( p < first or p >= last ) {
+						::operator delete( ptr );
+						return;
+					}
+					auto const n = static_cast<size_t>( p - first ) / sizeof( slot_t );
+#if defined( NODEPP_SINGLE_THREADED )
+					m_in_use[n] = false;
+#else
+					m_in_use[n].store( false, std::memory_order_release );
+#endif
+					release( );
+				}
+
+				size_t arena_block_t::fallbacks( ) const noexcept {
+					return m_fallbacks;
+				}
+			} // namespace ha_impl
+
+			handler_arena_t::handler_arena_t( )
+			  : m_block( ha_impl::arena_block_t::create( ) ) {}
+
+			handler_arena_t::~handler_arena_t( ) noexcept {
+				if( m_block != nullptr ) {
+					m_block->release( );
+				}
+			}
+
+			handler_arena_t::handler_arena_t( handler_arena_t const &other ) noexcept
+			  : m_block( other.m_block ) {
+				if( m_block != nullptr ) {
+					m_block->add_ref( );
+				}
+			}
+
+			handler_arena_t &
+			handler_arena_t::operator=( handler_arena_t const &rhs ) noexcept {
+				if( m_block != rhs.m_block ) {
+					if( rhs.m_block != nullptr ) {
+						rhs.m_block->add_ref( );
+					}
+					if( m_block != nullptr ) {
+						m_block->release( );
+					}
+					m_block = rhs.m_block;
+				}
+				return *this;
+			}
+
+			handler_arena_t::handler_arena_t( handler_arena_t &&other ) noexcept
+			  : m_block( std::exchange( other.m_block, nullptr ) ) {}
+
+			handler_arena_t &
+			handler_arena_t::operator=( handler_arena_t &&rhs ) noexcept {
+				if( this != &rhs ) {
+					if( m_block != nullptr ) {
+						m_block->release( );
+					}
+					m_block = std::exchange( rhs.m_block, nullptr );
+				}
+				return *this;
+			}
+
+			ha_impl::arena_block_t &handler_arena_t::block( ) const noexcept {
+				return *m_block;
+			}
+
+			size_t handler_arena_t::fallbacks( ) const noexcept {
+				return m_block->fallbacks( );
+			}
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
@@ -0,0 +1,135 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <system_error>
+#include <utility>
+
+#include <daw/daw_utility.h>
+
+#include "base_registered_buffers.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			RegisteredBufferPool::lease_t::lease_t( RegisteredBufferPool &pool,
+			                                        size_t index ) noexcept
+			  : m_pool( &pool )
+			  , m_index( index ) {}
+
+			RegisteredBufferPool::lease_t::~lease_t( ) noexcept {
+				if( m_pool != nullptr ) {
+					m_pool->release( m_index );
+				}
+			}
+
+			RegisteredBufferPool::lease_t::lease_t( lease_t &&other ) noexcept
+			  : m_pool( std::exchange( other.m_pool, nullptr ) )
+			  , m_index( other.m_index ) {}
+
+			RegisteredBufferPool::lease_t &RegisteredBufferPool::lease_t::
+			operator=( lease_t &&rhs ) noexcept {
+				if( this != &rhs ) {
+					if( m_pool != nullptr ) {
+						m_pool->release( m_index );
+					}
+					m_pool = std::exchange( rhs.m_pool, nullptr );
+					m_index = rhs.m_index;
+				}
+				return *this;
+			}
+
+			char *RegisteredBufferPool::lease_t::data( ) const noexcept {
+				return m_pool->m_memory.get( ) + m_index * m_pool->m_buffer_size;
+			}
+
+			size_t RegisteredBufferPool::lease_t::capacity( ) const noexcept {
+				return m_pool->m_buffer_size;
+			}
+
+			RegisteredBufferPool::buffer_type
+			RegisteredBufferPool::lease_t::buffer( size_t size ) const noexcept {
+#if defined( ASIO_HAS_IO_URING )
+				return asio::buffer( ( *m_pool->m_registration )[m_index], size );
+#else
+				return asio::buffer( data( ), size );
+#endif
+			}
+
+			RegisteredBufferPool::RegisteredBufferPool( IoService &service,
+			                                            size_t buffer_count,
+			                                            size_t buffer_size )
+			  : m_buffer_size( buffer_size )
+			  , m_memory( std::make_unique<char[]>( buffer_count * buffer_size ) )
+			  , m_free( buffer_count ) {
+
+				for( size_t n = 0; n < buffer_count; ++n ) {
+					m_free[n] = buffer_count - n - 1;
+				}
+#if defined( ASIO_HAS_IO_URING )
+				auto buffers = std::vector<asio::mutable_buffer>( );
+				buffers.reserve( buffer_count );
+				for( size_t n = 0; n < buffer_count; ++n ) {
+					buffers.emplace_back( m_memory.get( ) + n * buffer_size,
+					                      buffer_size );
+				}
+				try {
+					m_registration.emplace( service, buffers );
+				} catch( std::system_error const & ) {
+					// Usually RLIMIT_MEMLOCK.  try_acquire will always fail and
+					// callers use their own memory
+					m_registration.reset( );
+				}
+#else
+				Unused( service );
+#endif
+			}
+
+			void RegisteredBufferPool::release( size_t index ) noexcept {
+				auto const lck = std::lock_guard<std::mutex>( m_mutex );
+				m_free.push_back( index );
+			}
+
+			size_t RegisteredBufferPool::buffer_size( ) const noexcept {
+				return m_buffer_size;
+			}
+
+			std::optional<RegisteredBufferPool::lease_t>
+			RegisteredBufferPool::try_acquire( size_t size ) {
+				if( size > m_buffer_size ) {
+					return std::nullopt;
+				}
+#if defined( ASIO_HAS_IO_URING )
+				if( !m_registration ) {
+					return std::nullopt;
+				}
+#endif
+				auto const lck = std::lock_guard<std::mutex>( m_mutex );
+				if( m_free.empty( ) ) {
+					return std::nullopt;
+				}
+				auto const index = m_free.back( );
+				m_free.pop_back( );
+				return lease_t( *this, index );
+			}
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
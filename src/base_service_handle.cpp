@@ -24,14 +24,30 @@
 
 #include <daw/daw_exception.h>
 
+#include "base_registered_buffers.h"
 #include "base_service_handle.h"
+#include "base_threading.h"
 
 namespace daw {
 	namespace nodepp {
 		namespace base {
 			IoService &ServiceHandle::get( ) {
-				static IoService result{};
-				return result;
+				if constexpr( is_single_threaded ) {
+					// Lets the scheduler skip waking other threads for new work
+					static IoService result( 1 );
+					return result;
+				} else {
+					static IoService result{};
+					return result;
+				}
+			}
+
+			RegisteredBufferPool &ServiceHandle::registered_buffers( ) {
+				// Never destructed, write handlers still pending when the IoService
+				// is torn down return their buffers to it
+				static auto *const result =
+				  new RegisteredBufferPool( get( ), 64U, 16U * 1024U );
+				return *result;
 			}
 
 			void ServiceHandle::run( ) {
@@ -56,6 +72,11 @@ namespace daw {
 					ServiceHandle::run( );
 					break;
 				case StartServiceMode::OnePerCore:
+					// Connections may not be shared between threads, run one process
+					// per core instead
+					daw::exception::precondition_check(
+					  !is_single_threaded,
+					  "OnePerCore is not available with NODEPP_SINGLE_THREADED" );
 					for( size_t n = 1; n < std::thread::hardware_concurrency( ); ++n ) {
 						std::async( []( ) { ServiceHandle::run( ); } );
 					}
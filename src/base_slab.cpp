@@ -0,0 +1,261 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <array>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "base_slab.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace base {
+			namespace slab_impl {
+				namespace {
+					constexpr size_t size_class_count = max_block_size / cache_line_size;
+					constexpr size_t chunk_size = 64U * 1024U;
+					/// Free blocks of one size a thread keeps before returning some
+					/// to the depot.  A thread that frees what others allocate, like
+					/// the last handle of a connection, would otherwise hoard them
+					constexpr size_t max_thread_free_bytes = 4U * chunk_size;
+
+					struct free_block_t {
+						free_block_t *next;
+					};
+
+					struct free_list_t {
+						free_block_t *head = nullptr;
+						free_block_t *tail = nullptr;
+						size_t count = 0;
+
+						void push( free_block_t *block ) noexcept {
+							block->next = head;
+							head = block;
+							if( tail == nullptr ) {
+								tail = block;
+							}
+							++count;
+						}
+
+						free_block_t *pop( ) noexcept {
+							auto *block = head;
+							head = block->next;
+							if( head == nullptr ) {
+								tail = nullptr;
+							}
+							--count;
+							return block;
+						}
+
+						void splice( free_list_t &other ) noexcept {
+							if( other.head == nullptr ) {
+								return;
+							}
+							other.tail->next = head;
+							head = other.head;
+							if( tail == nullptr ) {
+								tail = other.tail;
+							}
+							count += other.count;
+							other = free_list_t{};
+						}
+
+						//////////////////////////////////////////////////////////////////
+						/// @brief	Keep the first keep blocks, the most recently freed,
+						///				and return the rest
+						free_list_t split( size_t keep ) noexcept {
+							auto result = free_list_t{};
+							if( count <= keep ) {
+								return result;
+							}
+							if( keep == 0 ) {
+								return std::exchange( *this, free_list_t{} );
+							}
+							auto *last = head;
+							for( size_t n = 1; n < keep; ++n ) {
+								last = last->next;
+							}
+							result.head = last->next;
+							result.tail = tail;
+							result.count = count - keep;
+							last->next = nullptr;
+							tail = last;
+							count = keep;
+							return result;
+						}
+					};
+
+					constexpr size_t size_class( size_t size ) noexcept {
+						return ( size + cache_line_size - 1U ) / cache_line_size - 1U;
+					}
+
+					constexpr size_t max_thread_free_blocks( size_t cls ) noexcept {
+						return max_thread_free_bytes / ( ( cls + 1U ) * cache_line_size );
+					}
+
+					//////////////////////////////////////////////////////////////////////
+					/// @brief	Owns every chunk and the blocks left behind by threads
+					///				that have exited.  Chunks live until the process ends
+					///				as blocks may be freed by any thread
+					struct depot_t {
+						std::mutex mutex{};
+						std::vector<void *> chunks{};
+						std::array<free_list_t, size_class_count> free_lists{};
+
+						void carve( size_t cls, free_list_t &out ) {
+							auto const block_size = ( cls + 1U ) * cache_line_size;
+							auto *chunk = static_cast<char *>( ::operator new(
+							  chunk_size, std::align_val_t{cache_line_size} ) );
+							{
+								auto const lck = std::lock_guard<std::mutex>( mutex );
+								chunks.push_back( chunk );
+							}
+							for( size_t pos = 0; pos + block_size <= chunk_size;
+							     pos += block_size ) {
+								out.push( reinterpret_cast<free_block_t *>( chunk + pos ) );
+							}
+						}
+
+						//////////////////////////////////////////////////////////////////
+						/// @brief	Move up to half a thread's worth of free blocks to out
+						bool take( size_t cls, free_list_t &out ) {
+							auto const lck = std::lock_guard<std::mutex>( mutex );
+							auto &list = free_lists[cls];
+							if( list.head == nullptr ) {
+								return false;
+							}
+							auto rest = list.split( max_thread_free_blocks( cls ) / 2U );
+							out.splice( list );
+							list = rest;
+							return true;
+						}
+
+						void give( size_t cls, free_list_t &list ) {
+							auto const lck = std::lock_guard<std::mutex>( mutex );
+							free_lists[cls].splice( list );
+						}
+
+						void give( std::array<free_list_t, size_class_count> &lists ) {
+							auto const lck = std::lock_guard<std::mutex>( mutex );
+							for( size_t n = 0; n < size_class_count; ++n ) {
+								free_lists[n].splice( lists[n] );
+							}
+						}
+
+						size_t chunk_count( ) {
+							auto const lck = std::lock_guard<std::mutex>( mutex );
+							return chunks.size( );
+						}
+					};
+
+					depot_t &depot( ) {
+						// Never destructed, threads may exit after static destruction
+						static auto *result = new depot_t{};
+						return *result;
+					}
+
+					struct thread_slab_t {
+						std::array<free_list_t, size_class_count> free_lists{};
+						size_t allocations = 0;
+						size_t reuses = 0;
+						bool closed = false;
+
+						thread_slab_t( ) = default;
+						thread_slab_t( thread_slab_t const & ) = delete;
+						thread_slab_t &operator=( thread_slab_t const & ) = delete;
+
+						~thread_slab_t( ) noexcept {
+							closed = true;
+							depot( ).give( free_lists );
+						}
+
+						void *allocate( size_t cls ) {
+							++allocations;
+							auto &list = free_lists[cls];
+							if( list.head != nullptr ) {
+								++reuses;
+							} else if( depot( ).take( cls, list ) ) {
+								++reuses;
+							} else {
+								depot( ).carve( cls, list );
+							}
+							return list.pop( );
+						}
+
+						void deallocate( void *ptr, size_t cls ) noexcept {
+							auto *block = static_cast<free_block_t *>( ptr );
+							if( closed ) {
+								// A thread_local destructed after this one freed a block
+								auto list = free_list_t{};
+								list.push( block );
+								depot( ).give( cls, list );
+								return;
+							}
+							auto &list = free_lists[cls];
+							list.push( block );
+							auto const max_blocks = max_thread_free_blocks( cls );
+							if( list.count > max_blocks ) {
+								// Keep half so a thread that allocates again soon does not
+								// go straight back to the depot
+								auto excess = list.split( max_blocks / 2U );
+								depot( ).give( cls, excess );
+							}
+						}
+					};
+
+					thread_slab_t &thread_slab( ) {
+						static thread_local thread_slab_t result{};
+						return result;
+					}
+				} // namespace
+
+				void *allocate( size_t size ) {
+					if( size > max_block_size ) {
+						return ::operator new( size,
+						                       std::align_val_t{cache_line_size} );
+					}
+					return thread_slab( ).allocate( size_class( size ) );
+				}
+
+				void deallocate( void *ptr, size_t size ) noexcept {
+					if( ptr == nullptr ) {
+						return;
+					}
+					if( size > max_block_size ) {
+						::operator delete( ptr, std::align_val_t{cache_line_size} );
+						return;
+					}
+					thread_slab( ).deallocate( ptr, size_class( size ) );
+				}
+			} // namespace slab_impl
+
+			slab_stats_t slab_stats( ) {
+				auto &slab = slab_impl::thread_slab( );
+				return slab_stats_t{slab_impl::depot( ).chunk_count( ),
+				                    slab.allocations, slab.reuses};
+			}
+		} // namespace base
+	}   // namespace nodepp
+} // namespace daw
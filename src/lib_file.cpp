@@ -20,11 +20,20 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <asio/post.hpp>
 #include <fstream>
 
+#if defined( ASIO_HAS_FILE )
+#include <asio/random_access_file.hpp>
+#include <asio/read_at.hpp>
+#include <asio/stream_file.hpp>
+#include <asio/write.hpp>
+#endif
+
 #include <daw/daw_string_view.h>
 #include <daw/daw_utility.h>
 
+#include "base_service_handle.h"
 #include "lib_file.h"
 
 namespace daw {
@@ -45,8 +54,136 @@ namespace daw {
 						stream.seekg( current_pos );
 						return result;
 					}
+
+#if defined( ASIO_HAS_FILE )
+					std::optional<base::Error> file_error( char const *description,
+					                                       base::ErrorCode const &err,
+					                                       char const *where ) {
+						auto result = base::create_optional_error( description, err );
+						result->add( "where", where );
+						return result;
+					}
+
+					asio::file_base::flags open_flags( FileWriteMode mode ) {
+						switch( mode ) {
+						case FileWriteMode::AppendOrCreate:
+							return asio::file_base::write_only | asio::file_base::create |
+							       asio::file_base::append;
+						case FileWriteMode::MustCreate:
+							return asio::file_base::write_only | asio::file_base::create |
+							       asio::file_base::exclusive;
+						case FileWriteMode::OverwriteOrCreate:
+							return asio::file_base::write_only | asio::file_base::create |
+							       asio::file_base::truncate;
+						default:
+							daw::exception::daw_throw_unexpected_enum( );
+						}
+					}
+#endif
 				} // namespace
 
+				namespace impl {
+#if defined( ASIO_HAS_FILE )
+					void read_file_async( daw::string_view path,
+					                      std::shared_ptr<base::data_t> buffer,
+					                      read_callback_t on_completion ) {
+
+						auto file = std::make_shared<asio::random_access_file>(
+						  base::ServiceHandle::get( ) );
+						auto err = base::ErrorCode( );
+						file->open( path.to_string( ), asio::file_base::read_only, err );
+						auto const fsize = err ? 0U : file->size( err );
+						if( err ) {
+							asio::post( base::ServiceHandle::get( ),
+							            [err, buffer = daw::move( buffer ),
+							             on_completion = daw::move( on_completion )]( ) {
+								            on_completion(
+								              file_error( "Could not open file", err,
+								                          "read_file#open" ),
+								              buffer );
+							            } );
+							return;
+						}
+						auto const first_pos = buffer->size( );
+						buffer->resize( first_pos + static_cast<size_t>( fsize ) );
+						auto const buff = asio::buffer( buffer->data( ) + first_pos,
+						                                static_cast<size_t>( fsize ) );
+
+						asio::async_read_at(
+						  *file, 0, buff,
+						  [file, buffer = daw::move( buffer ),
+						   on_completion = daw::move( on_completion )](
+						    base::ErrorCode const &read_err, size_t ) {
+							  if( read_err ) {
+								  on_completion( file_error( "Error reading file", read_err,
+								                             "read_file#read" ),
+								                 buffer );
+								  return;
+							  }
+							  on_completion( base::create_optional_error( ), buffer );
+						  } );
+					}
+
+					void write_file_async( daw::string_view path,
+					                       std::shared_ptr<base::data_t const> buffer,
+					                       FileWriteMode mode, size_t bytes_to_write,
+					                       write_callback_t on_completion ) {
+						if( 0 == bytes_to_write or bytes_to_write > buffer->size( ) ) {
+							bytes_to_write = buffer->size( );
+						}
+						auto file = std::make_shared<asio::stream_file>(
+						  base::ServiceHandle::get( ) );
+						auto err = base::ErrorCode( );
+						file->open( path.to_string( ), open_flags( mode ), err );
+						if( err ) {
+							asio::post( base::ServiceHandle::get( ),
+							            [err, on_completion = daw::move( on_completion )]( ) {
+								            on_completion( file_error(
+								              "Could not open file for writing", err,
+								              "write_from_file#open" ) );
+							            } );
+							return;
+						}
+						asio::async_write(
+						  *file, asio::buffer( buffer->data( ), bytes_to_write ),
+						  [file, buffer, on_completion = daw::move( on_completion )](
+						    base::ErrorCode const &write_err, size_t ) {
+							  if( write_err ) {
+								  on_completion( file_error( "Error writing data to file",
+								                             write_err,
+								                             "write_from_file#write" ) );
+								  return;
+							  }
+							  on_completion( base::create_optional_error( ) );
+						  } );
+					}
+#else
+					void read_file_async( daw::string_view path,
+					                      std::shared_ptr<base::data_t> buffer,
+					                      read_callback_t on_completion ) {
+						base::add_task(
+						  [path = path.to_string( ), buffer]( ) {
+							  return read_file( path, *buffer );
+						  },
+						  [buffer, on_completion = daw::move( on_completion )](
+						    std::optional<base::Error> result ) {
+							  on_completion( daw::move( result ), buffer );
+						  } );
+					}
+
+					void write_file_async( daw::string_view path,
+					                       std::shared_ptr<base::data_t const> buffer,
+					                       FileWriteMode mode, size_t bytes_to_write,
+					                       write_callback_t on_completion ) {
+						base::add_task(
+						  [path = path.to_string( ), buffer, mode, bytes_to_write]( ) {
+							  return write_file( path, *buffer, mode, bytes_to_write );
+						  },
+						  daw::move( on_completion ) );
+					}
+#endif
+				} // namespace impl
+
 				std::streampos file_size( daw::string_view path ) {
 					std::ifstream in_file( path.to_string( ),
 					                       std::ifstream::ate | std::ifstream::binary );
@@ -0,0 +1,185 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+#include <algorithm>
+#include <asio/error.hpp>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <daw/daw_utility.h>
+
+#include "lib_net_accept_guard.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					namespace {
+						constexpr int64_t min_backoff_ms = 10;
+
+						int open_spare_fd( ) noexcept {
+							return ::open( "/dev/null", O_RDONLY | O_CLOEXEC );
+						}
+
+						int accept_raw( int listen_fd ) noexcept {
+#if defined( __linux__ )
+							return ::accept4( listen_fd, nullptr, nullptr,
+							                  SOCK_NONBLOCK | SOCK_CLOEXEC );
+#else
+							return ::accept( listen_fd, nullptr, nullptr );
+#endif
+						}
+					} // namespace
+
+					connection_slot_t::connection_slot_t(
+					  std::shared_ptr<accept_guard_t> guard ) noexcept
+					  : m_guard( daw::move( guard ) ) {}
+
+					connection_slot_t::~connection_slot_t( ) noexcept {
+						if( m_guard ) {
+							--m_guard->m_active;
+						}
+					}
+
+					connection_slot_t &connection_slot_t::
+					operator=( connection_slot_t &&rhs ) noexcept {
+						if( this != &rhs ) {
+							if( m_guard ) {
+								--m_guard->m_active;
+							}
+							m_guard = daw::move( rhs.m_guard );
+							rhs.m_guard.reset( );
+						}
+						return *this;
+					}
+
+					connection_slot_t::operator bool( ) const noexcept {
+						return static_cast<bool>( m_guard );
+					}
+
+					accept_guard_t::accept_guard_t( AcceptOptions const &options )
+					  : m_max_connections( options.get_max_connections( ) )
+					  , m_max_backoff( options.get_max_accept_backoff( ) )
+					  , m_spare_fd( open_spare_fd( ) ) {}
+
+					accept_guard_t::~accept_guard_t( ) noexcept {
+						auto const fd = m_spare_fd.exchange( -1 );
+						if( fd >= 0 ) {
+							::close( fd );
+						}
+					}
+
+					connection_slot_t accept_guard_t::try_take_slot( ) {
+						auto const active = ++m_active;
+						if( m_max_connections != 0 and active > m_max_connections ) {
+							--m_active;
+							++m_shed_over_limit;
+							return connection_slot_t( );
+						}
+						return connection_slot_t( shared_from_this( ) );
+					}
+
+					void
+					accept_guard_t::shed_backlog( asio::ip::tcp::acceptor &acceptor ) {
+						// Another thread may already be using it
+						auto const spare = m_spare_fd.exchange( -1 );
+						if( spare >= 0 ) {
+							::close( spare );
+						}
+						auto err = base::ErrorCode( );
+						acceptor.non_blocking( true, err );
+						if( !err ) {
+							auto const listen_fd = acceptor.native_handle( );
+							while( true ) {
+								auto const fd = accept_raw( listen_fd );
+								if( fd < 0 ) {
+									if( errno == EINTR or errno == ECONNABORTED ) {
+										continue;
+									}
+									break;
+								}
+								::close( fd );
+								++m_shed_no_descriptors;
+							}
+						}
+						auto const fd = open_spare_fd( );
+						if( fd < 0 ) {
+							// Tried again on the next shortage
+							return;
+						}
+						auto expected = -1;
+						if( !m_spare_fd.compare_exchange_strong( expected, fd ) ) {
+							::close( fd );
+						}
+					}
+
+					std::chrono::milliseconds accept_guard_t::next_backoff( ) {
+						auto const current = static_cast<int64_t>( m_backoff_ms );
+						auto const next =
+						  current == 0 ? min_backoff_ms
+						               : std::min( current * 2,
+						                           static_cast<int64_t>(
+						                             m_max_backoff.count( ) ) );
+						m_backoff_ms = next;
+						++m_backoffs;
+						return std::chrono::milliseconds( next );
+					}
+
+					void accept_guard_t::reset_backoff( ) noexcept {
+						if( m_backoff_ms != 0 ) {
+							m_backoff_ms = 0;
+						}
+					}
+
+					AcceptStats accept_guard_t::stats( ) const noexcept {
+						auto result = AcceptStats{};
+						result.active_connections = m_active;
+						result.shed_over_limit = m_shed_over_limit;
+						result.shed_no_descriptors = m_shed_no_descriptors;
+						result.accept_backoffs = m_backoffs;
+						return result;
+					}
+
+					bool is_resource_exhausted( base::ErrorCode const &err ) noexcept {
+						if( err.category( ) != asio::error::get_system_category( ) ) {
+							return false;
+						}
+						switch( err.value( ) ) {
+						case EMFILE:
+						case ENFILE:
+						case ENOBUFS:
+						case ENOMEM:
+							return true;
+						default:
+							return false;
+						}
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,661 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <asio/post.hpp>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <system_error>
+#include <utility>
+
+#if defined( __linux__ )
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#define NODEPP_HAS_MMSG
+#if !defined( UDP_SEGMENT )
+#define UDP_SEGMENT 103
+#endif
+#if !defined( UDP_GRO )
+#define UDP_GRO 104
+#endif
+#endif
+
+#include <daw/daw_exception.h>
+#include <daw/daw_scope_guard.h>
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "base_threading.h"
+#include "lib_net_datagram_socket.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					namespace {
+						/// Largest UDP payload over IPv4
+						constexpr size_t max_udp_payload = 65507U;
+						/// Linux refuses more segments in one send
+						constexpr size_t max_gso_segments = 64U;
+						/// Free buffers kept of each size
+						constexpr size_t max_pooled_buffers = 16U;
+
+						bool would_block( base::ErrorCode const &ec ) noexcept {
+							return ec == std::errc::operation_would_block or
+							       ec == std::errc::resource_unavailable_try_again;
+						}
+
+						base::ErrorCode last_error( ) noexcept {
+							return base::ErrorCode( errno, std::system_category( ) );
+						}
+
+						asio::ip::udp::endpoint to_endpoint( sockaddr_storage const &addr,
+						                                     socklen_t size ) {
+							auto result = asio::ip::udp::endpoint( );
+							auto const len = std::min( static_cast<size_t>( size ),
+							                           static_cast<size_t>( result.capacity( ) ) );
+							std::memcpy( result.data( ), &addr, len );
+							result.resize( len );
+							return result;
+						}
+					} // namespace
+
+					datagram_buffer_pool_t &datagram_buffer_pool_t::get( ) {
+						static datagram_buffer_pool_t result{};
+						return result;
+					}
+
+					std::unique_ptr<char[]> datagram_buffer_pool_t::acquire( size_t size ) {
+						{
+							auto const lck = std::lock_guard<std::mutex>( m_mutex );
+							auto &free = m_free[size];
+							if( !free.empty( ) ) {
+								auto result = daw::move( free.back( ) );
+								free.pop_back( );
+								return result;
+							}
+						}
+						return std::make_unique<char[]>( size );
+					}
+
+					void datagram_buffer_pool_t::release( size_t size,
+					                                      std::unique_ptr<char[]> buffer ) {
+						auto const lck = std::lock_guard<std::mutex>( m_mutex );
+						auto &free = m_free[size];
+						if( free.size( ) < max_pooled_buffers ) {
+							free.push_back( daw::move( buffer ) );
+						}
+					}
+
+					struct datagram_state_t {
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	A queued datagram, its bytes are in send_data
+						struct pending_send_t {
+							asio::ip::udp::endpoint endpoint{};
+							size_t offset = 0;
+							size_t size = 0;
+						};
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	One message of a receive batch
+						struct received_t {
+							asio::ip::udp::endpoint endpoint{};
+							size_t size = 0;
+							/// Size of the coalesced datagrams when GRO joined several
+							size_t segment_size = 0;
+							bool truncated = false;
+						};
+
+#if defined( NODEPP_HAS_MMSG )
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Headers for one recvmmsg or sendmmsg call.  Receiving
+						///				and sending each have their own, with several io
+						///				threads their handlers run at the same time
+						struct mmsg_scratch_t {
+							std::vector<mmsghdr> messages{};
+							std::vector<iovec> vectors{};
+							std::vector<sockaddr_storage> addresses{};
+							std::vector<char> control{};
+
+							void resize( size_t batch, size_t control_size ) {
+								messages.resize( batch );
+								vectors.resize( batch );
+								addresses.resize( batch );
+								control.resize( batch * control_size );
+							}
+						};
+#endif
+
+						asio::ip::udp::socket socket{base::ServiceHandle::get( )};
+						DatagramOptions options{};
+						std::atomic<bool> receiving{false};
+						std::atomic<bool> closed{false};
+
+						/// The send side is guarded by send_mutex
+						std::mutex send_mutex{};
+						std::vector<char> send_data{};
+						std::vector<pending_send_t> sends{};
+						size_t send_head = 0;
+						bool flush_scheduled = false;
+						bool waiting_writable = false;
+
+						/// The receive side is only used by the one read handler
+						/// outstanding at a time
+						std::vector<received_t> received{};
+#if defined( NODEPP_HAS_MMSG )
+						mmsg_scratch_t receive_scratch{};
+						mmsg_scratch_t send_scratch{};
+#endif
+
+						base::counter_t<uint64_t> received_count{0};
+						base::counter_t<uint64_t> truncated_count{0};
+						base::counter_t<uint64_t> receive_calls{0};
+						base::counter_t<uint64_t> sent_count{0};
+						base::counter_t<uint64_t> segmented_count{0};
+						base::counter_t<uint64_t> send_calls{0};
+						base::counter_t<uint64_t> send_errors{0};
+
+						size_t datagram_buffer_size( ) const noexcept {
+							return options.gro ? 65536U : options.max_datagram_size;
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Receive up to batch_size datagrams into buffer, one
+						///				datagram_buffer_size slot each
+						base::ErrorCode receive_batch( char *buffer ) {
+							auto const fd = socket.native_handle( );
+							auto const slot = datagram_buffer_size( );
+							auto const batch = options.batch_size;
+							received.clear( );
+							++receive_calls;
+#if defined( NODEPP_HAS_MMSG )
+							constexpr size_t control_size = CMSG_SPACE( sizeof( int ) );
+							auto &scratch = receive_scratch;
+							scratch.resize( batch, control_size );
+							auto &messages = scratch.messages;
+							auto &vectors = scratch.vectors;
+							auto &addresses = scratch.addresses;
+							auto &control = scratch.control;
+							for( size_t n = 0; n < batch; ++n ) {
+								vectors[n] = iovec{buffer + n * slot, slot};
+								auto &hdr = messages[n].msg_hdr;
+								hdr = msghdr{};
+								hdr.msg_name = &addresses[n];
+								hdr.msg_namelen = sizeof( sockaddr_storage );
+								hdr.msg_iov = &vectors[n];
+								hdr.msg_iovlen = 1;
+								if( options.gro ) {
+									hdr.msg_control = control.data( ) + n * control_size;
+									hdr.msg_controllen = control_size;
+								}
+								messages[n].msg_len = 0;
+							}
+							auto const count =
+							  ::recvmmsg( fd, messages.data( ), static_cast<unsigned>( batch ),
+							              MSG_DONTWAIT, nullptr );
+							if( count < 0 ) {
+								return last_error( );
+							}
+							for( size_t n = 0; n < static_cast<size_t>( count ); ++n ) {
+								auto const &hdr = messages[n].msg_hdr;
+								auto item = received_t{};
+								item.endpoint = to_endpoint( addresses[n], hdr.msg_namelen );
+								item.size = messages[n].msg_len;
+								item.truncated = ( hdr.msg_flags & MSG_TRUNC ) != 0;
+								if( options.gro ) {
+									for( auto *cmsg = CMSG_FIRSTHDR( &hdr ); cmsg != nullptr;
+									     cmsg = CMSG_NXTHDR( const_cast<msghdr *>( &hdr ), cmsg ) ) {
+										if( cmsg->cmsg_level == SOL_UDP and
+										    cmsg->cmsg_type == UDP_GRO ) {
+											auto segment = 0;
+											std::memcpy( &segment, CMSG_DATA( cmsg ), sizeof( segment ) );
+											item.segment_size = static_cast<size_t>( segment );
+										}
+									}
+								}
+								received.push_back( item );
+							}
+#else
+							for( size_t n = 0; n < batch; ++n ) {
+								auto addr = sockaddr_storage{};
+								auto addr_len = static_cast<socklen_t>( sizeof( addr ) );
+								auto const size =
+								  ::recvfrom( fd, buffer + n * slot, slot, MSG_DONTWAIT,
+								              reinterpret_cast<sockaddr *>( &addr ), &addr_len );
+								if( size < 0 ) {
+									if( received.empty( ) ) {
+										return last_error( );
+									}
+									break;
+								}
+								auto item = received_t{};
+								item.endpoint = to_endpoint( addr, addr_len );
+								item.size = static_cast<size_t>( size );
+								item.truncated = item.size == slot;
+								received.push_back( item );
+							}
+#endif
+							return base::ErrorCode( );
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Queued datagrams from send_head that can go out as one
+						///				segmented buffer, 1 when segmentation is off
+						size_t segment_run( size_t first ) const {
+							auto const segment = options.gso_segment_size;
+							if( segment == 0 or sends[first].size != segment ) {
+								return 1;
+							}
+							size_t result = 1;
+							size_t total = sends[first].size;
+							while( first + result < sends.size( ) and
+							       result < max_gso_segments ) {
+								auto const &next = sends[first + result];
+								if( next.endpoint != sends[first].endpoint or
+								    next.size > segment or
+								    total + next.size > max_udp_payload ) {
+									break;
+								}
+								total += next.size;
+								++result;
+								if( next.size < segment ) {
+									// A short datagram ends the run
+									break;
+								}
+							}
+							return result;
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Send what is queued from send_head in one call
+						/// @return	Queued datagrams that are done with, sent or dropped
+						///				because of ec
+						size_t send_batch( base::ErrorCode &ec ) {
+							auto const fd = socket.native_handle( );
+							ec = base::ErrorCode( );
+							++send_calls;
+#if defined( NODEPP_HAS_MMSG )
+							constexpr size_t control_size = CMSG_SPACE( sizeof( uint16_t ) );
+							auto const batch = options.batch_size;
+							auto &scratch = send_scratch;
+							scratch.resize( batch, control_size );
+							auto &messages = scratch.messages;
+							auto &vectors = scratch.vectors;
+							auto &addresses = scratch.addresses;
+							auto &control = scratch.control;
+							auto runs = std::vector<size_t>( );
+							runs.reserve( batch );
+							auto pos = send_head;
+							while( pos < sends.size( ) and runs.size( ) < batch ) {
+								auto const n = runs.size( );
+								auto const run = segment_run( pos );
+								auto const &first = sends[pos];
+								auto const &last = sends[pos + run - 1];
+								vectors[n] = iovec{send_data.data( ) + first.offset,
+								                   last.offset + last.size - first.offset};
+								auto &hdr = messages[n].msg_hdr;
+								hdr = msghdr{};
+								std::memcpy( &addresses[n], first.endpoint.data( ),
+								             first.endpoint.size( ) );
+								hdr.msg_name = &addresses[n];
+								hdr.msg_namelen = static_cast<socklen_t>( first.endpoint.size( ) );
+								hdr.msg_iov = &vectors[n];
+								hdr.msg_iovlen = 1;
+								if( run > 1 ) {
+									hdr.msg_control = control.data( ) + n * control_size;
+									hdr.msg_controllen = control_size;
+									auto *cmsg = CMSG_FIRSTHDR( &hdr );
+									cmsg->cmsg_level = SOL_UDP;
+									cmsg->cmsg_type = UDP_SEGMENT;
+									cmsg->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+									auto const segment = options.gso_segment_size;
+									std::memcpy( CMSG_DATA( cmsg ), &segment, sizeof( segment ) );
+								}
+								runs.push_back( run );
+								pos += run;
+							}
+							auto const count =
+							  ::sendmmsg( fd, messages.data( ),
+							              static_cast<unsigned>( runs.size( ) ), MSG_DONTWAIT );
+							if( count < 0 ) {
+								ec = last_error( );
+								if( would_block( ec ) ) {
+									return 0;
+								}
+								if( runs.front( ) > 1 and ( ec == std::errc::io_error or
+								                            ec == std::errc::invalid_argument ) ) {
+									// No segmentation offload on this path, send them singly
+									options.gso_segment_size = 0;
+									ec = base::ErrorCode( );
+									return 0;
+								}
+								send_errors += runs.front( );
+								return runs.front( );
+							}
+							size_t result = 0;
+							for( size_t n = 0; n < static_cast<size_t>( count ); ++n ) {
+								result += runs[n];
+								if( runs[n] > 1 ) {
+									segmented_count += runs[n];
+								}
+							}
+							sent_count += result;
+							return result;
+#else
+							auto const &item = sends[send_head];
+							auto const size = ::sendto(
+							  fd, send_data.data( ) + item.offset, item.size, MSG_DONTWAIT,
+							  reinterpret_cast<sockaddr const *>( item.endpoint.data( ) ),
+							  static_cast<socklen_t>( item.endpoint.size( ) ) );
+							if( size < 0 ) {
+								ec = last_error( );
+								if( would_block( ec ) ) {
+									return 0;
+								}
+								++send_errors;
+								return 1;
+							}
+							++sent_count;
+							return 1;
+#endif
+						}
+					};
+				} // namespace nss_impl
+
+				NetDatagramSocket::NetDatagramSocket( base::StandardEventEmitter &&emitter )
+				  : base::StandardEvents<NetDatagramSocket>( daw::move( emitter ) )
+				  , m_state( std::make_shared<nss_impl::datagram_state_t>( ) ) {}
+
+				NetDatagramSocket &
+				NetDatagramSocket::set_options( DatagramOptions options ) {
+					daw::exception::precondition_check(
+					  options.batch_size > 0 and options.max_datagram_size > 0 and
+					    options.max_receive_batches > 0,
+					  "Batch and datagram sizes must be greater than zero" );
+					daw::exception::precondition_check(
+					  !m_state->socket.is_open( ), "Options must be set before opening" );
+					m_state->options = options;
+					return *this;
+				}
+
+				void NetDatagramSocket::open( asio::ip::udp const &protocol ) {
+					auto &socket = m_state->socket;
+					socket.open( protocol );
+					socket.non_blocking( true );
+#if defined( NODEPP_HAS_MMSG )
+					if( m_state->options.gro ) {
+						int const value = 1;
+						if( ::setsockopt( socket.native_handle( ), SOL_UDP, UDP_GRO, &value,
+						                  sizeof( value ) ) != 0 ) {
+							// Older kernels, datagrams arrive one per slot instead
+							m_state->options.gro = false;
+						}
+					}
+#else
+					m_state->options.gro = false;
+					m_state->options.gso_segment_size = 0;
+#endif
+				}
+
+				NetDatagramSocket &NetDatagramSocket::bind( uint16_t port,
+				                                            ip_version ip_ver ) {
+					try {
+						auto const protocol = ip_ver == ip_version::ipv4
+						                        ? asio::ip::udp::v4( )
+						                        : asio::ip::udp::v6( );
+						open( protocol );
+						if( ip_ver != ip_version::ipv4 ) {
+							m_state->socket.set_option(
+							  asio::ip::v6_only( ip_ver == ip_version::ipv6 ) );
+						}
+						m_state->socket.bind( asio::ip::udp::endpoint( protocol, port ) );
+						start_receiving( );
+						emitter( ).emit( "listening", m_state->socket.local_endpoint( ) );
+					} catch( ... ) {
+						emit_error( std::current_exception( ), "Error binding socket",
+						            "NetDatagramSocket::bind" );
+					}
+					return *this;
+				}
+
+				NetDatagramSocket &
+				NetDatagramSocket::bind( asio::ip::udp::endpoint const &endpoint ) {
+					try {
+						open( endpoint.protocol( ) );
+						m_state->socket.bind( endpoint );
+						start_receiving( );
+						emitter( ).emit( "listening", m_state->socket.local_endpoint( ) );
+					} catch( ... ) {
+						emit_error( std::current_exception( ), "Error binding socket",
+						            "NetDatagramSocket::bind" );
+					}
+					return *this;
+				}
+
+				void NetDatagramSocket::start_receiving( ) {
+					if( m_state->receiving.exchange( true ) ) {
+						return;
+					}
+					wait_readable( );
+				}
+
+				void NetDatagramSocket::wait_readable( ) {
+					m_state->socket.async_wait(
+					  asio::ip::udp::socket::wait_read,
+					  [self = mutable_capture( *this )]( base::ErrorCode const &err ) {
+						  handle_readable( *self, err );
+					  } );
+				}
+
+				void NetDatagramSocket::handle_readable( NetDatagramSocket &self,
+				                                         base::ErrorCode const &err ) {
+					if( self.m_state->closed ) {
+						return;
+					}
+					if( err ) {
+						self.emit_error( err, "Error waiting for datagrams",
+						                 "NetDatagramSocket::handle_readable" );
+						return;
+					}
+					try {
+						self.receive_batches( );
+					} catch( ... ) {
+						self.emit_error( std::current_exception( ),
+						                 "Exception while receiving datagrams",
+						                 "NetDatagramSocket::handle_readable" );
+					}
+					if( !self.m_state->closed ) {
+						self.wait_readable( );
+					}
+				}
+
+				void NetDatagramSocket::receive_batches( ) {
+					auto &state = *m_state;
+					auto const slot = state.datagram_buffer_size( );
+					auto const buffer_size = slot * state.options.batch_size;
+					auto &pool = nss_impl::datagram_buffer_pool_t::get( );
+					auto buffer = pool.acquire( buffer_size );
+					auto const give_back = daw::on_scope_exit(
+					  [&]( ) { pool.release( buffer_size, daw::move( buffer ) ); } );
+
+					for( size_t round = 0; round < state.options.max_receive_batches and
+					                       !state.closed;
+					     ++round ) {
+						auto const ec = state.receive_batch( buffer.get( ) );
+						if( ec ) {
+							if( !nss_impl::would_block( ec ) ) {
+								emit_error( ec, "Error receiving datagrams",
+								            "NetDatagramSocket::receive_batches" );
+							}
+							return;
+						}
+						// Listeners may close the socket or send, the batch is copied
+						// out of the state first
+						auto const received = state.received;
+						for( size_t n = 0; n < received.size( ); ++n ) {
+							auto const &item = received[n];
+							auto const *data = buffer.get( ) + n * slot;
+							if( item.truncated ) {
+								++state.truncated_count;
+							}
+							auto const segment =
+							  item.segment_size == 0 ? item.size : item.segment_size;
+							for( size_t offset = 0; offset < item.size or offset == 0;
+							     offset += segment ) {
+								auto const size = std::min( segment, item.size - offset );
+								++state.received_count;
+								emitter( ).emit( "datagram",
+								                 Datagram{item.endpoint,
+								                          daw::string_view( data + offset, size )} );
+								if( segment == 0 ) {
+									break;
+								}
+							}
+						}
+						if( received.size( ) < state.options.batch_size ) {
+							return;
+						}
+					}
+				}
+
+				NetDatagramSocket &
+				NetDatagramSocket::send_to( asio::ip::udp::endpoint endpoint,
+				                            daw::string_view data ) {
+					try {
+						daw::exception::precondition_check(
+						  data.size( ) <= nss_impl::max_udp_payload, "Datagram too large" );
+						auto &state = *m_state;
+						if( !state.socket.is_open( ) ) {
+							open( endpoint.protocol( ) );
+							start_receiving( );
+						} else if( state.socket.local_endpoint( ).protocol( ) ==
+						             asio::ip::udp::v6( ) and
+						           endpoint.address( ).is_v4( ) ) {
+							endpoint = asio::ip::udp::endpoint(
+							  asio::ip::make_address_v6( asio::ip::v4_mapped,
+							                             endpoint.address( ).to_v4( ) ),
+							  endpoint.port( ) );
+						}
+						auto schedule = false;
+						{
+							auto const lck = std::lock_guard<std::mutex>( state.send_mutex );
+							auto const offset = state.send_data.size( );
+							state.send_data.insert( state.send_data.end( ), data.begin( ),
+							                        data.end( ) );
+							state.sends.push_back(
+							  nss_impl::datagram_state_t::pending_send_t{endpoint, offset,
+							                                             data.size( )} );
+							if( !state.flush_scheduled and !state.waiting_writable ) {
+								state.flush_scheduled = true;
+								schedule = true;
+							}
+						}
+						if( schedule ) {
+							asio::post( base::ServiceHandle::get( ),
+							            [self = mutable_capture( *this )]( ) {
+								            self->flush_sends( );
+							            } );
+						}
+					} catch( ... ) {
+						emit_error( std::current_exception( ), "Error sending datagram",
+						            "NetDatagramSocket::send_to" );
+					}
+					return *this;
+				}
+
+				void NetDatagramSocket::flush_sends( ) {
+					auto &state = *m_state;
+					auto errors = std::vector<base::ErrorCode>( );
+					{
+						auto const lck = std::lock_guard<std::mutex>( state.send_mutex );
+						state.flush_scheduled = false;
+						while( !state.closed and state.send_head < state.sends.size( ) ) {
+							auto ec = base::ErrorCode( );
+							auto const done = state.send_batch( ec );
+							state.send_head += done;
+							if( nss_impl::would_block( ec ) ) {
+								state.waiting_writable = true;
+								state.socket.async_wait(
+								  asio::ip::udp::socket::wait_write,
+								  [self = mutable_capture( *this )]( base::ErrorCode const &err ) {
+									  {
+										  auto const l = std::lock_guard<std::mutex>(
+										    self->m_state->send_mutex );
+										  self->m_state->waiting_writable = false;
+									  }
+									  if( !err ) {
+										  self->flush_sends( );
+									  }
+								  } );
+								break;
+							}
+							if( ec ) {
+								errors.push_back( ec );
+							}
+						}
+						if( state.send_head == state.sends.size( ) ) {
+							state.sends.clear( );
+							state.send_data.clear( );
+							state.send_head = 0;
+						}
+					}
+					for( auto const &ec : errors ) {
+						emit_error( ec, "Error sending datagram",
+						            "NetDatagramSocket::flush_sends" );
+					}
+				}
+
+				void NetDatagramSocket::close( ) {
+					if( m_state->closed.exchange( true ) ) {
+						return;
+					}
+					auto ec = base::ErrorCode( );
+					m_state->socket.close( ec );
+					emitter( ).emit( "closed" );
+				}
+
+				bool NetDatagramSocket::is_open( ) const {
+					return !m_state->closed and m_state->socket.is_open( );
+				}
+
+				asio::ip::udp::endpoint NetDatagramSocket::local_endpoint( ) const {
+					return m_state->socket.local_endpoint( );
+				}
+
+				DatagramSocketStats NetDatagramSocket::stats( ) const {
+					auto result = DatagramSocketStats{};
+					result.received = m_state->received_count;
+					result.truncated = m_state->truncated_count;
+					result.receive_calls = m_state->receive_calls;
+					result.sent = m_state->sent_count;
+					result.segmented = m_state->segmented_count;
+					result.send_calls = m_state->send_calls;
+					result.send_errors = m_state->send_errors;
+					return result;
+				}
+			} // namespace net
+		}   // namespace lib
+	}     // namespace nodepp
+} // namespace daw
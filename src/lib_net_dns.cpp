@@ -25,12 +25,14 @@
 #include <functional>
 #include <memory>
 
+#include <daw/daw_exception.h>
 #include <daw/daw_string_view.h>
 
 #include "base_error.h"
 #include "base_event_emitter.h"
 #include "base_service_handle.h"
 #include "lib_net_dns.h"
+#include "lib_net_dns_cache.h"
 
 namespace daw {
 	namespace nodepp {
@@ -42,7 +44,18 @@ namespace daw {
 				NetDns::NetDns( base::StandardEventEmitter &&emitter )
 				  : daw::nodepp::base::StandardEvents<NetDns>( daw::move( emitter ) )
 				  , m_resolver(
-				      std::make_shared<Resolver>( base::ServiceHandle::get( ) ) ) {}
+				      std::make_shared<Resolver>( base::ServiceHandle::get( ) ) )
+				  , m_cache( DnsCache::get_default( ) ) {}
+
+				NetDns::NetDns( std::shared_ptr<DnsCache> cache,
+				                base::StandardEventEmitter &&emitter )
+				  : daw::nodepp::base::StandardEvents<NetDns>( daw::move( emitter ) )
+				  , m_resolver(
+				      std::make_shared<Resolver>( base::ServiceHandle::get( ) ) )
+				  , m_cache( daw::move( cache ) ) {
+
+					daw::exception::precondition_check( m_cache, "Invalid DNS cache" );
+				}
 
 				void NetDns::resolve( Resolver::query &query ) {
 					try {
@@ -58,23 +71,17 @@ namespace daw {
 				}
 
 				void NetDns::resolve( daw::string_view address ) {
-					try {
-						auto query = tcp::resolver::query(
-						  address.to_string( ), "",
-						  asio::ip::resolver_query_base::numeric_host );
-						resolve( query );
-					} catch( ... ) {
-						emit_error( std::current_exception( ), "Error resolving DNS",
-						            "NetDns::resolve" );
-					}
+					resolve( address, 0 );
 				}
 
 				void NetDns::resolve( daw::string_view address, uint16_t port ) {
 					try {
-						auto query = tcp::resolver::query(
-						  address.to_string( ), std::to_string( port ),
-						  asio::ip::resolver_query_base::numeric_host );
-						resolve( query );
+						m_cache->async_resolve(
+						  address.to_string( ), port,
+						  [self = mutable_capture( *this )](
+						    base::ErrorCode const &err, DnsCache::results_t results ) {
+							  handle_resolve( *self, err, results.begin( ) );
+						  } );
 					} catch( ... ) {
 						emit_error( std::current_exception( ), "Error resolving DNS",
 						            "NetDns::resolve" );
@@ -0,0 +1,255 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <asio/error.hpp>
+#include <asio/post.hpp>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#include <daw/daw_exception.h>
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "lib_net_dns_cache.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace {
+					std::mutex &default_cache_mutex( ) {
+						static std::mutex result{};
+						return result;
+					}
+
+					std::shared_ptr<DnsCache> &default_cache( ) {
+						static std::shared_ptr<DnsCache> result =
+						  std::make_shared<DnsCache>( );
+						return result;
+					}
+
+					std::string make_key( std::string const &host, uint16_t port ) {
+						return host + ':' + std::to_string( port );
+					}
+
+					/// Lines of "address name [aliases...]", # starts a comment
+					std::unordered_map<std::string, std::vector<asio::ip::address>>
+					read_hosts_file( std::string const &file_name ) {
+						auto result =
+						  std::unordered_map<std::string, std::vector<asio::ip::address>>( );
+						if( file_name.empty( ) ) {
+							return result;
+						}
+						auto file = std::ifstream( file_name );
+						daw::exception::daw_throw_on_false( file,
+						                                    "Could not open hosts file" );
+						auto line = std::string( );
+						while( std::getline( file, line ) ) {
+							line = line.substr( 0, line.find( '#' ) );
+							auto words = std::istringstream( line );
+							auto address_str = std::string( );
+							if( !( words >> address_str ) ) {
+								continue;
+							}
+							auto err = base::ErrorCode( );
+							auto const address = asio::ip::make_address( address_str, err );
+							if( err ) {
+								continue;
+							}
+							auto name = std::string( );
+							while( words >> name ) {
+								result[name].push_back( address );
+							}
+						}
+						return result;
+					}
+
+					void post_result( DnsCache::handler_t handler, base::ErrorCode err,
+					                  DnsCache::results_t results ) {
+						asio::post( base::ServiceHandle::get( ),
+						            [handler = daw::move( handler ), err,
+						             results = daw::move( results )]( ) {
+							            handler( err, results );
+						            } );
+					}
+				} // namespace
+
+				DnsCache::DnsCache( DnsCacheOptions options )
+				  : m_options( daw::move( options ) )
+				  , m_hosts( read_hosts_file( m_options.hosts_file ) ) {}
+
+				std::shared_ptr<DnsCache> DnsCache::get_default( ) {
+					auto const lck = std::lock_guard<std::mutex>( default_cache_mutex( ) );
+					return default_cache( );
+				}
+
+				void DnsCache::set_default( std::shared_ptr<DnsCache> cache ) {
+					daw::exception::precondition_check( cache, "Invalid DNS cache" );
+					auto const lck = std::lock_guard<std::mutex>( default_cache_mutex( ) );
+					default_cache( ) = daw::move( cache );
+				}
+
+				void DnsCache::async_resolve( std::string const &host, uint16_t port,
+				                              handler_t handler ) {
+					auto const service = std::to_string( port );
+					auto const host_pos = m_hosts.find( host );
+					if( host_pos != m_hosts.end( ) ) {
+						auto endpoints = std::vector<asio::ip::tcp::endpoint>( );
+						for( auto const &address : host_pos->second ) {
+							endpoints.emplace_back( address, port );
+						}
+						++m_hits;
+						post_result( daw::move( handler ), base::ErrorCode( ),
+						             results_t::create( endpoints.begin( ), endpoints.end( ),
+						                                host, service ) );
+						return;
+					}
+					auto key = make_key( host, port );
+					{
+						auto const lck = std::lock_guard<std::mutex>( m_mutex );
+						auto const pos = m_entries.find( key );
+						if( pos != m_entries.end( ) ) {
+							if( pos->second.expires > clock_t::now( ) ) {
+								if( pos->second.error ) {
+									++m_negative_hits;
+								} else {
+									++m_hits;
+								}
+								post_result( daw::move( handler ), pos->second.error,
+								             pos->second.results );
+								return;
+							}
+							m_entries.erase( pos );
+						}
+						auto &waiting = m_pending[key];
+						waiting.push_back( daw::move( handler ) );
+						if( waiting.size( ) > 1 ) {
+							++m_coalesced;
+							return;
+						}
+					}
+					++m_lookups;
+					try {
+						auto resolver =
+						  std::make_shared<asio::ip::tcp::resolver>( base::ServiceHandle::get( ) );
+						resolver->async_resolve(
+						  host, service,
+						  [self = shared_from_this( ), resolver,
+						   key]( base::ErrorCode const &err, results_t results ) {
+							  self->finish_lookup( key, err, daw::move( results ) );
+						  } );
+					} catch( std::system_error const &ex ) {
+						// The lookup never started, so there is no answer to cache.
+						// handler is among those waiting and hears of it there
+						fail_waiting( key, ex.code( ) );
+					} catch( ... ) {
+						fail_waiting( key, asio::error::no_recovery );
+					}
+				}
+
+				std::vector<DnsCache::handler_t>
+				DnsCache::take_waiting( std::string const &key ) {
+					auto result = std::vector<handler_t>( );
+					auto pos = m_pending.find( key );
+					if( pos != m_pending.end( ) ) {
+						result = daw::move( pos->second );
+						m_pending.erase( pos );
+					}
+					return result;
+				}
+
+				void DnsCache::finish_lookup( std::string const &key,
+				                              base::ErrorCode err, results_t results ) {
+					auto waiting = std::vector<handler_t>( );
+					{
+						auto const lck = std::lock_guard<std::mutex>( m_mutex );
+						waiting = take_waiting( key );
+						if( err != asio::error::operation_aborted ) {
+							auto entry = entry_t{};
+							entry.results = results;
+							entry.error = err;
+							entry.expires =
+							  clock_t::now( ) + ( err ? m_options.negative_ttl : m_options.ttl );
+							store( key, daw::move( entry ) );
+						}
+					}
+					for( auto &handler : waiting ) {
+						post_result( daw::move( handler ), err, results );
+					}
+				}
+
+				void DnsCache::fail_waiting( std::string const &key,
+				                             base::ErrorCode err ) {
+					auto waiting = std::vector<handler_t>( );
+					{
+						auto const lck = std::lock_guard<std::mutex>( m_mutex );
+						waiting = take_waiting( key );
+					}
+					for( auto &handler : waiting ) {
+						post_result( daw::move( handler ), err, results_t( ) );
+					}
+				}
+
+				void DnsCache::store( std::string const &key, entry_t entry ) {
+					if( m_options.max_entries == 0 ) {
+						return;
+					}
+					if( m_entries.size( ) >= m_options.max_entries and
+					    m_entries.count( key ) == 0 ) {
+						auto const now = clock_t::now( );
+						for( auto it = m_entries.begin( ); it != m_entries.end( ); ) {
+							if( it->second.expires <= now ) {
+								it = m_entries.erase( it );
+							} else {
+								++it;
+							}
+						}
+						if( m_entries.size( ) >= m_options.max_entries ) {
+							m_entries.erase( m_entries.begin( ) );
+						}
+					}
+					m_entries[key] = daw::move( entry );
+				}
+
+				void DnsCache::clear( ) {
+					auto const lck = std::lock_guard<std::mutex>( m_mutex );
+					m_entries.clear( );
+				}
+
+				DnsCacheStats DnsCache::stats( ) const {
+					auto result = DnsCacheStats{};
+					result.hits = m_hits;
+					result.negative_hits = m_negative_hits;
+					result.lookups = m_lookups;
+					result.coalesced = m_coalesced;
+					{
+						auto const lck = std::lock_guard<std::mutex>( m_mutex );
+						result.size = m_entries.size( );
+					}
+					return result;
+				}
+			} // namespace net
+		}   // namespace lib
+	}     // namespace nodepp
+} // namespace daw
@@ -0,0 +1,433 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/ssl.h>
+#include <string>
+#include <vector>
+
+#if defined( __linux__ ) and __has_include( <linux/tls.h> )
+#define NODEPP_HAS_KTLS
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include <daw/daw_string_view.h>
+
+#include "lib_net_ktls.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					namespace {
+						int state_index( ) noexcept {
+							static int const index =
+							  SSL_get_ex_new_index( 0, nullptr, nullptr, nullptr, nullptr );
+							return index;
+						}
+
+						ktls_state_t *get_state( SSL const *ssl ) noexcept {
+							return static_cast<ktls_state_t *>(
+							  SSL_get_ex_data( ssl, state_index( ) ) );
+						}
+
+						int from_hex( char c ) noexcept {
+							if( c >= '0' and c <= '9' ) {
+								return c - '0';
+							}
+							if( c >= 'a' and c <= 'f' ) {
+								return c - 'a' + 10;
+							}
+							if( c >= 'A' and c <= 'F' ) {
+								return c - 'A' + 10;
+							}
+							return -1;
+						}
+
+						// TLS 1.3 logs "SERVER_TRAFFIC_SECRET_0 <client random> <secret>"
+						// when the server starts writing with the application keys
+						void keylog_callback( SSL const *ssl, char const *line ) {
+							auto *state = get_state( ssl );
+							if( state == nullptr ) {
+								return;
+							}
+							auto sv = daw::string_view( line );
+							constexpr daw::string_view label = "SERVER_TRAFFIC_SECRET_0 ";
+							if( sv.substr( 0, label.size( ) ) != label ) {
+								return;
+							}
+							auto const pos = sv.find( ' ', label.size( ) );
+							if( pos == daw::string_view::npos ) {
+								return;
+							}
+							sv.remove_prefix( pos + 1 );
+							auto const size =
+							  std::min( sv.size( ) / 2, state->traffic_secret.size( ) );
+							for( size_t n = 0; n < size; ++n ) {
+								auto const hi = from_hex( sv[2 * n] );
+								auto const lo = from_hex( sv[2 * n + 1] );
+								if( hi < 0 or lo < 0 ) {
+									state->traffic_secret_size = 0;
+									return;
+								}
+								state->traffic_secret[n] =
+								  static_cast<unsigned char>( ( hi << 4 ) | lo );
+							}
+							state->traffic_secret_size = size;
+							state->write_seq = 0;
+							state->counting = true;
+						}
+
+						// Count the records OpenSSL writes with the current keys, the
+						// kernel has to continue the sequence
+						void msg_callback( int write_p, int, int content_type, void const *,
+						                   size_t, SSL *ssl, void * ) {
+							if( write_p == 0 ) {
+								return;
+							}
+							auto *state = get_state( ssl );
+							if( state == nullptr ) {
+								return;
+							}
+#ifdef NODEPP_HAS_KTLS
+							if( state->offloaded ) {
+								// The record is still in OpenSSL's buffer.  Once written it
+								// would be framed again by the kernel and the peer would
+								// read garbage, so end the connection before that happens
+								state->offloaded = false;
+								::shutdown( state->socket_fd, SHUT_RDWR );
+								return;
+							}
+#endif
+							if( content_type == SSL3_RT_CHANGE_CIPHER_SPEC and
+							    SSL_version( ssl ) != TLS1_3_VERSION ) {
+								state->write_seq = 0;
+								state->counting = true;
+							} else if( content_type == SSL3_RT_HEADER and state->counting ) {
+								++state->write_seq;
+							}
+						}
+
+						bool hkdf_expand_label( EVP_MD const *md,
+						                        ktls_state_t const &state,
+						                        std::string const &label,
+						                        unsigned char *out, size_t size ) {
+							auto const full = "tls13 " + label;
+							std::vector<unsigned char> info{};
+							info.push_back( static_cast<unsigned char>( size >> 8U ) );
+							info.push_back( static_cast<unsigned char>( size ) );
+							info.push_back( static_cast<unsigned char>( full.size( ) ) );
+							info.insert( info.end( ), full.begin( ), full.end( ) );
+							info.push_back( 0 );
+
+							auto *ctx = EVP_PKEY_CTX_new_id( EVP_PKEY_HKDF, nullptr );
+							if( ctx == nullptr ) {
+								return false;
+							}
+							auto const result =
+							  EVP_PKEY_derive_init( ctx ) > 0 and
+							  EVP_PKEY_CTX_hkdf_mode( ctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY ) >
+							    0 and
+							  EVP_PKEY_CTX_set_hkdf_md( ctx, md ) > 0 and
+							  EVP_PKEY_CTX_set1_hkdf_key(
+							    ctx, state.traffic_secret.data( ),
+							    static_cast<int>( state.traffic_secret_size ) ) > 0 and
+							  EVP_PKEY_CTX_add1_hkdf_info(
+							    ctx, info.data( ), static_cast<int>( info.size( ) ) ) > 0 and
+							  EVP_PKEY_derive( ctx, out, &size ) > 0;
+							EVP_PKEY_CTX_free( ctx );
+							return result;
+						}
+
+						bool tls12_key_block( SSL *ssl, EVP_MD const *md,
+						                      std::vector<unsigned char> &block ) {
+							std::array<unsigned char, SSL_MAX_MASTER_KEY_LENGTH> master{};
+							auto const master_size = SSL_SESSION_get_master_key(
+							  SSL_get_session( ssl ), master.data( ), master.size( ) );
+
+							std::array<unsigned char, SSL3_RANDOM_SIZE> client_random{};
+							std::array<unsigned char, SSL3_RANDOM_SIZE> server_random{};
+							SSL_get_client_random( ssl, client_random.data( ),
+							                       client_random.size( ) );
+							SSL_get_server_random( ssl, server_random.data( ),
+							                       server_random.size( ) );
+
+							static constexpr char const label[] = "key expansion";
+							auto *ctx = EVP_PKEY_CTX_new_id( EVP_PKEY_TLS1_PRF, nullptr );
+							if( ctx == nullptr ) {
+								return false;
+							}
+							auto size = block.size( );
+							auto const result =
+							  EVP_PKEY_derive_init( ctx ) > 0 and
+							  EVP_PKEY_CTX_set_tls1_prf_md( ctx, md ) > 0 and
+							  EVP_PKEY_CTX_set1_tls1_prf_secret(
+							    ctx, master.data( ), static_cast<int>( master_size ) ) > 0 and
+							  EVP_PKEY_CTX_add1_tls1_prf_seed(
+							    ctx, reinterpret_cast<unsigned char const *>( label ),
+							    static_cast<int>( sizeof( label ) - 1 ) ) > 0 and
+							  EVP_PKEY_CTX_add1_tls1_prf_seed(
+							    ctx, server_random.data( ),
+							    static_cast<int>( server_random.size( ) ) ) > 0 and
+							  EVP_PKEY_CTX_add1_tls1_prf_seed(
+							    ctx, client_random.data( ),
+							    static_cast<int>( client_random.size( ) ) ) > 0 and
+							  EVP_PKEY_derive( ctx, block.data( ), &size ) > 0;
+							EVP_PKEY_CTX_free( ctx );
+							OPENSSL_cleanse( master.data( ), master.size( ) );
+							return result;
+						}
+
+#ifdef NODEPP_HAS_KTLS
+						void store_seq( unsigned char *out, uint64_t seq ) noexcept {
+							for( size_t n = 0; n < 8; ++n ) {
+								out[7 - n] = static_cast<unsigned char>( seq >> ( 8U * n ) );
+							}
+						}
+
+						union crypto_info_t {
+							tls_crypto_info info;
+							tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+							tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+							tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+						};
+
+						// Fill the kernel's description of the write keys.  iv is the
+						// fixed part from the key schedule, 4 bytes for GCM in TLS 1.2
+						// and 12 otherwise
+						template<typename CryptoInfo>
+						size_t fill_crypto_info( CryptoInfo &ci, uint16_t version,
+						                         uint16_t cipher_type,
+						                         unsigned char const *key,
+						                         unsigned char const *iv,
+						                         uint64_t seq ) noexcept {
+							ci.info.version = version;
+							ci.info.cipher_type = cipher_type;
+							std::memcpy( ci.key, key, sizeof( ci.key ) );
+							store_seq( ci.rec_seq, seq );
+							if constexpr( sizeof( ci.salt ) > 0 ) {
+								std::memcpy( ci.salt, iv, sizeof( ci.salt ) );
+								if( version == TLS_1_2_VERSION ) {
+									// Explicit nonce, any unique value will do
+									store_seq( ci.iv, seq );
+								} else {
+									std::memcpy( ci.iv, iv + sizeof( ci.salt ), sizeof( ci.iv ) );
+								}
+							} else {
+								std::memcpy( ci.iv, iv, sizeof( ci.iv ) );
+							}
+							return sizeof( ci );
+						}
+#endif
+					} // namespace
+
+					void ktls_enable( asio::ssl::context &ctx ) {
+						SSL_CTX_set_keylog_callback( ctx.native_handle( ),
+						                             &keylog_callback );
+						// OpenSSL cannot write the renegotiation records once the
+						// kernel owns the write sequence
+						SSL_CTX_set_options( ctx.native_handle( ),
+						                     SSL_OP_NO_RENEGOTIATION );
+					}
+
+					bool ktls_prepare( SSL *ssl, ktls_state_t &state ) noexcept {
+						auto const *ctx = SSL_get_SSL_CTX( ssl );
+						if( SSL_CTX_get_keylog_callback( ctx ) != &keylog_callback ) {
+							return false;
+						}
+						state = ktls_state_t{};
+						SSL_set_ex_data( ssl, state_index( ), &state );
+						SSL_set_msg_callback( ssl, &msg_callback );
+						return true;
+					}
+
+					void ktls_release( SSL *ssl ) noexcept {
+						SSL_set_msg_callback( ssl, nullptr );
+						SSL_set_ex_data( ssl, state_index( ), nullptr );
+					}
+
+					bool ktls_write_keys( SSL *ssl, ktls_state_t const &state,
+					                      ktls_keys_t &keys ) noexcept {
+						if( !state.counting ) {
+							return false;
+						}
+						auto const version = SSL_version( ssl );
+						if( version != TLS1_2_VERSION and version != TLS1_3_VERSION ) {
+							return false;
+						}
+						auto const *cipher = SSL_get_current_cipher( ssl );
+						if( cipher == nullptr ) {
+							return false;
+						}
+						auto const *md = SSL_CIPHER_get_handshake_digest( cipher );
+						auto const cipher_nid = SSL_CIPHER_get_cipher_nid( cipher );
+						size_t key_size = 0;
+						switch( cipher_nid ) {
+						case NID_aes_128_gcm:
+							key_size = 16;
+							break;
+						case NID_aes_256_gcm:
+						case NID_chacha20_poly1305:
+							key_size = 32;
+							break;
+						default:
+							return false;
+						}
+						// GCM in TLS 1.2 has a 4 byte implicit nonce
+						size_t const iv_size =
+						  version == TLS1_2_VERSION and cipher_nid != NID_chacha20_poly1305
+						    ? 4U
+						    : 12U;
+
+						keys = ktls_keys_t{};
+						if( version == TLS1_3_VERSION ) {
+							if( state.traffic_secret_size == 0 or
+							    !hkdf_expand_label( md, state, "key", keys.key.data( ),
+							                        key_size ) or
+							    !hkdf_expand_label( md, state, "iv", keys.iv.data( ),
+							                        iv_size ) ) {
+								keys.clear( );
+								return false;
+							}
+						} else {
+							// client key, server key, client iv, server iv
+							auto block =
+							  std::vector<unsigned char>( 2 * key_size + 2 * iv_size );
+							if( !tls12_key_block( ssl, md, block ) ) {
+								return false;
+							}
+							std::copy_n( block.data( ) + key_size, key_size,
+							             keys.key.data( ) );
+							std::copy_n( block.data( ) + 2 * key_size + iv_size, iv_size,
+							             keys.iv.data( ) );
+							OPENSSL_cleanse( block.data( ), block.size( ) );
+						}
+						keys.version = version;
+						keys.cipher_nid = cipher_nid;
+						keys.key_size = key_size;
+						keys.iv_size = iv_size;
+						keys.seq = state.write_seq;
+						return true;
+					}
+
+					void ktls_keys_t::clear( ) noexcept {
+						OPENSSL_cleanse( key.data( ), key.size( ) );
+						OPENSSL_cleanse( iv.data( ), iv.size( ) );
+					}
+
+					bool ktls_start_send( SSL *ssl, int socket_fd,
+					                      ktls_state_t &state ) noexcept {
+#ifdef NODEPP_HAS_KTLS
+						// A renegotiation would need new keys in the kernel part way
+						// through the stream
+						if( ( SSL_get_options( ssl ) & SSL_OP_NO_RENEGOTIATION ) == 0 ) {
+							return false;
+						}
+						auto keys = ktls_keys_t{};
+						if( !ktls_write_keys( ssl, state, keys ) ) {
+							return false;
+						}
+						auto const kernel_version = static_cast<uint16_t>(
+						  keys.version == TLS1_3_VERSION ? TLS_1_3_VERSION
+						                                 : TLS_1_2_VERSION );
+						crypto_info_t crypto_info{};
+						size_t crypto_info_size = 0;
+						switch( keys.cipher_nid ) {
+						case NID_aes_128_gcm:
+							crypto_info_size = fill_crypto_info(
+							  crypto_info.aes_gcm_128, kernel_version, TLS_CIPHER_AES_GCM_128,
+							  keys.key.data( ), keys.iv.data( ), keys.seq );
+							break;
+						case NID_aes_256_gcm:
+							crypto_info_size = fill_crypto_info(
+							  crypto_info.aes_gcm_256, kernel_version, TLS_CIPHER_AES_GCM_256,
+							  keys.key.data( ), keys.iv.data( ), keys.seq );
+							break;
+						default:
+							crypto_info_size = fill_crypto_info(
+							  crypto_info.chacha20_poly1305, kernel_version,
+							  TLS_CIPHER_CHACHA20_POLY1305, keys.key.data( ),
+							  keys.iv.data( ), keys.seq );
+							break;
+						}
+						keys.clear( );
+
+						static constexpr char const ulp[] = "tls";
+						auto result =
+						  ::setsockopt( socket_fd, SOL_TCP, TCP_ULP, ulp, sizeof( ulp ) ) ==
+						    0 and
+						  ::setsockopt( socket_fd, SOL_TLS, TLS_TX, &crypto_info,
+						                static_cast<socklen_t>( crypto_info_size ) ) == 0;
+						OPENSSL_cleanse( &crypto_info, sizeof( crypto_info ) );
+						if( result ) {
+							state.socket_fd = socket_fd;
+							state.offloaded = true;
+						}
+						return result;
+#else
+						static_cast<void>( ssl );
+						static_cast<void>( socket_fd );
+						static_cast<void>( state );
+						return false;
+#endif
+					}
+
+					void ktls_send_close_notify( int socket_fd ) noexcept {
+#ifdef NODEPP_HAS_KTLS
+						// Alert level warning, description close_notify
+						unsigned char alert[2] = {1, 0};
+						alignas( cmsghdr ) char control[CMSG_SPACE( 1 )] = {};
+
+						iovec iov{};
+						iov.iov_base = alert;
+						iov.iov_len = sizeof( alert );
+
+						msghdr msg{};
+						msg.msg_iov = &iov;
+						msg.msg_iovlen = 1;
+						msg.msg_control = control;
+						msg.msg_controllen = sizeof( control );
+
+						auto *cmsg = CMSG_FIRSTHDR( &msg );
+						cmsg->cmsg_level = SOL_TLS;
+						cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+						cmsg->cmsg_len = CMSG_LEN( 1 );
+						*CMSG_DATA( cmsg ) = SSL3_RT_ALERT;
+						msg.msg_controllen = cmsg->cmsg_len;
+
+						::sendmsg( socket_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT );
+#else
+						static_cast<void>( socket_fd );
+#endif
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
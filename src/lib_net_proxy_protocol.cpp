@@ -0,0 +1,395 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <array>
+#include <asio/bind_executor.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/error.hpp>
+#include <asio/io_context_strand.hpp>
+#include <asio/steady_timer.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <daw/daw_string_view.h>
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "lib_net_proxy_protocol.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					namespace {
+						constexpr daw::string_view v1_prefix = "PROXY ";
+						/// Longest version 1 header, including the CRLF
+						constexpr size_t v1_max_size = 107U;
+						constexpr std::array<unsigned char, 12> v2_signature = {
+						  0x0D, 0x0A, 0x0D, 0x0A, 0x00, 0x0D,
+						  0x0A, 0x51, 0x55, 0x49, 0x54, 0x0A};
+						constexpr size_t v2_fixed_size = 16U;
+
+						proxy_parse_result_t invalid( ) {
+							return proxy_parse_result_t{};
+						}
+
+						proxy_parse_result_t incomplete( size_t needed ) {
+							auto result = proxy_parse_result_t{};
+							result.status = proxy_parse_status::incomplete;
+							result.needed = needed;
+							return result;
+						}
+
+						proxy_parse_result_t complete( ProxyHeader header ) {
+							auto result = proxy_parse_result_t{};
+							result.status = proxy_parse_status::complete;
+							result.header = daw::move( header );
+							return result;
+						}
+
+						uint16_t read_port( unsigned char const *ptr ) noexcept {
+							return static_cast<uint16_t>( ( ptr[0] << 8U ) | ptr[1] );
+						}
+
+						std::optional<uint16_t> parse_port( daw::string_view str ) {
+							if( str.empty( ) or str.size( ) > 5 ) {
+								return std::nullopt;
+							}
+							uint32_t result = 0;
+							for( auto c : str ) {
+								if( c < '0' or c > '9' ) {
+									return std::nullopt;
+								}
+								result = result * 10U + static_cast<uint32_t>( c - '0' );
+							}
+							if( result > 0xFFFFU ) {
+								return std::nullopt;
+							}
+							return static_cast<uint16_t>( result );
+						}
+
+						std::optional<asio::ip::address> parse_address( daw::string_view str,
+						                                                bool is_v6 ) {
+							auto ec = base::ErrorCode( );
+							auto result = asio::ip::make_address( str.to_string( ), ec );
+							if( ec or result.is_v6( ) != is_v6 ) {
+								return std::nullopt;
+							}
+							return result;
+						}
+
+						// PROXY TCP4 192.0.2.1 198.51.100.1 56324 443\r\n
+						proxy_parse_result_t parse_v1( char const *first, char const *last ) {
+							auto const size = static_cast<size_t>( last - first );
+							auto const searched = std::min( size, v1_max_size );
+							auto const line_end =
+							  daw::string_view( first, searched ).find( "\r\n" );
+							if( line_end == daw::string_view::npos ) {
+								if( size >= v1_max_size ) {
+									return invalid( );
+								}
+								return incomplete( size + 1U );
+							}
+							auto line = daw::string_view( first, line_end );
+							line.remove_prefix( v1_prefix.size( ) );
+							auto fields = std::vector<daw::string_view>( );
+							while( !line.empty( ) ) {
+								auto const pos = line.find( ' ' );
+								fields.push_back( line.substr( 0, pos ) );
+								if( pos == daw::string_view::npos ) {
+									break;
+								}
+								line.remove_prefix( pos + 1U );
+							}
+							auto header = ProxyHeader{};
+							header.size = line_end + 2U;
+							if( !fields.empty( ) and fields[0] == "UNKNOWN" ) {
+								// The balancer could not tell, the rest of the line is ignored
+								return complete( daw::move( header ) );
+							}
+							if( fields.size( ) != 5 or
+							    ( fields[0] != "TCP4" and fields[0] != "TCP6" ) ) {
+								return invalid( );
+							}
+							auto const is_v6 = fields[0] == "TCP6";
+							auto const source = parse_address( fields[1], is_v6 );
+							auto const destination = parse_address( fields[2], is_v6 );
+							auto const source_port = parse_port( fields[3] );
+							auto const destination_port = parse_port( fields[4] );
+							if( !source or !destination or !source_port or
+							    !destination_port ) {
+								return invalid( );
+							}
+							header.source = asio::ip::tcp::endpoint( *source, *source_port );
+							header.destination =
+							  asio::ip::tcp::endpoint( *destination, *destination_port );
+							return complete( daw::move( header ) );
+						}
+
+						proxy_parse_result_t parse_v2( unsigned char const *first,
+						                               size_t size ) {
+							if( size < v2_fixed_size ) {
+								return incomplete( v2_fixed_size );
+							}
+							auto const version = first[12] >> 4U;
+							auto const command = first[12] & 0x0FU;
+							if( version != 2U or command > 1U ) {
+								return invalid( );
+							}
+							auto const family = first[13] >> 4U;
+							auto const length = static_cast<size_t>( read_port( first + 14 ) );
+							auto header = ProxyHeader{};
+							header.size = v2_fixed_size + length;
+							if( size < header.size ) {
+								return incomplete( header.size );
+							}
+							if( command == 0U ) {
+								// LOCAL, the balancer's own connection such as a health check
+								return complete( daw::move( header ) );
+							}
+							auto const *addr = first + v2_fixed_size;
+							switch( family ) {
+							case 0x1U: { // AF_INET
+								if( length < 12U ) {
+									return invalid( );
+								}
+								auto src = asio::ip::address_v4::bytes_type( );
+								auto dst = asio::ip::address_v4::bytes_type( );
+								std::memcpy( src.data( ), addr, 4 );
+								std::memcpy( dst.data( ), addr + 4, 4 );
+								header.source = asio::ip::tcp::endpoint(
+								  asio::ip::address_v4( src ), read_port( addr + 8 ) );
+								header.destination = asio::ip::tcp::endpoint(
+								  asio::ip::address_v4( dst ), read_port( addr + 10 ) );
+								break;
+							}
+							case 0x2U: { // AF_INET6
+								if( length < 36U ) {
+									return invalid( );
+								}
+								auto src = asio::ip::address_v6::bytes_type( );
+								auto dst = asio::ip::address_v6::bytes_type( );
+								std::memcpy( src.data( ), addr, 16 );
+								std::memcpy( dst.data( ), addr + 16, 16 );
+								header.source = asio::ip::tcp::endpoint(
+								  asio::ip::address_v6( src ), read_port( addr + 32 ) );
+								header.destination = asio::ip::tcp::endpoint(
+								  asio::ip::address_v6( dst ), read_port( addr + 34 ) );
+								break;
+							}
+							case 0x0U: // AF_UNSPEC
+							case 0x3U: // AF_UNIX, nothing an EndPoint can hold
+								break;
+							default:
+								return invalid( );
+							}
+							// Any TLVs after the addresses are skipped
+							return complete( daw::move( header ) );
+						}
+
+						//////////////////////////////////////////////////////////////////////////
+						/// @brief	Peeks at a socket until a whole header has arrived.  An
+						///				incomplete header is taken off the socket so that
+						///				waiting for more does not wake straight away.  The
+						///				reads and the deadline run on a strand so only one of
+						///				them finishes
+						class proxy_reader_t
+						  : public std::enable_shared_from_this<proxy_reader_t> {
+							asio::io_context::strand m_strand;
+							asio::ip::tcp::socket &m_socket;
+							asio::steady_timer m_timer;
+							std::function<void( base::ErrorCode, ProxyHeader )> m_handler;
+							std::vector<char> m_buffer{};
+							size_t m_taken = 0;
+							size_t m_needed = v1_max_size;
+
+							void finish( base::ErrorCode ec, ProxyHeader header ) {
+								if( !m_handler ) {
+									return;
+								}
+								m_timer.cancel( );
+								auto handler = daw::move( m_handler );
+								handler( ec, daw::move( header ) );
+							}
+
+							void wait( ) {
+								m_socket.async_wait(
+								  asio::ip::tcp::socket::wait_read,
+								  asio::bind_executor(
+								    m_strand,
+								    [self = shared_from_this( )]( base::ErrorCode const &ec ) {
+									    if( !self->m_handler ) {
+										    // The deadline passed first
+										    return;
+									    }
+									    if( ec ) {
+										    self->finish( ec, ProxyHeader{} );
+										    return;
+									    }
+									    self->read( );
+								    } ) );
+							}
+
+							/// A client that never finishes its header would otherwise hold
+							/// the socket, and a connection slot, forever
+							void start_timer( std::chrono::milliseconds timeout ) {
+								m_timer.expires_after( timeout );
+								m_timer.async_wait( asio::bind_executor(
+								  m_strand,
+								  [self = shared_from_this( )]( base::ErrorCode const &err ) {
+									  if( err or !self->m_handler ) {
+										  return;
+									  }
+									  auto ec = base::ErrorCode( );
+									  self->m_socket.close( ec );
+									  self->finish( asio::error::timed_out, ProxyHeader{} );
+								  } ) );
+							}
+
+							/// Take count peeked bytes off the socket
+							bool take( size_t count ) {
+								auto const result = ::recv( m_socket.native_handle( ),
+								                            m_buffer.data( ) + m_taken, count,
+								                            MSG_DONTWAIT );
+								if( result < 0 ) {
+									finish( base::ErrorCode( errno, std::system_category( ) ),
+									        ProxyHeader{} );
+									return false;
+								}
+								if( static_cast<size_t>( result ) != count ) {
+									finish( std::make_error_code( std::errc::protocol_error ),
+									        ProxyHeader{} );
+									return false;
+								}
+								m_taken += count;
+								return true;
+							}
+
+						public:
+							proxy_reader_t(
+							  asio::ip::tcp::socket &socket,
+							  std::function<void( base::ErrorCode, ProxyHeader )> handler )
+							  : m_strand( base::ServiceHandle::get( ) )
+							  , m_socket( socket )
+							  , m_timer( base::ServiceHandle::get( ) )
+							  , m_handler( daw::move( handler ) ) {}
+
+							void start( std::chrono::milliseconds timeout ) {
+								asio::dispatch( m_strand, [self = shared_from_this( ),
+								                           timeout]( ) {
+									if( timeout.count( ) > 0 ) {
+										self->start_timer( timeout );
+									}
+									// Usually the header came with the connection, try before
+									// waiting
+									self->read( );
+								} );
+							}
+
+							void read( ) {
+								m_buffer.resize( std::max( m_needed, v1_max_size ) );
+								auto const peeked =
+								  ::recv( m_socket.native_handle( ), m_buffer.data( ) + m_taken,
+								          m_buffer.size( ) - m_taken, MSG_PEEK | MSG_DONTWAIT );
+								if( peeked < 0 ) {
+									if( errno == EAGAIN or errno == EWOULDBLOCK or
+									    errno == EINTR ) {
+										wait( );
+										return;
+									}
+									finish( base::ErrorCode( errno, std::system_category( ) ),
+									        ProxyHeader{} );
+									return;
+								}
+								if( peeked == 0 ) {
+									finish( asio::error::eof, ProxyHeader{} );
+									return;
+								}
+								auto const available = m_taken + static_cast<size_t>( peeked );
+								auto result = parse_proxy_header(
+								  m_buffer.data( ), m_buffer.data( ) + available );
+								switch( result.status ) {
+								case proxy_parse_status::complete:
+									if( take( result.header.size - m_taken ) ) {
+										finish( base::ErrorCode( ), daw::move( result.header ) );
+									}
+									return;
+								case proxy_parse_status::incomplete:
+									// Everything so far belongs to the header
+									if( take( static_cast<size_t>( peeked ) ) ) {
+										m_needed = result.needed;
+										wait( );
+									}
+									return;
+								case proxy_parse_status::invalid:
+									finish( std::make_error_code( std::errc::protocol_error ),
+									        ProxyHeader{} );
+									return;
+								}
+							}
+						};
+					} // namespace
+
+					proxy_parse_result_t parse_proxy_header( char const *first,
+					                                         char const *last ) {
+						auto const size = static_cast<size_t>( last - first );
+						if( size == 0 ) {
+							return incomplete( 1U );
+						}
+						if( first[0] == static_cast<char>( v2_signature[0] ) ) {
+							auto const count = std::min( size, v2_signature.size( ) );
+							if( std::memcmp( first, v2_signature.data( ), count ) != 0 ) {
+								return invalid( );
+							}
+							return parse_v2( reinterpret_cast<unsigned char const *>( first ),
+							                 size );
+						}
+						auto const count = std::min( size, v1_prefix.size( ) );
+						if( daw::string_view( first, count ) != v1_prefix.substr( 0, count ) ) {
+							return invalid( );
+						}
+						if( size < v1_prefix.size( ) ) {
+							return incomplete( v1_prefix.size( ) );
+						}
+						return parse_v1( first, last );
+					}
+
+					void read_proxy_header_async(
+					  asio::ip::tcp::socket &socket, std::chrono::milliseconds timeout,
+					  std::function<void( base::ErrorCode, ProxyHeader )> handler ) {
+						std::make_shared<proxy_reader_t>( socket, daw::move( handler ) )
+						  ->start( timeout );
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -20,15 +20,20 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
 #include <asio.hpp>
+#include <asio/steady_timer.hpp>
 #include <boost/filesystem.hpp>
+#include <system_error>
 
 #include <daw/daw_exception.h>
 #include <daw/daw_utility.h>
 #include <daw/json/daw_json_link.h>
 
 #include "base_service_handle.h"
+#include "base_threading.h"
 #include "lib_net_socket_asio_socket.h"
+#include "lib_net_tls_context.h"
 
 namespace daw {
 	namespace nodepp {
@@ -66,59 +71,120 @@ namespace daw {
 					return canonical( p ).string( );
 				}
 
+				bool SslServerConfig::get_tls_kernel_offload( ) const {
+					return tls_kernel_offload.value_or( false );
+				}
+
+				size_t SslServerConfig::get_tls_session_cache_size( ) const {
+					return tls_session_cache_size.value_or( 20480U );
+				}
+
+				size_t SslServerConfig::get_tls_session_cache_shards( ) const {
+					return std::max( tls_session_cache_shards.value_or( 16U ),
+					                 static_cast<uint16_t>( 1U ) );
+				}
+
+				std::chrono::seconds SslServerConfig::get_tls_session_timeout( ) const {
+					return std::chrono::seconds( tls_session_timeout.value_or( 300 ) );
+				}
+
+				bool SslServerConfig::get_tls_session_tickets( ) const {
+					return tls_session_tickets.value_or( true );
+				}
+
+				std::chrono::seconds
+				SslServerConfig::get_tls_ticket_key_rotation( ) const {
+					return std::chrono::seconds(
+					  tls_ticket_key_rotation.value_or( 3600 ) );
+				}
+
+				uint16_t SslServerConfig::get_tls_handshake_threads( ) const {
+					if constexpr( base::is_single_threaded ) {
+						// Connections may not leave the thread running the io service
+						return 0U;
+					}
+					return tls_handshake_threads.value_or( 0U );
+				}
+
+				std::chrono::seconds
+				SslServerConfig::get_tls_shutdown_timeout( ) const {
+					return std::chrono::seconds( tls_shutdown_timeout.value_or( 5 ) );
+				}
+
 				namespace nss_impl {
-					BoostSocket::BoostSocket( std::unique_ptr<EncryptionContext> context )
+					BoostSocket::BoostSocket( std::shared_ptr<EncryptionContext> context )
 					  : m_encryption_context( daw::move( context ) )
 					  , m_encryption_enabled(
 					      static_cast<bool>( m_encryption_context ) ) {}
 
 					BoostSocket::BoostSocket(
-					  std::unique_ptr<BoostSocket::BoostSocketValueType> &&socket,
-					  std::unique_ptr<EncryptionContext> &&context )
+					  base::slab_ptr<BoostSocket::BoostSocketValueType> &&socket,
+					  std::shared_ptr<EncryptionContext> context )
 					  : m_encryption_context( daw::move( context ) )
 					  , m_socket( daw::move( socket ) )
 					  , m_encryption_enabled(
 					      static_cast<bool>( m_encryption_context ) ) {}
 
-					namespace {
-						std::unique_ptr<EncryptionContext>
-						make_context( SslServerConfig const &ssl_config ) {
-							auto context = std::make_unique<EncryptionContext>(
-							  EncryptionContext::tlsv12_server );
-
-							context->set_options( EncryptionContext::default_workarounds |
-							                      EncryptionContext::no_sslv2 |
-							                      EncryptionContext::no_sslv3 |
-							                      EncryptionContext::single_dh_use );
-
-							if( !ssl_config.tls_certificate_chain_file.empty( ) ) {
-								context->use_certificate_chain_file(
-								  ssl_config.get_tls_certificate_chain_file( ) );
-							}
+					BoostSocket::BoostSocket( SslServerConfig const &ssl_config )
+					  : BoostSocket( make_server_context( ssl_config ) ) {}
 
-							if( !ssl_config.tls_private_key_file.empty( ) ) {
-								context->use_private_key_file(
-								  ssl_config.get_tls_private_key_file( ),
-								  EncryptionContext::file_format::pem );
-							}
+					namespace {
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	The stream type needs a context even when encryption is
+						///				never turned on.  Plaintext sockets all use this one
+						std::shared_ptr<EncryptionContext> const &plaintext_context( ) {
+							static auto const context = std::make_shared<EncryptionContext>(
+							  EncryptionContext::tlsv12 );
+							return context;
+						}
 
-							if( !ssl_config.tls_dh_file.empty( ) ) {
-								context->use_tmp_dh_file( ssl_config.get_tls_dh_file( ) );
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Owns an encrypted socket while close_notify is
+						///				exchanged, after the BoostSocket that had it moved on
+						struct tls_teardown_t {
+							base::slab_ptr<BoostSocket::BoostSocketValueType> socket;
+							std::shared_ptr<EncryptionContext> context;
+							asio::steady_timer timer;
+
+							tls_teardown_t(
+							  base::slab_ptr<BoostSocket::BoostSocketValueType> &&s,
+							  std::shared_ptr<EncryptionContext> ctx )
+							  : socket( daw::move( s ) )
+							  , context( daw::move( ctx ) )
+							  , timer( base::ServiceHandle::get( ) ) {}
+
+							void close( ) noexcept {
+								auto ec = base::ErrorCode( );
+								socket->lowest_layer( ).close( ec );
 							}
-							return context;
+						};
+
+						void start_teardown( base::rc_ptr<tls_teardown_t> teardown,
+						                     std::chrono::seconds timeout ) {
+							teardown->timer.expires_after( timeout );
+							teardown->timer.async_wait(
+							  [teardown]( base::ErrorCode const &err ) {
+								  // Closing the socket ends the shutdown of a peer that has
+								  // not answered
+								  if( !err ) {
+									  teardown->close( );
+								  }
+							  } );
+							auto &stream = *teardown->socket;
+							stream.async_shutdown(
+							  [teardown = daw::move( teardown )]( base::ErrorCode const & ) {
+								  teardown->timer.cancel( );
+								  teardown->close( );
+							  } );
 						}
 					} // namespace
 
-					BoostSocket::BoostSocket( SslServerConfig const &ssl_config )
-					  : BoostSocket( make_context( ssl_config ) ) {}
-
 					void BoostSocket::init( bool must_exist ) {
 						if( !m_encryption_context ) {
-							m_encryption_context = std::make_unique<EncryptionContext>(
-							  EncryptionContext::tlsv12 );
+							m_encryption_context = plaintext_context( );
 						}
 						if( !m_socket ) {
-							m_socket = std::make_unique<BoostSocketValueType>(
+							m_socket = base::make_slab_ptr<BoostSocketValueType>(
 							  base::ServiceHandle::get( ), *m_encryption_context );
 						}
 						daw::exception::precondition_check( !must_exist or
@@ -126,7 +192,47 @@ namespace daw {
 					}
 
 					void BoostSocket::reset_socket( ) {
+						m_connect.cancel( );
 						m_socket.reset( );
+						m_ktls.reset( );
+						m_ktls_send = false;
+						m_is_unix = false;
+					}
+
+					void BoostSocket::prepare_ktls( ) {
+						m_ktls_send = false;
+						if( !m_ktls ) {
+							m_ktls = std::make_unique<ktls_state_t>( );
+						}
+						if( !ktls_prepare( m_socket->native_handle( ), *m_ktls ) ) {
+							m_ktls.reset( );
+						}
+					}
+
+					void BoostSocket::start_ktls( ) {
+						if( m_ktls ) {
+							m_ktls_send = ktls_start_send(
+							  m_socket->native_handle( ),
+							  m_socket->next_layer( ).native_handle( ), *m_ktls );
+							if( !m_ktls_send ) {
+								ktls_release( m_socket->native_handle( ) );
+								m_ktls.reset( );
+							}
+						}
+					}
+
+					bool BoostSocket::user_space_encryption( ) const noexcept {
+						return m_encryption_enabled and !m_ktls_send;
+					}
+
+					void BoostSocket::set_max_record_size( size_t size ) {
+						init( );
+						SSL_set_max_send_fragment( m_socket->native_handle( ),
+						                           static_cast<long>( size ) );
+					}
+
+					bool BoostSocket::kernel_tls( ) const noexcept {
+						return m_encryption_enabled and m_ktls_send;
 					}
 
 					EncryptionContext &BoostSocket::encryption_context( ) {
@@ -178,6 +284,14 @@ namespace daw {
 						return m_socket.operator->( );
 					}
 
+					asio::ip::tcp::socket &BoostSocket::next_layer( ) {
+						return raw_socket( ).next_layer( );
+					}
+
+					asio::ip::tcp::socket const &BoostSocket::next_layer( ) const {
+						return raw_socket( ).next_layer( );
+					}
+
 					bool BoostSocket::encyption_on( ) const {
 						return m_encryption_enabled;
 					}
@@ -198,6 +312,10 @@ namespace daw {
 						m_encryption_enabled = value;
 					}
 
+					bool BoostSocket::can_sendfile( ) const noexcept {
+						return !user_space_encryption( ) and has_sendfile( );
+					}
+
 					bool BoostSocket::is_open( ) {
 						init( false );
 						if( !m_socket ) {
@@ -214,46 +332,105 @@ namespace daw {
 					}
 
 					void BoostSocket::shutdown( ) {
-						if( encryption_on( ) ) {
-							// raw_socket( ).shutdown( );
+						auto ec = base::ErrorCode( );
+						if( shutdown( ec ) ) {
+							throw std::system_error( ec );
 						}
-						raw_socket( ).lowest_layer( ).shutdown(
-						  asio::socket_base::shutdown_both );
 					}
 
 					std::error_code
 					BoostSocket::shutdown( std::error_code &ec ) noexcept {
-						if( encryption_on( ) ) {
-							raw_socket( ).shutdown( );
-							ec = raw_socket( ).shutdown( ec );
-							if( static_cast<bool>( ec ) ) {
-								return ec;
-							}
+						ec = std::error_code( );
+						if( user_space_encryption( ) ) {
+							// close_notify has to go out before the TCP send side is
+							// shut.  close_async exchanges it
+							return ec;
+						}
+						if( kernel_tls( ) ) {
+							ktls_send_close_notify(
+							  raw_socket( ).next_layer( ).native_handle( ) );
+							// Otherwise OpenSSL drops the session when it is freed
+							SSL_set_shutdown( raw_socket( ).native_handle( ),
+							                  SSL_SENT_SHUTDOWN );
 						}
 						return raw_socket( ).lowest_layer( ).shutdown(
 						  asio::socket_base::shutdown_both, ec );
 					}
 
+					void BoostSocket::set_shutdown_timeout(
+					  std::chrono::seconds timeout ) noexcept {
+						m_shutdown_timeout = timeout;
+					}
+
+					void BoostSocket::close_async( ) {
+						m_connect.cancel( );
+						if( !m_socket ) {
+							return;
+						}
+						if( !user_space_encryption( ) or
+						    !m_socket->next_layer( ).is_open( ) ) {
+							auto ec = base::ErrorCode( );
+							if( kernel_tls( ) ) {
+								ktls_send_close_notify(
+								  m_socket->next_layer( ).native_handle( ) );
+								SSL_set_shutdown( m_socket->native_handle( ),
+								                  SSL_SENT_SHUTDOWN );
+							}
+							m_socket->lowest_layer( ).shutdown(
+							  asio::socket_base::shutdown_both, ec );
+							m_socket->lowest_layer( ).close( ec );
+							reset_socket( );
+							return;
+						}
+						if( m_ktls ) {
+							// The teardown outlives the state
+							ktls_release( m_socket->native_handle( ) );
+						}
+						auto teardown = base::make_slab_shared<tls_teardown_t>(
+						  daw::move( m_socket ), m_encryption_context );
+						reset_socket( );
+						start_teardown( daw::move( teardown ), m_shutdown_timeout );
+					}
+
 					void BoostSocket::close( ) {
-						raw_socket( ).shutdown( );
+						close_async( );
 					}
 
 					std::error_code BoostSocket::close( std::error_code &ec ) {
-						return raw_socket( ).shutdown( ec );
+						close_async( );
+						ec = std::error_code( );
+						return ec;
 					}
 
 					void BoostSocket::cancel( ) {
+						m_connect.cancel( );
 						raw_socket( ).next_layer( ).cancel( );
 					}
 
 					asio::ip::tcp::endpoint BoostSocket::remote_endpoint( ) const {
+						if( m_is_unix ) {
+							return {};
+						}
 						return raw_socket( ).next_layer( ).remote_endpoint( );
 					}
 
 					asio::ip::tcp::endpoint BoostSocket::local_endpoint( ) const {
+						if( m_is_unix ) {
+							return {};
+						}
 						return raw_socket( ).next_layer( ).local_endpoint( );
 					}
 
+					std::optional<std::string>
+					BoostSocket::unix_address( bool peer ) const {
+						if( !m_is_unix ) {
+							return std::nullopt;
+						}
+						daw::exception::precondition_check( m_socket, "Invalid socket" );
+						return nss_impl::unix_address(
+						  m_socket->next_layer( ).native_handle( ), peer );
+					}
+
 					void BoostSocket::ip6_only( bool value ) {
 						asio::ip::v6_only option{value};
 						raw_socket( ).next_layer( ).set_option( option );
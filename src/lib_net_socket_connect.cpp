@@ -0,0 +1,274 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <asio/bind_executor.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/error.hpp>
+#include <asio/io_context_strand.hpp>
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "lib_net_socket_connect.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					//////////////////////////////////////////////////////////////////////////
+					/// @brief	One connect racing its attempts.  Everything runs on the
+					///				strand so attempts finishing on different io threads
+					///				see the same state.  m_target belongs to the owner of the
+					///				handle, which may cancel from any thread, so it is only
+					///				used under m_target_mutex
+					class connect_race_t
+					  : public std::enable_shared_from_this<connect_race_t> {
+						using socket_t = asio::ip::tcp::socket;
+
+						asio::io_context::strand m_strand;
+						std::mutex m_target_mutex{};
+						socket_t *m_target;
+						std::vector<asio::ip::tcp::endpoint> m_endpoints;
+						/// One per started attempt, in the order of m_endpoints
+						std::vector<std::unique_ptr<socket_t>> m_attempts{};
+						asio::steady_timer m_attempt_timer;
+						asio::steady_timer m_deadline_timer;
+						ConnectOptions m_options;
+						connect_handler_t m_handler;
+						size_t m_pending = 0;
+						base::ErrorCode m_last_error = asio::error::host_not_found;
+						bool m_done = false;
+
+						void close_attempts( std::optional<size_t> keep ) {
+							for( size_t n = 0; n < m_attempts.size( ); ++n ) {
+								if( n != keep and m_attempts[n] ) {
+									auto ec = base::ErrorCode( );
+									m_attempts[n]->close( ec );
+								}
+							}
+						}
+
+						void finish( base::ErrorCode err, std::optional<size_t> winner ) {
+							m_done = true;
+							m_attempt_timer.cancel( );
+							m_deadline_timer.cancel( );
+							close_attempts( winner );
+							auto endpoint = asio::ip::tcp::endpoint( );
+							{
+								auto const lck = std::lock_guard<std::mutex>( m_target_mutex );
+								if( winner and m_target ) {
+									endpoint = m_endpoints[*winner];
+									*m_target = daw::move( *m_attempts[*winner] );
+								} else if( winner ) {
+									// Cancelled while the winner's completion was queued
+									err = asio::error::operation_aborted;
+									auto ec = base::ErrorCode( );
+									m_attempts[*winner]->close( ec );
+								}
+								m_target = nullptr;
+							}
+							auto handler = daw::move( m_handler );
+							handler( err, endpoint );
+						}
+
+						void start_next( ) {
+							while( m_attempts.size( ) < m_endpoints.size( ) ) {
+								auto const index = m_attempts.size( );
+								auto const &endpoint = m_endpoints[index];
+								m_attempts.push_back(
+								  std::make_unique<socket_t>( base::ServiceHandle::get( ) ) );
+								auto ec = base::ErrorCode( );
+								m_attempts.back( )->open( endpoint.protocol( ), ec );
+								if( ec ) {
+									// No route for this family, try the next address now
+									m_last_error = ec;
+									continue;
+								}
+								++m_pending;
+								m_attempts.back( )->async_connect(
+								  endpoint,
+								  asio::bind_executor(
+								    m_strand, [self = shared_from_this( ),
+								               index]( base::ErrorCode const &err ) {
+									    self->attempt_done( index, err );
+								    } ) );
+								if( m_attempts.size( ) < m_endpoints.size( ) ) {
+									m_attempt_timer.expires_after( m_options.attempt_delay );
+									m_attempt_timer.async_wait( asio::bind_executor(
+									  m_strand,
+									  [self = shared_from_this( )]( base::ErrorCode const &err ) {
+										  if( !err and !self->m_done ) {
+											  self->start_next( );
+										  }
+									  } ) );
+								}
+								return;
+							}
+							if( m_pending == 0 ) {
+								finish( m_last_error, std::nullopt );
+							}
+						}
+
+						void attempt_done( size_t index, base::ErrorCode const &err ) {
+							--m_pending;
+							if( m_done ) {
+								return;
+							}
+							if( !err ) {
+								finish( err, index );
+								return;
+							}
+							m_last_error = err;
+							auto ec = base::ErrorCode( );
+							m_attempts[index]->close( ec );
+							if( m_attempts.size( ) < m_endpoints.size( ) ) {
+								m_attempt_timer.cancel( );
+								start_next( );
+							} else if( m_pending == 0 ) {
+								finish( m_last_error, std::nullopt );
+							}
+						}
+
+					public:
+						connect_race_t( socket_t &target,
+						                std::vector<asio::ip::tcp::endpoint> endpoints,
+						                ConnectOptions const &options,
+						                connect_handler_t handler )
+						  : m_strand( base::ServiceHandle::get( ) )
+						  , m_target( &target )
+						  , m_endpoints( daw::move( endpoints ) )
+						  , m_attempt_timer( base::ServiceHandle::get( ) )
+						  , m_deadline_timer( base::ServiceHandle::get( ) )
+						  , m_options( options )
+						  , m_handler( daw::move( handler ) ) {}
+
+						void start( ) {
+							asio::dispatch( m_strand, [self = shared_from_this( )]( ) {
+								if( self->m_options.deadline.count( ) > 0 ) {
+									self->m_deadline_timer.expires_after(
+									  self->m_options.deadline );
+									self->m_deadline_timer.async_wait( asio::bind_executor(
+									  self->m_strand, [self]( base::ErrorCode const &err ) {
+										  if( !err and !self->m_done ) {
+											  self->finish( asio::error::timed_out, std::nullopt );
+										  }
+									  } ) );
+								}
+								self->start_next( );
+							} );
+						}
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Forget the target now and finish on the strand.  Does
+						///				nothing once the race has finished
+						void cancel( ) {
+							{
+								auto const lck = std::lock_guard<std::mutex>( m_target_mutex );
+								if( m_target == nullptr ) {
+									return;
+								}
+								m_target = nullptr;
+							}
+							asio::dispatch( m_strand, [self = shared_from_this( )]( ) {
+								if( !self->m_done ) {
+									self->finish( asio::error::operation_aborted, std::nullopt );
+								}
+							} );
+						}
+					};
+
+					connect_race_handle_t::connect_race_handle_t(
+					  std::shared_ptr<connect_race_t> race ) noexcept
+					  : m_race( daw::move( race ) ) {}
+
+					connect_race_handle_t &connect_race_handle_t::
+					operator=( connect_race_handle_t &&rhs ) noexcept {
+						if( this != &rhs ) {
+							cancel( );
+							m_race = daw::move( rhs.m_race );
+						}
+						return *this;
+					}
+
+					connect_race_handle_t::~connect_race_handle_t( ) noexcept {
+						cancel( );
+					}
+
+					void connect_race_handle_t::cancel( ) noexcept {
+						auto race = daw::move( m_race );
+						if( !race ) {
+							return;
+						}
+						try {
+							race->cancel( );
+						} catch( ... ) {}
+					}
+
+					std::vector<asio::ip::tcp::endpoint> order_endpoints(
+					  asio::ip::tcp::resolver::results_type const &endpoints ) {
+						auto first = std::vector<asio::ip::tcp::endpoint>( );
+						auto second = std::vector<asio::ip::tcp::endpoint>( );
+						for( auto const &entry : endpoints ) {
+							auto const &endpoint = entry.endpoint( );
+							if( first.empty( ) or
+							    first.front( ).protocol( ) == endpoint.protocol( ) ) {
+								first.push_back( endpoint );
+							} else {
+								second.push_back( endpoint );
+							}
+						}
+						auto result = std::vector<asio::ip::tcp::endpoint>( );
+						result.reserve( first.size( ) + second.size( ) );
+						for( size_t n = 0; n < first.size( ) or n < second.size( ); ++n ) {
+							if( n < first.size( ) ) {
+								result.push_back( first[n] );
+							}
+							if( n < second.size( ) ) {
+								result.push_back( second[n] );
+							}
+						}
+						return result;
+					}
+
+					connect_race_handle_t happy_eyeballs_connect(
+					  asio::ip::tcp::socket &target,
+					  asio::ip::tcp::resolver::results_type const &endpoints,
+					  ConnectOptions const &options, connect_handler_t handler ) {
+
+						auto race = std::make_shared<connect_race_t>(
+						  target, order_endpoints( endpoints ), options,
+						  daw::move( handler ) );
+						race->start( );
+						return connect_race_handle_t( daw::move( race ) );
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
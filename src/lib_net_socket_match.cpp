@@ -0,0 +1,363 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined( __GNUC__ ) and ( defined( __x86_64__ ) or defined( __i386__ ) )
+#define NODEPP_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include <daw/daw_utility.h>
+
+#include "lib_net_socket_match.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					namespace {
+						// StreamBuf exposes its readable area as a single contiguous
+						// buffer, so the iterators can be turned back into a pointer
+						char const *to_pointer( match_iterator_t first,
+						                        match_iterator_t last ) noexcept {
+							if( first == last ) {
+								return nullptr;
+							}
+							return &( *first );
+						}
+
+						// Longest terminator after the first newline is "\r\n"
+						constexpr ptrdiff_t const max_terminator_tail = 2;
+
+						char const *terminator_end( char const *newline,
+						                            char const *last ) noexcept {
+							char const *pos = newline + 1;
+							if( pos == last ) {
+								return nullptr;
+							}
+							if( *pos == '\n' ) {
+								return pos + 1;
+							}
+							if( *pos == '\r' and ( pos + 1 ) != last and pos[1] == '\n' ) {
+								return pos + 2;
+							}
+							return nullptr;
+						}
+
+						char const *find_header_end_scalar( char const *first,
+						                                    char const *last ) noexcept {
+							while( first != last ) {
+								auto const newline = static_cast<char const *>( std::memchr(
+								  first, '\n', static_cast<size_t>( last - first ) ) );
+								if( newline == nullptr ) {
+									return nullptr;
+								}
+								if( auto const result = terminator_end( newline, last );
+								    result != nullptr ) {
+									return result;
+								}
+								first = newline + 1;
+							}
+							return nullptr;
+						}
+
+#ifdef NODEPP_HAS_X86_SIMD
+						char const *check_newlines( char const *block, unsigned mask,
+						                            char const *last ) noexcept {
+							while( mask != 0 ) {
+								auto const offset = __builtin_ctz( mask );
+								if( auto const result = terminator_end( block + offset, last );
+								    result != nullptr ) {
+									return result;
+								}
+								mask &= mask - 1;
+							}
+							return nullptr;
+						}
+
+						__attribute__( ( target( "sse2" ) ) ) char const *
+						find_header_end_sse2( char const *first,
+						                      char const *last ) noexcept {
+							auto const newlines = _mm_set1_epi8( '\n' );
+							while( last - first >= 16 ) {
+								auto const block = _mm_loadu_si128(
+								  reinterpret_cast<__m128i const *>( first ) );
+								auto const mask = static_cast<unsigned>(
+								  _mm_movemask_epi8( _mm_cmpeq_epi8( block, newlines ) ) );
+								if( auto const result = check_newlines( first, mask, last );
+								    result != nullptr ) {
+									return result;
+								}
+								first += 16;
+							}
+							return find_header_end_scalar( first, last );
+						}
+
+						__attribute__( ( target( "avx2" ) ) ) char const *
+						find_header_end_avx2( char const *first,
+						                      char const *last ) noexcept {
+							auto const newlines = _mm256_set1_epi8( '\n' );
+							while( last - first >= 32 ) {
+								auto const block = _mm256_loadu_si256(
+								  reinterpret_cast<__m256i const *>( first ) );
+								auto const mask = static_cast<unsigned>(
+								  _mm256_movemask_epi8( _mm256_cmpeq_epi8( block, newlines ) ) );
+								if( auto const result = check_newlines( first, mask, last );
+								    result != nullptr ) {
+									return result;
+								}
+								first += 32;
+							}
+							return find_header_end_sse2( first, last );
+						}
+#endif
+
+						// A u64 needs at most 10 groups of 7 bits
+						constexpr size_t const max_varint_size = 10;
+
+						constexpr size_t prefix_size( NetSocketStreamFramePrefix prefix ) {
+							switch( prefix ) {
+							case NetSocketStreamFramePrefix::u16:
+								return 2;
+							case NetSocketStreamFramePrefix::u32:
+								return 4;
+							case NetSocketStreamFramePrefix::varint:
+								return max_varint_size;
+							case NetSocketStreamFramePrefix::none:
+							default:
+								return 0;
+							}
+						}
+
+						size_t
+						decode_fixed( char const *first, size_t size,
+						              NetSocketStreamByteOrder byte_order ) noexcept {
+							size_t result = 0;
+							for( size_t n = 0; n < size; ++n ) {
+								auto const pos =
+								  byte_order == NetSocketStreamByteOrder::big_endian
+								    ? n
+								    : size - 1 - n;
+								result = ( result << 8U ) |
+								         static_cast<unsigned char>( first[pos] );
+							}
+							return result;
+						}
+
+						using find_header_end_t = char const *( * )( char const *,
+						                                             char const * ) noexcept;
+
+						find_header_end_t select_find_header_end( ) noexcept {
+#ifdef NODEPP_HAS_X86_SIMD
+							__builtin_cpu_init( );
+							if( __builtin_cpu_supports( "avx2" ) ) {
+								return &find_header_end_avx2;
+							}
+							if( __builtin_cpu_supports( "sse2" ) ) {
+								return &find_header_end_sse2;
+							}
+#endif
+							return &find_header_end_scalar;
+						}
+					} // namespace
+
+					char const *find_header_end( char const *first,
+					                             char const *last ) noexcept {
+						static find_header_end_t const impl = select_find_header_end( );
+						return impl( first, last );
+					}
+
+					match_result_t header_end_matcher_t::
+					operator( )( match_iterator_t first, match_iterator_t last ) const {
+						auto const len = last - first;
+						if( len == 0 ) {
+							return {last, false};
+						}
+						char const *const data = to_pointer( first, last );
+						if( auto const result = find_header_end( data, data + len );
+						    result != nullptr ) {
+							return {first + ( result - data ), true};
+						}
+						// Only a newline in the last couple of bytes can still become
+						// part of a terminator when more data arrives
+						return {last - std::min( len, max_terminator_tail ), false};
+					}
+
+					frame_matcher_t frame_matcher_t::exact( size_t frame_size ) noexcept {
+						auto result = frame_matcher_t( );
+						result.m_max_frame_size = frame_size;
+						return result;
+					}
+
+					frame_matcher_t
+					frame_matcher_t::length_prefixed( NetSocketStreamFramePrefix prefix,
+					                                  NetSocketStreamByteOrder byte_order,
+					                                  size_t max_frame_size ) noexcept {
+						auto result = frame_matcher_t( );
+						result.m_max_frame_size = max_frame_size;
+						result.m_prefix = prefix;
+						result.m_byte_order = byte_order;
+						return result;
+					}
+
+					size_t frame_matcher_t::max_frame_size( ) const noexcept {
+						return m_max_frame_size;
+					}
+
+					size_t frame_matcher_t::max_buffer_size( ) const noexcept {
+						return prefix_size( m_prefix ) + m_max_frame_size;
+					}
+
+					std::optional<frame_header_t>
+					frame_matcher_t::header( char const *first, char const *last ) const
+					  noexcept {
+						auto const len = static_cast<size_t>( last - first );
+						switch( m_prefix ) {
+						case NetSocketStreamFramePrefix::none:
+							return frame_header_t{0, m_max_frame_size};
+						case NetSocketStreamFramePrefix::u16:
+						case NetSocketStreamFramePrefix::u32: {
+							auto const size = prefix_size( m_prefix );
+							if( len < size ) {
+								return std::nullopt;
+							}
+							return frame_header_t{size,
+							                      decode_fixed( first, size, m_byte_order )};
+						}
+						case NetSocketStreamFramePrefix::varint: {
+							uint64_t value = 0;
+							for( size_t n = 0; n < max_varint_size; ++n ) {
+								if( n == len ) {
+									return std::nullopt;
+								}
+								auto const b = static_cast<unsigned char>( first[n] );
+								if( n + 1 == max_varint_size and b > 1U ) {
+									// More than 64 bits
+									break;
+								}
+								value |= static_cast<uint64_t>( b & 0x7FU ) << ( 7U * n );
+								if( ( b & 0x80U ) == 0 ) {
+									if( value > std::numeric_limits<size_t>::max( ) ) {
+										break;
+									}
+									return frame_header_t{n + 1, static_cast<size_t>( value )};
+								}
+							}
+							// Malformed, report it as too large so the frame is rejected
+							return frame_header_t{max_varint_size,
+							                      std::numeric_limits<size_t>::max( )};
+						}
+						}
+						return std::nullopt;
+					}
+
+					match_result_t frame_matcher_t::
+					operator( )( match_iterator_t first, match_iterator_t last ) const {
+						// Frames are always at the start of the buffer.  Returning first
+						// makes asio retry from there after the next read
+						auto const len = static_cast<size_t>( last - first );
+						char const *const data = to_pointer( first, last );
+						auto const hdr = header( data, data + len );
+						if( !hdr ) {
+							return {first, false};
+						}
+						if( hdr->payload_size > m_max_frame_size ) {
+							return {first + static_cast<ptrdiff_t>( hdr->prefix_size ), true};
+						}
+						auto const frame_size = hdr->prefix_size + hdr->payload_size;
+						if( len < frame_size ) {
+							return {first, false};
+						}
+						return {first + static_cast<ptrdiff_t>( frame_size ), true};
+					}
+
+					values_matcher_t::values_matcher_t( std::string values )
+					  : m_values( daw::move( values ) ) {
+
+						auto const len = m_values.size( );
+						m_skip.fill( len );
+						if( len == 0 ) {
+							return;
+						}
+						for( size_t n = 0; n < len - 1; ++n ) {
+							m_skip[static_cast<unsigned char>( m_values[n] )] = len - 1 - n;
+						}
+					}
+
+					std::string const &values_matcher_t::values( ) const noexcept {
+						return m_values;
+					}
+
+					bool values_matcher_t::empty( ) const noexcept {
+						return m_values.empty( );
+					}
+
+					match_result_t values_matcher_t::
+					operator( )( match_iterator_t first, match_iterator_t last ) const {
+						auto const needle_len = m_values.size( );
+						if( needle_len == 0 ) {
+							return {first, true};
+						}
+						auto const haystack_len = static_cast<size_t>( last - first );
+						if( haystack_len < needle_len ) {
+							return {first, false};
+						}
+						char const *const haystack = to_pointer( first, last );
+
+						if( needle_len == 1 ) {
+							auto const pos = static_cast<char const *>(
+							  std::memchr( haystack, m_values.front( ), haystack_len ) );
+							if( pos == nullptr ) {
+								return {last, false};
+							}
+							return {first + ( ( pos - haystack ) + 1 ), true};
+						}
+
+						char const *const needle = m_values.data( );
+						auto const last_needle = needle_len - 1;
+						size_t pos = 0;
+						while( pos + needle_len <= haystack_len ) {
+							auto const tail =
+							  static_cast<unsigned char>( haystack[pos + last_needle] );
+							if( tail == static_cast<unsigned char>( needle[last_needle] ) and
+							    std::memcmp( haystack + pos, needle, last_needle ) == 0 ) {
+								return {first + static_cast<ptrdiff_t>( pos + needle_len ),
+								        true};
+							}
+							pos += m_skip[tail];
+						}
+						// A partial match may straddle the end of the data.  Resume the
+						// next search where it could start
+						return {first +
+						          static_cast<ptrdiff_t>( haystack_len - last_needle ),
+						        false};
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,240 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+#include <daw/daw_utility.h>
+
+#include "lib_net_socket_options.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				uint16_t AcceptOptions::get_pending_accepts( ) const {
+					if( !pending_accepts or *pending_accepts == 0 ) {
+						return 1U;
+					}
+					return *pending_accepts;
+				}
+
+				bool AcceptOptions::get_drain_backlog( ) const {
+					return drain_backlog and *drain_backlog;
+				}
+
+				uint32_t AcceptOptions::get_max_connections( ) const {
+					return max_connections.value_or( 0U );
+				}
+
+				std::string AcceptOptions::get_overload_response( ) const {
+					return overload_response.value_or( std::string( ) );
+				}
+
+				std::chrono::milliseconds
+				AcceptOptions::get_max_accept_backoff( ) const {
+					if( !max_accept_backoff or *max_accept_backoff == 0 ) {
+						return std::chrono::milliseconds( 1000 );
+					}
+					return std::chrono::milliseconds( *max_accept_backoff );
+				}
+
+				bool AcceptOptions::get_proxy_protocol( ) const {
+					return proxy_protocol and *proxy_protocol;
+				}
+
+				std::chrono::milliseconds
+				AcceptOptions::get_proxy_header_timeout( ) const {
+					return std::chrono::milliseconds(
+					  proxy_header_timeout.value_or( 5000U ) );
+				}
+
+				namespace nss_impl {
+					namespace {
+						void set_int_option( int fd, int level, int name, int32_t value,
+						                     char const *description ) {
+							int const v = value;
+							if( ::setsockopt( fd, level, name, &v, sizeof( v ) ) != 0 ) {
+								throw std::system_error( errno, std::system_category( ),
+								                         description );
+							}
+						}
+
+						// The options a connection can have, shared by listening and
+						// accepted sockets
+						template<typename Socket>
+						void apply_common_options( Socket &socket,
+						                           SocketOptions const &options ) {
+							auto const fd = socket.native_handle( );
+							if( options.no_delay ) {
+								socket.set_option(
+								  asio::ip::tcp::no_delay( *options.no_delay ) );
+							}
+							if( options.keep_alive ) {
+								socket.set_option(
+								  asio::socket_base::keep_alive( *options.keep_alive ) );
+							}
+#if defined( TCP_KEEPIDLE )
+							if( options.keep_alive_idle ) {
+								set_int_option( fd, IPPROTO_TCP, TCP_KEEPIDLE,
+								                *options.keep_alive_idle, "TCP_KEEPIDLE" );
+							}
+#elif defined( TCP_KEEPALIVE )
+							if( options.keep_alive_idle ) {
+								set_int_option( fd, IPPROTO_TCP, TCP_KEEPALIVE,
+								                *options.keep_alive_idle, "TCP_KEEPALIVE" );
+							}
+#endif
+#if defined( TCP_KEEPINTVL )
+							if( options.keep_alive_interval ) {
+								set_int_option( fd, IPPROTO_TCP, TCP_KEEPINTVL,
+								                *options.keep_alive_interval, "TCP_KEEPINTVL" );
+							}
+#endif
+#if defined( TCP_KEEPCNT )
+							if( options.keep_alive_count ) {
+								set_int_option( fd, IPPROTO_TCP, TCP_KEEPCNT,
+								                *options.keep_alive_count, "TCP_KEEPCNT" );
+							}
+#endif
+							if( options.send_buffer_size ) {
+								socket.set_option( asio::socket_base::send_buffer_size(
+								  *options.send_buffer_size ) );
+							}
+							if( options.receive_buffer_size ) {
+								socket.set_option( asio::socket_base::receive_buffer_size(
+								  *options.receive_buffer_size ) );
+							}
+#if defined( TCP_NOTSENT_LOWAT )
+							if( options.not_sent_low_water ) {
+								set_int_option( fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+								                *options.not_sent_low_water,
+								                "TCP_NOTSENT_LOWAT" );
+							}
+#endif
+						}
+					} // namespace
+
+					bool try_accept( asio::ip::tcp::acceptor &acceptor,
+					                 asio::ip::tcp::socket &socket,
+					                 asio::ip::tcp const &protocol,
+					                 base::ErrorCode &ec ) {
+						ec = base::ErrorCode( );
+#if defined( __linux__ )
+						// One call gives a socket that is already non-blocking and close
+						// on exec
+						while( true ) {
+							auto const fd =
+							  ::accept4( acceptor.native_handle( ), nullptr, nullptr,
+							             SOCK_NONBLOCK | SOCK_CLOEXEC );
+							if( fd >= 0 ) {
+								socket.assign( protocol, fd, ec );
+								if( ec ) {
+									::close( fd );
+									return false;
+								}
+								return true;
+							}
+							switch( errno ) {
+							case EINTR:
+							case ECONNABORTED:
+								continue;
+							case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+							case EWOULDBLOCK:
+#endif
+								return false;
+							default:
+								ec = base::ErrorCode( errno, std::system_category( ) );
+								return false;
+							}
+						}
+#else
+						Unused( protocol );
+						acceptor.accept( socket, ec );
+						if( ec == asio::error::would_block or
+						    ec == asio::error::try_again ) {
+							ec = base::ErrorCode( );
+							return false;
+						}
+						return !ec;
+#endif
+					}
+
+					bool socket_options_inherited( ) noexcept {
+#if defined( __linux__ )
+						// Linux clones the listening socket, buffer sizes, keep alive,
+						// TCP_NODELAY and TCP_NOTSENT_LOWAT included
+						return true;
+#else
+						return false;
+#endif
+					}
+
+					void apply_listen_options( asio::ip::tcp::acceptor &acceptor,
+					                           SocketOptions const &options ) {
+						auto const fd = acceptor.native_handle( );
+						// The receive buffer must be set before listen so that the
+						// window scale is chosen from it
+						apply_common_options( acceptor, options );
+#if defined( TCP_DEFER_ACCEPT )
+						if( options.defer_accept ) {
+							set_int_option( fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+							                *options.defer_accept, "TCP_DEFER_ACCEPT" );
+						}
+#endif
+#if defined( TCP_FASTOPEN )
+						if( options.fast_open_queue ) {
+							set_int_option( fd, IPPROTO_TCP, TCP_FASTOPEN,
+							                *options.fast_open_queue, "TCP_FASTOPEN" );
+						}
+#endif
+						Unused( fd );
+					}
+
+					void apply_socket_options( asio::ip::tcp::socket &socket,
+					                           SocketOptions const &options ) {
+						apply_common_options( socket, options );
+					}
+
+					void set_no_delay( asio::ip::tcp::socket &socket, bool value ) {
+						socket.set_option( asio::ip::tcp::no_delay( value ) );
+					}
+
+					void set_keep_alive( asio::ip::tcp::socket &socket, bool value,
+					                     int32_t idle_seconds ) {
+						auto options = SocketOptions{};
+						options.keep_alive = value;
+						if( value and idle_seconds > 0 ) {
+							options.keep_alive_idle = idle_seconds;
+						}
+						apply_common_options( socket, options );
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
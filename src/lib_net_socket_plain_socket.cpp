@@ -0,0 +1,190 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <asio.hpp>
+
+#include <daw/daw_exception.h>
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "lib_net_socket_plain_socket.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					PlainSocket::PlainSocket(
+					  base::slab_ptr<BoostSocketValueType> &&socket ) noexcept
+					  : m_socket( daw::move( socket ) ) {}
+
+					void PlainSocket::init( bool must_exist ) {
+						if( !m_socket ) {
+							m_socket = base::make_slab_ptr<BoostSocketValueType>(
+							  base::ServiceHandle::get( ) );
+						}
+						daw::exception::precondition_check( !must_exist or
+						  m_socket, "Could not create asio socket" );
+					}
+
+					void PlainSocket::reset_socket( ) {
+						m_connect.cancel( );
+						m_socket.reset( );
+						m_is_unix = false;
+					}
+
+					PlainSocket::BoostSocketValueType &PlainSocket::raw_socket( ) {
+						init( );
+						return *m_socket;
+					}
+
+					PlainSocket::BoostSocketValueType const &
+					PlainSocket::raw_socket( ) const {
+						daw::exception::precondition_check( m_socket, "Invalid socket" );
+						return *m_socket;
+					}
+
+					PlainSocket::operator bool( ) const {
+						return static_cast<bool>( m_socket );
+					}
+
+					PlainSocket::BoostSocketValueType const &PlainSocket::
+					operator*( ) const {
+						return raw_socket( );
+					}
+
+					PlainSocket::BoostSocketValueType &PlainSocket::operator*( ) {
+						return raw_socket( );
+					}
+
+					PlainSocket::BoostSocketValueType *PlainSocket::operator->( ) const {
+						daw::exception::precondition_check( m_socket,
+						                                    "Invalid socket - null" );
+						return m_socket.operator->( );
+					}
+
+					PlainSocket::BoostSocketValueType *PlainSocket::operator->( ) {
+						init( );
+						return m_socket.operator->( );
+					}
+
+					PlainSocket::BoostSocketValueType &PlainSocket::next_layer( ) {
+						return raw_socket( );
+					}
+
+					PlainSocket::BoostSocketValueType const &
+					PlainSocket::next_layer( ) const {
+						return raw_socket( );
+					}
+
+					bool PlainSocket::can_sendfile( ) const noexcept {
+						return has_sendfile( );
+					}
+
+					bool PlainSocket::is_open( ) {
+						init( false );
+						if( !m_socket ) {
+							return false;
+						}
+						return m_socket->is_open( );
+					}
+
+					bool PlainSocket::is_open( ) const {
+						if( !m_socket ) {
+							return false;
+						}
+						return m_socket->is_open( );
+					}
+
+					void PlainSocket::shutdown( ) {
+						raw_socket( ).shutdown( asio::socket_base::shutdown_both );
+					}
+
+					std::error_code
+					PlainSocket::shutdown( std::error_code &ec ) noexcept {
+						return raw_socket( ).shutdown( asio::socket_base::shutdown_both,
+						                               ec );
+					}
+
+					void PlainSocket::close( ) {
+						raw_socket( ).close( );
+					}
+
+					std::error_code PlainSocket::close( std::error_code &ec ) {
+						return raw_socket( ).close( ec );
+					}
+
+					void PlainSocket::close_async( ) {
+						m_connect.cancel( );
+						if( !m_socket ) {
+							return;
+						}
+						auto ec = base::ErrorCode( );
+						m_socket->shutdown( asio::socket_base::shutdown_both, ec );
+						m_socket->close( ec );
+						reset_socket( );
+					}
+
+					void PlainSocket::cancel( ) {
+						m_connect.cancel( );
+						raw_socket( ).cancel( );
+					}
+
+					asio::ip::tcp::endpoint PlainSocket::remote_endpoint( ) const {
+						if( m_is_unix ) {
+							return {};
+						}
+						return raw_socket( ).remote_endpoint( );
+					}
+
+					asio::ip::tcp::endpoint PlainSocket::local_endpoint( ) const {
+						if( m_is_unix ) {
+							return {};
+						}
+						return raw_socket( ).local_endpoint( );
+					}
+
+					std::optional<std::string>
+					PlainSocket::unix_address( bool peer ) const {
+						if( !m_is_unix ) {
+							return std::nullopt;
+						}
+						daw::exception::precondition_check( m_socket, "Invalid socket" );
+						return nss_impl::unix_address( m_socket->native_handle( ), peer );
+					}
+
+					void PlainSocket::ip6_only( bool value ) {
+						asio::ip::v6_only option{value};
+						raw_socket( ).set_option( option );
+					}
+
+					bool PlainSocket::ip6_only( ) const {
+						asio::ip::v6_only option;
+						raw_socket( ).get_option( option );
+						return option.value( );
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,189 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#if defined( __linux__ )
+#define NODEPP_HAS_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+#include <daw/daw_exception.h>
+
+#include "lib_net_socket_sendfile.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					bool has_sendfile( ) noexcept {
+#ifdef NODEPP_HAS_SENDFILE
+						return true;
+#else
+						return false;
+#endif
+					}
+
+					file_descriptor_t::file_descriptor_t( daw::string_view file_name )
+					  : m_fd( ::open( file_name.to_string( ).c_str( ),
+					                  O_RDONLY | O_CLOEXEC ) ) {
+
+						daw::exception::precondition_check( m_fd >= 0,
+						                                    "Could not open file" );
+#if defined( POSIX_FADV_SEQUENTIAL )
+						::posix_fadvise( m_fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+					}
+
+					file_descriptor_t::~file_descriptor_t( ) noexcept {
+						if( m_fd >= 0 ) {
+							::close( m_fd );
+						}
+					}
+
+					file_descriptor_t::file_descriptor_t(
+					  file_descriptor_t &&other ) noexcept
+					  : m_fd( std::exchange( other.m_fd, -1 ) ) {}
+
+					file_descriptor_t &file_descriptor_t::
+					operator=( file_descriptor_t &&rhs ) noexcept {
+						if( this != &rhs ) {
+							if( m_fd >= 0 ) {
+								::close( m_fd );
+							}
+							m_fd = std::exchange( rhs.m_fd, -1 );
+						}
+						return *this;
+					}
+
+					int file_descriptor_t::get( ) const noexcept {
+						return m_fd;
+					}
+
+					file_descriptor_t::operator bool( ) const noexcept {
+						return m_fd >= 0;
+					}
+
+					size_t file_descriptor_t::size( ) const {
+						struct stat st {};
+						daw::exception::precondition_check( ::fstat( m_fd, &st ) == 0,
+						                                    "Could not stat file" );
+						return static_cast<size_t>( st.st_size );
+					}
+
+					file_chunk_reader_t::file_chunk_reader_t( file_descriptor_t file,
+					                                          uint64_t offset,
+					                                          size_t length,
+					                                          SendFileOptions options )
+					  : m_file( daw::move( file ) )
+					  , m_offset( offset )
+					  , m_remaining( length )
+					  , m_options( options ) {
+
+						daw::exception::precondition_check( m_file, "Invalid file" );
+						daw::exception::precondition_check(
+						  m_options.chunk_size > 0 and m_options.window > 0,
+						  "Chunk size and window must be greater than zero" );
+
+						auto const file_size = m_file.size( );
+						daw::exception::precondition_check(
+						  offset <= file_size, "Offset is past the end of the file" );
+						m_remaining = std::min( m_remaining,
+						                        file_size - static_cast<size_t>( offset ) );
+						m_buffer.resize( std::min(
+						  m_remaining, m_options.chunk_size * m_options.window ) );
+					}
+
+					bool file_chunk_reader_t::done( ) const noexcept {
+						return m_remaining == 0;
+					}
+
+					asio::const_buffer file_chunk_reader_t::read_window( ) {
+						auto const window_size = std::min( m_remaining, m_buffer.size( ) );
+#if defined( POSIX_FADV_WILLNEED )
+						// Have the kernel read the following window while this one is
+						// being sent
+						if( auto const next_size =
+						      std::min( m_remaining - window_size, m_buffer.size( ) );
+						    next_size > 0 ) {
+							::posix_fadvise( m_file.get( ),
+							                 static_cast<off_t>( m_offset + window_size ),
+							                 static_cast<off_t>( next_size ),
+							                 POSIX_FADV_WILLNEED );
+						}
+#endif
+						size_t pos = 0;
+						while( pos < window_size ) {
+							auto const count =
+							  std::min( m_options.chunk_size, window_size - pos );
+							auto const result =
+							  ::pread( m_file.get( ), m_buffer.data( ) + pos, count,
+							           static_cast<off_t>( m_offset + pos ) );
+							if( result < 0 ) {
+								if( errno == EINTR ) {
+									continue;
+								}
+								throw std::system_error( errno, std::system_category( ),
+								                         "Error reading file" );
+							}
+							daw::exception::precondition_check(
+							  result > 0, "File is shorter than expected" );
+							pos += static_cast<size_t>( result );
+						}
+						m_offset += window_size;
+						m_remaining -= window_size;
+						return asio::const_buffer( m_buffer.data( ), window_size );
+					}
+
+					size_t sendfile_some( int socket_fd, int file_fd, uint64_t &offset,
+					                      size_t count, base::ErrorCode &ec ) noexcept {
+#ifdef NODEPP_HAS_SENDFILE
+						while( true ) {
+							auto off = static_cast<off_t>( offset );
+							auto const result = ::sendfile( socket_fd, file_fd, &off, count );
+							if( result >= 0 ) {
+								ec = base::ErrorCode( );
+								offset = static_cast<uint64_t>( off );
+								return static_cast<size_t>( result );
+							}
+							if( errno != EINTR ) {
+								ec = base::ErrorCode( errno, std::system_category( ) );
+								return 0;
+							}
+						}
+#else
+						Unused( socket_fd, file_fd, offset, count );
+						ec = std::make_error_code( std::errc::operation_not_supported );
+						return 0;
+#endif
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
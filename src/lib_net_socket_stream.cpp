@@ -62,6 +62,10 @@ namespace daw {
 
 				void set_ipv6_only( asio::ip::tcp::acceptor &acceptor,
 				                    ip_version ip_ver ) {
+					// The option only exists for IPv6 sockets
+					if( ip_ver == ip_version::ipv4 ) {
+						return;
+					}
 					if( ip_ver == ip_version::ipv4_v6 ) {
 						acceptor.set_option( asio::ip::v6_only( false ) );
 					} else {
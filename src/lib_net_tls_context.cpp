@@ -0,0 +1,153 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <atomic>
+
+#include <daw/daw_utility.h>
+
+#include "lib_net_tls_context.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace {
+					std::shared_ptr<nss_impl::TlsSessionState>
+					make_session_state( SslServerConfig const &ssl_config ) {
+						return std::make_shared<nss_impl::TlsSessionState>(
+						  ssl_config.get_tls_session_cache_size( ),
+						  ssl_config.get_tls_session_cache_shards( ),
+						  ssl_config.get_tls_ticket_key_rotation( ) );
+					}
+				} // namespace
+
+				std::shared_ptr<EncryptionContext>
+				make_server_context( SslServerConfig const &ssl_config ) {
+					return make_server_context( ssl_config, nullptr );
+				}
+
+				std::shared_ptr<EncryptionContext> make_server_context(
+				  SslServerConfig const &ssl_config,
+				  std::shared_ptr<nss_impl::TlsSessionState> state ) {
+					if( !state ) {
+						state = make_session_state( ssl_config );
+					}
+					// TLS 1.2 and up, tlsv12_server would also rule out TLS 1.3
+					auto context = std::make_shared<EncryptionContext>(
+					  EncryptionContext::tls_server );
+
+					context->set_options( EncryptionContext::default_workarounds |
+					                      EncryptionContext::no_sslv2 |
+					                      EncryptionContext::no_sslv3 |
+					                      EncryptionContext::no_tlsv1 |
+					                      EncryptionContext::no_tlsv1_1 |
+					                      EncryptionContext::single_dh_use );
+
+					if( !ssl_config.tls_certificate_chain_file.empty( ) ) {
+						context->use_certificate_chain_file(
+						  ssl_config.get_tls_certificate_chain_file( ) );
+					}
+
+					if( !ssl_config.tls_private_key_file.empty( ) ) {
+						context->use_private_key_file(
+						  ssl_config.get_tls_private_key_file( ),
+						  EncryptionContext::file_format::pem );
+					}
+
+					if( !ssl_config.tls_dh_file.empty( ) ) {
+						context->use_tmp_dh_file( ssl_config.get_tls_dh_file( ) );
+					}
+
+					if( ssl_config.get_tls_kernel_offload( ) ) {
+						nss_impl::ktls_enable( *context );
+					}
+
+					nss_impl::enable_server_resumption(
+					  *context, daw::move( state ), ssl_config.get_tls_session_timeout( ),
+					  ssl_config.get_tls_session_tickets( ) );
+					return context;
+				}
+
+				std::shared_ptr<EncryptionContext>
+				make_client_context( size_t session_cache_size ) {
+					auto context = std::make_shared<EncryptionContext>(
+					  EncryptionContext::tls_client );
+
+					context->set_options( EncryptionContext::default_workarounds |
+					                      EncryptionContext::no_sslv2 |
+					                      EncryptionContext::no_sslv3 |
+					                      EncryptionContext::no_tlsv1 |
+					                      EncryptionContext::no_tlsv1_1 );
+					context->set_default_verify_paths( );
+
+					nss_impl::enable_client_resumption(
+					  *context, std::make_shared<nss_impl::TlsSessionState>(
+					              session_cache_size, 16U, std::chrono::seconds( 0 ) ) );
+					return context;
+				}
+
+				TlsContext::TlsContext( SslServerConfig ssl_config ) {
+					reload( daw::move( ssl_config ) );
+				}
+
+				std::shared_ptr<EncryptionContext> TlsContext::get( ) const {
+					return std::atomic_load( &m_context );
+				}
+
+				void TlsContext::reload( ) {
+					std::lock_guard<std::mutex> lock( m_reload_mutex );
+					if( !m_session_state ) {
+						m_session_state = make_session_state( m_config );
+					}
+					std::atomic_store( &m_context,
+					                   make_server_context( m_config, m_session_state ) );
+				}
+
+				void TlsContext::reload( SslServerConfig ssl_config ) {
+					std::lock_guard<std::mutex> lock( m_reload_mutex );
+					// The cache and ticket keys are sized on the first load and kept
+					// from then on, so clients can resume across certificate changes
+					if( !m_session_state ) {
+						m_session_state = make_session_state( ssl_config );
+					}
+					// Build first so that a bad config leaves everything as it was
+					auto context = make_server_context( ssl_config, m_session_state );
+					m_config = daw::move( ssl_config );
+					std::atomic_store( &m_context, daw::move( context ) );
+				}
+
+				TlsSessionStats TlsContext::session_stats( ) const {
+					auto context = get( );
+					if( !context ) {
+						return TlsSessionStats{};
+					}
+					return tls_session_stats( *context );
+				}
+
+				TlsContext::operator bool( ) const {
+					return static_cast<bool>( get( ) );
+				}
+			} // namespace net
+		}   // namespace lib
+	}     // namespace nodepp
+} // namespace daw
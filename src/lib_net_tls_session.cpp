@@ -0,0 +1,536 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <asio/ip/address.hpp>
+#include <ctime>
+#include <functional>
+#include <list>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <daw/daw_utility.h>
+
+#include "base_error.h"
+#include "lib_net_tls_session.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					struct TlsSessionCache::shard_t {
+						using entry_t = std::pair<std::string, SSL_SESSION *>;
+
+						std::mutex mutex{};
+						/// Most recently used first
+						std::list<entry_t> entries{};
+						std::unordered_map<std::string, std::list<entry_t>::iterator>
+						  index{};
+
+						void erase( std::list<entry_t>::iterator it ) {
+							SSL_SESSION_free( it->second );
+							index.erase( it->first );
+							entries.erase( it );
+						}
+					};
+
+					namespace {
+						bool is_expired( SSL_SESSION const *session ) noexcept {
+							auto const expires = SSL_SESSION_get_time( session ) +
+							                     SSL_SESSION_get_timeout( session );
+							return expires < static_cast<long>( std::time( nullptr ) );
+						}
+					} // namespace
+
+					TlsSessionCache::TlsSessionCache( size_t capacity,
+					                                  size_t shard_count )
+					  : m_shards( std::make_unique<shard_t[]>(
+					      std::max( shard_count, static_cast<size_t>( 1 ) ) ) )
+					  , m_shard_count( std::max( shard_count, static_cast<size_t>( 1 ) ) )
+					  , m_shard_capacity( std::max(
+					      ( capacity + m_shard_count - 1 ) / m_shard_count,
+					      static_cast<size_t>( 1 ) ) ) {}
+
+					TlsSessionCache::~TlsSessionCache( ) {
+						for( size_t n = 0; n < m_shard_count; ++n ) {
+							for( auto &entry : m_shards[n].entries ) {
+								SSL_SESSION_free( entry.second );
+							}
+						}
+					}
+
+					TlsSessionCache::shard_t &
+					TlsSessionCache::get_shard( std::string const &key ) const {
+						return m_shards[std::hash<std::string>{}( key ) % m_shard_count];
+					}
+
+					size_t TlsSessionCache::insert( std::string key,
+					                                SSL_SESSION *session ) {
+						auto &shard = get_shard( key );
+						std::lock_guard<std::mutex> lock( shard.mutex );
+
+						auto pos = shard.index.find( key );
+						if( pos != shard.index.end( ) ) {
+							shard.erase( pos->second );
+						}
+						shard.entries.emplace_front( key, session );
+						shard.index.emplace( daw::move( key ), shard.entries.begin( ) );
+
+						size_t evicted = 0;
+						while( shard.entries.size( ) > m_shard_capacity ) {
+							shard.erase( std::prev( shard.entries.end( ) ) );
+							++evicted;
+						}
+						return evicted;
+					}
+
+					SSL_SESSION *TlsSessionCache::find( std::string const &key,
+					                                    bool take ) {
+						auto &shard = get_shard( key );
+						std::lock_guard<std::mutex> lock( shard.mutex );
+
+						auto pos = shard.index.find( key );
+						if( pos == shard.index.end( ) ) {
+							return nullptr;
+						}
+						auto it = pos->second;
+						if( is_expired( it->second ) ) {
+							shard.erase( it );
+							return nullptr;
+						}
+						auto *session = it->second;
+						if( take ) {
+							// The cache's reference goes to the caller
+							shard.index.erase( pos );
+							shard.entries.erase( it );
+							return session;
+						}
+						shard.entries.splice( shard.entries.begin( ), shard.entries, it );
+						SSL_SESSION_up_ref( session );
+						return session;
+					}
+
+					void TlsSessionCache::erase( std::string const &key ) {
+						auto &shard = get_shard( key );
+						std::lock_guard<std::mutex> lock( shard.mutex );
+
+						auto pos = shard.index.find( key );
+						if( pos != shard.index.end( ) ) {
+							shard.erase( pos->second );
+						}
+					}
+
+					size_t TlsSessionCache::size( ) const {
+						size_t result = 0;
+						for( size_t n = 0; n < m_shard_count; ++n ) {
+							std::lock_guard<std::mutex> lock( m_shards[n].mutex );
+							result += m_shards[n].entries.size( );
+						}
+						return result;
+					}
+
+					TlsTicketKeys::TlsTicketKeys( std::chrono::seconds rotation )
+					  : m_rotation( rotation ) {}
+
+					TlsTicketKeys::key_t TlsTicketKeys::current( ) {
+						auto const now = std::chrono::steady_clock::now( );
+						std::lock_guard<std::mutex> lock( m_mutex );
+
+						if( m_keys.empty( ) or
+						    now - m_keys.front( ).created >= m_rotation ) {
+							auto key = key_t{};
+							key.created = now;
+							auto const fill = []( auto &bytes ) {
+								return RAND_bytes( bytes.data( ),
+								                   static_cast<int>( bytes.size( ) ) ) == 1;
+							};
+							if( !fill( key.name ) or !fill( key.aes_key ) or
+							    !fill( key.hmac_key ) ) {
+								throw std::runtime_error(
+								  "Could not create session ticket key" );
+							}
+							m_keys.push_front( key );
+							++m_rotations;
+						}
+						// Tickets issued under a key are accepted for one more period
+						while( m_keys.size( ) > 1 and
+						       now - m_keys.back( ).created >= 2 * m_rotation ) {
+							m_keys.pop_back( );
+						}
+						return m_keys.front( );
+					}
+
+					std::optional<std::pair<TlsTicketKeys::key_t, bool>>
+					TlsTicketKeys::find( unsigned char const *name ) {
+						auto const now = std::chrono::steady_clock::now( );
+						std::lock_guard<std::mutex> lock( m_mutex );
+
+						for( size_t n = 0; n < m_keys.size( ); ++n ) {
+							auto const &key = m_keys[n];
+							if( !std::equal( key.name.begin( ), key.name.end( ), name ) ) {
+								continue;
+							}
+							if( now - key.created >= 2 * m_rotation ) {
+								return std::nullopt;
+							}
+							return std::make_pair(
+							  key, n != 0 or now - key.created >= m_rotation );
+						}
+						return std::nullopt;
+					}
+
+					uint64_t TlsTicketKeys::rotations( ) const noexcept {
+						return m_rotations.load( std::memory_order_relaxed );
+					}
+
+					TlsSessionState::TlsSessionState(
+					  size_t cache_size, size_t cache_shards,
+					  std::chrono::seconds ticket_key_rotation ) {
+						if( cache_size > 0 ) {
+							cache.emplace( cache_size, cache_shards );
+						}
+						if( ticket_key_rotation.count( ) > 0 ) {
+							ticket_keys.emplace( ticket_key_rotation );
+						}
+					}
+
+					TlsSessionStats TlsSessionState::stats( ) const {
+						auto result = TlsSessionStats{};
+						result.handshakes = handshakes.load( std::memory_order_relaxed );
+						result.resumed = resumed.load( std::memory_order_relaxed );
+						result.cache_hits = cache_hits.load( std::memory_order_relaxed );
+						result.cache_misses =
+						  cache_misses.load( std::memory_order_relaxed );
+						result.cache_evictions =
+						  cache_evictions.load( std::memory_order_relaxed );
+						result.tickets_issued =
+						  tickets_issued.load( std::memory_order_relaxed );
+						if( cache ) {
+							result.cache_size = cache->size( );
+						}
+						if( ticket_keys ) {
+							result.ticket_key_rotations = ticket_keys->rotations( );
+						}
+						return result;
+					}
+
+					namespace {
+						// The state is owned by the SSL_CTX, OpenSSL frees it with the
+						// context
+						void free_state( void *, void *ptr, CRYPTO_EX_DATA *, int, long,
+						                 void * ) {
+							delete static_cast<std::shared_ptr<TlsSessionState> *>( ptr );
+						}
+
+						int state_index( ) noexcept {
+							static int const index = SSL_CTX_get_ex_new_index(
+							  0, nullptr, nullptr, nullptr, &free_state );
+							return index;
+						}
+
+						void free_peer( void *, void *ptr, CRYPTO_EX_DATA *, int, long,
+						                void * ) {
+							delete static_cast<std::string *>( ptr );
+						}
+
+						// Which server a client connection is for
+						int peer_index( ) noexcept {
+							static int const index = SSL_get_ex_new_index(
+							  0, nullptr, nullptr, nullptr, &free_peer );
+							return index;
+						}
+
+						TlsSessionState *get_state( SSL_CTX const *ctx ) noexcept {
+							auto *ptr = static_cast<std::shared_ptr<TlsSessionState> *>(
+							  SSL_CTX_get_ex_data( ctx, state_index( ) ) );
+							if( ptr == nullptr ) {
+								return nullptr;
+							}
+							return ptr->get( );
+						}
+
+						TlsSessionState *get_state( SSL const *ssl ) noexcept {
+							return get_state( SSL_get_SSL_CTX( ssl ) );
+						}
+
+						void set_state( SSL_CTX *ctx,
+						                std::shared_ptr<TlsSessionState> state ) {
+							delete static_cast<std::shared_ptr<TlsSessionState> *>(
+							  SSL_CTX_get_ex_data( ctx, state_index( ) ) );
+							SSL_CTX_set_ex_data(
+							  ctx, state_index( ),
+							  new std::shared_ptr<TlsSessionState>( daw::move( state ) ) );
+						}
+
+						std::string session_key( unsigned char const *id,
+						                         unsigned int size ) {
+							return std::string( reinterpret_cast<char const *>( id ), size );
+						}
+
+						int server_new_session( SSL *ssl, SSL_SESSION *session ) {
+							auto *state = get_state( ssl );
+							if( state == nullptr or !state->cache ) {
+								return 0;
+							}
+							try {
+								unsigned int size = 0;
+								auto const *id = SSL_SESSION_get_id( session, &size );
+								state->cache_evictions +=
+								  state->cache->insert( session_key( id, size ), session );
+								return 1;
+							} catch( ... ) { return 0; }
+						}
+
+						SSL_SESSION *server_get_session( SSL *ssl, unsigned char const *id,
+						                                 int size, int *copy ) {
+							*copy = 0;
+							auto *state = get_state( ssl );
+							if( state == nullptr or !state->cache ) {
+								return nullptr;
+							}
+							try {
+								auto *session = state->cache->find(
+								  session_key( id, static_cast<unsigned int>( size ) ) );
+								if( session == nullptr ) {
+									++state->cache_misses;
+								} else {
+									++state->cache_hits;
+								}
+								// find gave us a reference, OpenSSL takes it over
+								return session;
+							} catch( ... ) { return nullptr; }
+						}
+
+						void server_remove_session( SSL_CTX *ctx, SSL_SESSION *session ) {
+							auto *state = get_state( ctx );
+							if( state == nullptr or !state->cache ) {
+								return;
+							}
+							try {
+								unsigned int size = 0;
+								auto const *id = SSL_SESSION_get_id( session, &size );
+								state->cache->erase( session_key( id, size ) );
+							} catch( ... ) {}
+						}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+						using ticket_mac_t = EVP_MAC_CTX;
+
+						bool init_ticket_mac( EVP_MAC_CTX *mac,
+						                      TlsTicketKeys::key_t &key ) {
+							char digest[] = "SHA256";
+							OSSL_PARAM params[] = {
+							  OSSL_PARAM_construct_octet_string(
+							    OSSL_MAC_PARAM_KEY, key.hmac_key.data( ),
+							    key.hmac_key.size( ) ),
+							  OSSL_PARAM_construct_utf8_string( OSSL_MAC_PARAM_DIGEST, digest,
+							                                    0 ),
+							  OSSL_PARAM_construct_end( )};
+							return EVP_MAC_CTX_set_params( mac, params ) == 1;
+						}
+#else
+						using ticket_mac_t = HMAC_CTX;
+
+						bool init_ticket_mac( HMAC_CTX *mac, TlsTicketKeys::key_t &key ) {
+							return HMAC_Init_ex( mac, key.hmac_key.data( ),
+							                     static_cast<int>( key.hmac_key.size( ) ),
+							                     EVP_sha256( ), nullptr ) == 1;
+						}
+#endif
+
+						// Returns -1 on error, 0 to fall back to a full handshake, 1 to
+						// use the ticket and 2 to use it and issue a new one
+						int ticket_key_callback( SSL *ssl, unsigned char *key_name,
+						                         unsigned char *iv, EVP_CIPHER_CTX *cipher,
+						                         ticket_mac_t *mac, int encrypt ) {
+							auto *state = get_state( ssl );
+							if( state == nullptr or !state->ticket_keys ) {
+								return -1;
+							}
+							try {
+								if( encrypt == 1 ) {
+									auto key = state->ticket_keys->current( );
+									if( RAND_bytes( iv, EVP_MAX_IV_LENGTH ) != 1 ) {
+										return -1;
+									}
+									std::copy( key.name.begin( ), key.name.end( ), key_name );
+									if( EVP_EncryptInit_ex( cipher, EVP_aes_256_cbc( ), nullptr,
+									                        key.aes_key.data( ), iv ) != 1 or
+									    !init_ticket_mac( mac, key ) ) {
+										return -1;
+									}
+									++state->tickets_issued;
+									return 1;
+								}
+								auto found = state->ticket_keys->find( key_name );
+								if( !found ) {
+									return 0;
+								}
+								if( EVP_DecryptInit_ex( cipher, EVP_aes_256_cbc( ), nullptr,
+								                        found->first.aes_key.data( ),
+								                        iv ) != 1 or
+								    !init_ticket_mac( mac, found->first ) ) {
+									return -1;
+								}
+								// TLS 1.3 clients use a ticket once, and OpenSSL only sends
+								// a new one after a resumption when asked to renew
+								return found->second or SSL_version( ssl ) == TLS1_3_VERSION
+								         ? 2
+								         : 1;
+							} catch( ... ) { return -1; }
+						}
+
+						int client_new_session( SSL *ssl, SSL_SESSION *session ) {
+							auto *state = get_state( ssl );
+							auto const *peer = static_cast<std::string const *>(
+							  SSL_get_ex_data( ssl, peer_index( ) ) );
+							if( state == nullptr or !state->cache or peer == nullptr ) {
+								return 0;
+							}
+							try {
+								state->cache_evictions +=
+								  state->cache->insert( *peer, session );
+								return 1;
+							} catch( ... ) { return 0; }
+						}
+
+						bool is_ip_address( std::string const &host ) {
+							auto ec = base::ErrorCode( );
+							asio::ip::make_address( host, ec );
+							return !ec;
+						}
+					} // namespace
+
+					void enable_server_resumption( asio::ssl::context &ctx,
+					                               std::shared_ptr<TlsSessionState> state,
+					                               std::chrono::seconds timeout,
+					                               bool use_tickets ) {
+						auto *native = ctx.native_handle( );
+						auto const has_cache = static_cast<bool>( state->cache );
+						auto const has_keys = static_cast<bool>( state->ticket_keys );
+						set_state( native, daw::move( state ) );
+
+						static unsigned char const id_context[] = "daw::nodepp";
+						SSL_CTX_set_session_id_context( native, id_context,
+						                                sizeof( id_context ) - 1 );
+						SSL_CTX_set_timeout( native,
+						                     static_cast<long>( timeout.count( ) ) );
+
+						if( has_cache ) {
+							SSL_CTX_set_session_cache_mode(
+							  native, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL );
+							SSL_CTX_sess_set_new_cb( native, &server_new_session );
+							SSL_CTX_sess_set_get_cb( native, &server_get_session );
+							SSL_CTX_sess_set_remove_cb( native, &server_remove_session );
+						} else {
+							SSL_CTX_set_session_cache_mode( native, SSL_SESS_CACHE_OFF );
+						}
+
+						if( !use_tickets ) {
+							SSL_CTX_set_options( native, SSL_OP_NO_TICKET );
+						} else if( has_keys ) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+							SSL_CTX_set_tlsext_ticket_key_evp_cb( native,
+							                                      &ticket_key_callback );
+#else
+							SSL_CTX_set_tlsext_ticket_key_cb( native, &ticket_key_callback );
+#endif
+						}
+					}
+
+					void
+					enable_client_resumption( asio::ssl::context &ctx,
+					                          std::shared_ptr<TlsSessionState> state ) {
+						auto *native = ctx.native_handle( );
+						set_state( native, daw::move( state ) );
+						SSL_CTX_set_session_cache_mode(
+						  native,
+						  SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+						SSL_CTX_sess_set_new_cb( native, &client_new_session );
+					}
+
+					void tls_client_prepare( SSL *ssl, std::string const &host,
+					                         uint16_t port ) {
+						if( !host.empty( ) and !is_ip_address( host ) ) {
+							SSL_set_tlsext_host_name( ssl, host.c_str( ) );
+						}
+						auto *state = get_state( ssl );
+						if( state == nullptr or !state->cache ) {
+							return;
+						}
+						auto peer = host + ':' + std::to_string( port );
+						// TLS 1.3 tickets are meant to be used once, a new one arrives
+						// after each handshake
+						auto *session = state->cache->find( peer, true );
+						if( session == nullptr ) {
+							++state->cache_misses;
+						} else {
+							++state->cache_hits;
+							if( SSL_SESSION_get_protocol_version( session ) !=
+							    TLS1_3_VERSION ) {
+								SSL_SESSION_up_ref( session );
+								state->cache->insert( peer, session );
+							}
+							SSL_set_session( ssl, session );
+							SSL_SESSION_free( session );
+						}
+						delete static_cast<std::string *>(
+						  SSL_get_ex_data( ssl, peer_index( ) ) );
+						SSL_set_ex_data( ssl, peer_index( ),
+						                 new std::string( daw::move( peer ) ) );
+					}
+
+					void tls_record_handshake( SSL *ssl ) noexcept {
+						auto *state = get_state( ssl );
+						if( state == nullptr ) {
+							return;
+						}
+						++state->handshakes;
+						if( SSL_session_reused( ssl ) == 1 ) {
+							++state->resumed;
+						}
+					}
+				} // namespace nss_impl
+
+				TlsSessionStats tls_session_stats( asio::ssl::context &ctx ) {
+					auto *state = nss_impl::get_state( ctx.native_handle( ) );
+					if( state == nullptr ) {
+						return TlsSessionStats{};
+					}
+					return state->stats( );
+				}
+			} // namespace net
+		}   // namespace lib
+	}     // namespace nodepp
+} // namespace daw
@@ -0,0 +1,119 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <utility>
+
+#include <daw/daw_utility.h>
+
+#include "lib_net_tls_writer.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					size_t tls_record_sizer_t::record_size(
+					  clock_type::time_point now ) noexcept {
+						if( now - m_last_send > idle_timeout ) {
+							m_sent = 0;
+						}
+						if( m_sent < bulk_threshold ) {
+							return small_record_size;
+						}
+						return large_record_size;
+					}
+
+					void tls_record_sizer_t::sent( size_t bytes,
+					                               clock_type::time_point now ) noexcept {
+						m_sent += bytes;
+						m_last_send = now;
+					}
+
+					bool tls_write_queue_t::start( ) {
+						if( m_busy ) {
+							return false;
+						}
+						m_busy = true;
+						return true;
+					}
+
+					bool tls_write_queue_t::push_job( job_t job ) {
+						auto item = item_t{};
+						item.writes = 1;
+						item.job = daw::move( job );
+						m_items.push_back( daw::move( item ) );
+						return start( );
+					}
+
+					std::optional<tls_write_queue_t::job_t>
+					tls_write_queue_t::take_job( ) {
+						if( m_items.empty( ) or !m_items.front( ).job ) {
+							return std::nullopt;
+						}
+						auto job = daw::move( m_items.front( ).job );
+						m_items.pop_front( );
+						return job;
+					}
+
+					bool tls_write_queue_t::take_writes( ) {
+						if( m_items.empty( ) ) {
+							m_busy = false;
+							return false;
+						}
+						auto &item = m_items.front( );
+						m_writing = daw::move( item.data );
+						m_writing_count = item.writes;
+						m_items.pop_front( );
+						return true;
+					}
+
+					asio::const_buffer tls_write_queue_t::writing( ) const noexcept {
+						return asio::const_buffer( m_writing.data( ), m_writing.size( ) );
+					}
+
+					size_t tls_write_queue_t::record_size( ) {
+						return m_record_sizer.record_size(
+						  tls_record_sizer_t::clock_type::now( ) );
+					}
+
+					size_t tls_write_queue_t::finish_writes( size_t bytes_transferred ) {
+						m_record_sizer.sent( bytes_transferred,
+						                     tls_record_sizer_t::clock_type::now( ) );
+						m_writing.clear( );
+						return std::exchange( m_writing_count, 0U );
+					}
+
+					size_t tls_write_queue_t::clear( ) noexcept {
+						size_t result = 0;
+						for( auto const &item : m_items ) {
+							result += item.writes;
+						}
+						m_items.clear( );
+						m_busy = false;
+						return result;
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,194 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <asio/post.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+
+#include <daw/daw_exception.h>
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "lib_net_unix_socket.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace lib {
+			namespace net {
+				namespace nss_impl {
+					namespace {
+						struct unix_address_t {
+							sockaddr_un addr{};
+							socklen_t size = 0;
+							bool is_abstract = false;
+						};
+
+						unix_address_t make_address( std::string const &path ) {
+							auto result = unix_address_t{};
+							result.addr.sun_family = AF_UNIX;
+							daw::exception::precondition_check(
+							  !path.empty( ) and path.size( ) < sizeof( result.addr.sun_path ),
+							  "Unix socket path is empty or too long" );
+							std::memcpy( result.addr.sun_path, path.data( ), path.size( ) );
+							result.is_abstract = path.front( ) == '@';
+							if( result.is_abstract ) {
+								// The name is the bytes after a leading nul, not a string
+								result.addr.sun_path[0] = '\0';
+								result.size = static_cast<socklen_t>(
+								  offsetof( sockaddr_un, sun_path ) + path.size( ) );
+							} else {
+								result.size = static_cast<socklen_t>( sizeof( result.addr ) );
+							}
+							return result;
+						}
+
+						int open_unix_socket( ) {
+#if defined( __linux__ )
+							auto const fd =
+							  ::socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+#else
+							auto const fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+							if( fd >= 0 ) {
+								::fcntl( fd, F_SETFL, ::fcntl( fd, F_GETFL ) | O_NONBLOCK );
+								::fcntl( fd, F_SETFD, FD_CLOEXEC );
+							}
+#endif
+							if( fd < 0 ) {
+								throw std::system_error( errno, std::system_category( ),
+								                         "Could not open unix socket" );
+							}
+							return fd;
+						}
+
+						//////////////////////////////////////////////////////////////////////
+						/// @brief	Remove the socket file a server that is gone left at
+						///				path.  One that is still listening is in use and is
+						///				left alone
+						void remove_stale_socket( unix_address_t const &address,
+						                          std::string const &path ) {
+							struct stat st {};
+							if( ::stat( path.c_str( ), &st ) != 0 or
+							    !S_ISSOCK( st.st_mode ) ) {
+								return;
+							}
+							auto const fd = open_unix_socket( );
+							auto result = 0;
+							do {
+								result = ::connect(
+								  fd, reinterpret_cast<sockaddr const *>( &address.addr ),
+								  address.size );
+							} while( result != 0 and errno == EINTR );
+							auto const err = result == 0 ? 0 : errno;
+							::close( fd );
+							if( err == ECONNREFUSED ) {
+								::unlink( path.c_str( ) );
+							} else if( err == 0 or err == EAGAIN or err == EINPROGRESS ) {
+								// Accepting connections, or has a full backlog of them
+								throw std::system_error( EADDRINUSE, std::system_category( ),
+								                         "Unix socket in use at " + path );
+							}
+							// Anything else is left for bind to report
+						}
+					} // namespace
+
+					void listen_unix( asio::ip::tcp::acceptor &acceptor,
+					                  std::string const &path, int backlog ) {
+						auto const address = make_address( path );
+						if( !address.is_abstract ) {
+							remove_stale_socket( address, path );
+						}
+						auto const fd = open_unix_socket( );
+						if( ::bind( fd, reinterpret_cast<sockaddr const *>( &address.addr ),
+						            address.size ) != 0 or
+						    ::listen( fd, backlog ) != 0 ) {
+							auto const err = errno;
+							::close( fd );
+							throw std::system_error( err, std::system_category( ),
+							                         "Could not listen on " + path );
+						}
+						auto ec = base::ErrorCode( );
+						acceptor.assign( asio::ip::tcp::v4( ), fd, ec );
+						if( ec ) {
+							::close( fd );
+							throw std::system_error( ec );
+						}
+					}
+
+					void
+					connect_unix_async( asio::ip::tcp::socket &socket,
+					                    std::string const &path,
+					                    std::function<void( base::ErrorCode )> handler ) {
+						auto const address = make_address( path );
+						auto const fd = open_unix_socket( );
+						auto ec = base::ErrorCode( );
+						socket.assign( asio::ip::tcp::v4( ), fd, ec );
+						if( ec ) {
+							::close( fd );
+						}
+						// A local connect completes or fails at once, there is no
+						// handshake to wait for
+						while( !ec and
+						       ::connect( fd, reinterpret_cast<sockaddr const *>( &address.addr ),
+						                  address.size ) != 0 ) {
+							if( errno != EINTR ) {
+								ec = base::ErrorCode( errno, std::system_category( ) );
+							}
+						}
+						asio::post( base::ServiceHandle::get( ),
+						            [handler = daw::move( handler ), ec]( ) { handler( ec ); } );
+					}
+
+					std::optional<std::string> unix_address( int fd, bool peer ) {
+						auto addr = sockaddr_storage{};
+						auto size = static_cast<socklen_t>( sizeof( addr ) );
+						auto const ptr = reinterpret_cast<sockaddr *>( &addr );
+						if( ( peer ? ::getpeername( fd, ptr, &size )
+						           : ::getsockname( fd, ptr, &size ) ) != 0 or
+						    addr.ss_family != AF_UNIX ) {
+							return std::nullopt;
+						}
+						auto const &un = reinterpret_cast<sockaddr_un const &>( addr );
+						auto const offset =
+						  static_cast<socklen_t>( offsetof( sockaddr_un, sun_path ) );
+						if( size <= offset ) {
+							return std::string( "unix" );
+						}
+						auto const len = static_cast<size_t>( size - offset );
+						if( un.sun_path[0] == '\0' ) {
+							// Abstract names are length delimited and may hold nuls
+							return "unix:@" + std::string( un.sun_path + 1, len - 1 );
+						}
+						return "unix:" +
+						       std::string( un.sun_path, ::strnlen( un.sun_path, len ) );
+					}
+				} // namespace nss_impl
+			}   // namespace net
+		}     // namespace lib
+	}       // namespace nodepp
+} // namespace daw
@@ -0,0 +1,224 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Measures accept+close churn and the heap allocations each connection costs
+// the server:
+//
+//   bench_connection_churn_bin [clients] [connections] [port]
+//
+// Each client connects, waits for the server to close the connection and
+// repeats.  The server runs on one io thread and only the operator new calls
+// made on that thread are counted.  A warm up round fills the connection
+// slab, the measured round shows the steady state where the per connection
+// blocks are recycled
+
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "base_slab.h"
+#include "lib_net_server.h"
+#include "test_helpers.h"
+
+namespace {
+	thread_local size_t t_allocations = 0;
+
+	void *counted_alloc( size_t size, size_t align ) {
+		++t_allocations;
+		void *result = nullptr;
+		if( align <= alignof( std::max_align_t ) ) {
+			result = std::malloc( size == 0 ? 1 : size );
+		} else {
+			auto const rounded = ( size + align - 1 ) / align * align;
+			result = std::aligned_alloc( align, rounded == 0 ? align : rounded );
+		}
+		if( result == nullptr ) {
+			throw std::bad_alloc( );
+		}
+		return result;
+	}
+} // namespace
+
+void *operator new( size_t size ) {
+	return counted_alloc( size, 0 );
+}
+
+void *operator new[]( size_t size ) {
+	return counted_alloc( size, 0 );
+}
+
+void *operator new( size_t size, std::align_val_t align ) {
+	return counted_alloc( size, static_cast<size_t>( align ) );
+}
+
+void *operator new[]( size_t size, std::align_val_t align ) {
+	return counted_alloc( size, static_cast<size_t>( align ) );
+}
+
+void operator delete( void *ptr ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void *ptr, size_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr, size_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void *ptr, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void *ptr, size_t, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr, size_t, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+namespace {
+	using clock_type = std::chrono::steady_clock;
+
+	struct server_counters_t {
+		size_t allocations = 0;
+		daw::nodepp::base::slab_stats_t slab{};
+	};
+
+	// Read the counters of the io thread from the io thread
+	server_counters_t server_counters( ) {
+		auto result = std::promise<server_counters_t>( );
+		auto fut = result.get_future( );
+		daw::nodepp::base::ServiceHandle::get( ).post( [&result]( ) {
+			result.set_value(
+			  server_counters_t{t_allocations, daw::nodepp::base::slab_stats( )} );
+		} );
+		return fut.get( );
+	}
+
+	// Connections made, each one is closed by the server
+	size_t run_client( uint16_t port, size_t connections ) {
+		auto io = asio::io_context( );
+		auto const endpoint =
+		  asio::ip::tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+		size_t result = 0;
+		char buff[16];
+		for( size_t n = 0; n < connections; ++n ) {
+			auto socket = asio::ip::tcp::socket( io );
+			auto ec = daw::nodepp::base::ErrorCode( );
+			socket.connect( endpoint, ec );
+			if( ec ) {
+				continue;
+			}
+			while( !ec ) {
+				socket.read_some( asio::buffer( buff ), ec );
+			}
+			++result;
+		}
+		return result;
+	}
+
+	void run_round( std::string const &name, uint16_t port, size_t clients,
+	                size_t connections ) {
+		auto const before = server_counters( );
+		auto const start = clock_type::now( );
+		auto results = std::vector<std::future<size_t>>( );
+		for( size_t n = 0; n < clients; ++n ) {
+			results.push_back( std::async( std::launch::async, [=]( ) {
+				return run_client( port, connections / clients );
+			} ) );
+		}
+		size_t total = 0;
+		for( auto &result : results ) {
+			total += result.get( );
+		}
+		auto const elapsed =
+		  std::chrono::duration<double>( clock_type::now( ) - start ).count( );
+		auto const after = server_counters( );
+		auto const per_connection = []( size_t value, size_t count ) {
+			return count == 0 ? 0.0
+			                  : static_cast<double>( value ) /
+			                      static_cast<double>( count );
+		};
+
+		std::cout << name << ": connections: " << total
+		          << ", connections/s: " << static_cast<double>( total ) / elapsed
+		          << ", allocations/connection: "
+		          << per_connection( after.allocations - before.allocations,
+		                             total )
+		          << ", slab blocks/connection: "
+		          << per_connection(
+		               after.slab.allocations - before.slab.allocations, total )
+		          << ", recycled: "
+		          << per_connection( after.slab.reuses - before.slab.reuses,
+		                             total )
+		          << ", slab chunks: " << after.slab.chunks << '\n';
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using namespace daw::nodepp::lib::net;
+
+	auto const clients =
+	  static_cast<size_t>( argc > 1 ? std::stoul( argv[1] ) : 4U );
+	auto const connections =
+	  static_cast<size_t>( argc > 2 ? std::stoul( argv[2] ) : 20000U );
+	auto const port =
+	  static_cast<uint16_t>( argc > 3 ? std::stoul( argv[3] ) : 8090U );
+
+	auto server = NetServer( );
+	server.on_error( []( base::Error error ) {
+		std::cerr << "Error: " << error << '\n';
+	} );
+	server.on_connection( []( NetServerSocket socket ) { socket.close( ); } );
+	server.listen( port, ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+
+	run_round( "warm up", port, clients, connections / 10 );
+	run_round( "churn", port, clients, connections );
+
+	io_thread.stop( );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compares the io backends.  Build once with NODEPP_USE_IO_URING=OFF and once
+// with it ON, then run each build in both modes:
+//
+//   bench_io_backend_bin static [connections] [requests] [port] [runs]
+//   bench_io_backend_bin web [connections] [requests] [port] [runs]
+//
+// The web mode serves the /teapot service of test_web_service_bin.  To see
+// the cost of the atomics on the hot path, build it with
+// NODEPP_SINGLE_THREADED=ON and OFF and compare the median throughput:
+//
+//   cmake -S . -B build-mt -DCMAKE_BUILD_TYPE=Release
+//   cmake -S . -B build-st -DCMAKE_BUILD_TYPE=Release \
+//     -DNODEPP_SINGLE_THREADED=ON
+//   cmake --build build-mt --target bench_io_backend_bin
+//   cmake --build build-st --target bench_io_backend_bin
+//   build-mt/bench_io_backend_bin web 8 20000 8089 7
+//   build-st/bench_io_backend_bin web 8 20000 8089 7
+//
+// Each run sends all the requests again to the same server.  The spread
+// between runs shows whether a difference between builds is noise.
+//
+// The server runs on one io thread so that its read/write class syscalls can
+// be read from /proc/thread-self/io.  io_uring submissions go through
+// io_uring_enter and are not in those counters; for a full count run the
+// benchmark under strace -c -f or perf stat -e 'syscalls:sys_enter_*'
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "base_threading.h"
+#include "lib_http_request.h"
+#include "lib_http_site.h"
+#include "lib_http_static_service.h"
+#include "lib_http_webservice.h"
+#include "test_helpers.h"
+
+namespace {
+	struct io_counters_t {
+		uint64_t syscr = 0;
+		uint64_t syscw = 0;
+		bool valid = false;
+	};
+
+	io_counters_t current_thread_io( ) {
+		auto result = io_counters_t{};
+		std::ifstream proc_io( "/proc/thread-self/io" );
+		std::string name{};
+		uint64_t value = 0;
+		while( proc_io >> name >> value ) {
+			if( name == "syscr:" ) {
+				result.syscr = value;
+				result.valid = true;
+			} else if( name == "syscw:" ) {
+				result.syscw = value;
+			}
+		}
+		return result;
+	}
+
+	// Read the counters of the io thread from the io thread
+	io_counters_t server_io( ) {
+		auto result = std::promise<io_counters_t>( );
+		auto fut = result.get_future( );
+		daw::nodepp::base::ServiceHandle::get( ).post(
+		  [&result]( ) { result.set_value( current_thread_io( ) ); } );
+		return fut.get( );
+	}
+
+	// One request per connection as the services close after responding
+	size_t run_client( uint16_t port, std::string const &request,
+	                   size_t requests ) {
+		auto io = asio::io_context( );
+		auto const endpoint = asio::ip::tcp::endpoint(
+		  asio::ip::address_v4::loopback( ), port );
+		size_t good = 0;
+		std::vector<char> response( 64U * 1024U );
+		for( size_t n = 0; n < requests; ++n ) {
+			auto socket = asio::ip::tcp::socket( io );
+			auto ec = daw::nodepp::base::ErrorCode( );
+			socket.connect( endpoint, ec );
+			if( ec ) {
+				continue;
+			}
+			asio::write( socket, asio::buffer( request ), ec );
+			size_t total = 0;
+			bool is_ok = false;
+			while( !ec ) {
+				auto const count = socket.read_some( asio::buffer( response ), ec );
+				if( total == 0 and count >= 12 ) {
+					auto const status = std::string( response.data( ) + 9, 3 );
+					is_ok = status == "200" or status == "418";
+				}
+				total += count;
+			}
+			if( is_ok ) {
+				++good;
+			}
+		}
+		return good;
+	}
+
+	struct run_result_t {
+		size_t good = 0;
+		double seconds = 0.0;
+
+		double throughput( ) const {
+			return static_cast<double>( good ) / seconds;
+		}
+	};
+
+	run_result_t run_clients( uint16_t port, std::string const &request,
+	                          size_t connections, size_t requests ) {
+		auto const start = std::chrono::steady_clock::now( );
+		auto clients = std::vector<std::future<size_t>>( );
+		for( size_t n = 0; n < connections; ++n ) {
+			clients.push_back( std::async( std::launch::async, [&]( ) {
+				return run_client( port, request, requests / connections );
+			} ) );
+		}
+		auto result = run_result_t{};
+		for( auto &client : clients ) {
+			result.good += client.get( );
+		}
+		result.seconds = std::chrono::duration<double>(
+		                   std::chrono::steady_clock::now( ) - start )
+		                   .count( );
+		return result;
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using namespace daw::nodepp::lib::net;
+	using namespace daw::nodepp::lib::http;
+
+	auto const mode = std::string( argc > 1 ? argv[1] : "static" );
+	auto const connections =
+	  static_cast<size_t>( argc > 2 ? std::stoul( argv[2] ) : 8U );
+	auto const requests =
+	  static_cast<size_t>( argc > 3 ? std::stoul( argv[3] ) : 20000U );
+	auto const port =
+	  static_cast<uint16_t>( argc > 4 ? std::stoul( argv[4] ) : 8089U );
+	auto const runs =
+	  static_cast<size_t>( argc > 5 ? std::stoul( argv[5] ) : 1U );
+
+	if( ( mode != "static" and mode != "web" ) or runs == 0 ) {
+		std::cerr << "Usage: " << argv[0]
+		          << " static|web [connections] [requests] [port] [runs]\n";
+		return EXIT_FAILURE;
+	}
+
+	auto const web_root = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( web_root );
+	{
+		std::ofstream index( ( web_root / "index.html" ).string( ),
+		                     std::ios::binary );
+		index << std::string( 16U * 1024U, 'a' );
+	}
+
+	auto site = HttpSite{};
+	site.on_error( []( base::Error error ) {
+		std::cerr << "Error: " << error << '\n';
+	} );
+
+	auto static_service = HttpStaticService( "/", web_root.string( ) );
+	auto web_service =
+	  HttpWebService<>( HttpClientRequestMethod::Get, "/teapot",
+	                    []( auto &&request, auto &&response ) {
+		                    Unused( request );
+		                    response.send_status( 418 )
+		                      .add_header( "Content-Type", "text/plain" )
+		                      .add_header( "Connection", "close" )
+		                      .end( "I'm a little teapot short and stout." )
+		                      .close_when_writes_completed( );
+	                    } );
+	if( mode == "static" ) {
+		static_service.connect( site );
+	} else {
+		web_service.connect( site );
+	}
+	site.listen_on( port, ip_version::ipv4 );
+
+	auto const request = "GET /" + std::string( mode == "web" ? "teapot" : "" ) +
+	                     " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+	auto server = test::io_thread_t( );
+
+	auto const io_before = server_io( );
+	auto results = std::vector<run_result_t>( );
+	size_t good = 0;
+	for( size_t n = 0; n < runs; ++n ) {
+		results.push_back( run_clients( port, request, connections, requests ) );
+		good += results.back( ).good;
+	}
+	auto const io_after = server_io( );
+
+	server.stop( );
+	boost::filesystem::remove_all( web_root );
+
+	auto const backend = base::ServiceHandle::backend( ) ==
+	                         base::IoBackend::io_uring
+	                       ? "io_uring"
+	                       : "reactor";
+
+	std::cout << "backend: " << backend << ", threading: "
+	          << ( base::is_single_threaded ? "single" : "multi" ) << '\n';
+	std::cout << "mode: " << mode << ", connections: " << connections
+	          << ", requests: " << good << '\n';
+	for( auto const &result : results ) {
+		std::cout << "throughput: " << result.throughput( ) << " requests/s\n";
+	}
+	if( results.size( ) > 1 ) {
+		std::sort( results.begin( ), results.end( ),
+		           []( run_result_t const &lhs, run_result_t const &rhs ) {
+			           return lhs.throughput( ) < rhs.throughput( );
+		           } );
+		std::cout << "median throughput: "
+		          << results[results.size( ) / 2U].throughput( )
+		          << " requests/s\n";
+	}
+	if( io_before.valid and good > 0 ) {
+		auto const per_request = []( uint64_t before, uint64_t after,
+		                             size_t count ) {
+			return static_cast<double>( after - before ) /
+			       static_cast<double>( count );
+		};
+		std::cout << "server read syscalls/request: "
+		          << per_request( io_before.syscr, io_after.syscr, good ) << '\n';
+		std::cout << "server write syscalls/request: "
+		          << per_request( io_before.syscw, io_after.syscw, good ) << '\n';
+	}
+	return good > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
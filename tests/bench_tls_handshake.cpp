@@ -0,0 +1,233 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Measures how a flood of new TLS connections delays the traffic on
+// connections that are already established:
+//
+//   bench_tls_handshake_bin [handshake_threads] [established] [flooders]
+//                           [seconds] [port]
+//
+// The server runs on one io thread.  Established clients send a line and
+// wait for the reply, the round trip times are reported first without and
+// then with flooders making full handshakes in a loop.  Run with 0
+// handshake threads to handshake on the io thread, then with 1 or more to
+// use the handshake pool and compare the p99
+
+#include <algorithm>
+#include <asio/ssl.hpp>
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "test_certificate.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using clock_type = std::chrono::steady_clock;
+
+	using tls_stream_t = asio::ssl::stream<asio::ip::tcp::socket>;
+
+	// Round trip times, in microseconds, of one established connection
+	std::vector<double> run_established( uint16_t port,
+	                                     std::atomic<bool> const &running ) {
+		auto io = asio::io_context( );
+		auto ctx = asio::ssl::context( asio::ssl::context::tlsv12_client );
+		auto stream = tls_stream_t( io, ctx );
+		stream.next_layer( ).connect( asio::ip::tcp::endpoint(
+		  asio::ip::address_v4::loopback( ), port ) );
+		stream.next_layer( ).set_option( asio::ip::tcp::no_delay( true ) );
+		stream.handshake( tls_stream_t::client );
+
+		auto result = std::vector<double>( );
+		auto reply = asio::streambuf( );
+		while( running ) {
+			auto const start = clock_type::now( );
+			asio::write( stream, asio::buffer( "ping\n", 5 ) );
+			auto const count = asio::read_until( stream, reply, '\n' );
+			reply.consume( count );
+			result.push_back( std::chrono::duration<double, std::micro>(
+			                    clock_type::now( ) - start )
+			                    .count( ) );
+		}
+		return result;
+	}
+
+	// Full handshakes made until running is cleared
+	size_t run_flood( uint16_t port, std::atomic<bool> const &running ) {
+		auto ctx = asio::ssl::context( asio::ssl::context::tlsv12_client );
+		size_t handshakes = 0;
+		while( running ) {
+			auto io = asio::io_context( );
+			auto stream = tls_stream_t( io, ctx );
+			auto ec = daw::nodepp::base::ErrorCode( );
+			stream.next_layer( ).connect(
+			  asio::ip::tcp::endpoint( asio::ip::address_v4::loopback( ), port ),
+			  ec );
+			if( ec ) {
+				continue;
+			}
+			stream.handshake( tls_stream_t::client, ec );
+			if( !ec ) {
+				++handshakes;
+			}
+		}
+		return handshakes;
+	}
+
+	struct phase_result_t {
+		std::vector<double> round_trips{};
+		size_t handshakes = 0;
+	};
+
+	phase_result_t run_phase( uint16_t port, size_t established,
+	                          size_t flooders, std::chrono::seconds duration ) {
+		auto running = std::atomic<bool>( true );
+		auto clients = std::vector<std::future<std::vector<double>>>( );
+		for( size_t n = 0; n < established; ++n ) {
+			clients.push_back( std::async( std::launch::async, [&]( ) {
+				return run_established( port, running );
+			} ) );
+		}
+		auto floods = std::vector<std::future<size_t>>( );
+		for( size_t n = 0; n < flooders; ++n ) {
+			floods.push_back( std::async( std::launch::async, [&]( ) {
+				return run_flood( port, running );
+			} ) );
+		}
+		std::this_thread::sleep_for( duration );
+		running = false;
+
+		auto result = phase_result_t{};
+		for( auto &client : clients ) {
+			auto times = client.get( );
+			result.round_trips.insert( result.round_trips.end( ), times.begin( ),
+			                           times.end( ) );
+		}
+		for( auto &flood : floods ) {
+			result.handshakes += flood.get( );
+		}
+		std::sort( result.round_trips.begin( ), result.round_trips.end( ) );
+		return result;
+	}
+
+	double percentile( std::vector<double> const &sorted, double p ) {
+		if( sorted.empty( ) ) {
+			return 0.0;
+		}
+		auto const pos = static_cast<size_t>(
+		  p * static_cast<double>( sorted.size( ) - 1 ) + 0.5 );
+		return sorted[pos];
+	}
+
+	void report( std::string const &name, phase_result_t const &result,
+	             std::chrono::seconds duration ) {
+		std::cout << name << ": round trips: " << result.round_trips.size( )
+		          << ", p50: " << percentile( result.round_trips, 0.50 )
+		          << "us, p99: " << percentile( result.round_trips, 0.99 )
+		          << "us, max: " << percentile( result.round_trips, 1.0 ) << "us";
+		if( result.handshakes > 0 ) {
+			std::cout << ", handshakes/s: "
+			          << static_cast<double>( result.handshakes ) /
+			               static_cast<double>( duration.count( ) );
+		}
+		std::cout << '\n';
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using namespace daw::nodepp::lib::net;
+
+	auto const handshake_threads =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 0U );
+	auto const established =
+	  static_cast<size_t>( argc > 2 ? std::stoul( argv[2] ) : 4U );
+	auto const flooders =
+	  static_cast<size_t>( argc > 3 ? std::stoul( argv[3] ) : 8U );
+	auto const duration =
+	  std::chrono::seconds( argc > 4 ? std::stoul( argv[4] ) : 5U );
+	auto const port =
+	  static_cast<uint16_t>( argc > 5 ? std::stoul( argv[5] ) : 8443U );
+
+	auto const cert_dir = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( cert_dir );
+	auto config = SslServerConfig{};
+	config.tls_certificate_chain_file = ( cert_dir / "cert.pem" ).string( );
+	config.tls_private_key_file = ( cert_dir / "key.pem" ).string( );
+	config.tls_session_tickets = false;
+	config.tls_session_cache_size = 0U;
+	config.tls_handshake_threads = handshake_threads;
+	// RSA so that the handshakes pay for a private key operation
+	if( !test::write_certificate( config.tls_certificate_chain_file,
+	                              config.tls_private_key_file ) ) {
+		std::cerr << "Could not create a certificate\n";
+		return EXIT_FAILURE;
+	}
+
+	auto server = NetServer( config );
+	server.on_error( []( base::Error error ) {
+		std::cerr << "Error: " << error << '\n';
+	} );
+	server.on_connection( []( NetServerSocket socket ) {
+		socket.set_no_delay( true );
+		socket.on_data_received(
+		  [socket = daw::mutable_capture( socket )](
+		    std::shared_ptr<base::data_t> buffer, bool eof ) {
+			  if( eof or !buffer ) {
+				  return;
+			  }
+			  socket->write_async( "pong\n" );
+			  socket->read_async( );
+		  } );
+		socket.read_async( );
+	} );
+	server.listen( port, ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+
+	auto const quiet = run_phase( port, established, 0, duration );
+	auto const flood = run_phase( port, established, flooders, duration );
+
+	io_thread.stop( );
+	boost::filesystem::remove_all( cert_dir );
+
+	std::cout << "handshake threads: " << handshake_threads
+	          << ", established: " << established << ", flooders: " << flooders
+	          << '\n';
+	report( "quiet", quiet, duration );
+	report( "flood", flood, duration );
+	return quiet.round_trips.empty( ) or flood.round_trips.empty( )
+	         ? EXIT_FAILURE
+	         : EXIT_SUCCESS;
+}
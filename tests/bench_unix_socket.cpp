@@ -0,0 +1,171 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compares request latency over a unix domain socket with TCP loopback:
+//
+//   bench_unix_socket_bin [requests] [port] [path]
+//
+// Two HttpSites serve the same /teapot service, one on TCP loopback and one
+// on a unix domain socket, like the hop from a reverse proxy on the same
+// host.  A single client connects, sends one request and reads the response
+// until the server closes, one request at a time, so the figures are the
+// latency of a whole exchange rather than throughput.  A path starting with
+// '@' uses the abstract namespace
+
+#include <algorithm>
+#include <asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_http_request.h"
+#include "lib_http_site.h"
+#include "lib_http_webservice.h"
+#include "test_helpers.h"
+
+namespace {
+	using clock_type = std::chrono::steady_clock;
+
+	std::string const request =
+	  "GET /teapot HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+	// Latency of each good exchange in microseconds
+	template<typename Protocol>
+	std::vector<double> run_client( typename Protocol::endpoint const &endpoint,
+	                                size_t requests ) {
+		auto io = asio::io_context( );
+		auto result = std::vector<double>( );
+		result.reserve( requests );
+		std::vector<char> response( 4096U );
+		for( size_t n = 0; n < requests; ++n ) {
+			auto const start = clock_type::now( );
+			auto socket = typename Protocol::socket( io );
+			auto ec = daw::nodepp::base::ErrorCode( );
+			socket.connect( endpoint, ec );
+			if( ec ) {
+				continue;
+			}
+			asio::write( socket, asio::buffer( request ), ec );
+			size_t total = 0;
+			bool is_ok = false;
+			while( !ec ) {
+				auto const count = socket.read_some( asio::buffer( response ), ec );
+				if( total == 0 and count >= 12 ) {
+					is_ok = std::string( response.data( ) + 9, 3 ) == "418";
+				}
+				total += count;
+			}
+			if( is_ok ) {
+				result.push_back( std::chrono::duration<double, std::micro>(
+				                    clock_type::now( ) - start )
+				                    .count( ) );
+			}
+		}
+		return result;
+	}
+
+	void report( std::string const &name, std::vector<double> latencies ) {
+		if( latencies.empty( ) ) {
+			std::cout << name << ": no successful requests\n";
+			return;
+		}
+		std::sort( latencies.begin( ), latencies.end( ) );
+		auto const at = [&latencies]( double fraction ) {
+			auto const index = static_cast<size_t>(
+			  fraction * static_cast<double>( latencies.size( ) - 1 ) );
+			return latencies[index];
+		};
+		auto total = 0.0;
+		for( auto latency : latencies ) {
+			total += latency;
+		}
+		std::cout << name << ": requests: " << latencies.size( )
+		          << ", mean: " << total / static_cast<double>( latencies.size( ) )
+		          << "us, p50: " << at( 0.5 ) << "us, p99: " << at( 0.99 )
+		          << "us, max: " << latencies.back( ) << "us\n";
+	}
+
+	asio::local::stream_protocol::endpoint local_endpoint( std::string path ) {
+		if( !path.empty( ) and path.front( ) == '@' ) {
+			path.front( ) = '\0';
+		}
+		return asio::local::stream_protocol::endpoint( path );
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using namespace daw::nodepp::lib::net;
+	using namespace daw::nodepp::lib::http;
+
+	auto const requests =
+	  static_cast<size_t>( argc > 1 ? std::stoul( argv[1] ) : 20000U );
+	auto const port =
+	  static_cast<uint16_t>( argc > 2 ? std::stoul( argv[2] ) : 8094U );
+	auto const path =
+	  std::string( argc > 3 ? argv[3] : "@nodepp_bench_unix_socket" );
+
+	auto web_service =
+	  HttpWebService<>( HttpClientRequestMethod::Get, "/teapot",
+	                    []( auto &&req, auto &&response ) {
+		                    Unused( req );
+		                    response.send_status( 418 )
+		                      .add_header( "Content-Type", "text/plain" )
+		                      .add_header( "Connection", "close" )
+		                      .end( "I'm a little teapot short and stout." )
+		                      .close_when_writes_completed( );
+	                    } );
+	auto const on_error = []( base::Error error ) {
+		std::cerr << "Error: " << error << '\n';
+	};
+
+	auto tcp_site = HttpSite{};
+	tcp_site.on_error( on_error );
+	web_service.connect( tcp_site );
+	tcp_site.listen_on( port, ip_version::ipv4 );
+
+	auto unix_site = HttpSite{};
+	unix_site.on_error( on_error );
+	web_service.connect( unix_site );
+	unix_site.listen_on( UnixEndPoint( path ) );
+
+	auto server = test::io_thread_t( );
+
+	auto const tcp_endpoint =
+	  asio::ip::tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+	auto const unix_endpoint = local_endpoint( path );
+
+	// Warm up both before measuring either
+	run_client<asio::ip::tcp>( tcp_endpoint, requests / 10 );
+	run_client<asio::local::stream_protocol>( unix_endpoint, requests / 10 );
+
+	report( "tcp loopback", run_client<asio::ip::tcp>( tcp_endpoint, requests ) );
+	report( "unix socket", run_client<asio::local::stream_protocol>(
+	                         unix_endpoint, requests ) );
+
+	server.stop( );
+	return EXIT_SUCCESS;
+}
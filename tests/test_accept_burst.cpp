@@ -0,0 +1,123 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks accepting a burst of queued connections.  Clients connect while the
+// io service is not running, so all of them wait in the listen backlog.
+// A server with several pending accepts that drains the backlog must take
+// every one of them.  The rate is printed next to a server with a single
+// pending accept that goes back to the reactor after each connection
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using daw::nodepp::lib::net::AcceptOptions;
+	using daw::nodepp::lib::net::NetServer;
+	using daw::nodepp::lib::net::NetServerSocket;
+	using daw::nodepp::test::check;
+	using daw::nodepp::test::on_io_thread;
+	using tcp = asio::ip::tcp;
+
+	constexpr size_t burst_size = 500U;
+
+	struct burst_result_t {
+		size_t accepted = 0;
+		std::chrono::duration<double> elapsed{};
+	};
+
+	burst_result_t accept_burst( uint16_t port, AcceptOptions options ) {
+		using namespace daw::nodepp;
+		// Shared with the handler, which outlives this call
+		auto accepted = std::make_shared<size_t>( 0U );
+		auto server = NetServer( );
+		server.set_accept_options( options );
+		server.on_error( []( base::Error const &err ) {
+			std::cerr << "Error: " << err << '\n';
+		} );
+		server.on_connection( [accepted]( NetServerSocket ) { ++*accepted; } );
+		server.listen( port, lib::net::ip_version::ipv4,
+		               static_cast<uint16_t>( burst_size ) );
+
+		auto io = asio::io_context( );
+		auto clients = std::vector<tcp::socket>( );
+		clients.reserve( burst_size );
+		auto const endpoint =
+		  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+		for( size_t n = 0; n < burst_size; ++n ) {
+			clients.emplace_back( io );
+			clients.back( ).connect( endpoint );
+		}
+
+		auto result = burst_result_t{};
+		auto const start = std::chrono::steady_clock::now( );
+		auto io_thread = test::io_thread_t( );
+		auto const deadline = start + 5s;
+		while( ( result.accepted = on_io_thread( [&]( ) { return *accepted; } ) ) <
+		         burst_size and
+		       std::chrono::steady_clock::now( ) < deadline ) {
+			std::this_thread::yield( );
+		}
+		result.elapsed = std::chrono::steady_clock::now( ) - start;
+		io_thread.stop( );
+		base::ServiceHandle::reset( );
+		return result;
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8101U );
+
+	auto const single = accept_burst( port, AcceptOptions{} );
+
+	auto drain_options = AcceptOptions{};
+	drain_options.pending_accepts = 4U;
+	drain_options.drain_backlog = true;
+	auto const drain = accept_burst( static_cast<uint16_t>( port + 1U ),
+	                                 drain_options );
+
+	auto ok = check( single.accepted == burst_size,
+	                 "single pending accept took the whole burst" );
+	ok &= check( drain.accepted == burst_size,
+	             "draining accepts took the whole burst" );
+
+	auto const report = []( char const *name, burst_result_t const &r ) {
+		std::cout << name << ": " << r.accepted << " connections in "
+		          << r.elapsed.count( ) * 1000.0 << "ms, "
+		          << static_cast<double>( r.accepted ) / r.elapsed.count( )
+		          << " per second\n";
+	};
+	report( "single pending accept", single );
+	report( "4 pending accepts, drain backlog", drain );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
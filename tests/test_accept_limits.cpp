@@ -0,0 +1,206 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Checks the overload protection of the acceptor.  A server limited to two
+// connections must answer a third with its overload response and take new
+// ones once the first two are gone.  With the descriptor limit lowered so
+// accept fails, queued clients must be closed instead of left waiting and
+// the server must accept again once descriptors are available
+
+#include <asio.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using daw::nodepp::lib::net::AcceptStats;
+	using daw::nodepp::lib::net::NetServer;
+	using daw::nodepp::lib::net::NetServerSocket;
+	using tcp = asio::ip::tcp;
+
+	// Everything received until the peer closes, a newline or a timeout
+	std::string read_line( tcp::socket &socket ) {
+		auto const fd = socket.native_handle( );
+		auto const timeout = timeval{5, 0};
+		::setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+		auto result = std::string( );
+		char c = 0;
+		while( ::recv( fd, &c, 1, 0 ) == 1 ) {
+			result.push_back( c );
+			if( c == '\n' ) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	// Has the peer closed the connection, rather than left it waiting
+	bool is_closed( tcp::socket &socket ) {
+		auto const fd = socket.native_handle( );
+		auto const timeout = timeval{5, 0};
+		::setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+		char c = 0;
+		auto const count = ::recv( fd, &c, 1, 0 );
+		return count == 0 or ( count < 0 and errno == ECONNRESET );
+	}
+
+	using daw::nodepp::test::on_io_thread;
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8093U );
+	auto const endpoint =
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+
+	// Connections the server keeps open, only touched on the io thread
+	auto open_connections = std::vector<NetServerSocket>( );
+	size_t descriptor_errors = 0;
+
+	auto options = lib::net::AcceptOptions{};
+	options.max_connections = 2U;
+	options.overload_response = "busy\n";
+	options.max_accept_backoff = 100U;
+
+	auto server = NetServer( );
+	server.set_accept_options( options );
+	server.on_error( [&]( base::Error const & ) { ++descriptor_errors; } );
+	server.on_connection( [&]( NetServerSocket socket ) {
+		socket.write_async( "hi\n" );
+		open_connections.push_back( daw::move( socket ) );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+	auto const stats = [&]( ) {
+		return on_io_thread( [&]( ) { return server.accept_stats( ); } );
+	};
+
+	auto io = asio::io_context( );
+	auto ok = true;
+
+	// The limit
+	{
+		auto first = tcp::socket( io );
+		auto second = tcp::socket( io );
+		auto third = tcp::socket( io );
+		first.connect( endpoint );
+		ok &= check( read_line( first ) == "hi\n", "first connection" );
+		second.connect( endpoint );
+		ok &= check( read_line( second ) == "hi\n", "second connection" );
+		third.connect( endpoint );
+		ok &= check( read_line( third ) == "busy\n", "overload response" );
+		ok &= check( is_closed( third ), "refused connection closed" );
+
+		auto const limited = stats( );
+		ok &= check( limited.active_connections == 2, "two connections active" );
+		ok &= check( limited.shed_over_limit == 1, "one connection shed" );
+
+		on_io_thread( [&]( ) {
+			open_connections.clear( );
+			return true;
+		} );
+		for( int n = 0; n < 100 and stats( ).active_connections != 0; ++n ) {
+			std::this_thread::sleep_for( 10ms );
+		}
+		auto fourth = tcp::socket( io );
+		fourth.connect( endpoint );
+		ok &= check( read_line( fourth ) == "hi\n", "accepting after the limit" );
+		on_io_thread( [&]( ) {
+			open_connections.clear( );
+			return true;
+		} );
+	}
+
+	// Running out of descriptors
+	{
+		size_t const client_count = 4;
+		auto clients = std::vector<tcp::socket>( );
+		for( size_t n = 0; n < client_count; ++n ) {
+			clients.emplace_back( io ).open( tcp::v4( ) );
+		}
+		auto limits = rlimit{};
+		::getrlimit( RLIMIT_NOFILE, &limits );
+		auto const old_limit = limits.rlim_cur;
+		// The lowest free descriptor becomes the limit
+		auto const probe = ::dup( 0 );
+		::close( probe );
+		limits.rlim_cur = static_cast<rlim_t>( probe );
+		::setrlimit( RLIMIT_NOFILE, &limits );
+
+		auto closed = size_t( 0 );
+		for( auto &client : clients ) {
+			client.connect( endpoint );
+			if( is_closed( client ) ) {
+				++closed;
+			}
+		}
+		limits.rlim_cur = old_limit;
+		::setrlimit( RLIMIT_NOFILE, &limits );
+		ok &= check( closed == client_count, "queued clients closed" );
+
+		auto const exhausted = stats( );
+		ok &= check( exhausted.shed_no_descriptors == client_count,
+		             "clients shed with the spare descriptor" );
+		ok &= check( exhausted.accept_backoffs > 0, "accepting backed off" );
+
+		auto after = tcp::socket( io );
+		after.connect( endpoint );
+		ok &= check( read_line( after ) == "hi\n", "accepting after exhaustion" );
+	}
+
+	auto const final_stats = stats( );
+	auto const errors = on_io_thread( [&]( ) { return descriptor_errors; } );
+	std::cout << "active: " << final_stats.active_connections
+	          << ", shed over limit: " << final_stats.shed_over_limit
+	          << ", shed without descriptors: "
+	          << final_stats.shed_no_descriptors
+	          << ", backoffs: " << final_stats.accept_backoffs
+	          << ", descriptor errors: " << errors << '\n';
+
+	on_io_thread( [&]( ) {
+		open_connections.clear( );
+		return true;
+	} );
+	io_thread.stop( );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
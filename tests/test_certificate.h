@@ -0,0 +1,91 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// A self signed certificate for the tests that need a TLS server
+
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <string>
+
+namespace daw {
+	namespace nodepp {
+		namespace test {
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Write a self signed RSA certificate for localhost and its
+			///				key as PEM files
+			/// @return	false when either could not be created
+			inline bool write_certificate( std::string const &cert_file,
+			                               std::string const &key_file ) {
+				using key_ctx_t =
+				  std::unique_ptr<EVP_PKEY_CTX, decltype( &EVP_PKEY_CTX_free )>;
+				auto key_ctx = key_ctx_t( EVP_PKEY_CTX_new_id( EVP_PKEY_RSA, nullptr ),
+				                          &EVP_PKEY_CTX_free );
+				EVP_PKEY *raw_key = nullptr;
+				if( !key_ctx or EVP_PKEY_keygen_init( key_ctx.get( ) ) != 1 or
+				    EVP_PKEY_CTX_set_rsa_keygen_bits( key_ctx.get( ), 2048 ) != 1 or
+				    EVP_PKEY_keygen( key_ctx.get( ), &raw_key ) != 1 ) {
+					return false;
+				}
+				auto key = std::unique_ptr<EVP_PKEY, decltype( &EVP_PKEY_free )>(
+				  raw_key, &EVP_PKEY_free );
+				auto cert = std::unique_ptr<X509, decltype( &X509_free )>(
+				  X509_new( ), &X509_free );
+				X509_set_version( cert.get( ), 2 );
+				ASN1_INTEGER_set( X509_get_serialNumber( cert.get( ) ), 1 );
+				X509_gmtime_adj( X509_getm_notBefore( cert.get( ) ), 0 );
+				X509_gmtime_adj( X509_getm_notAfter( cert.get( ) ), 24L * 60L * 60L );
+				X509_set_pubkey( cert.get( ), key.get( ) );
+				auto *name = X509_get_subject_name( cert.get( ) );
+				X509_NAME_add_entry_by_txt(
+				  name, "CN", MBSTRING_ASC,
+				  reinterpret_cast<unsigned char const *>( "localhost" ), -1, -1, 0 );
+				X509_set_issuer_name( cert.get( ), name );
+				if( X509_sign( cert.get( ), key.get( ), EVP_sha256( ) ) == 0 ) {
+					return false;
+				}
+
+				auto const write_pem = []( std::string const &file, auto writer ) {
+					auto *bio = BIO_new_file( file.c_str( ), "w" );
+					if( bio == nullptr ) {
+						return false;
+					}
+					auto const result = writer( bio ) == 1;
+					BIO_free( bio );
+					return result;
+				};
+				return write_pem( cert_file,
+				                  [&]( BIO *bio ) {
+					                  return PEM_write_bio_X509( bio, cert.get( ) );
+				                  } ) and
+				       write_pem( key_file, [&]( BIO *bio ) {
+					       return PEM_write_bio_PrivateKey( bio, key.get( ), nullptr,
+					                                        nullptr, 0, nullptr, nullptr );
+				       } );
+			}
+		} // namespace test
+	}   // namespace nodepp
+} // namespace daw
@@ -0,0 +1,120 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks batched datagram sockets over loopback.  A client queues a burst of
+// datagrams, with segmentation offload on, to an echo server receiving with
+// GRO.  Every datagram comes back intact and separate, and the burst goes
+// out in fewer system calls than datagrams
+
+#include <asio.hpp>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "base_service_handle.h"
+#include "lib_net_datagram_socket.h"
+#include "test_helpers.h"
+
+namespace {
+	constexpr size_t datagram_count = 40U;
+	constexpr uint16_t datagram_size = 100U;
+
+	std::string make_datagram( size_t n ) {
+		// The last one is short, ending a segmented run early
+		auto const size = n + 1 == datagram_count ? datagram_size / 2U : datagram_size;
+		auto result = std::string( size, static_cast<char>( 'a' + n % 26U ) );
+		result.replace( 0, 3, std::to_string( 100U + n ) );
+		return result;
+	}
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( ) {
+	using namespace daw::nodepp;
+	using lib::net::Datagram;
+	using lib::net::DatagramOptions;
+	using lib::net::NetDatagramSocket;
+
+	auto server = NetDatagramSocket( );
+	auto client = NetDatagramSocket( );
+	auto errors = size_t( 0 );
+	auto replies = std::set<std::string>( );
+	auto done = std::promise<void>( );
+
+	auto server_options = DatagramOptions{};
+	server_options.gro = true;
+	server.set_options( server_options );
+	server.on_error( [&]( base::Error const &err ) {
+		std::cerr << err << '\n';
+		++errors;
+	} );
+	server.on_datagram( [&server]( Datagram const &dg ) {
+		server.send_to( dg.endpoint, dg.data );
+	} );
+	server.bind(
+	  asio::ip::udp::endpoint( asio::ip::make_address( "127.0.0.1" ), 0 ) );
+
+	auto client_options = DatagramOptions{};
+	client_options.gso_segment_size = datagram_size;
+	client.set_options( client_options );
+	client.on_error( [&]( base::Error const &err ) {
+		std::cerr << err << '\n';
+		++errors;
+	} );
+	client.on_datagram( [&]( Datagram const &dg ) {
+		replies.emplace( dg.data.data( ), dg.data.size( ) );
+		if( replies.size( ) == datagram_count ) {
+			done.set_value( );
+		}
+	} );
+
+	auto const target = server.local_endpoint( );
+	for( size_t n = 0; n < datagram_count; ++n ) {
+		client.send_to( target, make_datagram( n ) );
+	}
+
+	auto io_thread = test::io_thread_t( );
+	auto ok = check( done.get_future( ).wait_for( std::chrono::seconds( 5 ) ) ==
+	                   std::future_status::ready,
+	                 "all replies received" );
+	io_thread.stop( );
+
+	for( size_t n = 0; n < datagram_count and ok; ++n ) {
+		ok &= check( replies.count( make_datagram( n ) ) == 1, "reply intact" );
+	}
+	auto const client_stats = client.stats( );
+	auto const server_stats = server.stats( );
+	ok &= check( client_stats.sent == datagram_count, "client sent count" );
+	ok &= check( client_stats.send_calls < datagram_count, "client sends batched" );
+	ok &= check( server_stats.received == datagram_count, "server received count" );
+	ok &= check( server_stats.truncated == 0, "nothing truncated" );
+	ok &= check( errors == 0, "no errors" );
+
+	server.close( );
+	client.close( );
+	ok &= check( !server.is_open( ) and !client.is_open( ), "closed" );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
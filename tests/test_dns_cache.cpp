@@ -0,0 +1,170 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Checks the DNS cache against a local hosts file and the system resolver.
+// Names from the hosts file are answered without a lookup, requests for a
+// name already being looked up share the lookup, answers and failures are
+// reused until they expire and NetDns resolves through the cache
+
+#include <asio.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <daw/daw_utility.h>
+
+#include "base_service_handle.h"
+#include "lib_net_dns.h"
+#include "lib_net_dns_cache.h"
+#include "test_helpers.h"
+
+namespace {
+	using daw::nodepp::lib::net::DnsCache;
+	using tcp = asio::ip::tcp;
+
+	struct answer_t {
+		daw::nodepp::base::ErrorCode error{};
+		std::vector<tcp::endpoint> endpoints{};
+	};
+
+	void resolve( DnsCache &cache, std::string const &host, uint16_t port,
+	              std::vector<answer_t> &answers ) {
+		cache.async_resolve(
+		  host, port,
+		  [&answers]( daw::nodepp::base::ErrorCode err,
+		              DnsCache::results_t results ) {
+			  auto answer = answer_t{err, {}};
+			  for( auto const &entry : results ) {
+				  answer.endpoints.push_back( entry.endpoint( ) );
+			  }
+			  answers.push_back( daw::move( answer ) );
+		  } );
+	}
+
+	void run_io( ) {
+		daw::nodepp::base::ServiceHandle::reset( );
+		daw::nodepp::base::ServiceHandle::run( );
+	}
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( ) {
+	using namespace daw::nodepp;
+
+	auto const hosts_file = std::string( "test_dns_cache_hosts" );
+	{
+		auto file = std::ofstream( hosts_file );
+		file << "# stub entries\n"
+		     << "127.0.0.1 stub.nodepp.test alias.nodepp.test\n"
+		     << "::1 stub.nodepp.test # and over IPv6\n";
+	}
+	auto options = lib::net::DnsCacheOptions{};
+	options.hosts_file = hosts_file;
+	auto cache = std::make_shared<DnsCache>( options );
+	auto ok = true;
+
+	// The hosts file
+	{
+		auto answers = std::vector<answer_t>( );
+		resolve( *cache, "stub.nodepp.test", 80, answers );
+		resolve( *cache, "alias.nodepp.test", 81, answers );
+		ok &= check( answers.empty( ), "answered before async_resolve returned" );
+		run_io( );
+		ok &= check( answers.size( ) == 2, "hosts file answers" );
+		ok &= check( answers[0].endpoints.size( ) == 2, "both stub addresses" );
+		ok &= check( answers[0].endpoints[0] ==
+		               tcp::endpoint( asio::ip::make_address( "127.0.0.1" ), 80 ),
+		             "stub address and port" );
+		ok &= check( answers[1].endpoints.size( ) == 1 and
+		               answers[1].endpoints[0].port( ) == 81,
+		             "alias address and port" );
+		ok &= check( cache->stats( ).lookups == 0, "no lookup for the hosts file" );
+	}
+
+	// Coalescing and reuse
+	{
+		auto answers = std::vector<answer_t>( );
+		for( int n = 0; n < 3; ++n ) {
+			resolve( *cache, "localhost", 8080, answers );
+		}
+		run_io( );
+		ok &= check( answers.size( ) == 3, "every request answered" );
+		for( auto const &answer : answers ) {
+			ok &= check( !answer.error and !answer.endpoints.empty( ) and
+			               answer.endpoints.front( ).port( ) == 8080,
+			             "localhost resolved" );
+		}
+		auto const stats = cache->stats( );
+		ok &= check( stats.lookups == 1, "one lookup for concurrent requests" );
+		ok &= check( stats.coalesced == 2, "two requests coalesced" );
+
+		resolve( *cache, "localhost", 8080, answers );
+		run_io( );
+		ok &= check( cache->stats( ).lookups == 1, "answer reused" );
+	}
+
+	// Failures
+	{
+		auto answers = std::vector<answer_t>( );
+		resolve( *cache, "nodepp.invalid", 80, answers );
+		run_io( );
+		resolve( *cache, "nodepp.invalid", 80, answers );
+		run_io( );
+		ok &= check( answers.size( ) == 2 and answers[0].error and
+		               answers[1].error == answers[0].error,
+		             "failure repeated" );
+		ok &= check( cache->stats( ).negative_hits == 1, "failure reused" );
+
+		auto const lookups = cache->stats( ).lookups;
+		cache->clear( );
+		resolve( *cache, "nodepp.invalid", 80, answers );
+		run_io( );
+		ok &= check( cache->stats( ).lookups == lookups + 1,
+		             "looked up again after clear" );
+	}
+
+	// NetDns over the cache
+	{
+		auto port = uint16_t( 0 );
+		auto dns = lib::net::NetDns( cache );
+		dns.on_resolved(
+		  [&port]( lib::net::Resolver::iterator it ) { port = it->endpoint( ).port( ); } );
+		dns.resolve( "stub.nodepp.test", 443 );
+		run_io( );
+		ok &= check( port == 443, "NetDns resolved from the hosts file" );
+	}
+
+	auto const stats = cache->stats( );
+	std::cout << "hits: " << stats.hits << ", negative hits: "
+	          << stats.negative_hits << ", lookups: " << stats.lookups
+	          << ", coalesced: " << stats.coalesced << ", size: " << stats.size
+	          << '\n';
+	std::remove( hosts_file.c_str( ) );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
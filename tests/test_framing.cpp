@@ -0,0 +1,310 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks the framing read modes.  frame_matcher_t is fed fragmented input
+// the way asio::async_read_until does, for exact frames and u16, u32 and
+// varint length prefixes in both byte orders, including prefixes split over
+// reads, empty frames and frames over the maximum.  Then set_read_exact and
+// set_read_length_prefixed are used on a server's connections
+
+#include <asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "lib_net_socket_match.h"
+#include "test_helpers.h"
+
+namespace {
+	using daw::nodepp::lib::net::NetSocketStreamByteOrder;
+	using daw::nodepp::lib::net::NetSocketStreamFramePrefix;
+	using daw::nodepp::lib::net::nss_impl::frame_matcher_t;
+	using daw::nodepp::lib::net::nss_impl::match_iterator_t;
+	using tcp = asio::ip::tcp;
+
+	struct read_result_t {
+		std::vector<std::string> frames{};
+		/// A frame declared larger than the maximum was found
+		bool too_large = false;
+	};
+
+	// Follows what asio::async_read_until and handle_read do with a frame
+	// matcher.  The prefix is taken off each frame
+	read_result_t read_frames( std::vector<std::string> const &chunks,
+	                           frame_matcher_t const &matcher ) {
+		auto buff = asio::streambuf( );
+		auto out = std::ostream( &buff );
+		auto result = read_result_t{};
+		for( auto const &chunk : chunks ) {
+			out << chunk;
+			while( !result.too_large ) {
+				auto const data = buff.data( );
+				auto const first = match_iterator_t::begin( data );
+				auto const last = match_iterator_t::end( data );
+				auto const match = matcher( first, last );
+				if( !match.second ) {
+					break;
+				}
+				auto const size = static_cast<size_t>( match.first - first );
+				auto const frame = std::string( first, match.first );
+				auto const hdr =
+				  matcher.header( frame.data( ), frame.data( ) + frame.size( ) );
+				if( !hdr or hdr->payload_size > matcher.max_frame_size( ) ) {
+					result.too_large = true;
+					break;
+				}
+				result.frames.push_back( frame.substr( hdr->prefix_size ) );
+				buff.consume( size );
+			}
+		}
+		return result;
+	}
+
+	std::vector<std::string> split( std::string const &data, size_t size ) {
+		auto result = std::vector<std::string>( );
+		for( size_t pos = 0; pos < data.size( ); pos += size ) {
+			result.push_back( data.substr( pos, size ) );
+		}
+		return result;
+	}
+
+	std::string encode_fixed( uint64_t value, size_t size,
+	                          NetSocketStreamByteOrder order ) {
+		auto result = std::string( size, '\0' );
+		for( size_t n = 0; n < size; ++n ) {
+			auto const b = static_cast<char>( ( value >> ( 8U * n ) ) & 0xFFU );
+			if( order == NetSocketStreamByteOrder::little_endian ) {
+				result[n] = b;
+			} else {
+				result[size - 1 - n] = b;
+			}
+		}
+		return result;
+	}
+
+	std::string encode_varint( uint64_t value ) {
+		auto result = std::string( );
+		do {
+			auto b = static_cast<unsigned char>( value & 0x7FU );
+			value >>= 7U;
+			if( value != 0 ) {
+				b |= 0x80U;
+			}
+			result.push_back( static_cast<char>( b ) );
+		} while( value != 0 );
+		return result;
+	}
+
+	std::string prefixed( std::string const &payload,
+	                      NetSocketStreamFramePrefix prefix,
+	                      NetSocketStreamByteOrder order ) {
+		switch( prefix ) {
+		case NetSocketStreamFramePrefix::u16:
+			return encode_fixed( payload.size( ), 2, order ) + payload;
+		case NetSocketStreamFramePrefix::u32:
+			return encode_fixed( payload.size( ), 4, order ) + payload;
+		case NetSocketStreamFramePrefix::varint:
+			return encode_varint( payload.size( ) ) + payload;
+		case NetSocketStreamFramePrefix::none:
+			break;
+		}
+		return payload;
+	}
+
+	using daw::nodepp::test::check;
+
+	bool check_exact( ) {
+		auto const matcher = frame_matcher_t::exact( 4 );
+		auto ok = check( matcher.max_buffer_size( ) == 4, "exact buffer size" );
+		for( size_t chunk_size : {1U, 3U, 4U, 64U} ) {
+			auto const result = read_frames( split( "abcdefghij", chunk_size ), matcher );
+			ok &= check( result.frames == std::vector<std::string>{"abcd", "efgh"},
+			             "exact frames, chunks of " + std::to_string( chunk_size ) );
+		}
+		return ok;
+	}
+
+	bool check_prefixed( NetSocketStreamFramePrefix prefix,
+	                     NetSocketStreamByteOrder order, std::string const &name ) {
+		auto const payloads = std::vector<std::string>{
+		  "hello", "", std::string( 300, 'x' ), std::string( 1024, 'y' )};
+		auto const matcher = frame_matcher_t::length_prefixed( prefix, order, 1024 );
+		auto stream = std::string( );
+		for( auto const &payload : payloads ) {
+			stream += prefixed( payload, prefix, order );
+		}
+		auto ok = true;
+		// Chunks of one byte split every prefix
+		for( size_t chunk_size : {1U, 3U, 7U, 4096U} ) {
+			auto const result = read_frames( split( stream, chunk_size ), matcher );
+			ok &= check( result.frames == payloads and !result.too_large,
+			             name + " frames, chunks of " + std::to_string( chunk_size ) );
+		}
+		// Rejected as soon as the prefix is complete, before the payload arrives
+		auto const oversize = prefixed( std::string( 1025, 'z' ), prefix, order );
+		auto const prefix_only = oversize.substr( 0, oversize.size( ) - 1025 );
+		auto const result =
+		  read_frames( split( prefixed( "ok", prefix, order ) + prefix_only, 1 ),
+		               matcher );
+		ok &= check( result.frames == std::vector<std::string>{"ok"} and
+		               result.too_large,
+		             name + " frame over the maximum" );
+		return ok;
+	}
+
+	bool check_malformed_varint( ) {
+		auto const matcher = frame_matcher_t::length_prefixed(
+		  NetSocketStreamFramePrefix::varint, NetSocketStreamByteOrder::big_endian,
+		  1024 );
+		auto const bytes = std::string( 11, '\xFF' );
+		auto const hdr = matcher.header( bytes.data( ), bytes.data( ) + bytes.size( ) );
+		auto ok = check( hdr and hdr->payload_size > matcher.max_frame_size( ),
+		                 "varint over 64 bits rejected" );
+		auto const partial = std::string( 3, '\xFF' );
+		ok &= check( !matcher.header( partial.data( ),
+		                              partial.data( ) + partial.size( ) ),
+		             "partial varint waits for more" );
+		return ok;
+	}
+
+	// Everything received until the peer closes, a newline or a timeout
+	std::string read_line( tcp::socket &socket ) {
+		auto const fd = socket.native_handle( );
+		auto const timeout = timeval{5, 0};
+		::setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+		auto result = std::string( );
+		char c = 0;
+		while( ::recv( fd, &c, 1, 0 ) == 1 ) {
+			result.push_back( c );
+			if( c == '\n' ) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	void send_slowly( tcp::socket &socket, std::vector<std::string> const &parts ) {
+		for( auto const &part : parts ) {
+			asio::write( socket, asio::buffer( part ) );
+			std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+		}
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using lib::net::NetServer;
+	using lib::net::NetServerSocket;
+
+	auto ok = check_exact( );
+	for( auto order : {NetSocketStreamByteOrder::big_endian,
+	                   NetSocketStreamByteOrder::little_endian} ) {
+		auto const suffix =
+		  order == NetSocketStreamByteOrder::big_endian ? " big endian" : " little endian";
+		ok &= check_prefixed( NetSocketStreamFramePrefix::u16, order,
+		                      std::string( "u16" ) + suffix );
+		ok &= check_prefixed( NetSocketStreamFramePrefix::u32, order,
+		                      std::string( "u32" ) + suffix );
+	}
+	ok &= check_prefixed( NetSocketStreamFramePrefix::varint,
+	                      NetSocketStreamByteOrder::big_endian, "varint" );
+	ok &= check_malformed_varint( );
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8095U );
+	auto const endpoint =
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+
+	// The first byte a client sends picks the read mode.  Each frame is
+	// answered with the frame and a '|', a newline after every second one
+	auto error_count = std::atomic<size_t>( 0 );
+	auto server = NetServer( );
+	server.on_error( [&]( base::Error const & ) { ++error_count; } );
+	server.on_connection( []( NetServerSocket socket ) {
+		socket.set_read_exact( 1 );
+		auto frames = std::make_shared<size_t>( 0 );
+		socket.on_data_received(
+		  [socket = daw::mutable_capture( socket ),
+		   frames]( std::shared_ptr<base::data_t> buffer, bool ) {
+			  if( !buffer ) {
+				  return;
+			  }
+			  if( ( *frames )++ == 0 ) {
+				  // Applies from the next read on
+				  if( buffer->front( ) == 'e' ) {
+					  socket->set_read_exact( 5 );
+				  } else {
+					  socket->set_read_length_prefixed(
+					    NetSocketStreamFramePrefix::u16,
+					    NetSocketStreamByteOrder::big_endian, 16 );
+				  }
+				  return;
+			  }
+			  auto reply = std::string( buffer->begin( ), buffer->end( ) ) + '|';
+			  if( *frames % 2 == 1 ) {
+				  reply += '\n';
+			  }
+			  socket->write_async( reply );
+		  } );
+		socket.read_async( );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+	auto io = asio::io_context( );
+
+	{
+		auto client = tcp::socket( io );
+		client.connect( endpoint );
+		send_slowly( client, {"e", "hel", "lowor", "ld"} );
+		ok &= check( read_line( client ) == "hello|world|\n", "set_read_exact" );
+	}
+	{
+		auto const frame = []( std::string const &payload ) {
+			return prefixed( payload, NetSocketStreamFramePrefix::u16,
+			                 NetSocketStreamByteOrder::big_endian );
+		};
+		auto client = tcp::socket( io );
+		client.connect( endpoint );
+		auto const frames = "p" + frame( "ab" ) + frame( "cde" );
+		send_slowly( client, split( frames, 2 ) );
+		ok &= check( read_line( client ) == "ab|cde|\n", "set_read_length_prefixed" );
+
+		send_slowly( client, {frame( std::string( 17, 'x' ) ).substr( 0, 2 )} );
+		char c = 0;
+		ok &= check( ::recv( client.native_handle( ), &c, 1, 0 ) <= 0,
+		             "frame over the maximum closes the connection" );
+	}
+
+	io_thread.stop( );
+	ok &= check( error_count == 1, "frame over the maximum reported" );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,288 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Checks that completion handlers bound to a handler_arena_t do not reach the
+// heap once a connection is running.  Several loopback connections ping-pong
+// a line with async_read_until/async_write.  The server side answers while
+// its next read is already pending, like a server streaming a response, so
+// more memory is in use than asio's own per thread handler cache holds.  The
+// same loop is run with unbound handlers to show the difference
+
+#include <asio.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "base_error.h"
+#include "base_handler_arena.h"
+
+namespace {
+	thread_local size_t t_allocations = 0;
+
+	void *counted_alloc( size_t size, size_t align ) {
+		++t_allocations;
+		void *result = nullptr;
+		if( align <= alignof( std::max_align_t ) ) {
+			result = std::malloc( size == 0 ? 1 : size );
+		} else {
+			auto const rounded = ( size + align - 1 ) / align * align;
+			result = std::aligned_alloc( align, rounded == 0 ? align : rounded );
+		}
+		if( result == nullptr ) {
+			throw std::bad_alloc( );
+		}
+		return result;
+	}
+} // namespace
+
+void *operator new( size_t size ) {
+	return counted_alloc( size, 0 );
+}
+
+void *operator new[]( size_t size ) {
+	return counted_alloc( size, 0 );
+}
+
+void *operator new( size_t size, std::align_val_t align ) {
+	return counted_alloc( size, static_cast<size_t>( align ) );
+}
+
+void *operator new[]( size_t size, std::align_val_t align ) {
+	return counted_alloc( size, static_cast<size_t>( align ) );
+}
+
+void operator delete( void *ptr ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void *ptr, size_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr, size_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void *ptr, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete( void *ptr, size_t, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+void operator delete[]( void *ptr, size_t, std::align_val_t ) noexcept {
+	std::free( ptr );
+}
+
+namespace {
+	using daw::nodepp::base::ErrorCode;
+	using daw::nodepp::base::handler_arena_t;
+	using tcp = asio::ip::tcp;
+
+	// One end of a connection.  A server echoes every line and reads on
+	// without waiting for the write, a client sends a line per round and
+	// stops the io_context after the last client's final round
+	struct peer_t {
+		asio::io_context &io;
+		tcp::socket socket;
+		asio::streambuf buffer{};
+		std::string line = "ping\n";
+		handler_arena_t arena{};
+		size_t *clients_running = nullptr;
+		size_t rounds = 0;
+		bool use_arena = false;
+
+		explicit peer_t( asio::io_context &ctx )
+		  : io( ctx )
+		  , socket( ctx ) {}
+
+		template<typename Handler>
+		void read( Handler &&handler ) {
+			if( use_arena ) {
+				asio::async_read_until(
+				  socket, buffer, '\n',
+				  daw::nodepp::base::bind_arena( arena, std::move( handler ) ) );
+			} else {
+				asio::async_read_until( socket, buffer, '\n', std::move( handler ) );
+			}
+		}
+
+		template<typename Handler>
+		void write( Handler &&handler ) {
+			if( use_arena ) {
+				asio::async_write(
+				  socket, asio::buffer( line ),
+				  daw::nodepp::base::bind_arena( arena, std::move( handler ) ) );
+			} else {
+				asio::async_write( socket, asio::buffer( line ), std::move( handler ) );
+			}
+		}
+
+		void start_read( ) {
+			read( [this]( ErrorCode err, size_t count ) {
+				if( err ) {
+					return;
+				}
+				buffer.consume( count );
+				if( clients_running == nullptr ) {
+					write( []( ErrorCode, size_t ) {} );
+					start_read( );
+					return;
+				}
+				if( --rounds == 0 ) {
+					if( --*clients_running == 0 ) {
+						io.stop( );
+					}
+					return;
+				}
+				start_write( );
+			} );
+		}
+
+		void start_write( ) {
+			write( [this]( ErrorCode err, size_t ) {
+				if( !err ) {
+					start_read( );
+				}
+			} );
+		}
+	};
+
+	struct connection_t {
+		std::unique_ptr<peer_t> client;
+		std::unique_ptr<peer_t> server;
+	};
+
+	struct test_state_t {
+		size_t clients_running = 0;
+		// Declared after clients_running so that pending handlers are destroyed
+		// with the io_context before the counter goes away
+		asio::io_context io{1};
+		std::vector<connection_t> connections{};
+	};
+
+	void make_connections( test_state_t &state, size_t count,
+	                       bool use_arena ) {
+		auto const loopback =
+		  tcp::endpoint( asio::ip::address_v4::loopback( ), 0 );
+		auto acceptor = tcp::acceptor( state.io, loopback );
+		for( size_t n = 0; n < count; ++n ) {
+			auto conn = connection_t{std::make_unique<peer_t>( state.io ),
+			                         std::make_unique<peer_t>( state.io )};
+			conn.client->socket.connect( acceptor.local_endpoint( ) );
+			acceptor.accept( conn.server->socket );
+			for( auto *peer : {conn.client.get( ), conn.server.get( )} ) {
+				peer->socket.set_option( tcp::no_delay( true ) );
+				peer->use_arena = use_arena;
+			}
+			conn.client->clients_running = &state.clients_running;
+			conn.server->start_read( );
+			state.connections.push_back( std::move( conn ) );
+		}
+	}
+
+	// Allocations made while every client does rounds round trips
+	size_t run_rounds( test_state_t &state, size_t rounds ) {
+		state.clients_running = state.connections.size( );
+		for( auto &conn : state.connections ) {
+			conn.client->rounds = rounds;
+			conn.client->start_write( );
+		}
+		auto const before = t_allocations;
+		state.io.restart( );
+		state.io.run( );
+		return t_allocations - before;
+	}
+
+	// Allocations per round trip in the steady state
+	double measure( size_t connection_count, size_t rounds, bool use_arena,
+	                size_t &fallbacks ) {
+		auto state = test_state_t( );
+		make_connections( state, connection_count, use_arena );
+		run_rounds( state, 16 );
+		auto const allocations = run_rounds( state, rounds );
+		fallbacks = 0;
+		for( auto &conn : state.connections ) {
+			fallbacks +=
+			  conn.client->arena.fallbacks( ) + conn.server->arena.fallbacks( );
+		}
+		return static_cast<double>( allocations ) /
+		       static_cast<double>( rounds * connection_count );
+	}
+
+	// The arena must stay alive for an operation that is still pending when
+	// its owner goes away
+	bool outlives_owner( ) {
+		auto state = test_state_t( );
+		make_connections( state, 1, true );
+		auto &server = *state.connections.front( ).server;
+		auto completed = false;
+		{
+			auto arena = handler_arena_t( );
+			auto &client = *state.connections.front( ).client;
+			asio::async_read_until(
+			  client.socket, client.buffer, '\n',
+			  daw::nodepp::base::bind_arena(
+			    arena, [&completed]( ErrorCode, size_t ) { completed = true; } ) );
+		}
+		server.socket.close( );
+		state.io.run( );
+		return completed;
+	}
+} // namespace
+
+int main( ) {
+	size_t const connection_count = 8;
+	size_t const rounds = 2000;
+
+	size_t fallbacks = 0;
+	auto const plain = measure( connection_count, rounds, false, fallbacks );
+	auto const arena = measure( connection_count, rounds, true, fallbacks );
+	std::cout << "allocations/round trip: without arena: " << plain
+	          << ", with arena: " << arena << ", fallbacks: " << fallbacks
+	          << '\n';
+
+	auto result = EXIT_SUCCESS;
+	if( arena != 0.0 or fallbacks != 0 ) {
+		std::cerr << "Handlers bound to an arena allocated\n";
+		result = EXIT_FAILURE;
+	}
+	if( !outlives_owner( ) ) {
+		std::cerr << "Pending handler did not complete after its arena\n";
+		result = EXIT_FAILURE;
+	}
+	return result;
+}
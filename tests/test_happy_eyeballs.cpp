@@ -0,0 +1,241 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Checks the parallel connect.  Endpoints alternate between address
+// families, a refused address moves on to the next one at once, an address
+// that never answers is raced by the next one after the attempt delay and
+// the deadline ends a connect that cannot succeed.  Cancelling, or dropping
+// the handle, aborts the connect without touching the target socket.  A
+// listener whose accept queue is full stands in for a host that drops the SYN
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_socket_connect.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using daw::nodepp::lib::net::ConnectOptions;
+	using tcp = asio::ip::tcp;
+	using results_t = tcp::resolver::results_type;
+
+	results_t make_results( std::vector<tcp::endpoint> const &endpoints ) {
+		return results_t::create( endpoints.begin( ), endpoints.end( ), "test",
+		                          "" );
+	}
+
+	tcp::endpoint loopback( uint16_t port ) {
+		return tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+	}
+
+	uint16_t port_of( int fd ) {
+		auto addr = sockaddr_in{};
+		auto len = static_cast<socklen_t>( sizeof( addr ) );
+		::getsockname( fd, reinterpret_cast<sockaddr *>( &addr ), &len );
+		return ntohs( addr.sin_port );
+	}
+
+	int listen_on_loopback( int backlog ) {
+		auto const fd = ::socket( AF_INET, SOCK_STREAM, 0 );
+		auto addr = sockaddr_in{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+		::bind( fd, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) );
+		::listen( fd, backlog );
+		return fd;
+	}
+
+	// A port nothing listens on
+	uint16_t closed_port( ) {
+		auto const fd = listen_on_loopback( 1 );
+		auto const result = port_of( fd );
+		::close( fd );
+		return result;
+	}
+
+	struct outcome_t {
+		daw::nodepp::base::ErrorCode error{};
+		tcp::endpoint endpoint{};
+		std::chrono::milliseconds elapsed{};
+	};
+
+	enum class cancel_t { none, cancel, drop };
+
+	// With cancel set, the connect is cancelled or its handle dropped after
+	// cancel_after
+	outcome_t connect( std::vector<tcp::endpoint> const &endpoints,
+	                   ConnectOptions const &options,
+	                   cancel_t cancel = cancel_t::none,
+	                   std::chrono::milliseconds cancel_after = 0ms ) {
+		auto socket = tcp::socket( daw::nodepp::base::ServiceHandle::get( ) );
+		auto result = outcome_t{};
+		auto const start = std::chrono::steady_clock::now( );
+		auto race = daw::nodepp::lib::net::nss_impl::happy_eyeballs_connect(
+		  socket, make_results( endpoints ), options,
+		  [&]( daw::nodepp::base::ErrorCode err, tcp::endpoint endpoint ) {
+			  result.error = err;
+			  result.endpoint = endpoint;
+			  result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+			    std::chrono::steady_clock::now( ) - start );
+		  } );
+		auto timer =
+		  asio::steady_timer( daw::nodepp::base::ServiceHandle::get( ) );
+		if( cancel != cancel_t::none ) {
+			timer.expires_after( cancel_after );
+			timer.async_wait( [&]( daw::nodepp::base::ErrorCode const & ) {
+				if( cancel == cancel_t::cancel ) {
+					race.cancel( );
+				} else {
+					race = daw::nodepp::lib::net::nss_impl::connect_race_handle_t( );
+				}
+			} );
+		}
+		daw::nodepp::base::ServiceHandle::reset( );
+		daw::nodepp::base::ServiceHandle::run( );
+		if( !result.error and !socket.is_open( ) ) {
+			result.error = asio::error::not_connected;
+		}
+		if( result.error and socket.is_open( ) ) {
+			result.error = asio::error::already_open;
+		}
+		return result;
+	}
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( ) {
+	auto ok = true;
+
+	// Order
+	{
+		auto const v6 = []( uint16_t port ) {
+			return tcp::endpoint( asio::ip::address_v6::loopback( ), port );
+		};
+		auto const ordered = daw::nodepp::lib::net::nss_impl::order_endpoints(
+		  make_results( {v6( 1 ), v6( 2 ), loopback( 3 ), loopback( 4 ),
+		                 loopback( 5 )} ) );
+		auto const expected = std::vector<tcp::endpoint>{
+		  v6( 1 ), loopback( 3 ), v6( 2 ), loopback( 4 ), loopback( 5 )};
+		ok &= check( ordered == expected, "families alternate" );
+	}
+
+	auto const good = listen_on_loopback( 16 );
+	auto const good_endpoint = loopback( port_of( good ) );
+
+	// A full accept queue drops new SYNs, so connecting to it never completes
+	auto const silent = listen_on_loopback( 0 );
+	auto const silent_endpoint = loopback( port_of( silent ) );
+	auto fillers = std::vector<int>( );
+	for( int n = 0; n < 4; ++n ) {
+		auto const fd = ::socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0 );
+		auto addr = sockaddr_in{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+		addr.sin_port = htons( silent_endpoint.port( ) );
+		::connect( fd, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) );
+		fillers.push_back( fd );
+	}
+
+	auto options = ConnectOptions{};
+	options.attempt_delay = 100ms;
+	options.deadline = 2s;
+
+	// Refused
+	{
+		auto const result =
+		  connect( {loopback( closed_port( ) ), good_endpoint}, options );
+		ok &= check( !result.error and result.endpoint == good_endpoint,
+		             "connected after a refusal" );
+		ok &= check( result.elapsed < options.attempt_delay,
+		             "refusal did not wait for the attempt delay" );
+	}
+
+	// Silent
+	{
+		auto const result = connect( {silent_endpoint, good_endpoint}, options );
+		ok &= check( !result.error and result.endpoint == good_endpoint,
+		             "connected past a silent address" );
+		ok &= check( result.elapsed >= options.attempt_delay and
+		               result.elapsed < options.deadline,
+		             "second attempt started after the attempt delay" );
+	}
+
+	// Deadline
+	{
+		options.deadline = 300ms;
+		auto const result = connect( {silent_endpoint}, options );
+		ok &= check( result.error == asio::error::timed_out, "timed out" );
+		ok &= check( result.elapsed >= options.deadline and result.elapsed < 2s,
+		             "ended at the deadline" );
+	}
+
+	// Cancelled
+	{
+		options.deadline = 2s;
+		auto const result =
+		  connect( {silent_endpoint}, options, cancel_t::cancel, 100ms );
+		ok &= check( result.error == asio::error::operation_aborted,
+		             "cancel aborts the connect" );
+		ok &= check( result.elapsed < options.deadline,
+		             "cancel did not wait for the deadline" );
+	}
+
+	// Handle dropped, the connect must not write to the target any more
+	{
+		auto const result =
+		  connect( {silent_endpoint}, options, cancel_t::drop, 100ms );
+		ok &= check( result.error == asio::error::operation_aborted,
+		             "dropping the handle aborts the connect" );
+	}
+
+	// Cancelled once connected changes nothing
+	{
+		auto const result =
+		  connect( {good_endpoint}, options, cancel_t::cancel, 100ms );
+		ok &= check( !result.error and result.endpoint == good_endpoint,
+		             "cancel after the connect completed" );
+	}
+
+	// Nothing to connect to
+	{
+		auto const result = connect( {}, options );
+		ok &= check( static_cast<bool>( result.error ), "no endpoints" );
+	}
+
+	for( auto fd : fillers ) {
+		::close( fd );
+	}
+	::close( silent );
+	::close( good );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
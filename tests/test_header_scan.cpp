@@ -0,0 +1,149 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/regex.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "lib_net_socket_match.h"
+
+namespace {
+	using daw::nodepp::lib::net::nss_impl::match_iterator_t;
+	using daw::nodepp::lib::net::nss_impl::match_result_t;
+
+	// What NetSocketStreamReadMode::double_newline used before
+	struct regex_matcher_t {
+		boost::regex const &re;
+
+		match_result_t operator( )( match_iterator_t first,
+		                            match_iterator_t last ) const {
+			boost::match_results<match_iterator_t> match;
+			if( !boost::regex_search( first, last, match, re,
+			                          boost::match_default | boost::match_partial ) ) {
+				return {last, false};
+			}
+			if( match[0].matched ) {
+				return {match[0].second, true};
+			}
+			return {match[0].first, false};
+		}
+	};
+
+	std::string const request =
+	  "GET /index.html HTTP/1.1\r\n"
+	  "Host: localhost:8080\r\n"
+	  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:62.0) Gecko/20100101 "
+	  "Firefox/62.0\r\n"
+	  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+	  "Accept-Language: en-US,en;q=0.5\r\n"
+	  "Accept-Encoding: gzip, deflate\r\n"
+	  "Connection: keep-alive\r\n"
+	  "Upgrade-Insecure-Requests: 1\r\n"
+	  "Cache-Control: max-age=0\r\n\r\n";
+
+	std::vector<std::string> make_stream( size_t request_count,
+	                                      size_t chunk_size ) {
+		std::string all{};
+		for( size_t n = 0; n < request_count; ++n ) {
+			all += request;
+		}
+		std::vector<std::string> result{};
+		for( size_t pos = 0; pos < all.size( ); pos += chunk_size ) {
+			result.push_back( all.substr( pos, chunk_size ) );
+		}
+		return result;
+	}
+
+	// Follows what asio::async_read_until does with a match condition
+	template<typename Matcher>
+	size_t read_headers( std::vector<std::string> const &chunks,
+	                     Matcher const &matcher ) {
+		auto buff = asio::streambuf( );
+		auto out = std::ostream( &buff );
+		size_t search_position = 0;
+		size_t headers = 0;
+		for( auto const &chunk : chunks ) {
+			out << chunk;
+			while( true ) {
+				auto const data = buff.data( );
+				auto const first = match_iterator_t::begin( data );
+				auto const last = match_iterator_t::end( data );
+				auto const result =
+				  matcher( first + static_cast<ptrdiff_t>( search_position ), last );
+				if( !result.second ) {
+					search_position = static_cast<size_t>( result.first - first );
+					break;
+				}
+				buff.consume( static_cast<size_t>( result.first - first ) );
+				search_position = 0;
+				++headers;
+			}
+		}
+		return headers;
+	}
+
+	template<typename Matcher>
+	bool bench( char const *title, std::vector<std::string> const &chunks,
+	            size_t expected, Matcher const &matcher ) {
+		constexpr size_t const runs = 100;
+		size_t found = 0;
+		auto const start = std::chrono::steady_clock::now( );
+		for( size_t n = 0; n < runs; ++n ) {
+			found = read_headers( chunks, matcher );
+		}
+		auto const finish = std::chrono::steady_clock::now( );
+		auto const ms =
+		  std::chrono::duration<double, std::milli>( finish - start ).count( );
+		std::cout << title << ": " << ( ms / runs ) << "ms per run\n";
+		if( found != expected ) {
+			std::cerr << title << ": expected " << expected << " headers but found "
+			          << found << '\n';
+			return false;
+		}
+		return true;
+	}
+} // namespace
+
+int main( ) {
+	using daw::nodepp::lib::net::nss_impl::header_end_matcher_t;
+
+	boost::regex const dbl_newline( R"((?:\r\n|\n){2})" );
+	auto const regex_matcher = regex_matcher_t{dbl_newline};
+	auto const simd_matcher = header_end_matcher_t{};
+
+	constexpr size_t const request_count = 1000;
+	auto const pipelined = make_stream( request_count, 64 * 1024 );
+	auto const fragmented = make_stream( request_count, 7 );
+
+	bool good = true;
+	good &= bench( "pipelined regex", pipelined, request_count, regex_matcher );
+	good &= bench( "pipelined scanner", pipelined, request_count, simd_matcher );
+	good &= bench( "fragmented regex", fragmented, request_count, regex_matcher );
+	good &=
+	  bench( "fragmented scanner", fragmented, request_count, simd_matcher );
+
+	return good ? EXIT_SUCCESS : EXIT_FAILURE;
+}
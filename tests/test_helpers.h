@@ -0,0 +1,90 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Helpers shared by the tests and benchmarks that run a server on the io
+// service
+
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "base_service_handle.h"
+
+namespace daw {
+	namespace nodepp {
+		namespace test {
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Report a failed check on stderr
+			/// @return	value, so results can be combined with &=
+			inline bool check( bool value, std::string const &what ) {
+				if( !value ) {
+					std::cerr << "Failed: " << what << '\n';
+				}
+				return value;
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Run func on the io service and wait for its result.  Used to
+			///				look at state the io thread owns
+			template<typename Function>
+			auto on_io_thread( Function func ) {
+				auto result = std::promise<decltype( func( ) )>( );
+				auto fut = result.get_future( );
+				base::ServiceHandle::get( ).post(
+				  [&]( ) { result.set_value( func( ) ); } );
+				return fut.get( );
+			}
+
+			//////////////////////////////////////////////////////////////////////////
+			/// @brief	Runs the io service on a thread of its own until stopped
+			class io_thread_t {
+				using work_t = base::IoService::work;
+
+				std::unique_ptr<work_t> m_work =
+				  std::make_unique<work_t>( base::ServiceHandle::get( ) );
+				std::thread m_thread{[]( ) { base::ServiceHandle::run( ); }};
+
+			public:
+				io_thread_t( ) = default;
+				io_thread_t( io_thread_t const & ) = delete;
+				io_thread_t &operator=( io_thread_t const & ) = delete;
+
+				~io_thread_t( ) {
+					stop( );
+				}
+
+				void stop( ) {
+					if( !m_thread.joinable( ) ) {
+						return;
+					}
+					m_work.reset( );
+					base::ServiceHandle::stop( );
+					m_thread.join( );
+				}
+			};
+		} // namespace test
+	}   // namespace nodepp
+} // namespace daw
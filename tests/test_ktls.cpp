@@ -0,0 +1,413 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks kernel TLS.  The write keys derived for the kernel must open the
+// records OpenSSL itself writes after the handshake, for each cipher the
+// kernel supports in TLS 1.2 and 1.3.  Once the kernel owns the write side a
+// record from OpenSSL, e.g. the reply to a KeyUpdate, must shut the socket
+// down rather than reach the peer.  When the kernel has kTLS, data is also
+// sent through a server with tls_kernel_offload on
+
+#include <array>
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_ktls.h"
+#include "lib_net_server.h"
+#include "test_certificate.h"
+#include "test_helpers.h"
+
+namespace {
+	using tcp = asio::ip::tcp;
+	using daw::nodepp::lib::net::nss_impl::ktls_keys_t;
+	using daw::nodepp::lib::net::nss_impl::ktls_state_t;
+
+	struct cipher_case_t {
+		int version;
+		char const *cipher;
+	};
+
+	constexpr std::array<cipher_case_t, 6> cipher_cases = {{
+	  {TLS1_2_VERSION, "ECDHE-RSA-AES128-GCM-SHA256"},
+	  {TLS1_2_VERSION, "ECDHE-RSA-AES256-GCM-SHA384"},
+	  {TLS1_2_VERSION, "ECDHE-RSA-CHACHA20-POLY1305"},
+	  {TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256"},
+	  {TLS1_3_VERSION, "TLS_AES_256_GCM_SHA384"},
+	  {TLS1_3_VERSION, "TLS_CHACHA20_POLY1305_SHA256"},
+	}};
+
+	using daw::nodepp::test::check;
+
+	void limit_client( SSL *ssl, cipher_case_t const &cc ) {
+		SSL_set_min_proto_version( ssl, cc.version );
+		SSL_set_max_proto_version( ssl, cc.version );
+		if( cc.version == TLS1_3_VERSION ) {
+			SSL_set_ciphersuites( ssl, cc.cipher );
+		} else {
+			SSL_set_cipher_list( ssl, cc.cipher );
+		}
+	}
+
+	// Decrypt one record written with keys, seq is its sequence number
+	bool open_record( ktls_keys_t const &keys, uint64_t seq,
+	                  std::vector<unsigned char> const &record,
+	                  std::string &plaintext ) {
+		static constexpr size_t header_size = 5;
+		static constexpr size_t tag_size = 16;
+		if( record.size( ) < header_size + tag_size ) {
+			return false;
+		}
+		auto const *body = record.data( ) + header_size;
+		auto body_size = record.size( ) - header_size;
+
+		std::array<unsigned char, 12> nonce{};
+		auto const gcm12 = keys.version == TLS1_2_VERSION and
+		                   keys.cipher_nid != NID_chacha20_poly1305;
+		if( gcm12 ) {
+			// Implicit salt then the explicit nonce sent with the record
+			std::memcpy( nonce.data( ), keys.iv.data( ), 4 );
+			std::memcpy( nonce.data( ) + 4, body, 8 );
+			body += 8;
+			body_size -= 8;
+		} else {
+			std::memcpy( nonce.data( ), keys.iv.data( ), nonce.size( ) );
+			for( size_t n = 0; n < 8; ++n ) {
+				nonce[11 - n] ^= static_cast<unsigned char>( seq >> ( 8U * n ) );
+			}
+		}
+		auto const size = body_size - tag_size;
+
+		std::vector<unsigned char> aad{};
+		if( keys.version == TLS1_3_VERSION ) {
+			aad.assign( record.begin( ), record.begin( ) + header_size );
+		} else {
+			for( size_t n = 0; n < 8; ++n ) {
+				aad.push_back( static_cast<unsigned char>( seq >> ( 56U - 8U * n ) ) );
+			}
+			aad.insert( aad.end( ), record.begin( ), record.begin( ) + 3 );
+			aad.push_back( static_cast<unsigned char>( size >> 8U ) );
+			aad.push_back( static_cast<unsigned char>( size ) );
+		}
+
+		auto out = std::vector<unsigned char>( size + 16 );
+		auto *ctx = EVP_CIPHER_CTX_new( );
+		int len = 0;
+		int final_len = 0;
+		auto const ok =
+		  EVP_DecryptInit_ex( ctx, EVP_get_cipherbynid( keys.cipher_nid ), nullptr,
+		                      nullptr, nullptr ) > 0 and
+		  EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_AEAD_SET_IVLEN,
+		                       static_cast<int>( nonce.size( ) ), nullptr ) > 0 and
+		  EVP_DecryptInit_ex( ctx, nullptr, nullptr, keys.key.data( ),
+		                      nonce.data( ) ) > 0 and
+		  EVP_DecryptUpdate( ctx, nullptr, &len, aad.data( ),
+		                     static_cast<int>( aad.size( ) ) ) > 0 and
+		  EVP_DecryptUpdate( ctx, out.data( ), &len, body,
+		                     static_cast<int>( size ) ) > 0 and
+		  EVP_CIPHER_CTX_ctrl(
+		    ctx, EVP_CTRL_AEAD_SET_TAG, static_cast<int>( tag_size ),
+		    const_cast<unsigned char *>( body + size ) ) > 0 and
+		  EVP_DecryptFinal_ex( ctx, out.data( ) + len, &final_len ) > 0;
+		EVP_CIPHER_CTX_free( ctx );
+		if( !ok ) {
+			return false;
+		}
+		out.resize( static_cast<size_t>( len + final_len ) );
+		if( keys.version == TLS1_3_VERSION ) {
+			// The real content type follows the content, then any padding
+			while( !out.empty( ) and out.back( ) == 0 ) {
+				out.pop_back( );
+			}
+			if( out.empty( ) or out.back( ) != SSL3_RT_APPLICATION_DATA ) {
+				return false;
+			}
+			out.pop_back( );
+		}
+		plaintext.assign( out.begin( ), out.end( ) );
+		return true;
+	}
+
+	// Split what was written into records
+	std::vector<std::vector<unsigned char>> read_records( BIO *bio ) {
+		auto data = std::vector<unsigned char>( );
+		std::array<unsigned char, 4096> buff{};
+		int count = 0;
+		while( ( count = BIO_read( bio, buff.data( ),
+		                           static_cast<int>( buff.size( ) ) ) ) > 0 ) {
+			data.insert( data.end( ), buff.data( ), buff.data( ) + count );
+		}
+		auto result = std::vector<std::vector<unsigned char>>( );
+		size_t pos = 0;
+		while( pos + 5 <= data.size( ) ) {
+			auto const size = ( static_cast<size_t>( data[pos + 3] ) << 8U ) |
+			                  data[pos + 4];
+			if( pos + 5 + size > data.size( ) ) {
+				break;
+			}
+			result.emplace_back( data.begin( ) + static_cast<ptrdiff_t>( pos ),
+			                     data.begin( ) +
+			                       static_cast<ptrdiff_t>( pos + 5 + size ) );
+			pos += 5 + size;
+		}
+		return result;
+	}
+
+	// A server and client connected through a BIO pair, the server's state
+	// tracked for kTLS
+	struct memory_connection_t {
+		SSL *server;
+		SSL *client;
+		BIO *client_bio = nullptr;
+		ktls_state_t state{};
+
+		memory_connection_t( asio::ssl::context &server_ctx,
+		                     asio::ssl::context &client_ctx,
+		                     cipher_case_t const &cc )
+		  : server( SSL_new( server_ctx.native_handle( ) ) )
+		  , client( SSL_new( client_ctx.native_handle( ) ) ) {
+
+			BIO *server_bio = nullptr;
+			// Room for everything the server writes
+			BIO_new_bio_pair( &server_bio, 65536, &client_bio, 65536 );
+			SSL_set_bio( server, server_bio, server_bio );
+			SSL_set_bio( client, client_bio, client_bio );
+			SSL_set_accept_state( server );
+			SSL_set_connect_state( client );
+			limit_client( client, cc );
+		}
+
+		~memory_connection_t( ) {
+			SSL_free( client );
+			SSL_free( server );
+		}
+
+		memory_connection_t( memory_connection_t const & ) = delete;
+		memory_connection_t &operator=( memory_connection_t const & ) = delete;
+
+		bool handshake( ) {
+			if( !daw::nodepp::lib::net::nss_impl::ktls_prepare( server, state ) ) {
+				return false;
+			}
+			for( int n = 0; n < 10; ++n ) {
+				auto const c = SSL_do_handshake( client );
+				auto const s = SSL_do_handshake( server );
+				if( c == 1 and s == 1 ) {
+					// Let the client take the session tickets
+					char ch = 0;
+					SSL_read( client, &ch, 1 );
+					return BIO_ctrl_pending( client_bio ) == 0;
+				}
+			}
+			return false;
+		}
+	};
+
+	bool check_write_keys( asio::ssl::context &server_ctx,
+	                       cipher_case_t const &cc ) {
+		auto client_ctx = asio::ssl::context( asio::ssl::context::tls_client );
+		auto conn = memory_connection_t( server_ctx, client_ctx, cc );
+		if( !check( conn.handshake( ), std::string( "handshake " ) + cc.cipher ) ) {
+			return false;
+		}
+		auto keys = ktls_keys_t{};
+		if( !check( daw::nodepp::lib::net::nss_impl::ktls_write_keys(
+		              conn.server, conn.state, keys ),
+		            std::string( "write keys " ) + cc.cipher ) ) {
+			return false;
+		}
+		auto const messages =
+		  std::array<std::string, 3>{{"first", std::string( 20000, 'x' ), "last"}};
+		for( auto const &message : messages ) {
+			SSL_write( conn.server, message.data( ),
+			           static_cast<int>( message.size( ) ) );
+		}
+		auto received = std::string( );
+		auto seq = keys.seq;
+		for( auto const &record : read_records( conn.client_bio ) ) {
+			auto plaintext = std::string( );
+			if( !check( open_record( keys, seq++, record, plaintext ),
+			            std::string( "open record " ) + cc.cipher ) ) {
+				return false;
+			}
+			received += plaintext;
+		}
+		return check( received == messages[0] + messages[1] + messages[2],
+		              std::string( "records match " ) + cc.cipher );
+	}
+
+	// After the kernel took over, a KeyUpdate asking for ours makes OpenSSL
+	// write a record.  It must end the connection instead
+	bool check_key_update_closes( asio::ssl::context &server_ctx ) {
+		auto client_ctx = asio::ssl::context( asio::ssl::context::tls_client );
+		auto conn = memory_connection_t( server_ctx, client_ctx,
+		                                 cipher_cases[3] );
+		if( !check( conn.handshake( ), "handshake for KeyUpdate" ) ) {
+			return false;
+		}
+		int fds[2] = {-1, -1};
+		::socketpair( AF_UNIX, SOCK_STREAM, 0, fds );
+		conn.state.socket_fd = fds[0];
+		conn.state.offloaded = true;
+
+		SSL_key_update( conn.client, SSL_KEY_UPDATE_REQUESTED );
+		SSL_write( conn.client, "ping", 4 );
+		std::array<char, 16> buff{};
+		SSL_read( conn.server, buff.data( ), static_cast<int>( buff.size( ) ) );
+		SSL_write( conn.server, "pong", 4 );
+
+		char ch = 0;
+		auto const peer_closed = ::recv( fds[1], &ch, 1, MSG_DONTWAIT ) == 0;
+		::close( fds[0] );
+		::close( fds[1] );
+		return check( peer_closed and !conn.state.offloaded,
+		              "socket shut down when OpenSSL writes after offload" );
+	}
+
+	// Does this kernel have the tls upper layer protocol
+	bool kernel_has_ktls( ) {
+		auto io = asio::io_context( );
+		auto acceptor =
+		  tcp::acceptor( io, tcp::endpoint( asio::ip::address_v4::loopback( ), 0 ) );
+		auto client = tcp::socket( io );
+		client.connect( acceptor.local_endpoint( ) );
+		static constexpr char const ulp[] = "tls";
+		return ::setsockopt( client.native_handle( ), SOL_TCP, TCP_ULP, ulp,
+		                     sizeof( ulp ) ) == 0;
+	}
+
+	// Round trip a line through the server, then ask for a KeyUpdate on TLS 1.3.
+	// The server may ignore it or close, but never send what cannot be read
+	bool check_round_trip( tcp::endpoint const &endpoint,
+	                       cipher_case_t const &cc ) {
+		auto io = asio::io_context( );
+		auto ctx = asio::ssl::context( asio::ssl::context::tls_client );
+		auto stream = asio::ssl::stream<tcp::socket>( io, ctx );
+		limit_client( stream.native_handle( ), cc );
+		stream.next_layer( ).connect( endpoint );
+		stream.handshake( asio::ssl::stream_base::client );
+
+		auto line = std::string( );
+		asio::write( stream, asio::buffer( "ping\n", 5 ) );
+		asio::read_until( stream, asio::dynamic_buffer( line ), '\n' );
+		auto ok = check( line == "kping\n",
+		                 std::string( "round trip through kTLS " ) + cc.cipher );
+		if( cc.version == TLS1_3_VERSION ) {
+			line.clear( );
+			SSL_key_update( stream.native_handle( ), SSL_KEY_UPDATE_REQUESTED );
+			asio::write( stream, asio::buffer( "again\n", 6 ) );
+			auto ec = daw::nodepp::base::ErrorCode( );
+			asio::read_until( stream, asio::dynamic_buffer( line ), '\n', ec );
+			ok &= check( ( !ec and line == "kagain\n" ) or
+			               ec == asio::error::eof or
+			               ec == asio::ssl::error::stream_truncated,
+			             std::string( "KeyUpdate through kTLS " ) + cc.cipher );
+		}
+		return ok;
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using lib::net::NetServer;
+	using lib::net::NetServerSocket;
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8098U );
+
+	auto const cert_dir = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( cert_dir );
+	auto config = lib::net::SslServerConfig{};
+	config.tls_certificate_chain_file = ( cert_dir / "cert.pem" ).string( );
+	config.tls_private_key_file = ( cert_dir / "key.pem" ).string( );
+	config.tls_kernel_offload = true;
+	if( !test::write_certificate( config.tls_certificate_chain_file,
+	                              config.tls_private_key_file ) ) {
+		std::cerr << "Could not create a certificate\n";
+		return EXIT_FAILURE;
+	}
+
+	auto server_ctx = asio::ssl::context( asio::ssl::context::tls_server );
+	server_ctx.use_certificate_chain_file( config.tls_certificate_chain_file );
+	server_ctx.use_private_key_file( config.tls_private_key_file,
+	                                 asio::ssl::context::pem );
+	lib::net::nss_impl::ktls_enable( server_ctx );
+
+	auto ok = true;
+	for( auto const &cc : cipher_cases ) {
+		ok &= check_write_keys( server_ctx, cc );
+	}
+	ok &= check_key_update_closes( server_ctx );
+
+	if( !kernel_has_ktls( ) ) {
+		std::cout << "The kernel does not support kTLS, skipping the server\n";
+		boost::filesystem::remove_all( cert_dir );
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	auto server = NetServer( config );
+	server.on_error( []( base::Error const &err ) {
+		std::cerr << "Error: " << err << '\n';
+	} );
+	server.on_connection( []( NetServerSocket socket ) {
+		socket.set_read_until_values( "\n", false );
+		socket.on_data_received(
+		  [socket = daw::mutable_capture( socket )](
+		    std::shared_ptr<base::data_t> buffer, bool ) {
+			  if( !buffer ) {
+				  return;
+			  }
+			  auto reply = std::string( socket->kernel_tls( ) ? "k" : "u" );
+			  reply.append( buffer->begin( ), buffer->end( ) );
+			  socket->write( reply );
+		  } );
+		socket.read_async( );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+
+	auto const endpoint =
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+	for( auto const &cc : cipher_cases ) {
+		ok &= check_round_trip( endpoint, cc );
+	}
+
+	io_thread.stop( );
+	boost::filesystem::remove_all( cert_dir );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,191 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks the PROXY protocol acceptor stage.  Each client sends a header
+// naming another address and a line, and the server answers with the
+// address it sees and the line.  Version 1 headers, version 2 headers with
+// TLVs, a header split over two writes and LOCAL connections are checked.
+// A connection without a header is closed, as is one that stalls part way
+// through its header
+
+#include <asio.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "test_helpers.h"
+
+namespace {
+	using daw::nodepp::lib::net::NetServer;
+	using daw::nodepp::lib::net::NetServerSocket;
+	using tcp = asio::ip::tcp;
+
+	std::string const v2_signature( "\r\n\r\n\0\r\nQUIT\n", 12 );
+
+	std::string v2_header( char command, char family, std::string addresses ) {
+		auto result = v2_signature;
+		result.push_back( command );
+		result.push_back( family );
+		result.push_back( static_cast<char>( addresses.size( ) >> 8U ) );
+		result.push_back( static_cast<char>( addresses.size( ) & 0xFFU ) );
+		return result + addresses;
+	}
+
+	// Everything received until the peer closes, a newline or a timeout
+	std::string read_line( tcp::socket &socket ) {
+		auto const fd = socket.native_handle( );
+		auto const timeout = timeval{5, 0};
+		::setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+		auto result = std::string( );
+		char c = 0;
+		while( ::recv( fd, &c, 1, 0 ) == 1 ) {
+			result.push_back( c );
+			if( c == '\n' ) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	std::string exchange( tcp::endpoint const &endpoint,
+	                      std::vector<std::string> const &writes ) {
+		auto io = asio::io_context( );
+		auto socket = tcp::socket( io );
+		socket.connect( endpoint );
+		for( auto const &data : writes ) {
+			asio::write( socket, asio::buffer( data ) );
+			std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+		}
+		return read_line( socket );
+	}
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8094U );
+	auto const endpoint =
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+
+	auto header_errors = std::promise<size_t>( );
+	auto error_count = size_t( 0 );
+
+	auto options = lib::net::AcceptOptions{};
+	options.proxy_protocol = true;
+	options.proxy_header_timeout = 500U;
+
+	auto server = NetServer( );
+	server.set_accept_options( options );
+	server.on_error( [&]( base::Error const & ) {
+		if( ++error_count == 1 ) {
+			header_errors.set_value( error_count );
+		}
+	} );
+	server.on_connection( []( NetServerSocket socket ) {
+		socket.on_data_received(
+		  [socket = daw::mutable_capture( socket )](
+		    std::shared_ptr<base::data_t> buffer, bool ) {
+			  auto const line = buffer ? std::string( buffer->begin( ), buffer->end( ) )
+			                           : std::string( );
+			  socket->write_async( socket->remote_address( ) + ' ' +
+			                       std::to_string( socket->remote_port( ) ) + ' ' +
+			                       std::to_string( socket->local_port( ) ) + ' ' +
+			                       line );
+			  socket->close_when_writes_completed( );
+		  } );
+		socket.read_async( );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+	auto ok = true;
+
+	ok &= check( exchange( endpoint, {"PROXY TCP4 203.0.113.7 192.0.2.1 51000 "
+	                                  "443\r\nhello\n"} ) ==
+	               "203.0.113.7 51000 443 hello\n",
+	             "version 1 header with data" );
+
+	ok &= check( exchange( endpoint, {"PROXY TCP4 203.0.113.8 192.0.2.1 ",
+	                                  "51001 443\r\nhello\n"} ) ==
+	               "203.0.113.8 51001 443 hello\n",
+	             "version 1 header split" );
+
+	auto v6_addresses = std::string( 36, '\0' );
+	v6_addresses[0] = '\x20';
+	v6_addresses[1] = '\x01';
+	v6_addresses[2] = '\x0d';
+	v6_addresses[3] = '\xb8';
+	v6_addresses[15] = '\x07';
+	v6_addresses[31] = '\x01';
+	v6_addresses[32] = '\xc7';
+	v6_addresses[33] = '\x3a'; // 51002
+	v6_addresses[34] = '\x01';
+	v6_addresses[35] = '\xbb'; // 443
+	// A NOOP TLV the server skips
+	v6_addresses += std::string( "\x04\x00\x02xx", 5 );
+	auto const v6_header = v2_header( '\x21', '\x21', v6_addresses );
+	ok &= check( exchange( endpoint, {v6_header.substr( 0, 10 ),
+	                                  v6_header.substr( 10 ), "hello\n"} ) ==
+	               "2001:db8::7 51002 443 hello\n",
+	             "version 2 header" );
+
+	auto const local =
+	  exchange( endpoint, {v2_header( '\x20', '\x00', "" ) + "hello\n"} );
+	ok &= check( local.rfind( "127.0.0.1 ", 0 ) == 0 and
+	               local.find( " " + std::to_string( port ) + " hello\n" ) !=
+	                 std::string::npos,
+	             "LOCAL keeps the connection's addresses" );
+
+	ok &= check( exchange( endpoint, {"GET / HTTP/1.1\r\n\r\n"} ).empty( ),
+	             "no header closed" );
+	auto const reported =
+	  header_errors.get_future( ).wait_for( std::chrono::seconds( 5 ) );
+	ok &= check( reported == std::future_status::ready,
+	             "missing header reported" );
+
+	{
+		auto io = asio::io_context( );
+		auto socket = tcp::socket( io );
+		socket.connect( endpoint );
+		asio::write( socket, asio::buffer( std::string( "PROXY TCP4 " ) ) );
+		auto const start = std::chrono::steady_clock::now( );
+		auto const line = read_line( socket );
+		ok &= check( line.empty( ) and std::chrono::steady_clock::now( ) - start <
+		                                  std::chrono::seconds( 3 ),
+		             "stalled header closed" );
+	}
+
+	io_thread.stop( );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,230 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks send_file.  The client reads every byte of a file larger than the
+// socket buffers and compares it with the file.  On plaintext connections
+// the io thread must stay free while the client is not reading, sendfile is
+// not allowed to block it until the client catches up.  Encrypted
+// connections read the file a window at a time with file_chunk_reader_t,
+// which is also checked on its own
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "lib_net_socket_sendfile.h"
+#include "test_certificate.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using tcp = asio::ip::tcp;
+
+	std::string make_contents( size_t size ) {
+		auto result = std::string( size, '\0' );
+		for( size_t n = 0; n < size; ++n ) {
+			result[n] = static_cast<char>( ( n * 7U + n / 251U ) & 0xFFU );
+		}
+		return result;
+	}
+
+	// Everything until the peer closes
+	std::string read_all( tcp::socket &socket ) {
+		auto result = std::string( );
+		auto ec = daw::nodepp::base::ErrorCode( );
+		asio::read( socket, asio::dynamic_buffer( result ), ec );
+		return result;
+	}
+
+	// Everything until the peer ends the TLS session
+	std::string read_all( asio::ssl::stream<tcp::socket> &stream ) {
+		auto result = std::string( );
+		auto ec = daw::nodepp::base::ErrorCode( );
+		asio::read( stream, asio::dynamic_buffer( result ), ec );
+		return result;
+	}
+
+	// Windows of chunk_size * window bytes until length is read
+	bool check_chunk_reader( std::string const &file_name,
+	                         std::string const &contents ) {
+		using daw::nodepp::lib::net::SendFileOptions;
+		using daw::nodepp::lib::net::nss_impl::file_chunk_reader_t;
+		using daw::nodepp::lib::net::nss_impl::file_descriptor_t;
+
+		auto const read = []( file_chunk_reader_t &reader,
+		                      std::vector<size_t> &sizes ) {
+			auto result = std::string( );
+			while( !reader.done( ) ) {
+				auto const window = reader.read_window( );
+				sizes.push_back( window.size( ) );
+				result.append( static_cast<char const *>( window.data( ) ),
+				               window.size( ) );
+			}
+			return result;
+		};
+		auto ok = true;
+		{
+			auto reader = file_chunk_reader_t( file_descriptor_t( file_name ), 1000,
+			                                   30000, SendFileOptions{4096, 3} );
+			auto sizes = std::vector<size_t>( );
+			ok &= read( reader, sizes ) == contents.substr( 1000, 30000 );
+			ok &= sizes == std::vector<size_t>{12288, 12288, 5424};
+		}
+		{
+			// A length past the end stops at the end of the file
+			auto const offset = contents.size( ) - 5000;
+			auto reader = file_chunk_reader_t( file_descriptor_t( file_name ),
+			                                   offset, 1000000,
+			                                   SendFileOptions{1024, 2} );
+			auto sizes = std::vector<size_t>( );
+			ok &= read( reader, sizes ) == contents.substr( offset );
+			ok &= sizes == std::vector<size_t>{2048, 2048, 904};
+		}
+		return ok;
+	}
+
+	// Does the io thread run a handler within timeout
+	bool io_thread_responds( std::chrono::milliseconds timeout ) {
+		auto result = std::make_shared<std::promise<void>>( );
+		auto fut = result->get_future( );
+		daw::nodepp::base::ServiceHandle::get( ).post(
+		  [result]( ) { result->set_value( ); } );
+		return fut.wait_for( timeout ) == std::future_status::ready;
+	}
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using lib::net::NetServer;
+	using lib::net::NetServerSocket;
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8096U );
+	auto const endpoint =
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+
+	auto const file_name = ( boost::filesystem::temp_directory_path( ) /
+	                         boost::filesystem::unique_path( ) )
+	                         .string( );
+	// Several times what the socket buffers hold, and not a round size
+	auto const contents = make_contents( 16U * 1024U * 1024U + 123U );
+	std::ofstream( file_name, std::ios::binary ) << contents;
+
+	auto const cert_dir = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( cert_dir );
+	auto config = lib::net::SslServerConfig{};
+	config.tls_certificate_chain_file = ( cert_dir / "cert.pem" ).string( );
+	config.tls_private_key_file = ( cert_dir / "key.pem" ).string( );
+	// Encrypt in user space so that the file goes through the chunk reader
+	config.tls_kernel_offload = false;
+	if( !test::write_certificate( config.tls_certificate_chain_file,
+	                              config.tls_private_key_file ) ) {
+		std::cerr << "Could not create a certificate\n";
+		return EXIT_FAILURE;
+	}
+
+	auto ok = check( check_chunk_reader( file_name, contents ),
+	                 "file_chunk_reader_t windows" );
+
+	auto server = NetServer( );
+	auto tls_server = NetServer( config );
+	auto const on_connection = [&]( NetServerSocket socket ) {
+		// Several windows, none of them a whole number of TLS records
+		socket.set_send_file_options( lib::net::SendFileOptions{10000, 3} );
+		// The first byte picks the whole file or a range of it
+		socket.set_read_exact( 1 );
+		socket.on_data_received(
+		  [socket = daw::mutable_capture( socket ),
+		   &file_name]( std::shared_ptr<base::data_t> buffer, bool ) {
+			  if( !buffer ) {
+				  return;
+			  }
+			  if( buffer->front( ) == 'a' ) {
+				  socket->send_file( file_name );
+			  } else {
+				  socket->send_file_async( file_name, 1000, 100000 );
+			  }
+			  socket->close_when_writes_completed( );
+		  } );
+		socket.read_async( );
+	};
+	for( auto *srv : {&server, &tls_server} ) {
+		srv->on_error( []( base::Error const &err ) {
+			std::cerr << "Error: " << err << '\n';
+		} );
+		srv->on_connection( on_connection );
+	}
+	server.listen( port, lib::net::ip_version::ipv4 );
+	tls_server.listen( static_cast<uint16_t>( port + 1U ),
+	                   lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+	auto io = asio::io_context( );
+
+	{
+		auto client = tcp::socket( io );
+		client.connect( endpoint );
+		asio::write( client, asio::buffer( "a", 1 ) );
+		// The socket buffers fill up while nothing is read
+		std::this_thread::sleep_for( 200ms );
+		ok &= check( io_thread_responds( 2000ms ),
+		             "io thread free while the client is not reading" );
+		ok &= check( read_all( client ) == contents, "whole file received" );
+	}
+	{
+		auto client = tcp::socket( io );
+		client.connect( endpoint );
+		asio::write( client, asio::buffer( "r", 1 ) );
+		ok &= check( read_all( client ) == contents.substr( 1000, 100000 ),
+		             "range of the file received" );
+	}
+
+	{
+		auto ctx = asio::ssl::context( asio::ssl::context::tls_client );
+		auto stream = asio::ssl::stream<tcp::socket>( io, ctx );
+		stream.next_layer( ).connect( tcp::endpoint(
+		  asio::ip::address_v4::loopback( ), static_cast<uint16_t>( port + 1U ) ) );
+		stream.handshake( asio::ssl::stream_base::client );
+		asio::write( stream, asio::buffer( "a", 1 ) );
+		ok &= check( read_all( stream ) == contents,
+		             "whole file received over TLS" );
+	}
+
+	io_thread.stop( );
+	boost::filesystem::remove( file_name );
+	boost::filesystem::remove_all( cert_dir );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
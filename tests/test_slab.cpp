@@ -0,0 +1,97 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks that a thread freeing blocks other threads allocated does not keep
+// them all.  One thread allocates, a second frees everything and stays alive,
+// and a third allocating as much again should mostly reuse those blocks
+// rather than carve new chunks
+
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base_slab.h"
+
+int main( ) {
+	using namespace daw::nodepp::base;
+	// 16 chunks of 64 byte blocks
+	size_t const block_count = 16U * 1024U;
+	size_t const block_size = 64U;
+	// The free blocks a thread may keep of one size, in chunks
+	size_t const max_kept_chunks = 4U;
+
+	auto blocks = std::vector<void *>( );
+	std::thread( [&]( ) {
+		for( size_t n = 0; n < block_count; ++n ) {
+			blocks.push_back( slab_impl::allocate( block_size ) );
+		}
+	} ).join( );
+
+	auto mutex = std::mutex( );
+	auto cv = std::condition_variable( );
+	auto freed = false;
+	auto done = false;
+	auto freeing_thread = std::thread( [&]( ) {
+		for( auto *block : blocks ) {
+			slab_impl::deallocate( block, block_size );
+		}
+		auto lck = std::unique_lock<std::mutex>( mutex );
+		freed = true;
+		cv.notify_all( );
+		cv.wait( lck, [&] { return done; } );
+	} );
+	{
+		auto lck = std::unique_lock<std::mutex>( mutex );
+		cv.wait( lck, [&] { return freed; } );
+	}
+
+	size_t new_chunks = 0;
+	std::thread( [&]( ) {
+		auto const before = slab_stats( ).chunks;
+		for( auto &block : blocks ) {
+			block = slab_impl::allocate( block_size );
+		}
+		new_chunks = slab_stats( ).chunks - before;
+		for( auto *block : blocks ) {
+			slab_impl::deallocate( block, block_size );
+		}
+	} ).join( );
+
+	{
+		auto const lck = std::lock_guard<std::mutex>( mutex );
+		done = true;
+	}
+	cv.notify_all( );
+	freeing_thread.join( );
+
+	std::cout << "chunks carved while another thread held free blocks: "
+	          << new_chunks << '\n';
+	if( new_chunks > max_kept_chunks ) {
+		std::cerr << "The freeing thread kept more than " << max_kept_chunks
+		          << " chunks of free blocks\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks that the SocketOptions given to a server reach the connections it
+// accepts.  Where they are inherited from the listening socket nothing is set
+// per connection, so reading them back on an accepted socket tests both
+// apply_listen_options and that claim
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using daw::nodepp::lib::net::NetServer;
+	using daw::nodepp::lib::net::NetServerSocket;
+	using daw::nodepp::lib::net::SocketOptions;
+	using daw::nodepp::test::check;
+	using daw::nodepp::test::on_io_thread;
+	using tcp = asio::ip::tcp;
+
+	constexpr int32_t keep_alive_idle = 42;
+	constexpr int32_t not_sent_low_water = 16384;
+
+	// The options as read back from an accepted socket
+	struct accepted_options_t {
+		int no_delay = -1;
+		int keep_alive = -1;
+		int keep_alive_idle = -1;
+		int not_sent_low_water = -1;
+	};
+
+	int get_int_option( int fd, int level, int name ) {
+		int value = -1;
+		auto size = static_cast<socklen_t>( sizeof( value ) );
+		if( ::getsockopt( fd, level, name, &value, &size ) != 0 ) {
+			return -1;
+		}
+		return value;
+	}
+
+	accepted_options_t read_options( int fd ) {
+		auto result = accepted_options_t{};
+		result.no_delay = get_int_option( fd, IPPROTO_TCP, TCP_NODELAY );
+		result.keep_alive = get_int_option( fd, SOL_SOCKET, SO_KEEPALIVE );
+#if defined( TCP_KEEPIDLE )
+		result.keep_alive_idle = get_int_option( fd, IPPROTO_TCP, TCP_KEEPIDLE );
+#elif defined( TCP_KEEPALIVE )
+		result.keep_alive_idle = get_int_option( fd, IPPROTO_TCP, TCP_KEEPALIVE );
+#endif
+#if defined( TCP_NOTSENT_LOWAT )
+		result.not_sent_low_water =
+		  get_int_option( fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT );
+#endif
+		return result;
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8103U );
+
+	auto options = SocketOptions{};
+	options.no_delay = true;
+	options.keep_alive = true;
+	options.keep_alive_idle = keep_alive_idle;
+	options.not_sent_low_water = not_sent_low_water;
+
+	// Only touched on the io thread
+	auto accepted = std::optional<accepted_options_t>( );
+	auto connection = std::optional<NetServerSocket>( );
+
+	auto server = NetServer( );
+	server.set_socket_options( options );
+	server.on_error( []( base::Error const &err ) {
+		std::cerr << "Error: " << err << '\n';
+	} );
+	server.on_connection( [&]( NetServerSocket socket ) {
+		accepted = read_options(
+		  socket.socket( ).next_layer( ).native_handle( ) );
+		connection = daw::move( socket );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+
+	auto io = asio::io_context( );
+	auto client = tcp::socket( io );
+	client.connect( tcp::endpoint( asio::ip::address_v4::loopback( ), port ) );
+
+	auto result = std::optional<accepted_options_t>( );
+	auto const deadline = std::chrono::steady_clock::now( ) + 5s;
+	while( !( result = on_io_thread( [&]( ) { return accepted; } ) ) and
+	       std::chrono::steady_clock::now( ) < deadline ) {
+		std::this_thread::sleep_for( 10ms );
+	}
+
+	auto ok = check( static_cast<bool>( result ), "connection accepted" );
+	if( result ) {
+		ok &= check( result->no_delay != 0, "TCP_NODELAY set" );
+		ok &= check( result->keep_alive != 0, "SO_KEEPALIVE set" );
+#if defined( TCP_KEEPIDLE ) or defined( TCP_KEEPALIVE )
+		ok &= check( result->keep_alive_idle == keep_alive_idle,
+		             "keep alive idle time set" );
+#endif
+#if defined( TCP_NOTSENT_LOWAT )
+		ok &= check( result->not_sent_low_water == not_sent_low_water,
+		             "TCP_NOTSENT_LOWAT set" );
+#endif
+	}
+
+	client.close( );
+	io_thread.stop( );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
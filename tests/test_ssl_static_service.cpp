@@ -104,6 +104,8 @@ int main( int argc, char const **argv ) {
 	auto service = HttpStaticService( config.url_path, config.file_system_path );
 	service.connect( site );
 
-	base::start_service( base::StartServiceMode::OnePerCore );
+	base::start_service( base::is_single_threaded
+	                       ? base::StartServiceMode::Single
+	                       : base::StartServiceMode::OnePerCore );
 	return EXIT_SUCCESS;
 }
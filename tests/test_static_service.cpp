@@ -22,6 +22,7 @@
 
 #include <cstdlib>
 #include <memory>
+#include <optional>
 
 #include <daw/daw_read_file.h>
 #include <daw/json/daw_json_link.h>
@@ -31,6 +32,7 @@
 #include "lib_http_site.h"
 #include "lib_http_static_service.h"
 #include "lib_http_webservice.h"
+#include "lib_net_socket_options.h"
 
 namespace {
 	struct config_t {
@@ -39,6 +41,8 @@ namespace {
 		std::vector<std::string> default_files = {};
 		std::string mime_db = "";
 		uint16_t port = 8080;
+		std::optional<daw::nodepp::lib::net::SocketOptions> socket_options{};
+		std::optional<daw::nodepp::lib::net::AcceptOptions> accept_options{};
 	};
 
 	inline auto describe_json_class( config_t ) noexcept {
@@ -48,16 +52,21 @@ namespace {
 		static constexpr char const n2[] = "default_files";
 		static constexpr char const n3[] = "mime_db";
 		static constexpr char const n4[] = "port";
+		static constexpr char const n5[] = "socket_options";
+		static constexpr char const n6[] = "accept_options";
 		return class_description_t<
 		  json_string<n0>, json_string<n1>,
 		  json_array<n2, std::vector<std::string>, json_string<no_name>>,
-		  json_string<n3>, json_number<n4, uint16_t>>{};
+		  json_string<n3>, json_number<n4, uint16_t>,
+		  json_nullable<json_class<n5, daw::nodepp::lib::net::SocketOptions>>,
+		  json_nullable<json_class<n6, daw::nodepp::lib::net::AcceptOptions>>>{};
 	}
 
 	constexpr inline auto to_json_data( config_t const &value ) noexcept {
 		return std::forward_as_tuple( value.url_path, value.file_system_path,
 		                              value.default_files, value.mime_db,
-		                              value.port );
+		                              value.port, value.socket_options,
+		                              value.accept_options );
 	}
 } // namespace
 
@@ -95,10 +104,18 @@ int main( int argc, char const **argv ) {
 		std::cerr << "Looking for web root in folder: '" << boost::filesystem::canonical( "./" ) << "/web_files/'\n";
 		return EXIT_FAILURE;
 	}
+	if( config.socket_options ) {
+		site.set_socket_options( *config.socket_options );
+	}
+	if( config.accept_options ) {
+		site.set_accept_options( *config.accept_options );
+	}
 	site.listen_on( config.port, ip_version::ipv4_v6, 150 );
 	auto service = HttpStaticService( config.url_path, config.file_system_path );
 	service.connect( site );
 
-	base::start_service( base::StartServiceMode::OnePerCore );
+	base::start_service( base::is_single_threaded
+	                       ? base::StartServiceMode::Single
+	                       : base::StartServiceMode::OnePerCore );
 	return EXIT_SUCCESS;
 }
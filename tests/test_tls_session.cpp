@@ -0,0 +1,206 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks TLS session resumption on a server's TlsContext with TLS 1.2 and
+// 1.3, once through the session cache and once with tickets.  A client
+// using make_client_context reconnects and must resume, also after the
+// server reloads its certificates.  With a short ticket key rotation, a
+// ticket still resumes for one period after its key was replaced and not
+// after that.  The handshakes run over in-memory BIOs
+
+#include <asio/ssl.hpp>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <openssl/ssl.h>
+#include <string>
+#include <thread>
+
+#include "lib_net_tls_context.h"
+#include "lib_net_tls_session.h"
+#include "test_certificate.h"
+#include "test_helpers.h"
+
+namespace {
+	using namespace std::chrono_literals;
+	using daw::nodepp::lib::net::EncryptionContext;
+
+	using daw::nodepp::test::check;
+
+	std::string version_name( int version ) {
+		return version == TLS1_3_VERSION ? "TLS 1.3" : "TLS 1.2";
+	}
+
+	struct connection_result_t {
+		bool connected = false;
+		bool reused = false;
+		SSL_SESSION *session = nullptr;
+	};
+
+	// Handshake a client on client_ctx with a server on server_ctx.  offer,
+	// when given, is used instead of what the client context remembers.  The
+	// session the client ends up with is returned, the caller frees it
+	connection_result_t connect( EncryptionContext &server_ctx,
+	                             EncryptionContext &client_ctx, int version,
+	                             SSL_SESSION *offer = nullptr ) {
+		using namespace daw::nodepp::lib::net::nss_impl;
+
+		auto *server = SSL_new( server_ctx.native_handle( ) );
+		auto *client = SSL_new( client_ctx.native_handle( ) );
+		BIO *server_bio = nullptr;
+		BIO *client_bio = nullptr;
+		BIO_new_bio_pair( &server_bio, 65536, &client_bio, 65536 );
+		SSL_set_bio( server, server_bio, server_bio );
+		SSL_set_bio( client, client_bio, client_bio );
+		SSL_set_accept_state( server );
+		SSL_set_connect_state( client );
+		SSL_set_min_proto_version( client, version );
+		SSL_set_max_proto_version( client, version );
+		tls_client_prepare( client, "localhost", 443 );
+		if( offer != nullptr ) {
+			SSL_set_session( client, offer );
+		}
+
+		auto result = connection_result_t{};
+		for( int n = 0; n < 10 and !result.connected; ++n ) {
+			auto const c = SSL_do_handshake( client );
+			auto const s = SSL_do_handshake( server );
+			result.connected = c == 1 and s == 1;
+		}
+		if( result.connected ) {
+			tls_record_handshake( server );
+			// TLS 1.3 tickets arrive after the handshake
+			char ch = 0;
+			SSL_read( client, &ch, 1 );
+			result.reused = SSL_session_reused( client ) == 1;
+			result.session = SSL_get1_session( client );
+			// Without a close_notify OpenSSL forgets the session
+			SSL_shutdown( client );
+			SSL_shutdown( server );
+		}
+		SSL_free( client );
+		SSL_free( server );
+		return result;
+	}
+
+	bool check_resumption( daw::nodepp::lib::net::SslServerConfig config,
+	                       int version, bool tickets ) {
+		using namespace daw::nodepp::lib::net;
+
+		auto const name = version_name( version ) +
+		                  ( tickets ? " with tickets" : " with the cache" );
+		config.tls_session_tickets = tickets;
+		auto tls = TlsContext( config );
+		auto client_ctx = make_client_context( );
+
+		auto const reconnect = [&]( ) {
+			auto const result = connect( *tls.get( ), *client_ctx, version );
+			SSL_SESSION_free( result.session );
+			return result;
+		};
+		auto ok = check( reconnect( ).connected, name + ": first handshake" );
+		ok &= check( reconnect( ).reused, name + ": resumed" );
+		ok &= check( reconnect( ).reused, name + ": resumed again" );
+		tls.reload( );
+		ok &= check( reconnect( ).reused, name + ": resumed after a reload" );
+
+		auto const stats = tls.session_stats( );
+		ok &= check( stats.handshakes == 4 and stats.resumed == 3,
+		             name + ": handshake counters" );
+		if( tickets ) {
+			ok &= check( stats.tickets_issued > 0, name + ": tickets issued" );
+			ok &= check( stats.cache_hits == 0, name + ": cache unused" );
+		} else {
+			ok &= check( stats.tickets_issued == 0, name + ": no tickets" );
+			ok &= check( stats.cache_hits == 3, name + ": cache hits" );
+		}
+		return ok;
+	}
+
+	// A ticket resumes while its key is current and for one period after it
+	// was replaced, then the client gets a full handshake
+	bool check_ticket_rotation( daw::nodepp::lib::net::SslServerConfig config,
+	                            int version ) {
+		using namespace daw::nodepp::lib::net;
+
+		auto const name = version_name( version ) + " ticket rotation";
+		config.tls_session_tickets = true;
+		config.tls_ticket_key_rotation = 1;
+		auto tls = TlsContext( config );
+		auto client_ctx = make_client_context( );
+
+		auto first = connect( *tls.get( ), *client_ctx, version );
+		auto ok = check( first.connected and first.session != nullptr,
+		                 name + ": first handshake" );
+
+		std::this_thread::sleep_for( 1200ms );
+		auto renewed =
+		  connect( *tls.get( ), *client_ctx, version, first.session );
+		ok &= check( renewed.reused, name + ": resumed under the old key" );
+		ok &= check( tls.session_stats( ).ticket_key_rotations == 2,
+		             name + ": key rotated" );
+
+		std::this_thread::sleep_for( 1000ms );
+		auto expired = connect( *tls.get( ), *client_ctx, version, first.session );
+		ok &= check( expired.connected and !expired.reused,
+		             name + ": full handshake once the key is gone" );
+		auto again =
+		  connect( *tls.get( ), *client_ctx, version, renewed.session );
+		ok &= check( again.reused, name + ": renewed ticket resumed" );
+
+		for( auto *session :
+		     {first.session, renewed.session, expired.session, again.session} ) {
+			SSL_SESSION_free( session );
+		}
+		return ok;
+	}
+} // namespace
+
+int main( int, char const ** ) {
+	using namespace daw::nodepp;
+
+	auto const cert_dir = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( cert_dir );
+	auto config = lib::net::SslServerConfig{};
+	config.tls_certificate_chain_file = ( cert_dir / "cert.pem" ).string( );
+	config.tls_private_key_file = ( cert_dir / "key.pem" ).string( );
+	config.tls_kernel_offload = false;
+	if( !test::write_certificate( config.tls_certificate_chain_file,
+	                              config.tls_private_key_file ) ) {
+		std::cerr << "Could not create a certificate\n";
+		return EXIT_FAILURE;
+	}
+
+	auto ok = true;
+	for( auto const version : {TLS1_2_VERSION, TLS1_3_VERSION} ) {
+		for( auto const tickets : {false, true} ) {
+			ok &= check_resumption( config, version, tickets );
+		}
+		ok &= check_ticket_rotation( config, version );
+	}
+
+	boost::filesystem::remove_all( cert_dir );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks how a TLS server closes a connection.  The server answers and
+// closes when the write completes.  The client must get close_notify
+// rather than a bare TCP shutdown.  It then never answers, and the server
+// must keep serving other clients and drop the connection once
+// tls_shutdown_timeout has passed
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "test_certificate.h"
+#include "test_helpers.h"
+
+namespace {
+	using daw::nodepp::test::check;
+	using asio::ip::tcp;
+	using ssl_stream_t = asio::ssl::stream<tcp::socket>;
+
+	std::string read_greeting( ssl_stream_t &stream,
+	                           tcp::endpoint const &endpoint ) {
+		stream.next_layer( ).connect( endpoint );
+		stream.handshake( asio::ssl::stream_base::client );
+		auto result = std::string( );
+		auto ec = daw::nodepp::base::ErrorCode( );
+		asio::read_until( stream, asio::dynamic_buffer( result ), '\n', ec );
+		return result;
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using lib::net::NetServer;
+	using lib::net::NetServerSocket;
+	using namespace std::chrono_literals;
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8100U );
+	auto const endpoint =
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port );
+
+	auto const cert_dir = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( cert_dir );
+	auto config = lib::net::SslServerConfig{};
+	config.tls_certificate_chain_file = ( cert_dir / "cert.pem" ).string( );
+	config.tls_private_key_file = ( cert_dir / "key.pem" ).string( );
+	config.tls_kernel_offload = false;
+	config.tls_shutdown_timeout = 1;
+	if( !test::write_certificate( config.tls_certificate_chain_file,
+	                              config.tls_private_key_file ) ) {
+		std::cerr << "Could not create a certificate\n";
+		return EXIT_FAILURE;
+	}
+
+	auto server = NetServer( config );
+	server.on_error( []( base::Error const &err ) {
+		std::cerr << "Error: " << err << '\n';
+	} );
+	server.on_connection( []( NetServerSocket socket ) {
+		socket.write_async( "hi\n" );
+		socket.close_when_writes_completed( );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+	auto ok = true;
+
+	auto io = asio::io_context( );
+	auto ctx = asio::ssl::context( asio::ssl::context::tls_client );
+	auto silent = ssl_stream_t( io, ctx );
+	ok &= check( read_greeting( silent, endpoint ) == "hi\n", "greeting" );
+
+	// The next read ends with the server's close_notify.  A TCP shutdown
+	// without one shows up as stream_truncated
+	auto ec = base::ErrorCode( );
+	auto byte = char( );
+	asio::read( silent, asio::buffer( &byte, 1 ), ec );
+	ok &= check( ec == asio::error::eof,
+	             "close_notify received, got: " + ec.message( ) );
+	auto const notified = std::chrono::steady_clock::now( );
+
+	// The silent client never answers.  Meanwhile others are still served
+	{
+		auto other = ssl_stream_t( io, ctx );
+		auto const start = std::chrono::steady_clock::now( );
+		ok &= check( read_greeting( other, endpoint ) == "hi\n",
+		             "another client served" );
+		ok &= check( std::chrono::steady_clock::now( ) - start < 500ms,
+		             "io thread responsive during the teardown" );
+		ok &= check( test::on_io_thread( []( ) { return true; } ),
+		             "io thread runs handlers" );
+	}
+
+	// Then the server gives up waiting and closes the TCP connection
+	auto const timeout = timeval{5, 0};
+	::setsockopt( silent.next_layer( ).native_handle( ), SOL_SOCKET,
+	              SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+	silent.next_layer( ).read_some( asio::buffer( &byte, 1 ), ec );
+	auto const waited = std::chrono::steady_clock::now( ) - notified;
+	ok &= check( ec == asio::error::eof,
+	             "closed after the timeout, got: " + ec.message( ) );
+	ok &= check( waited >= 500ms and waited < 4s,
+	             "closed after tls_shutdown_timeout" );
+
+	io_thread.stop( );
+	boost::filesystem::remove_all( cert_dir );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,215 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Checks the TLS write path.  tls_record_sizer_t keeps records to one TCP
+// segment until a connection has sent a bulk transfer's worth and again after
+// it idles.  tls_write_queue_t packs copied writes, keeps jobs in their place
+// and tells the caller when a flush must be scheduled.  Last, a TLS server
+// writes a reply, calls end( ) and asks to close straight away, the client
+// must still get all of it before the connection is shut down
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "lib_net_tls_writer.h"
+#include "test_certificate.h"
+#include "test_helpers.h"
+
+namespace {
+	using daw::nodepp::lib::net::nss_impl::tls_record_sizer_t;
+	using daw::nodepp::lib::net::nss_impl::tls_write_queue_t;
+	using asio::ip::tcp;
+
+	using daw::nodepp::test::check;
+
+	bool check_record_sizer( ) {
+		auto sizer = tls_record_sizer_t( );
+		auto now = tls_record_sizer_t::clock_type::now( );
+		auto ok = check( sizer.record_size( now ) ==
+		                   tls_record_sizer_t::small_record_size,
+		                 "a new connection starts with small records" );
+
+		sizer.sent( tls_record_sizer_t::bulk_threshold - 1, now );
+		ok &= check( sizer.record_size( now ) ==
+		               tls_record_sizer_t::small_record_size,
+		             "small records below the bulk threshold" );
+
+		sizer.sent( 1, now );
+		ok &= check( sizer.record_size( now ) ==
+		               tls_record_sizer_t::large_record_size,
+		             "large records from the bulk threshold on" );
+
+		now += tls_record_sizer_t::idle_timeout;
+		ok &= check( sizer.record_size( now ) ==
+		               tls_record_sizer_t::large_record_size,
+		             "large records until the idle timeout has passed" );
+
+		now += std::chrono::milliseconds( 1 );
+		ok &= check( sizer.record_size( now ) ==
+		               tls_record_sizer_t::small_record_size,
+		             "small records again after idling" );
+
+		sizer.sent( 100, now );
+		ok &= check( sizer.record_size( now ) ==
+		               tls_record_sizer_t::small_record_size,
+		             "the count starts over after idling" );
+		return ok;
+	}
+
+	std::string writing( tls_write_queue_t const &queue ) {
+		auto const buff = queue.writing( );
+		return std::string( static_cast<char const *>( buff.data( ) ),
+		                    buff.size( ) );
+	}
+
+	bool push( tls_write_queue_t &queue, std::string const &str ) {
+		return queue.push( str.data( ), str.data( ) + str.size( ) );
+	}
+
+	bool check_write_queue( ) {
+		auto queue = tls_write_queue_t( );
+		auto ok = check( push( queue, "a" ), "the first write schedules a flush" );
+		ok &= check( !push( queue, "bc" ),
+		             "a write while a flush is scheduled does not" );
+
+		auto order = std::vector<int>( );
+		ok &= check( !queue.push_job( [&order]( ) { order.push_back( 1 ); } ),
+		             "a job while a flush is scheduled does not" );
+		ok &= check( !push( queue, "d" ), "a write after a job does not" );
+		ok &= check( !push( queue, "e" ), "a second write after a job does not" );
+
+		ok &= check( !queue.take_job( ), "writes queued before a job go first" );
+		ok &= check( queue.take_writes( ) and writing( queue ) == "abc",
+		             "the writes before the job are packed together" );
+		ok &= check( !push( queue, "f" ),
+		             "a write while another is in flight does not flush" );
+		ok &= check( queue.finish_writes( 3 ) == 2,
+		             "the packed buffer holds two writes" );
+		ok &= check( writing( queue ).empty( ),
+		             "the write buffer is empty once sent" );
+
+		auto job = queue.take_job( );
+		ok &= check( static_cast<bool>( job ), "the job keeps its place" );
+		if( job ) {
+			( *job )( );
+		}
+		ok &= check( order.size( ) == 1, "the job is the one queued" );
+
+		ok &= check( queue.take_writes( ) and writing( queue ) == "def",
+		             "the writes after the job are packed together" );
+		ok &= check( queue.finish_writes( 3 ) == 3,
+		             "writes made during a flush join the next buffer" );
+
+		ok &= check( !queue.take_writes( ), "the queue is idle once empty" );
+		ok &= check( push( queue, "g" ), "a write on an idle queue flushes" );
+		ok &= check( !queue.push_job( []( ) {} ), "a job joins the pending flush" );
+		ok &= check( !push( queue, "h" ), "a write after it too" );
+		ok &= check( queue.clear( ) == 3, "clear counts each dropped write" );
+		ok &= check( push( queue, "i" ), "a cleared queue is idle" );
+		return ok;
+	}
+
+	// Read until the server shuts the connection down
+	bool check_end_flushes( tcp::endpoint const &endpoint,
+	                        std::string const &expected ) {
+		auto io = asio::io_context( );
+		auto ctx = asio::ssl::context( asio::ssl::context::tls_client );
+		auto stream = asio::ssl::stream<tcp::socket>( io, ctx );
+		stream.next_layer( ).connect( endpoint );
+		stream.handshake( asio::ssl::stream_base::client );
+
+		auto received = std::string( );
+		auto ec = daw::nodepp::base::ErrorCode( );
+		asio::read( stream, asio::dynamic_buffer( received ), ec );
+		auto ok = check( ec == asio::error::eof or
+		                   ec == asio::ssl::error::stream_truncated,
+		                 "the server shut the connection down" );
+		ok &= check( received == expected,
+		             "the reply written before end( ) arrived in full (" +
+		               std::to_string( received.size( ) ) + " of " +
+		               std::to_string( expected.size( ) ) + " bytes)" );
+		return ok;
+	}
+} // namespace
+
+int main( int argc, char const **argv ) {
+	using namespace daw::nodepp;
+	using lib::net::NetServer;
+	using lib::net::NetServerSocket;
+
+	auto ok = check_record_sizer( );
+	ok &= check_write_queue( );
+
+	auto const port =
+	  static_cast<uint16_t>( argc > 1 ? std::stoul( argv[1] ) : 8099U );
+
+	auto const cert_dir = boost::filesystem::temp_directory_path( ) /
+	                      boost::filesystem::unique_path( );
+	boost::filesystem::create_directories( cert_dir );
+	auto config = lib::net::SslServerConfig{};
+	config.tls_certificate_chain_file = ( cert_dir / "cert.pem" ).string( );
+	config.tls_private_key_file = ( cert_dir / "key.pem" ).string( );
+	config.tls_kernel_offload = false;
+	if( !test::write_certificate( config.tls_certificate_chain_file,
+	                              config.tls_private_key_file ) ) {
+		std::cerr << "Could not create a certificate\n";
+		return EXIT_FAILURE;
+	}
+
+	// Several writes, one larger than a record, so the reply needs more
+	// than one flush
+	auto const head = std::string( "head\n" );
+	auto const body = std::string( 100U * 1024U, 'x' );
+	auto const tail = std::string( "tail\n" );
+
+	auto server = NetServer( config );
+	server.on_error( []( base::Error const &err ) {
+		std::cerr << "Error: " << err << '\n';
+	} );
+	server.on_connection( [&]( NetServerSocket socket ) {
+		socket.write_async( head );
+		socket.write_async( body );
+		socket.end( tail );
+		socket.close_when_writes_completed( );
+	} );
+	server.listen( port, lib::net::ip_version::ipv4 );
+
+	auto io_thread = test::io_thread_t( );
+
+	ok &= check_end_flushes(
+	  tcp::endpoint( asio::ip::address_v4::loopback( ), port ),
+	  head + body + tail );
+
+	io_thread.stop( );
+	boost::filesystem::remove_all( cert_dir );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
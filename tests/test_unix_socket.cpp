@@ -0,0 +1,190 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 Darrell Wright
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files( the "Software" ), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and / or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+
+// Checks unix domain socket listeners and connections.  A server listening
+// on a socket file and one on an abstract name each greet a client, a stale
+// socket file is replaced when listening again while one a server still
+// listens on is not, and connect_unix_async reaches a listener and reports
+// one that is not there.  Servers and accepted sockets report "unix:"
+// addresses rather than decoding them as IP
+
+#include <asio.hpp>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "base_service_handle.h"
+#include "lib_net_server.h"
+#include "lib_net_unix_socket.h"
+#include "test_helpers.h"
+
+namespace {
+	using daw::nodepp::lib::net::NetServer;
+	using daw::nodepp::lib::net::NetServerSocket;
+	using local = asio::local::stream_protocol;
+
+	local::endpoint make_endpoint( std::string path ) {
+		if( path.front( ) == '@' ) {
+			path.front( ) = '\0';
+		}
+		return local::endpoint( path );
+	}
+
+	std::string read_greeting( std::string const &path ) {
+		auto io = asio::io_context( );
+		auto socket = local::socket( io );
+		auto ec = daw::nodepp::base::ErrorCode( );
+		socket.connect( make_endpoint( path ), ec );
+		if( ec ) {
+			return "connect failed: " + ec.message( );
+		}
+		auto result = std::string( );
+		asio::read_until( socket, asio::dynamic_buffer( result ), '\n', ec );
+		return result;
+	}
+
+	using daw::nodepp::test::on_io_thread;
+
+	// Leaves a socket file behind with nothing listening on it, as a server
+	// that crashed would
+	void make_stale_socket( std::string const &path ) {
+		auto io = asio::io_context( );
+		auto acceptor = local::acceptor( io, local::endpoint( path ) );
+	}
+
+	bool is_socket_file( std::string const &path ) {
+		struct stat st {};
+		return ::stat( path.c_str( ), &st ) == 0 and S_ISSOCK( st.st_mode );
+	}
+
+	using daw::nodepp::test::check;
+} // namespace
+
+int main( ) {
+	using namespace daw::nodepp;
+
+	auto const file_path =
+	  "/tmp/nodepp_test_unix_socket_" + std::to_string( ::getpid( ) );
+	auto const abstract_path =
+	  "@nodepp_test_unix_socket_" + std::to_string( ::getpid( ) );
+	auto errors = std::vector<std::string>( );
+	auto servers = std::vector<std::unique_ptr<NetServer>>( );
+	auto addresses = std::vector<std::string>( );
+
+	auto const start_server = [&]( std::string const &path ) {
+		servers.push_back( std::make_unique<NetServer>( ) );
+		auto &server = *servers.back( );
+		server.on_error( [&]( base::Error const &err ) {
+			errors.push_back( err.to_string( ) );
+		} );
+		server.on_connection( [&addresses]( NetServerSocket socket ) {
+			addresses.push_back( socket.local_address( ) + ' ' +
+			                     socket.remote_address( ) + ' ' +
+			                     std::to_string( socket.remote_port( ) ) );
+			socket.write_async( "hi\n" );
+			socket.close_when_writes_completed( );
+		} );
+		server.listen_unix( path );
+	};
+
+	start_server( file_path );
+	start_server( abstract_path );
+
+	auto io_thread = test::io_thread_t( );
+	auto ok = true;
+
+	ok &= check( is_socket_file( file_path ), "socket file created" );
+	ok &= check( read_greeting( file_path ) == "hi\n", "socket file" );
+	ok &= check( read_greeting( abstract_path ) == "hi\n", "abstract name" );
+
+	auto const address = [&]( size_t n ) {
+		return on_io_thread(
+		  [&]( ) { return servers[n]->address( )( ).to_string( ); } );
+	};
+	ok &= check( address( 0 ) == "unix:" + file_path, "file server address" );
+	ok &= check( address( 1 ) == "unix:" + abstract_path,
+	             "abstract server address" );
+	auto const accepted = on_io_thread( [&]( ) { return addresses; } );
+	ok &= check( accepted.size( ) == 2 and
+	               accepted[0] == "unix:" + file_path + " unix 0" and
+	               accepted[1] == "unix:" + abstract_path + " unix 0",
+	             "accepted socket addresses" );
+
+	auto const stale_path = file_path + "_stale";
+	make_stale_socket( stale_path );
+	on_io_thread( [&]( ) {
+		start_server( stale_path );
+		return true;
+	} );
+	ok &= check( read_greeting( stale_path ) == "hi\n", "stale file replaced" );
+
+	auto const connect = [&]( std::string const &path ) {
+		auto socket = asio::ip::tcp::socket( base::ServiceHandle::get( ) );
+		auto result = std::promise<base::ErrorCode>( );
+		auto fut = result.get_future( );
+		lib::net::nss_impl::connect_unix_async(
+		  socket, path,
+		  [&result]( base::ErrorCode err ) { result.set_value( err ); } );
+		auto const err = fut.get( );
+		auto greeting = std::string( );
+		if( !err ) {
+			auto ec = base::ErrorCode( );
+			asio::read_until( socket, asio::dynamic_buffer( greeting ), '\n', ec );
+		}
+		return std::make_pair( err, greeting );
+	};
+	auto const connected = connect( abstract_path );
+	ok &= check( !connected.first and connected.second == "hi\n",
+	             "connect_unix_async" );
+	ok &= check( static_cast<bool>( connect( abstract_path + "_none" ).first ),
+	             "connect_unix_async without a listener" );
+
+	auto const error_count = on_io_thread( [&]( ) { return errors.size( ); } );
+	ok &= check( error_count == 0, "no server errors" );
+
+	// The first server still listens on its file, a second may not take it
+	auto const in_use_errors = on_io_thread( [&]( ) {
+		start_server( file_path );
+		return errors.size( );
+	} );
+	ok &= check( in_use_errors == 1, "socket file in use reported" );
+	ok &= check( read_greeting( file_path ) == "hi\n",
+	             "first server keeps its socket file" );
+	if( in_use_errors != 1 ) {
+		for( auto const &err : errors ) {
+			std::cerr << err << '\n';
+		}
+	}
+
+	io_thread.stop( );
+	::unlink( file_path.c_str( ) );
+	::unlink( stale_path.c_str( ) );
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
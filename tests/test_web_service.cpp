@@ -161,6 +161,8 @@ Just tip me over and pour me out)" )
 
 	teapot.connect( site );
 
-	base::start_service( base::StartServiceMode::OnePerCore );
+	base::start_service( base::is_single_threaded
+	                       ? base::StartServiceMode::Single
+	                       : base::StartServiceMode::OnePerCore );
 	return EXIT_SUCCESS;
 }
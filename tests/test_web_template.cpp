@@ -122,7 +122,9 @@ int main( int argc, char const **argv ) {
 	  .on_error( []( auto err ) { std::cerr << err << std::endl; } )
 	  .listen_on( config.port, daw::nodepp::lib::net::ip_version::ipv4_v6, 1024 );
 
-	base::start_service( base::StartServiceMode::OnePerCore );
+	base::start_service( base::is_single_threaded
+	                       ? base::StartServiceMode::Single
+	                       : base::StartServiceMode::OnePerCore );
 	//	base::ServiceHandle::run( );
 	return EXIT_SUCCESS;
 }